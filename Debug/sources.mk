@@ -24,11 +24,16 @@ OBJS :=
 # Every subdirectory with source files must be described here
 SUBDIRS := \
 src/APDS9660 \
+src/AttitudeFilter \
 src/BME688 \
+src/I2CSimulator \
 src/IAQTracker \
 src/LSM6DSOX \
+src/MotionCodec \
+src/OccupancyEngine \
 src/PWMDriver \
 src/TFTDriver \
+src/VibrationAnalyzer \
 src/custom_gpio \
 src/i2c_master \
 src \
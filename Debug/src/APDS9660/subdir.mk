@@ -4,13 +4,22 @@
 
 # Add inputs and outputs from these tool invocations to the build variables 
 CPP_SRCS += \
-../src/APDS9660/APDS9660_lib.cpp 
+../src/APDS9660/APDS9660_lib.cpp \
+../src/APDS9660/als_autorange.cpp \
+../src/APDS9660/gesture_classifier.cpp \
+../src/APDS9660/light_meter.cpp 
 
 CPP_DEPS += \
-./src/APDS9660/APDS9660_lib.d 
+./src/APDS9660/APDS9660_lib.d \
+./src/APDS9660/als_autorange.d \
+./src/APDS9660/gesture_classifier.d \
+./src/APDS9660/light_meter.d 
 
 OBJS += \
-./src/APDS9660/APDS9660_lib.o 
+./src/APDS9660/APDS9660_lib.o \
+./src/APDS9660/als_autorange.o \
+./src/APDS9660/gesture_classifier.o \
+./src/APDS9660/light_meter.o 
 
 
 # Each subdirectory must supply rules for building sources it contributes
@@ -25,7 +34,7 @@ src/APDS9660/%.o: ../src/APDS9660/%.cpp src/APDS9660/subdir.mk
 clean: clean-src-2f-APDS9660
 
 clean-src-2f-APDS9660:
-	-$(RM) ./src/APDS9660/APDS9660_lib.d ./src/APDS9660/APDS9660_lib.o
+	-$(RM) ./src/APDS9660/APDS9660_lib.d ./src/APDS9660/APDS9660_lib.o ./src/APDS9660/als_autorange.d ./src/APDS9660/als_autorange.o ./src/APDS9660/gesture_classifier.d ./src/APDS9660/gesture_classifier.o ./src/APDS9660/light_meter.d ./src/APDS9660/light_meter.o
 
 .PHONY: clean-src-2f-APDS9660
 
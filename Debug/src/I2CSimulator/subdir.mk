@@ -0,0 +1,34 @@
+################################################################################
+# Automatically-generated file. Do not edit!
+################################################################################
+
+# Add inputs and outputs from these tool invocations to the build variables 
+CPP_SRCS += \
+../src/I2CSimulator/i2c_simulator.cpp \
+../src/I2CSimulator/sim_devices.cpp 
+
+CPP_DEPS += \
+./src/I2CSimulator/i2c_simulator.d \
+./src/I2CSimulator/sim_devices.d 
+
+OBJS += \
+./src/I2CSimulator/i2c_simulator.o \
+./src/I2CSimulator/sim_devices.o 
+
+
+# Each subdirectory must supply rules for building sources it contributes
+src/I2CSimulator/%.o: ../src/I2CSimulator/%.cpp src/I2CSimulator/subdir.mk
+	@echo 'Building file: $<'
+	@echo 'Invoking: Cross G++ Compiler'
+	aarch64-poky-linux-gcc  -mcpu=cortex-a53 -march=armv8-a+crc -mbranch-protection=standard -fstack-protector-strong  -O2 -D_FORTIFY_SOURCE=2 -Wformat -Wformat-security -Werror=format-security --sysroot=/home/ubuntu/kirk_yocto/sdk3/sysroots/cortexa53-poky-linux -O0 -g3 -Wall -c -fmessage-length=0 -MMD -MP -MF"$(@:%.o=%.d)" -MT"$@" -o "$@" "$<"
+	@echo 'Finished building: $<'
+	@echo ' '
+
+
+clean: clean-src-2f-I2CSimulator
+
+clean-src-2f-I2CSimulator:
+	-$(RM) ./src/I2CSimulator/i2c_simulator.d ./src/I2CSimulator/i2c_simulator.o ./src/I2CSimulator/sim_devices.d ./src/I2CSimulator/sim_devices.o
+
+.PHONY: clean-src-2f-I2CSimulator
+
@@ -0,0 +1,31 @@
+################################################################################
+# Automatically-generated file. Do not edit!
+################################################################################
+
+# Add inputs and outputs from these tool invocations to the build variables 
+CPP_SRCS += \
+../src/MotionCodec/MotionCodec.cpp 
+
+CPP_DEPS += \
+./src/MotionCodec/MotionCodec.d 
+
+OBJS += \
+./src/MotionCodec/MotionCodec.o 
+
+
+# Each subdirectory must supply rules for building sources it contributes
+src/MotionCodec/%.o: ../src/MotionCodec/%.cpp src/MotionCodec/subdir.mk
+	@echo 'Building file: $<'
+	@echo 'Invoking: Cross G++ Compiler'
+	aarch64-poky-linux-gcc  -mcpu=cortex-a53 -march=armv8-a+crc -mbranch-protection=standard -fstack-protector-strong  -O2 -D_FORTIFY_SOURCE=2 -Wformat -Wformat-security -Werror=format-security --sysroot=/home/ubuntu/kirk_yocto/sdk3/sysroots/cortexa53-poky-linux -O0 -g3 -Wall -c -fmessage-length=0 -MMD -MP -MF"$(@:%.o=%.d)" -MT"$@" -o "$@" "$<"
+	@echo 'Finished building: $<'
+	@echo ' '
+
+
+clean: clean-src-2f-MotionCodec
+
+clean-src-2f-MotionCodec:
+	-$(RM) ./src/MotionCodec/MotionCodec.d ./src/MotionCodec/MotionCodec.o
+
+.PHONY: clean-src-2f-MotionCodec
+
@@ -4,13 +4,16 @@
 
 # Add inputs and outputs from these tool invocations to the build variables 
 CPP_SRCS += \
-../src/LSM6DSOX/LSM6DSOX.cpp 
+../src/LSM6DSOX/LSM6DSOX.cpp \
+../src/LSM6DSOX/mlc_reference.cpp 
 
 CPP_DEPS += \
-./src/LSM6DSOX/LSM6DSOX.d 
+./src/LSM6DSOX/LSM6DSOX.d \
+./src/LSM6DSOX/mlc_reference.d 
 
 OBJS += \
-./src/LSM6DSOX/LSM6DSOX.o 
+./src/LSM6DSOX/LSM6DSOX.o \
+./src/LSM6DSOX/mlc_reference.o 
 
 
 # Each subdirectory must supply rules for building sources it contributes
@@ -25,7 +28,7 @@ src/LSM6DSOX/%.o: ../src/LSM6DSOX/%.cpp src/LSM6DSOX/subdir.mk
 clean: clean-src-2f-LSM6DSOX
 
 clean-src-2f-LSM6DSOX:
-	-$(RM) ./src/LSM6DSOX/LSM6DSOX.d ./src/LSM6DSOX/LSM6DSOX.o
+	-$(RM) ./src/LSM6DSOX/LSM6DSOX.d ./src/LSM6DSOX/LSM6DSOX.o ./src/LSM6DSOX/mlc_reference.d ./src/LSM6DSOX/mlc_reference.o
 
 .PHONY: clean-src-2f-LSM6DSOX
 
@@ -4,13 +4,22 @@
 
 # Add inputs and outputs from these tool invocations to the build variables 
 CPP_SRCS += \
-../src/i2c_master/i2c_master.cpp 
+../src/i2c_master/i2c_async.cpp \
+../src/i2c_master/i2c_master.cpp \
+../src/i2c_master/i2c_replay.cpp \
+../src/i2c_master/i2c_trace.cpp 
 
 CPP_DEPS += \
-./src/i2c_master/i2c_master.d 
+./src/i2c_master/i2c_async.d \
+./src/i2c_master/i2c_master.d \
+./src/i2c_master/i2c_replay.d \
+./src/i2c_master/i2c_trace.d 
 
 OBJS += \
-./src/i2c_master/i2c_master.o 
+./src/i2c_master/i2c_async.o \
+./src/i2c_master/i2c_master.o \
+./src/i2c_master/i2c_replay.o \
+./src/i2c_master/i2c_trace.o 
 
 
 # Each subdirectory must supply rules for building sources it contributes
@@ -25,7 +34,7 @@ src/i2c_master/%.o: ../src/i2c_master/%.cpp src/i2c_master/subdir.mk
 clean: clean-src-2f-i2c_master
 
 clean-src-2f-i2c_master:
-	-$(RM) ./src/i2c_master/i2c_master.d ./src/i2c_master/i2c_master.o
+	-$(RM) ./src/i2c_master/i2c_async.d ./src/i2c_master/i2c_async.o ./src/i2c_master/i2c_master.d ./src/i2c_master/i2c_master.o ./src/i2c_master/i2c_replay.d ./src/i2c_master/i2c_replay.o ./src/i2c_master/i2c_trace.d ./src/i2c_master/i2c_trace.o
 
 .PHONY: clean-src-2f-i2c_master
 
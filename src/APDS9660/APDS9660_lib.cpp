@@ -11,289 +11,449 @@
 
 #include "./APDS9660_lib.h"
 #include <cmath>
+#include <cstring>
+#include <mutex>
 
-static uint8_t rgb_gain;
+const float als_gains[4] = {1, 4, 16, 64};
 
-int APDS9660_Master::conf_rgbc(int gain){
-	
-	uint8_t data[2] = {0x80,0x00};
-	uint8_t read_data;
-	I2C_Master::read_msg(0x39,0x80,&read_data,1);
-	if((read_data & 0x03) != 3){
-		printf("Setting enable register to ALS EN and Power ON\n");
-		data[1] = read_data | 0x03;
-		I2C_Master::write_msg(0x39,data,2);
-	}
+//Channel selected in each mux plus one, 0 if unknown. Indexed by bus and address 0x70-0x77.
+static uint8_t mux_selected[I2C_MAX_BUSES][8];
+static std::mutex mux_mutex;
 
+//Sensor used by the APDS9660_Master functions
+static APDS9660 default_sensor;
 
-	I2C_Master::read_msg(0x39,0x8f,&read_data,1);
-	if((read_data & 0x3) != gain){
-		printf("Setting gain to %d\n", gain);
-		data[0] = 0x8f;
-		data[1] = read_data | gain;
-		I2C_Master::write_msg(0x39,data,2);
-		rgb_gain = gain;
-	} else{
-		rgb_gain = read_data & 0x3;
-	}
+APDS9660::APDS9660(int bus, uint8_t addr, uint8_t mux_addr, uint8_t mux_channel){
+
+	this->bus = bus;
+	this->addr = addr;
+	this->mux_addr = mux_addr;
+	this->mux_channel = mux_channel;
+
+	std::memset(shadow, 0, sizeof(shadow));
+	std::memset(shadow_valid, 0, sizeof(shadow_valid));
+
+	rgb_gain = 0;
+	als_atime = 0xFF;
+	prox_low_th = 0;
+	prox_high_th = 255;
+	prox_near = false;
+	ges_int = 0x00;
+}
 
+int APDS9660::conf_rgbc(int gain){
+
+	if(update_reg(0x80, 0x03, 0x03) < 0)
+		return -1;
+
+	if(update_reg(0x8f, 0x03, gain & 0x03) < 0)
+		return -1;
+	rgb_gain = gain & 0x03;
 
 	return 0;
 }
 
+int APDS9660::conf_als_range(int gain, uint8_t atime){
 
+	if(update_reg(0x8f, 0x03, gain & 0x03) < 0)
+		return -1;
+	rgb_gain = gain & 0x03;
 
-int APDS9660_Master::conf_proximity(int gain, int ledBoost){
-	
-	uint8_t data[2] = {0x80,0x00};
-	uint8_t read_data;
-	
-	I2C_Master::read_msg(0x39,0x80,&read_data,1);
-	
-	if((read_data & 0x05) != 5){
-		printf("Setting enable register to Prox EN and Power ON\n");
-		data[1] = read_data | 0x05;
-		I2C_Master::write_msg(0x39,data,2);
-	}
+	if(update_reg(0x81, 0xFF, atime) < 0)
+		return -1;
+	als_atime = atime;
 
-	I2C_Master::read_msg(0x39,0x8f,&read_data,1);
-	printf("Proximity gain: %x\n", read_data);
-	if((read_data & 0x0C) != gain){
-		printf("Setting LED gain to %d\n", ledBoost);
-		data[0] = 0x8f;
-		data[1] = read_data | (gain << 2);
-		I2C_Master::write_msg(0x39,data,2);
-	}
-	
-	I2C_Master::read_msg(0x39,0x90,&read_data,1);
-	printf("Proximity %x\n", read_data);
-	if((read_data & 0x30) != ledBoost){
-		printf("Setting LED Boost to %d\n", ledBoost);
-		data[0] = 0x90;
-		data[1] = read_data | ((ledBoost & 0x03) << 4);
-		I2C_Master::write_msg(0x39,data,2);
-	}
-	
 	return 0;
+}
 
+int APDS9660::conf_proximity(int gain, int ledBoost){
+
+	if(update_reg(0x80, 0x05, 0x05) < 0)
+		return -1;
+
+	if(update_reg(0x8f, 0x0C, (gain & 0x03) << 2) < 0)
+		return -1;
+
+	if(update_reg(0x90, 0x30, (ledBoost & 0x03) << 4) < 0)
+		return -1;
+
+	return 0;
 }
 
-int APDS9660_Master::conf_gesture(int ledBoost, uint8_t proximity_enter, uint8_t proximity_exit){
+int APDS9660::conf_proximity_int(int enable, uint8_t low_th, uint8_t high_th, uint8_t persistence){
 
-	uint8_t data[2] = {0x80,0x00};
-	uint8_t read_data;
+	prox_low_th = low_th;
+	prox_high_th = high_th;
+	prox_near = false;
 
-	I2C_Master::read_msg(0x39,0xA3,&read_data,1);
-	printf("Gesture gain: %x\n", read_data);
-	if(read_data != 0x65){
-		printf("Setting LED Gain to x8\n");
-		data[0] = 0xA3;
-		data[1] = read_data | 0x65;
-		I2C_Master::write_msg(0x39,data,2);
-	}
+	if(arm_proximity_int() < 0)
+		return -1;
 
-	I2C_Master::read_msg(0x39,0x80,&read_data,1);
-	if((read_data & 0x41) != 0x41){
-		printf("Setting enable register to Ges EN and Power ON\n");
-		data[0] = 0x80;
-		data[1] = read_data | 0x41;
-		I2C_Master::write_msg(0x39,data,2);
-	}
+	if(update_reg(0x8C, 0xF0, (persistence & 0x0F) << 4) < 0)
+		return -1;
 
-	I2C_Master::read_msg(0x39,0x8f,&read_data,1);
-	printf("Proximity gain: %x\n", read_data);
-	if((read_data & 0x0C >> 2) != 3){
-		printf("Setting LED gain to %d\n", ledBoost);
-		data[0] = 0x8f;
-		data[1] = read_data | 0x0C;
-		I2C_Master::write_msg(0x39,data,2);
-	}
+	//Start with no interrupt pending so the pin is released
+	if(write_cmd(0xE5) < 0)
+		return -1;
+
+	if(update_reg(0x80, 0x20, enable ? 0x20 : 0x00) < 0)
+		return -1;
+
+	return 0;
+}
 
-	I2C_Master::read_msg(0x39,0x8f,&read_data,1);
-	printf("Proximity gain 2n measure: %x\n", read_data);
+int APDS9660::read_proximity_event(uint8_t *prox){
 
+	uint8_t status;
 
-	I2C_Master::read_msg(0x39,0x90,&read_data,1);
-	printf("Gesture Led Boost %x\n", read_data);
-	if(((read_data & 0x30) >> 4) != ledBoost){
-		printf("Setting LED Boost to %d\n", ledBoost);
-		data[0] = 0x90;
-		data[1] = read_data | ((ledBoost & 0x03) << 4);
-		I2C_Master::write_msg(0x39,data,2);
+	if(read_regs(0x93,&status,1) < 0)
+		return -1;
+
+	if(!(status & 0x20))
+		return 0;
+
+	if(read_regs(0x9C,prox,1) < 0)
+		return -1;
+
+	//Persistence 0 interrupts on every cycle, so the side is checked here
+	int event = 0;
+	if(!prox_near && *prox > prox_high_th)
+		event = PROX_NEAR;
+	else if(prox_near && *prox < prox_low_th)
+		event = PROX_FAR;
+
+	if(event){
+		prox_near = event == PROX_NEAR;
+		if(arm_proximity_int() < 0)
+			return -1;
 	}
 
-	//Clear FIFO data
+	if(write_cmd(0xE5) < 0)
+		return -1;
 
-	data[0] = 0xAB;
-	data[1] = 0x04;
+	return event;
+}
 
-	I2C_Master::write_msg(0x39,data,2);
+int APDS9660::conf_gesture(int ledBoost, uint8_t proximity_enter, uint8_t proximity_exit){
 
-	//Proximity enter
+	//Gesture gain x8, wait time 5
+	if(update_reg(0xA3, 0xFF, 0x65) < 0)
+		return -1;
 
-	data[0] = 0xA0;
-	data[1] = proximity_enter;
+	if(update_reg(0x80, 0x41, 0x41) < 0)
+		return -1;
 
-	I2C_Master::write_msg(0x39,data,2);
+	if(update_reg(0x8f, 0x0C, 0x0C) < 0)
+		return -1;
 
-	//Proximity exit
+	if(update_reg(0x90, 0x30, (ledBoost & 0x03) << 4) < 0)
+		return -1;
 
-	data[0] = 0xA1;
-	data[1] = proximity_exit;
+	//Clear FIFO data
+	clear_ges_fifo();
 
-	I2C_Master::write_msg(0x39,data,2);
+	//Proximity enter and exit
+	if(update_reg(0xA0, 0xFF, proximity_enter) < 0)
+		return -1;
+
+	if(update_reg(0xA1, 0xFF, proximity_exit) < 0)
+		return -1;
 
 	//Proximity threshold
+	if(update_reg(0xA2, 0xFF, 0x40) < 0)
+		return -1;
+
+	return 0;
+}
 
-	data[0] = 0xA2;
-	data[1] = 0x40;
+int APDS9660::conf_gesture_int(int enable, uint8_t fifo_th){
 
-	I2C_Master::write_msg(0x39,data,2);
+	if(update_reg(0xA2, 0xC0, (fifo_th & 0x03) << 6) < 0)
+		return -1;
 
-	return 0;
+	ges_int = enable ? 0x02 : 0x00;
 
+	//Start with an empty FIFO so the pin is released
+	return clear_ges_fifo();
 }
 
-color_data APDS9660_Master::read_rgbc(){
+uint8_t APDS9660::check_gesture(){
 
-	uint8_t rgbc[8];
+	uint8_t data_valid = 0;
 
-	color_data data;
+	if(read_regs(0xAF,&data_valid,1) < 0)
+		return 0;
 
-	I2C_Master::read_msg(0x39,0x94,rgbc,8);
+	return data_valid & 0x01;
+}
+
+int APDS9660::read_ges_fifo(uint8_t *datasets, int max_datasets){
+
+	uint8_t fifo_level = 0;
 
-	data.clear = rgbc[1] << 8 | rgbc[0];
-	data.red = rgbc[3] << 8 | rgbc[2];
-	data.green = rgbc[5] << 8 | rgbc[4];
-	data.blue = rgbc[7] << 8 | rgbc[6];
+	if(read_regs(0xAE,&fifo_level,1) < 0)
+		return -1;
 
-	return data;
+	if(fifo_level > max_datasets)
+		fifo_level = max_datasets;
+	if(fifo_level > GES_FIFO_DATASETS)
+		fifo_level = GES_FIFO_DATASETS;
+	if(fifo_level == 0)
+		return 0;
+
+	//The address wraps from 0xFF back to 0xFC, so one read drains the FIFO
+	if(read_regs(0xFC,datasets,fifo_level * 4) < 0)
+		return -1;
+
+	return fifo_level;
 }
 
-uint8_t APDS9660_Master::read_proximity(){
+int APDS9660::read_rgbc(color_data *data){
 
-	uint8_t prox;
+	uint8_t rgbc[8];
 
-	I2C_Master::read_msg(0x39,0x9C,&prox,1);
+	if(read_regs(0x94,rgbc,8) < 0)
+		return -1;
 
-	return prox;
+	data->clear = rgbc[1] << 8 | rgbc[0];
+	data->red = rgbc[3] << 8 | rgbc[2];
+	data->green = rgbc[5] << 8 | rgbc[4];
+	data->blue = rgbc[7] << 8 | rgbc[6];
+	data->gain = rgb_gain;
+	data->atime = als_atime;
+	data->cct = 0;
+	data->lux = calc_illuminance(*data);
+
+	return 0;
 }
 
-uint8_t APDS9660_Master::check_gesture(){
+int APDS9660::read_proximity(uint8_t *prox){
+
+	if(read_regs(0x9C,prox,1) < 0)
+		return -1;
+
+	return 0;
+}
 
-	uint8_t data_valid;
+float APDS9660::calc_illuminance(color_data data){
 
-	uint8_t fifo_level;
+	//The range the sample was taken with, the sensor may have been re-ranged since
+	float illuminance = (data.clear/(als_gains[data.gain & 0x03]*(256 - data.atime)))/0.216;
 
-	I2C_Master::read_msg(0x39,0xAF,&data_valid,1);
+	return illuminance;
 
-	I2C_Master::read_msg(0x39,0xAE,&fifo_level,1);
+}
 
+int APDS9660::read_rgbc_all(APDS9660 *sensors[], int n, color_data data[], int results[]){
 
-	return data_valid & 0x01;
+	int order[APDS9660_MAX_SENSORS];
+	int valid = 0;
+
+	if(n > APDS9660_MAX_SENSORS)
+		return -1;
+
+	//Sensors behind the same mux channel go together, so each channel is selected once
+	for(int i = 0; i < n; i++)
+		order[i] = i;
+	for(int i = 1; i < n; i++){
+		int current = order[i];
+		int j = i;
+		while(j > 0 && sensors[current]->before(sensors[order[j - 1]])){
+			order[j] = order[j - 1];
+			j--;
+		}
+		order[j] = current;
+	}
+
+	for(int i = 0; i < n; i++){
+		int k = order[i];
+		results[k] = sensors[k]->read_rgbc(&data[k]);
+		if(results[k] == 0)
+			valid++;
+	}
+
+	return valid;
 }
 
-uint8_t APDS9660_Master::read_ges_fifo_ud(){
+/* Private functions ---------------------------------------------------------*/
 
-	uint8_t data[4];
+/**
+ * @brief Routes the bus to the sensor through its mux. The selected channel
+ *        is cached, so it is only written when another one was in use.
+ */
+int APDS9660::select(){
+
+	if(mux_addr == APDS9660_NO_MUX)
+		return 0;
+	if(bus < 0 || bus >= I2C_MAX_BUSES)
+		return -1;
+
+	uint8_t *selected = &mux_selected[bus][mux_addr & 0x07];
+	if(*selected == mux_channel + 1)
+		return 0;
+
+	uint8_t mask = 1 << mux_channel;
+	if(I2C_Master::write_msg_bus(bus,mux_addr,&mask,1) < 0){
+		*selected = 0;
+		return -1;
+	}
+	*selected = mux_channel + 1;
 
-	uint8_t up = 0,down = 0;
+	return 0;
+}
 
-	uint8_t fifo_level;
+/**
+ * @brief Reads `len` registers from `reg` on. The mux is held from the channel
+ *        selection until the transaction ends.
+ */
+int APDS9660::read_regs(uint8_t reg, uint8_t *data, int len){
 
-	uint8_t motion = 0;
+	std::unique_lock<std::mutex> lock(mux_mutex, std::defer_lock);
 
-	I2C_Master::read_msg(0x39,0xAE,&fifo_level,1);
+	if(mux_addr != APDS9660_NO_MUX)
+		lock.lock();
 
-	I2C_Master::read_msg(0x39,0xAF,data,4);
+	if(select() < 0)
+		return -1;
 
-	while(fifo_level>0 && motion == 0){
-		I2C_Master::read_msg(0x39,0xFC,data,4);
+	return I2C_Master::read_msg_bus(bus,addr,reg,data,len) < 0 ? -1 : 0;
+}
 
-		if(data[0]-data[1] < 2){
-			if(down == 0){
-				down++;
-			}
+/**
+ * @brief Writes a register, or only the register address when `len` is 1.
+ */
+int APDS9660::write_regs(uint8_t *data, int len){
 
-			if(up > 0){
-				motion = DOWN;
-			}
+	std::unique_lock<std::mutex> lock(mux_mutex, std::defer_lock);
 
-		}else if(data[0] - data[1] > 5){
+	if(mux_addr != APDS9660_NO_MUX)
+		lock.lock();
 
-			if(up == 0){
-				up++;
-			}
+	if(select() < 0)
+		return -1;
 
-			if(down > 0){
-				motion = UP;
-			}
-		}
+	if(I2C_Master::write_msg_bus(bus,addr,data,len) < 0)
+		return -1;
 
-		I2C_Master::read_msg(0x39,0xAE,&fifo_level,1);
+	if(len == 2){
+		shadow[data[0]] = data[1];
+		shadow_valid[data[0] >> 3] |= 1 << (data[0] & 0x07);
 	}
 
-	data[0] = 0xAB;
-	data[1] = 0x04;
+	return 0;
+}
 
-	I2C_Master::write_msg(0x39,data,2);
+/**
+ * @brief Sends only a register address, as the special function registers
+ *        (interrupt clears) need.
+ */
+int APDS9660::write_cmd(uint8_t reg){
 
-	return motion;
+	return write_regs(&reg, 1);
 }
 
-uint8_t APDS9660_Master::read_ges_fifo_lr(){
+/**
+ * @brief Changes the `mask` bits of a configuration register. The register is
+ *        read only the first time and not written if it already holds the value.
+ */
+int APDS9660::update_reg(uint8_t reg, uint8_t mask, uint8_t value){
+
+	if(!(shadow_valid[reg >> 3] & (1 << (reg & 0x07)))){
+		if(read_regs(reg,&shadow[reg],1) < 0)
+			return -1;
+		shadow_valid[reg >> 3] |= 1 << (reg & 0x07);
+	}
 
-	uint8_t data[4];
+	uint8_t data[2] = {reg, (uint8_t)((shadow[reg] & ~mask) | (value & mask))};
+	if(data[1] == shadow[reg])
+		return 0;
 
-	uint8_t left = 0,right = 0;
+	return write_regs(data, 2);
+}
 
-	uint8_t fifo_level;
+/**
+ * @brief Writes the thresholds for the next crossing: the high one while the
+ *        object is far, the low one while it is near.
+ */
+int APDS9660::arm_proximity_int(){
 
-	uint8_t motion = 0;
+	if(update_reg(0x89, 0xFF, prox_near ? prox_low_th : 0) < 0)
+		return -1;
 
-	I2C_Master::read_msg(0x39,0xAE,&fifo_level,1);
+	if(update_reg(0x8B, 0xFF, prox_near ? 255 : prox_high_th) < 0)
+		return -1;
 
-	I2C_Master::read_msg(0x39,0xAF,data,4);
+	return 0;
+}
 
-	while(fifo_level>0 && motion == 0){
-		I2C_Master::read_msg(0x39,0xFC,data,4);
+/**
+ * @brief Clears the gesture FIFO, keeping the interrupt enable.
+ */
+int APDS9660::clear_ges_fifo(){
 
-		if(data[2]-data[3] < 2){
-			if(right == 0){
-				right++;
-			}
+	uint8_t data[2] = {0xAB, (uint8_t)(0x04 | ges_int)};
 
-			if(left > 0){
-				motion = RIGHT;
-			}
+	return write_regs(data, 2);
+}
 
-		}else if(data[2] - data[3] > 5){
+/**
+ * @brief Order of the sensors in a joint sampling: by bus, mux and channel.
+ */
+bool APDS9660::before(const APDS9660 *other) const{
+
+	if(bus != other->bus)
+		return bus < other->bus;
+	if(mux_addr != other->mux_addr)
+		return mux_addr < other->mux_addr;
+	return mux_channel < other->mux_channel;
+}
 
-			if(left == 0){
-				left++;
-			}
+/* APDS9660_Master -----------------------------------------------------------*/
 
-			if(right > 0){
-				motion = LEFT;
-			}
-		}
+int APDS9660_Master::conf_rgbc(int gain){
+	return default_sensor.conf_rgbc(gain);
+}
 
-		I2C_Master::read_msg(0x39,0xAE,&fifo_level,1);
-	}
+int APDS9660_Master::conf_als_range(int gain, uint8_t atime){
+	return default_sensor.conf_als_range(gain, atime);
+}
+
+int APDS9660_Master::conf_proximity(int gain, int ledBoost){
+	return default_sensor.conf_proximity(gain, ledBoost);
+}
 
-	data[0] = 0xAB;
-	data[1] = 0x04;
+int APDS9660_Master::conf_proximity_int(int enable, uint8_t low_th, uint8_t high_th, uint8_t persistence){
+	return default_sensor.conf_proximity_int(enable, low_th, high_th, persistence);
+}
 
-	I2C_Master::write_msg(0x39,data,2);
+int APDS9660_Master::read_proximity_event(uint8_t *prox){
+	return default_sensor.read_proximity_event(prox);
+}
 
-	return motion;
+int APDS9660_Master::conf_gesture(int ledBoost, uint8_t proximity_enter, uint8_t proximity_exit){
+	return default_sensor.conf_gesture(ledBoost, proximity_enter, proximity_exit);
 }
 
-float APDS9660_Master::calc_illuminance(color_data data){
+int APDS9660_Master::conf_gesture_int(int enable, uint8_t fifo_th){
+	return default_sensor.conf_gesture_int(enable, fifo_th);
+}
 
-	float illuminance = (data.clear/pow(4,rgb_gain))/0.216;
+uint8_t APDS9660_Master::check_gesture(){
+	return default_sensor.check_gesture();
+}
 
-	return illuminance;
+int APDS9660_Master::read_ges_fifo(uint8_t *datasets, int max_datasets){
+	return default_sensor.read_ges_fifo(datasets, max_datasets);
+}
+
+int APDS9660_Master::read_rgbc(color_data *data){
+	return default_sensor.read_rgbc(data);
+}
 
+int APDS9660_Master::read_proximity(uint8_t *prox){
+	return default_sensor.read_proximity(prox);
 }
 
+float APDS9660_Master::calc_illuminance(color_data data){
+	return default_sensor.calc_illuminance(data);
+}
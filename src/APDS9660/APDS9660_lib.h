@@ -26,6 +26,10 @@
 extern "C" {
 #endif
   /* Exported variables --------------------------------------------------------*/
+
+//ALS gain of each AGAIN value
+extern const float als_gains[4];
+
   /* Exported types ------------------------------------------------------------*/
 
 typedef struct{
@@ -34,6 +38,10 @@ typedef struct{
 	int blue;
 	int green;
 	int clear;
+	float lux;	//Illuminance normalized by the ALS gain and integration time
+	float cct;	//Correlated colour temperature in K, 0 if unknown
+	uint8_t gain;	//AGAIN the sample was taken with
+	uint8_t atime;	//ATIME the sample was taken with
 
 }color_data;
 
@@ -46,95 +54,246 @@ typedef struct{
 #define RIGHT 0x04
 #define OUTDOOR_ILLUMINANCE 50
 
+//Gesture FIFO datasets that raise the gesture interrupt
+#define GES_FIFO_TH_1 0x00
+#define GES_FIFO_TH_4 0x01
+#define GES_FIFO_TH_8 0x02
+#define GES_FIFO_TH_16 0x03
+
+//ALS integration: ATIME = 256 - cycles, 2.78 ms and up to 1025 counts per cycle
+#define ALS_CYCLE_US 2780
+#define ALS_COUNTS_PER_CYCLE 1025
+#define ALS_MAX_COUNTS 65535
+
+//Proximity events
+#define PROX_NEAR 0x01
+#define PROX_FAR 0x02
+
+//Default address, and mux address of a sensor wired straight to its bus
+#define APDS9660_ADDR 0x39
+#define APDS9660_NO_MUX 0x00
+
+//Sensors read together by APDS9660::read_rgbc_all()
+#define APDS9660_MAX_SENSORS 8
+
+//Datasets (U, D, L, R bytes) the gesture FIFO holds
+#define GES_FIFO_DATASETS 32
+
   /* Exported Functions --------------------------------------------------------*/
 
+/**
+ * @brief APDS9660 sensor. Each instance keeps its bus, address, mux channel and
+ *        configuration, so several sensors can be used at the same time. The
+ *        configuration registers are shadowed: they are read once and only
+ *        written when they change. Sensors behind a TCA9548A-like mux (one
+ *        byte with the channel mask) share the mux state per bus and address.
+ */
+class APDS9660{
+  int bus;
+  uint8_t addr;
+  uint8_t mux_addr;
+  uint8_t mux_channel;
+  uint8_t shadow[256];
+  uint8_t shadow_valid[32];
+  uint8_t rgb_gain;
+  uint8_t als_atime;
+  uint8_t prox_low_th;
+  uint8_t prox_high_th;
+  bool prox_near;
+  uint8_t ges_int;
+
+  int select();
+  int read_regs(uint8_t reg, uint8_t *data, int len);
+  int write_regs(uint8_t *data, int len);
+  int write_cmd(uint8_t reg);
+  int update_reg(uint8_t reg, uint8_t mask, uint8_t value);
+  int arm_proximity_int();
+  int clear_ges_fifo();
+  bool before(const APDS9660 *other) const;
+public:
+
+  /**
+   * @brief Class constructor. Nothing is sent to the sensor until it is configured.
+   *
+   * @param[in] bus I2C_Master bus index.
+   *
+   * @param[in] addr I2C 7-bits address of the sensor.
+   *
+   * @param[in] mux_addr Address of the mux in front of the sensor, APDS9660_NO_MUX if none.
+   *
+   * @param[in] mux_channel Mux channel the sensor is wired to, 0 to 7.
+   */
+  APDS9660(int bus = 0, uint8_t addr = APDS9660_ADDR, uint8_t mux_addr = APDS9660_NO_MUX, uint8_t mux_channel = 0);
+
+  /**
+   * @brief configures the APDS9660 and wakes it up.
+   * 
+   * @param[in] gain Gain of the LEDs. Value from 0 to 3.
+   *
+   * @return 0 if success, -1 if error.
+   */
+  int conf_rgbc (int gain);
+
+  /**
+   * @brief configures the ALS gain and integration time. The result being
+   *        integrated when the range changes may mix both ranges.
+   *
+   * @param[in] gain Gain of the ALS. Value from 0 to 3 (1x, 4x, 16x, 64x).
+   *
+   * @param[in] atime Integration time register, 256 - integration cycles.
+   *
+   * @return 0 if success, -1 if error.
+   */
+  int conf_als_range(int gain, uint8_t atime);
+  
+  /**
+   * @brief configures the proximity detection
+   *        
+   * @param[in] gain Gain of the LEDs. Value from 0 to 3.
+   *
+   * @param[in] ledBoost Boost of the current of the LEDs, allowing further detection.
+   *
+   * @return non negative value if success, -1 if error.
+   */
+  int conf_proximity(int gain, int ledBoost);
+
+  /**
+   * @brief configures the proximity interrupt. When enabled, the INT pin
+   *        (active low, open drain, shared with the gesture interrupt) is
+   *        asserted when the proximity crosses a threshold and stays there
+   *        for `persistence` cycles. Only crossings are reported: while far
+   *        only the high threshold is armed and while near only the low one.
+   *
+   * @param[in] enable 1 to enable the interrupt, 0 to disable it.
+   *
+   * @param[in] low_th Proximity under which an object is far again.
+   *
+   * @param[in] high_th Proximity over which an object is near.
+   *
+   * @param[in] persistence Consecutive cycles out of the threshold, 0 to 15.
+   *
+   * @return 0 if success, -1 if error.
+   */
+  int conf_proximity_int(int enable, uint8_t low_th, uint8_t high_th, uint8_t persistence);
+
+  /**
+   * @brief checks for a proximity threshold crossing and clears the interrupt
+   *
+   * @param[out] prox Proximity byte that caused the event.
+   *
+   * @return PROX_NEAR or PROX_FAR if a crossing happened, 0 if not, -1 if error.
+   */
+  int read_proximity_event(uint8_t *prox);
+
+  /**
+   * @brief configures the gesture detection
+   *
+   * @param[in] ledBoost Boost of the current of the LEDs, allowing further detection.
+   *
+   * @param[in] proximity_enter Threshold to enter the gesture detection state machine
+   *
+   * @param[in] proximity_exit Threshold to exit the gesture detection state machine
+   *
+   * @return non negative value if success, -1 if error.
+   */
+  int conf_gesture(int ledBoost, uint8_t proximity_enter, uint8_t proximity_exit);
+
+  /**
+   * @brief configures the gesture interrupt. When enabled, the INT pin (active low,
+   *        open drain) is asserted once the FIFO holds `fifo_th` datasets and is
+   *        released when the FIFO is read or cleared by the gesture readers.
+   *
+   * @param[in] enable 1 to enable the interrupt, 0 to disable it.
+   *
+   * @param[in] fifo_th FIFO threshold, one of the GES_FIFO_TH_* values.
+   *
+   * @return 0 if success, -1 if error.
+   */
+  int conf_gesture_int(int enable, uint8_t fifo_th);
+
+  /**
+   * @brief configures the proximity detection
+   *
+   * @return 0 if not enough data in the FIFO to read, 1 if enough data
+   */
+
+  uint8_t check_gesture();
+
+  /**
+   * @brief reads the whole gesture FIFO with one level read and one burst read
+   *
+   * @param[out] datasets Buffer for the datasets, 4 bytes (U, D, L, R) each.
+   *
+   * @param[in] max_datasets Datasets `datasets` can hold.
+   *
+   * @return number of datasets read if success, -1 if error.
+   */
+
+  int read_ges_fifo(uint8_t *datasets, int max_datasets);
+
+  /**
+   * @brief Reads the RGBC value given by the sensor and its illuminance
+   *  
+   * @param[out] data Structure to store the RGBC values.
+   *
+   * @return 0 if success, -1 if error.
+   */
+
+  int read_rgbc(color_data *data);
+
+  /**
+   * @brief Reads the proximity value given by the sensor
+   *
+   * @param[out] prox Proximity byte read from the sensor.
+   *
+   * @return 0 if success, -1 if error.
+   */
+  
+  int read_proximity(uint8_t *prox);
+  
+  /**
+   * @brief Calculates the illuminance read by the sensor, normalized by the
+   *        gain and integration time recorded in the sample
+   *
+   * @return Illuminance in Lux
+   *
+   */
+
+  float calc_illuminance(color_data data);
+
+  /**
+   * @brief Reads the RGBC values of several sensors in a row, ordered by bus,
+   *        mux and channel so each mux channel is selected once.
+   *
+   * @param[in] sensors Sensors to read, up to APDS9660_MAX_SENSORS.
+   *
+   * @param[in] n Number of sensors.
+   *
+   * @param[out] data Readings, in the order of `sensors`.
+   *
+   * @param[out] results Result of each read, 0 if success, -1 if error.
+   *
+   * @return number of sensors read if success, -1 if too many sensors.
+   */
+  static int read_rgbc_all(APDS9660 *sensors[], int n, color_data data[], int results[]);
+};
+
 #ifdef __cplusplus
     namespace APDS9660_Master{
 #endif
-      /**
-       * @brief configures the APDS9660 and wakes it up.
-       * 
-       * @param[in] gain Gain of the LEDs. Value from 0 to 3.
-       *
-       * @return 0 if success, -1 if error.
-       */
+      //Same as the APDS9660 methods, for a sensor at APDS9660_ADDR on bus 0 without a mux
       int conf_rgbc (int gain);
-      
-      /**
-       * @brief configures the proximity detection
-       *        
-       * @param[in] gain Gain of the LEDs. Value from 0 to 3.
-       *
-       * @param[in] ledBoost Boost of the current of the LEDs, allowing further detection.
-       *
-       * @return non negative value if success, -1 if error.
-       */
+      int conf_als_range(int gain, uint8_t atime);
       int conf_proximity(int gain, int ledBoost);
-
-      /**
-       * @brief configures the gesture detection
-       *
-       * @param[in] ledBoost Boost of the current of the LEDs, allowing further detection.
-       *
-       * @param[in] proximity_enter Threshold to enter the gesture detection state machine
-       *
-       * @param[in] proximity_exit Threshold to exit the gesture detection state machine
-       *
-       * @return non negative value if success, -1 if error.
-       */
+      int conf_proximity_int(int enable, uint8_t low_th, uint8_t high_th, uint8_t persistence);
+      int read_proximity_event(uint8_t *prox);
       int conf_gesture(int ledBoost, uint8_t proximity_enter, uint8_t proximity_exit);
-
-      /**
-       * @brief configures the proximity detection
-       *
-       * @return 0 if not enough data in the FIFO to read, 1 if enough data
-       */
-
+      int conf_gesture_int(int enable, uint8_t fifo_th);
       uint8_t check_gesture();
-
-      /**
-       * @brief reads the gesture FIFO and detects up and down motion
-       *
-       * @return 0 if gesture not detected, value if gesture detected
-       */
-
-      uint8_t read_ges_fifo_ud();
-
-      /**
-       * @brief reads the gesture FIFO and detects left and right motion
-       *
-       * @return 0 if gesture not detected, value if gesture detected
-       */
-
-      uint8_t read_ges_fifo_lr();
-
-      /**
-       * @brief Reads the RGBC value given by the sensor
-       *  
-       * @param[out] rgbc Array of 8 chars to store the RGBC values.
-       *
-       * @return non negative value if success, -1 if error.
-       */
-
-      color_data read_rgbc();
-
-      /**
-       * @brief Reads the proximity value given by the sensor
-       *
-       * @return Proximity byte read from the sensor
-       */
-      
-      uint8_t read_proximity();
-      
-      /**
-       * @brief Calculates the illuminance read by the sensor
-       *
-       * @return Illuminance in Lux
-       *
-       */
-
+      int read_ges_fifo(uint8_t *datasets, int max_datasets);
+      int read_rgbc(color_data *data);
+      int read_proximity(uint8_t *prox);
       float calc_illuminance(color_data data);
-
 #ifdef __cplusplus 
     }
 #endif
@@ -0,0 +1,161 @@
+/**
+  ******************************************************************************
+  * @file   als_autorange.cpp
+  * @brief  APDS9660 ALS Auto-Ranging.
+  *
+  * @note   End-of-degree work.
+  *         Adjusts the ALS gain and integration time to the light level.
+  ******************************************************************************
+*/
+/* Includes ------------------------------------------------------------------*/
+#include "als_autorange.h" // Module header
+
+/* Private defines -----------------------------------------------------------*/
+/* Private typedef -----------------------------------------------------------*/
+typedef struct{
+
+  int gain;         //AGAIN, 0 to 3
+  uint8_t atime;    //256 - integration cycles
+
+}als_range;
+
+/* Private variables----------------------------------------------------------*/
+
+//Gain first: longer integrations only when the gain is exhausted
+static const als_range ranges[ALS_RANGES] = {
+  {0, 0xFF},  //1x,  2.78 ms
+  {1, 0xFF},  //4x,  2.78 ms
+  {2, 0xFF},  //16x, 2.78 ms
+  {3, 0xFF},  //64x, 2.78 ms
+  {3, 0xFC},  //64x, 11.1 ms
+  {3, 0xF0},  //64x, 44.5 ms
+};
+
+/* Private function prototypes -----------------------------------------------*/
+static float sensitivity(int range);
+static float full_scale(int range);
+
+/* Functions -----------------------------------------------------------------*/
+
+/**
+  * @brief Class constructor.
+  *
+  * @param[in] sensor Sensor whose ALS is controlled.
+  * @param[in] range Range to start with, 0 (least sensitive) to ALS_RANGES - 1.
+  */
+ALSAutoRange::ALSAutoRange(APDS9660 *sensor, int range){
+  this->sensor = sensor;
+  if(range < 0)
+    range = 0;
+  if(range >= ALS_RANGES)
+    range = ALS_RANGES - 1;
+  this->range = range;
+  low_count = 0;
+  settling = true;
+  recovering = false;
+}
+
+
+/**
+  * @brief Configures the sensor with the current range.
+  *
+  * @return 0 if success, -1 if error.
+  */
+int ALSAutoRange::init(){
+  return apply(range);
+}
+
+
+/**
+  * @brief Checks a reading from APDS9660::read_rgbc() and changes
+  *        the range when the clear counts leave the hysteresis band.
+  *
+  * @param[in] data Reading with its normalized lux.
+  *
+  * @return 1 if the reading is valid, 0 if it must be discarded, -1 if the
+  *         range could not be changed.
+  */
+int ALSAutoRange::update(const color_data *data){
+  if(settling){
+    settling = false;
+    return 0;
+  }
+
+  float full = full_scale(range);
+
+  if(data->clear >= ALS_HIGH_TH * full){
+    low_count = 0;
+    recovering = false;
+    if(range == 0)
+      return 1;   //Brightest range: the lux is a lower bound
+
+    //Saturated: the light is unknown, so it is measured with the least
+    //sensitive range and the range is picked from there without waiting
+    if(data->clear >= full){
+      if(apply(0) < 0)
+        return -1;
+      recovering = true;
+      return 0;
+    }
+
+    //Least sensitive range needed to read it around the target
+    int target = range;
+    while(target > 0 && data->clear * sensitivity(target) / sensitivity(range) > ALS_TARGET * full_scale(target))
+      target--;
+
+    if(apply(target) < 0)
+      return -1;
+    return 1;
+  }
+
+  if((recovering || data->clear < ALS_LOW_TH * full) && range < ALS_RANGES - 1){
+    if(!recovering && ++low_count < ALS_RAISE_SAMPLES)
+      return 1;
+    low_count = 0;
+    recovering = false;
+
+    //Most sensitive range that still reads it under the target
+    int target = range;
+    while(target < ALS_RANGES - 1 && data->clear * sensitivity(target + 1) / sensitivity(range) <= ALS_TARGET * full_scale(target + 1))
+      target++;
+
+    if(target != range && apply(target) < 0)
+      return -1;
+    return 1;
+  }
+
+  low_count = 0;
+  recovering = false;
+  return 1;
+}
+
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief Configures the sensor with a range and discards the next reading.
+  */
+int ALSAutoRange::apply(int range){
+  if(sensor->conf_als_range(ranges[range].gain, ranges[range].atime) < 0)
+    return -1;
+  this->range = range;
+  settling = true;
+  return 0;
+}
+
+
+/**
+  * @brief Counts per lux of a range, relative to 1x gain and 1 cycle.
+  */
+static float sensitivity(int range){
+  return (float)(1 << (2 * ranges[range].gain)) * (256 - ranges[range].atime);
+}
+
+
+/**
+  * @brief Clear counts at which a range saturates.
+  */
+static float full_scale(int range){
+  int counts = ALS_COUNTS_PER_CYCLE * (256 - ranges[range].atime);
+  return counts < ALS_MAX_COUNTS ? counts : ALS_MAX_COUNTS;
+}
@@ -0,0 +1,89 @@
+/**
+  ******************************************************************************
+  * @file   als_autorange.h
+  * @brief  APDS9660 ALS Auto-Ranging Header.
+  *
+  * @note   End-of-degree work.
+  *         Adjusts the ALS gain and integration time to the light level so
+  *         the clear channel neither saturates nor integrates longer than
+  *         needed. Ranges are sorted by sensitivity, each 4 times the previous
+  *         one: the gain is raised before the integration time.
+  ******************************************************************************
+*/
+
+#ifndef __ALS_AUTORANGE_H__
+#define __ALS_AUTORANGE_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "APDS9660_lib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* Exported types ------------------------------------------------------------*/
+/* Exported constants --------------------------------------------------------*/
+#define ALS_RANGES          6       //1x to 64x gain at 2.78 ms, then 11 and 44 ms
+#define ALS_HIGH_TH         0.8f    //Fraction of full scale over which sensitivity drops
+#define ALS_LOW_TH          0.1f    //Fraction of full scale under which it rises
+#define ALS_TARGET          0.5f    //Fraction of full scale aimed at when changing
+#define ALS_RAISE_SAMPLES   3       //Consecutive dark samples before raising
+
+/* Exported macro ------------------------------------------------------------*/
+/* Exported Functions --------------------------------------------------------*/
+
+class ALSAutoRange{
+  APDS9660 *sensor;
+  int range;
+  int low_count;
+  bool settling;
+  bool recovering;
+
+  int apply(int range);
+public:
+
+  /**
+    * @brief Class constructor.
+    *
+    * @param[in] sensor Sensor whose ALS is controlled.
+    * @param[in] range Range to start with, 0 (least sensitive) to ALS_RANGES - 1.
+    */
+  ALSAutoRange(APDS9660 *sensor, int range = ALS_RANGES - 1);
+
+  /**
+    * @brief Configures the sensor with the current range.
+    *
+    * @return 0 if success, -1 if error.
+    */
+  int init();
+
+  /**
+    * @brief Checks a reading from APDS9660::read_rgbc() and changes
+    *        the range when the clear counts leave the hysteresis band.
+    *
+    *        Readings over the band move straight to the range that reads them
+    *        around ALS_TARGET. Saturated ones go to the least sensitive range
+    *        first, and the next reading picks the range. Readings under the
+    *        band move up the same way once they have lasted ALS_RAISE_SAMPLES
+    *        samples.
+    *        The reading after a change is discarded, as it may mix both
+    *        ranges.
+    *
+    * @param[in] data Reading with its normalized lux.
+    *
+    * @return 1 if the reading is valid, 0 if it must be discarded, -1 if the
+    *         range could not be changed.
+    */
+  int update(const color_data *data);
+
+  /**
+    * @brief Current range, 0 (least sensitive) to ALS_RANGES - 1.
+    */
+  int get_range() { return range; };
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ALS_AUTORANGE_H__ */
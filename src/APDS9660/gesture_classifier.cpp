@@ -0,0 +1,251 @@
+/**
+  ******************************************************************************
+  * @file   gesture_classifier.cpp
+  * @brief  APDS9660 Streaming Gesture Classifier.
+  *
+  * @note   End-of-degree work.
+  *         Classifies hand passes in the four directions from the U, D, L, R
+  *         datasets of the gesture FIFO.
+  ******************************************************************************
+*/
+/* Includes ------------------------------------------------------------------*/
+#include "gesture_classifier.h" // Module header
+#include <cmath>
+
+/* Private defines -----------------------------------------------------------*/
+#define CH_U 0
+#define CH_D 1
+#define CH_L 2
+#define CH_R 3
+
+#define BASELINE_ALPHA 0.25f    //Weight of the last pass in the baseline
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private variables----------------------------------------------------------*/
+/* Private function prototypes -----------------------------------------------*/
+static uint8_t dataset_max(const uint8_t *dataset);
+
+/* Functions -----------------------------------------------------------------*/
+
+/**
+  * @brief Class constructor.
+  *
+  * @param[in] entry_th Dataset maximum over which a pass starts.
+  * @param[in] exit_th Dataset maximum under which a pass ends.
+  */
+GestureClassifier::GestureClassifier(uint8_t entry_th, uint8_t exit_th){
+  this->entry_th = entry_th;
+  this->exit_th = exit_th;
+  for(int i = 0; i < 4; i++)
+    baseline[i] = 0;
+  baseline_valid = false;
+  active = false;
+  overlong = false;
+  pass_len = 0;
+}
+
+
+/**
+  * @brief Feeds datasets as read by APDS9660::read_ges_fifo().
+  *
+  * @param[in] datasets U, D, L, R bytes of each dataset.
+  * @param[in] len Number of datasets.
+  * @param[out] events Array where the classified passes will be stored.
+  * @param[in] max_events Capacity of `events`. Further passes are dropped.
+  *
+  * @return The number of events stored.
+  */
+int GestureClassifier::push(const uint8_t *datasets, int len, gesture_event *events, int max_events){
+  int stored = 0;
+
+  for(int i = 0; i < len; i++){
+    const uint8_t *dataset = &datasets[i * 4];
+    uint8_t max = dataset_max(dataset);
+
+    if(!active){
+      if(max <= entry_th)
+        continue;
+      active = true;
+      overlong = false;
+      pass_len = 0;
+    }
+
+    if(pass_len < GESTURE_MAX_DATASETS){
+      for(int c = 0; c < 4; c++)
+        pass[pass_len][c] = dataset[c];
+      pass_len++;
+    }
+    else{
+      overlong = true;
+    }
+
+    if(max < exit_th){
+      int ended = end_pass(&events[stored], max_events - stored);
+      //The rest of the batch is newer than the pass
+      for(int e = stored; e < stored + ended; e++)
+        events[e].age += len - 1 - i;
+      stored += ended;
+    }
+  }
+
+  return stored;
+}
+
+
+/**
+  * @brief Ends the current pass. To be called when the sensor has stopped
+  *        giving datasets for a while, as its engine may leave without a
+  *        dataset under the exit threshold.
+  *
+  * @param[out] events Array where the classified passes will be stored.
+  * @param[in] max_events Capacity of `events`.
+  *
+  * @return The number of events stored.
+  */
+int GestureClassifier::flush(gesture_event *events, int max_events){
+  if(!active)
+    return 0;
+  return end_pass(events, max_events);
+}
+
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief Classifies the stored pass and goes back to idle.
+  *
+  *        The static offset of each photodiode (crosstalk, ambient) is tracked
+  *        from the minimum it reaches during the passes and subtracted. Two
+  *        hands passing too close for the sensor to exit are told apart by the
+  *        dip of the total signal between them.
+  *
+  * @param[out] events Array where the classified passes will be stored.
+  * @param[in] max_events Capacity of `events`.
+  *
+  * @return The number of events stored.
+  */
+int GestureClassifier::end_pass(gesture_event *events, int max_events){
+  int stored = 0;
+
+  active = false;
+  if(pass_len < GESTURE_MIN_DATASETS || overlong)
+    return 0;
+
+  for(int c = 0; c < 4; c++){
+    uint8_t min = 255;
+    for(int i = 0; i < pass_len; i++)
+      min = pass[i][c] < min ? pass[i][c] : min;
+    baseline[c] = baseline_valid ? baseline[c] + BASELINE_ALPHA * (min - baseline[c]) : min;
+  }
+  baseline_valid = true;
+
+  int start = 0, valley_index = -1;
+  float peak = 0, valley = 0;
+  for(int i = 0; i < pass_len; i++){
+    float total = 0;
+    for(int c = 0; c < 4; c++)
+      total += pass[i][c] > baseline[c] ? pass[i][c] - baseline[c] : 0;
+
+    if(valley_index < 0){
+      if(total > peak)
+        peak = total;
+      else if(total < GESTURE_VALLEY_RATIO * peak){
+        valley_index = i;
+        valley = total;
+      }
+    }
+    else if(total < valley){
+      valley_index = i;
+      valley = total;
+    }
+    else if(valley < GESTURE_VALLEY_RATIO * total){
+      //Rising again from the dip: a second pass starts there
+      if(stored < max_events && classify(start, valley_index + 1, &events[stored]))
+        stored++;
+      start = valley_index;
+      peak = total;
+      valley_index = -1;
+    }
+  }
+
+  if(stored < max_events && classify(start, pass_len, &events[stored]))
+    stored++;
+
+  return stored;
+}
+
+
+/**
+  * @brief Classifies the datasets [start, end) of the stored pass. The
+  *        direction comes from how the U-D and L-R ratios swing between the
+  *        first and the last significant datasets: the hand moves away from
+  *        the photodiode that sees it first.
+  *
+  * @param[in] start First dataset.
+  * @param[in] end Dataset after the last one.
+  * @param[out] event Where the classified pass will be stored.
+  *
+  * @return 1 if the pass gives a direction, 0 if it is rejected as noise.
+  */
+int GestureClassifier::classify(int start, int end, gesture_event *event){
+  float ratio_first[2] = {0, 0}, ratio_last[2] = {0, 0};
+  bool found = false;
+
+  if(end - start < GESTURE_MIN_DATASETS)
+    return 0;
+
+  for(int i = start; i < end; i++){
+    float ch[4];
+    for(int c = 0; c < 4; c++){
+      ch[c] = pass[i][c] - baseline[c];
+      ch[c] = ch[c] > 0 ? ch[c] : 0;
+    }
+    if(ch[CH_U] + ch[CH_D] + ch[CH_L] + ch[CH_R] < GESTURE_MIN_COUNTS)
+      continue;
+
+    float ud = (ch[CH_U] - ch[CH_D]) / (ch[CH_U] + ch[CH_D] + 1.0f);
+    float lr = (ch[CH_L] - ch[CH_R]) / (ch[CH_L] + ch[CH_R] + 1.0f);
+    if(!found){
+      ratio_first[0] = ud;
+      ratio_first[1] = lr;
+      found = true;
+    }
+    ratio_last[0] = ud;
+    ratio_last[1] = lr;
+  }
+
+  float delta_ud = ratio_last[0] - ratio_first[0];
+  float delta_lr = ratio_last[1] - ratio_first[1];
+  bool vertical = std::fabs(delta_ud) >= std::fabs(delta_lr);
+  float main_delta = vertical ? delta_ud : delta_lr;
+  float other_delta = vertical ? delta_lr : delta_ud;
+
+  if(!found || std::fabs(main_delta) < GESTURE_MIN_DELTA)
+    return 0;
+
+  if(vertical)
+    event->direction = delta_ud < 0 ? DOWN : UP;
+  else
+    event->direction = delta_lr < 0 ? RIGHT : LEFT;
+
+  //Full swing along one axis only gives 1
+  float swing = std::fabs(main_delta) / 2.0f;
+  float dominance = 1.0f - std::fabs(other_delta) / std::fabs(main_delta);
+  event->confidence = (swing > 1.0f ? 1.0f : swing) * dominance;
+  event->datasets = end - start;
+  event->age = pass_len - end;
+
+  return 1;
+}
+
+
+/**
+  * @brief Highest of the four photodiodes of a dataset.
+  */
+static uint8_t dataset_max(const uint8_t *dataset){
+  uint8_t max = dataset[0];
+
+  for(int c = 1; c < 4; c++)
+    max = dataset[c] > max ? dataset[c] : max;
+  return max;
+}
@@ -0,0 +1,103 @@
+/**
+  ******************************************************************************
+  * @file   gesture_classifier.h
+  * @brief  APDS9660 Streaming Gesture Classifier Header.
+  *
+  * @note   End-of-degree work.
+  *         Classifies hand passes in the four directions from the U, D, L, R
+  *         datasets of the gesture FIFO, in a single pass over the stream.
+  *         Passes can span several FIFO reads and several passes can come in
+  *         the same read.
+  ******************************************************************************
+*/
+
+#ifndef __GESTURE_CLASSIFIER_H__
+#define __GESTURE_CLASSIFIER_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "APDS9660_lib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* Exported types ------------------------------------------------------------*/
+
+typedef struct{
+
+  uint8_t direction;    //UP, DOWN, LEFT or RIGHT
+  float confidence;     //0 to 1
+  int datasets;         //Length of the pass
+  int age;              //Datasets received after the last one of the pass
+
+}gesture_event;
+
+/* Exported constants --------------------------------------------------------*/
+#define GESTURE_ENTRY_TH        40    //Counts over which a pass starts
+#define GESTURE_EXIT_TH         20    //Counts under which it ends
+#define GESTURE_MIN_DATASETS    3     //Shorter passes are noise
+#define GESTURE_MAX_DATASETS    256   //Longer ones are something standing in front
+#define GESTURE_MIN_COUNTS      10    //Datasets weaker than this give no direction
+#define GESTURE_MIN_DELTA       0.3f  //Minimum ratio swing along the winning axis
+#define GESTURE_VALLEY_RATIO    0.25f //A dip under this fraction of the peaks splits two passes
+#define GESTURE_DATASET_US      25200 //Dataset period with the wait time of APDS9660::conf_gesture()
+
+/* Exported macro ------------------------------------------------------------*/
+/* Exported Functions --------------------------------------------------------*/
+
+class GestureClassifier{
+  uint8_t entry_th, exit_th;
+  float baseline[4];
+  bool baseline_valid;
+  bool active;
+  bool overlong;
+  int pass_len;
+  uint8_t pass[GESTURE_MAX_DATASETS][4];
+
+  int end_pass(gesture_event *events, int max_events);
+  int classify(int start, int end, gesture_event *event);
+public:
+
+  /**
+    * @brief Class constructor.
+    *
+    * @param[in] entry_th Dataset maximum over which a pass starts.
+    * @param[in] exit_th Dataset maximum under which a pass ends.
+    */
+  GestureClassifier(uint8_t entry_th = GESTURE_ENTRY_TH, uint8_t exit_th = GESTURE_EXIT_TH);
+
+  /**
+    * @brief Feeds datasets as read by APDS9660::read_ges_fifo().
+    *
+    * @param[in] datasets U, D, L, R bytes of each dataset.
+    * @param[in] len Number of datasets.
+    * @param[out] events Array where the classified passes will be stored.
+    * @param[in] max_events Capacity of `events`. Further passes are dropped.
+    *
+    * @return The number of events stored.
+    */
+  int push(const uint8_t *datasets, int len, gesture_event *events, int max_events);
+
+  /**
+    * @brief Ends the current pass. To be called when the sensor has stopped
+    *        giving datasets for a while, as its engine may leave without a
+    *        dataset under the exit threshold.
+    *
+    * @param[out] events Array where the classified passes will be stored.
+    * @param[in] max_events Capacity of `events`.
+    *
+    * @return The number of events stored.
+    */
+  int flush(gesture_event *events, int max_events);
+
+  /**
+    * @brief Whether a pass is in progress.
+    */
+  bool in_pass() { return active; };
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __GESTURE_CLASSIFIER_H__ */
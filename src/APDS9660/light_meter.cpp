@@ -0,0 +1,83 @@
+/**
+  ******************************************************************************
+  * @file   light_meter.cpp
+  * @brief  APDS9660 Lux and Colour Temperature.
+  *
+  * @note   End-of-degree work.
+  *         Computes the illuminance and the correlated colour temperature of
+  *         RGBC samples with precomputed count to lux factors.
+  ******************************************************************************
+*/
+/* Includes ------------------------------------------------------------------*/
+#include "light_meter.h" // Module header
+
+/* Private defines -----------------------------------------------------------*/
+/* Private typedef -----------------------------------------------------------*/
+/* Private variables----------------------------------------------------------*/
+
+//RGBC coefficients, device factor chosen so that white light (R, G, B at 0.36,
+//0.42, 0.30 of clear) gives the same lux as the clear-only formula
+static const als_calibration default_calibration = {
+  0.136f, 1.0f, -0.444f, 1.0f, 41.78f, 3810.0f, 1391.0f
+};
+
+/* Private function prototypes -----------------------------------------------*/
+/* Functions -----------------------------------------------------------------*/
+
+/**
+  * @brief Class constructor. Uses the default calibration.
+  */
+LightMeter::LightMeter() : LightMeter(&default_calibration) {}
+
+
+/**
+  * @brief Class constructor.
+  *
+  * @param[in] cal Calibration of the sensor in its enclosure.
+  */
+LightMeter::LightMeter(const als_calibration *cal){
+  this->cal = *cal;
+
+  //ATIME 0 integrates 256 cycles
+  for(int gain = 0; gain < 4; gain++){
+    for(int atime = 0; atime < 256; atime++){
+      float cycles = 256 - atime;
+      lux_factor[gain][atime] = cal->ga * cal->df / (cycles * ALS_CYCLE_MS * als_gains[gain]);
+    }
+  }
+
+  for(int atime = 0; atime < 256; atime++){
+    int counts = ALS_COUNTS_PER_CYCLE * (256 - atime);
+    full_scale[atime] = counts < ALS_MAX_COUNTS ? counts : ALS_MAX_COUNTS;
+  }
+}
+
+
+/**
+  * @brief Fills the lux and cct fields of a batch of samples, each one with
+  *        the gain and integration time it was taken with. Saturated samples
+  *        give a lower bound of the lux and no cct.
+  *
+  * @param[in,out] samples Samples as read by APDS9660::read_rgbc().
+  * @param[in] len Number of samples.
+  */
+void LightMeter::process(color_data *samples, int len){
+  for(int i = 0; i < len; i++){
+    color_data *s = &samples[i];
+
+    //What the colour channels do not explain in the clear one is infrared,
+    //unless the clear channel is clipped
+    bool saturated = s->clear >= full_scale[s->atime];
+    float ir = saturated ? 0 : (s->red + s->green + s->blue - s->clear) * 0.5f;
+    ir = ir > 0 ? ir : 0;
+    float r = s->red - ir;
+    float g = s->green - ir;
+    float b = s->blue - ir;
+
+    float counts = cal.r_coef * r + cal.g_coef * g + cal.b_coef * b;
+    float lux = counts * lux_factor[s->gain & 0x03][s->atime];
+    s->lux = lux > 0 ? lux : 0;
+
+    s->cct = (r > 0 && !saturated) ? cal.ct_coef * b / r + cal.ct_offset : 0;
+  }
+}
@@ -0,0 +1,88 @@
+/**
+  ******************************************************************************
+  * @file   light_meter.h
+  * @brief  APDS9660 Lux and Colour Temperature Header.
+  *
+  * @note   End-of-degree work.
+  *         Computes the illuminance and the correlated colour temperature of
+  *         RGBC samples. The infrared seen by the clear channel is removed
+  *         from the colour channels, which are then weighted with the
+  *         calibration coefficients. The count to lux factor of every gain and
+  *         integration time is precomputed, so a sample costs a handful of
+  *         multiplications and one division.
+  ******************************************************************************
+*/
+
+#ifndef __LIGHT_METER_H__
+#define __LIGHT_METER_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include "APDS9660_lib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* Exported types ------------------------------------------------------------*/
+
+typedef struct{
+
+  float r_coef;     //Weight of the IR compensated red channel
+  float g_coef;     //Weight of the IR compensated green channel
+  float b_coef;     //Weight of the IR compensated blue channel
+  float ga;         //Glass attenuation of the enclosure, 1 without glass
+  float df;         //Device factor, lux * ms per count at 1x gain
+  float ct_coef;    //K per unit of the blue to red ratio
+  float ct_offset;  //K at a null blue to red ratio
+
+}als_calibration;
+
+/* Exported constants --------------------------------------------------------*/
+#define ALS_CYCLE_MS (ALS_CYCLE_US / 1000.0f)
+
+/* Exported macro ------------------------------------------------------------*/
+/* Exported Functions --------------------------------------------------------*/
+
+class LightMeter{
+  als_calibration cal;
+  float lux_factor[4][256];   //Lux per weighted count, by AGAIN and ATIME
+  int full_scale[256];        //Clear counts at saturation, by ATIME
+
+public:
+
+  /**
+    * @brief Class constructor. Uses the default calibration: the usual RGBC
+    *        coefficients with the device factor matched to the 0.216 counts
+    *        per lux and cycle of APDS9660_Master::calc_illuminance() on white
+    *        light, without glass.
+    */
+  LightMeter();
+
+  /**
+    * @brief Class constructor.
+    *
+    * @param[in] cal Calibration of the sensor in its enclosure.
+    */
+  LightMeter(const als_calibration *cal);
+
+  /**
+    * @brief Fills the lux and cct fields of a batch of samples, each one with
+    *        the gain and integration time it was taken with. Saturated samples
+    *        give a lower bound of the lux and no cct.
+    *
+    * @param[in,out] samples Samples as read by APDS9660::read_rgbc().
+    * @param[in] len Number of samples.
+    */
+  void process(color_data *samples, int len);
+
+  /**
+    * @brief Gets the calibration in use.
+    */
+  const als_calibration *get_calibration() { return &cal; };
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LIGHT_METER_H__ */
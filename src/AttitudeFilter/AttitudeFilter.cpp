@@ -0,0 +1,214 @@
+/**
+  ******************************************************************************
+  * @file   AttitudeFilter.cpp
+  * @brief  IMU Attitude Fusion Module.
+  *
+  * @note   End-of-degree work.
+  *         This module fuses the accelerometer and gyroscope samples of the
+  *         LSM6DSOX with a Mahony complementary filter.
+  ******************************************************************************
+*/
+/* Includes ------------------------------------------------------------------*/
+#include "AttitudeFilter.h" // Module header
+#include <cmath>
+
+/* Private defines -----------------------------------------------------------*/
+#define DEG_TO_RAD  ((float)(M_PI / 180.0))
+#define RAD_TO_DEG  ((float)(180.0 / M_PI))
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private variables----------------------------------------------------------*/
+/* Private function prototypes -----------------------------------------------*/
+/* Functions -----------------------------------------------------------------*/
+
+/**
+  * @brief Class constructor.
+  *
+  * @param[in] sample_rate Rate at which update() will be called, in Hz.
+  * @param[in] kp Proportional gain of the accelerometer correction.
+  * @param[in] ki Integral gain of the accelerometer correction, 0 to disable it.
+  */
+AttitudeFilter::AttitudeFilter(float sample_rate, float kp, float ki){
+  dt = 1.0f / sample_rate;
+  this->kp = kp;
+  this->ki = ki;
+  bias_alpha = dt / (ATTITUDE_BIAS_TIME + dt);
+  bias[0] = bias[1] = bias[2] = 0;
+  reference_yaw = 0;
+  reset();
+}
+
+
+/**
+  * @brief Integrates one sample. Constant cost: no trigonometric functions,
+  *        one square root per normalization.
+  *
+  * @param[in] gyr Gyroscope x, y and z in dps.
+  * @param[in] acc Accelerometer x, y and z in g.
+  */
+void AttitudeFilter::update(const float *gyr, const float *acc){
+  float acc_norm = std::sqrt(acc[0] * acc[0] + acc[1] * acc[1] + acc[2] * acc[2]);
+  bool acc_valid = std::fabs(acc_norm - 1.0f) < ATTITUDE_ACC_TOLERANCE;
+
+  if(!initialized){
+    if(!acc_valid)
+      return;
+    init_from_acc(acc);
+  }
+
+  //Still: the gyroscope output is its bias
+  float gx = gyr[0] - bias[0], gy = gyr[1] - bias[1], gz = gyr[2] - bias[2];
+  if(acc_valid && std::fabs(acc_norm - 1.0f) < ATTITUDE_ACC_TOLERANCE / 4
+      && gx * gx + gy * gy + gz * gz < ATTITUDE_STILL_DPS * ATTITUDE_STILL_DPS){
+    for(int i = 0; i < 3; i++)
+      bias[i] += bias_alpha * (gyr[i] - bias[i]);
+  }
+
+  //Gravity direction estimated by the quaternion, in the body frame
+  float vx = 2.0f * (q1 * q3 - q0 * q2);
+  float vy = 2.0f * (q0 * q1 + q2 * q3);
+  float vz = q0 * q0 - q1 * q1 - q2 * q2 + q3 * q3;
+
+  vertical_rate = gx * vx + gy * vy + gz * vz;
+
+  gx *= DEG_TO_RAD;
+  gy *= DEG_TO_RAD;
+  gz *= DEG_TO_RAD;
+
+  //Bumps and swings are not gravity, the correction is skipped for them
+  if(acc_valid){
+    float ax = acc[0] / acc_norm, ay = acc[1] / acc_norm, az = acc[2] / acc_norm;
+    float ex = ay * vz - az * vy;
+    float ey = az * vx - ax * vz;
+    float ez = ax * vy - ay * vx;
+
+    if(ki > 0){
+      integral[0] += ki * ex * dt;
+      integral[1] += ki * ey * dt;
+      integral[2] += ki * ez * dt;
+    }
+    gx += kp * ex;
+    gy += kp * ey;
+    gz += kp * ez;
+  }
+  gx += integral[0];
+  gy += integral[1];
+  gz += integral[2];
+
+  gx *= 0.5f * dt;
+  gy *= 0.5f * dt;
+  gz *= 0.5f * dt;
+  float qa = q0, qb = q1, qc = q2;
+  q0 += -qb * gx - qc * gy - q3 * gz;
+  q1 += qa * gx + qc * gz - q3 * gy;
+  q2 += qa * gy - qb * gz + q3 * gx;
+  q3 += qa * gz + qb * gy - qc * gx;
+
+  float q_norm = 1.0f / std::sqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+  q0 *= q_norm;
+  q1 *= q_norm;
+  q2 *= q_norm;
+  q3 *= q_norm;
+}
+
+
+/**
+  * @brief Gets the orientation as a body to world quaternion.
+  *
+  * @param[out] q Where the quaternion will be stored.
+  */
+void AttitudeFilter::get_quaternion(attitude_quaternion *q){
+  q->w = q0;
+  q->x = q1;
+  q->y = q2;
+  q->z = q3;
+}
+
+
+/**
+  * @brief Gets the orientation as Euler angles (z-y-x).
+  *
+  * @param[out] angles Where the angles will be stored.
+  */
+void AttitudeFilter::get_angles(attitude_angles *angles){
+  float sin_pitch = 2.0f * (q0 * q2 - q3 * q1);
+
+  if(sin_pitch > 1.0f)
+    sin_pitch = 1.0f;
+  else if(sin_pitch < -1.0f)
+    sin_pitch = -1.0f;
+
+  angles->roll = std::atan2(2.0f * (q0 * q1 + q2 * q3), 1.0f - 2.0f * (q1 * q1 + q2 * q2)) * RAD_TO_DEG;
+  angles->pitch = std::asin(sin_pitch) * RAD_TO_DEG;
+  angles->yaw = current_yaw() * RAD_TO_DEG;
+}
+
+
+/**
+  * @brief Takes the current heading as the reference of get_swing_angle(),
+  *        e.g. with the door closed.
+  */
+void AttitudeFilter::set_reference(){
+  reference_yaw = current_yaw();
+}
+
+
+/**
+  * @brief Gets the rotation around the vertical since set_reference().
+  *
+  * @return Angle in deg, from -180 to 180.
+  */
+float AttitudeFilter::get_swing_angle(){
+  float angle = current_yaw() - reference_yaw;
+
+  if(angle > M_PI)
+    angle -= 2.0f * M_PI;
+  else if(angle < -M_PI)
+    angle += 2.0f * M_PI;
+  return angle * RAD_TO_DEG;
+}
+
+
+/**
+  * @brief Restarts the filter. The next sample sets roll and pitch from the
+  *        accelerometer, the learned bias is kept.
+  */
+void AttitudeFilter::reset(){
+  q0 = 1;
+  q1 = q2 = q3 = 0;
+  integral[0] = integral[1] = integral[2] = 0;
+  vertical_rate = 0;
+  initialized = false;
+}
+
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief Sets roll and pitch from the gravity measured by the accelerometer,
+  *        with heading 0, so the filter does not have to converge from level.
+  *
+  * @param[in] acc Accelerometer x, y and z in g.
+  */
+void AttitudeFilter::init_from_acc(const float *acc){
+  float roll = std::atan2(acc[1], acc[2]);
+  float pitch = std::atan2(-acc[0], std::sqrt(acc[1] * acc[1] + acc[2] * acc[2]));
+  float cr = std::cos(roll / 2), sr = std::sin(roll / 2);
+  float cp = std::cos(pitch / 2), sp = std::sin(pitch / 2);
+
+  q0 = cr * cp;
+  q1 = sr * cp;
+  q2 = cr * sp;
+  q3 = -sr * sp;
+  initialized = true;
+}
+
+
+/**
+  * @brief Heading of the body x axis around the vertical.
+  *
+  * @return Angle in rad.
+  */
+float AttitudeFilter::current_yaw(){
+  return std::atan2(2.0f * (q0 * q3 + q1 * q2), 1.0f - 2.0f * (q2 * q2 + q3 * q3));
+}
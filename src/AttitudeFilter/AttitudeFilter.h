@@ -0,0 +1,132 @@
+/**
+  ******************************************************************************
+  * @file   AttitudeFilter.h
+  * @brief  IMU Attitude Fusion Module Header.
+  *
+  * @note   End-of-degree work.
+  *         This module fuses the accelerometer and gyroscope samples of the
+  *         LSM6DSOX with a Mahony complementary filter, running at the fixed
+  *         rate of the sensor, to give the orientation and the angle a door
+  *         has swung around the vertical.
+  ******************************************************************************
+*/
+
+#ifndef __ATTITUDEFILTER_H__
+#define __ATTITUDEFILTER_H__
+
+/* Includes ------------------------------------------------------------------*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* Exported types ------------------------------------------------------------*/
+
+typedef struct{
+
+  float w, x, y, z;
+
+}attitude_quaternion;
+
+typedef struct{
+
+  float roll, pitch, yaw;   //deg
+
+}attitude_angles;
+
+/* Exported constants --------------------------------------------------------*/
+#define ATTITUDE_DEFAULT_KP       2.0f    //Proportional gain of the accelerometer correction
+#define ATTITUDE_DEFAULT_KI       0.01f   //Integral gain, tracks the gyroscope bias on roll and pitch
+#define ATTITUDE_ACC_TOLERANCE    0.2f    //g, accelerometer samples further from 1 g are not trusted
+#define ATTITUDE_STILL_DPS        3.0f    //dps, below this and near 1 g the gyroscope output is taken as bias
+#define ATTITUDE_BIAS_TIME        2.0f    //s, time constant of the bias learning
+
+/* Exported macro ------------------------------------------------------------*/
+/* Exported Functions --------------------------------------------------------*/
+
+class AttitudeFilter{
+  float dt;
+  float kp, ki;
+  float bias_alpha;
+
+  float q0, q1, q2, q3;         //Body to world quaternion, world z is the vertical
+  float integral[3];            //rad/s
+  float bias[3];                //dps, learned while still
+  float vertical_rate;          //dps
+  float reference_yaw;          //rad
+  bool initialized;
+
+  void init_from_acc(const float *acc);
+  float current_yaw();
+public:
+
+  /**
+    * @brief Class constructor.
+    *
+    * @param[in] sample_rate Rate at which update() will be called, in Hz.
+    */
+  AttitudeFilter(float sample_rate) : AttitudeFilter(sample_rate, ATTITUDE_DEFAULT_KP, ATTITUDE_DEFAULT_KI) {};
+
+  /**
+    * @brief Class constructor.
+    *
+    * @param[in] sample_rate Rate at which update() will be called, in Hz.
+    * @param[in] kp Proportional gain of the accelerometer correction.
+    * @param[in] ki Integral gain of the accelerometer correction, 0 to disable it.
+    */
+  AttitudeFilter(float sample_rate, float kp, float ki);
+
+  /**
+    * @brief Integrates one sample. Constant cost: no trigonometric functions,
+    *        one square root per normalization.
+    *
+    * @param[in] gyr Gyroscope x, y and z in dps.
+    * @param[in] acc Accelerometer x, y and z in g.
+    */
+  void update(const float *gyr, const float *acc);
+
+  /**
+    * @brief Gets the orientation as a body to world quaternion.
+    *
+    * @param[out] q Where the quaternion will be stored.
+    */
+  void get_quaternion(attitude_quaternion *q);
+
+  /**
+    * @brief Gets the orientation as Euler angles (z-y-x).
+    *
+    * @param[out] angles Where the angles will be stored.
+    */
+  void get_angles(attitude_angles *angles);
+
+  /**
+    * @brief Gets the rotation rate around the vertical, bias corrected.
+    *
+    * @return Rate in dps, positive counterclockwise seen from above.
+    */
+  float get_vertical_rate() { return vertical_rate; };
+
+  /**
+    * @brief Takes the current heading as the reference of get_swing_angle(),
+    *        e.g. with the door closed.
+    */
+  void set_reference();
+
+  /**
+    * @brief Gets the rotation around the vertical since set_reference().
+    *
+    * @return Angle in deg, from -180 to 180.
+    */
+  float get_swing_angle();
+
+  /**
+    * @brief Restarts the filter. The next sample sets roll and pitch from the
+    *        accelerometer, the learned bias is kept.
+    */
+  void reset();
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ATTITUDEFILTER_H__ */
@@ -11,12 +11,18 @@
 /* Includes ------------------------------------------------------------------*/
 #include "BME688.h" // Module header
 #include "../i2c_master/i2c_master.h"
+#include "../i2c_master/i2c_async.h"
 #include <unistd.h>
 
 /* Private defines -----------------------------------------------------------*/
 #define BME688_ADRR       0x76
 
 #define MAX_GAS_WAIT_TIME 0xFC0
+#define MAX_HEAT_DUR_SHARED 0x783   //ms, largest shared heater time of the parallel mode
+
+#define STATUS_POLL_US      500     //First wait when the measure is not ready yet, doubled on every poll
+#define STATUS_POLL_MAX_US  8000    //Longest wait between two status polls
+#define MEASURE_TIMEOUT_US  200000  //Extra time given to a measure before failing
 
 #define RESET_REG                         0xE0
 #define CHIP_ID_REG                       0xD0
@@ -27,6 +33,7 @@
 #define CONTROL_GAS_1_REG                 0x71
 #define RESISTANCE_HEATER_0_REG           0x5A
 #define GAS_WAIT_0_REG                    0x64
+#define GAS_WAIT_SHARED_REG               0x6E
 #define START_DATA_FIELD_0_REG            0x1D
 
 #define START_GROUP_1_CALIB_REGS          0x8A
@@ -38,6 +45,7 @@
 #define LEN_GROUP_3_CALIB_REGS            5
 
 #define LEN_DATA_FIELD_0                  17
+#define N_DATA_FIELDS                     3   //Contiguous, starting at START_DATA_FIELD_0_REG
 
 #define RESET_VALUE         0xB6
 #define CHIP_ID_VALUE       0x61
@@ -47,11 +55,17 @@
 #define OVSP_MASK           0x07
 #define NB_CONV_MASK        0x0F
 #define NEW_DATA_MSK        0x80
+#define GAS_MEASURING_MSK   0x40
+#define MEASURING_MSK       0x20
 #define GAS_RANGE_MSK       0x0F
+#define GAS_INDEX_MSK       0x0F
+#define GAS_VALID_MSK       0x20
+#define HEAT_STAB_MSK       0x10
 
 #define SLEEP_OP_MODE         0
 #define FORCED_OP_MODE        1
 #define PARALLEL_OP_MODE      2
+#define SEQUENTIAL_OP_MODE    3
 
 #define OVSP_TEMP_POS     5
 #define OVSP_PRESS_POS    2
@@ -60,6 +74,9 @@
 #define HEATER_OFF_POS    3
 #define RUN_GAS_POS       5
 
+#define SUB_MEAS_INDEX      1
+#define GAS_R_LSB           16
+
 #define TEMPERATURE_T1_LSB  8
 #define TEMPERATURE_T1_MSB  9
 #define TEMPERATURE_T2_LSB  0
@@ -104,15 +121,20 @@
 /* Private function prototypes -----------------------------------------------*/
 static int get_data_forced_mode(float *temperature, float *pressure, float *humidity, float *gas_resistance,
                                 float temp_offset, bme688_calib_sensor *calibs);
+static int wait_measure_done();
+static bool measure_done(uint8_t status);
+static void decode_data_field(const uint8_t *buffer, float *temperature, float *pressure, float *humidity,
+                              float *gas_resistance, float temp_offset, bme688_calib_sensor *calibs);
 static int set_operation_mode(uint8_t mode);
 static uint32_t get_measure_duration(uint8_t mode, bme688_oversamplings ovsp);
 static int get_calibs(bme688_calib_sensor *calibs);
 static int set_heat_gas_confs(uint8_t mode, float target_temp, float amb_temp, uint16_t ms, bme688_calib_gas_sensor gas_cals);
 static uint8_t calc_res_heat_x(float target_temp, float amb_temp, bme688_calib_gas_sensor gas_cals);
 static uint8_t calc_gas_wait_x(uint16_t ms);
-static float calc_compensated_temperature(float temp_adc, float temp_offset, bme688_calib_sensor *calibs);
-static float calc_compensated_pressure(float press_adc, bme688_calib_sensor *calibs);
-static float calc_compensated_humidity(float hum_adc, bme688_calib_sensor *calibs);
+static uint8_t calc_heat_dur_shared(uint16_t ms);
+static float calc_compensated_temperature(uint32_t temp_adc, float temp_offset, bme688_calib_sensor *calibs);
+static float calc_compensated_pressure(uint32_t press_adc, bme688_calib_sensor *calibs);
+static float calc_compensated_humidity(uint16_t hum_adc, bme688_calib_sensor *calibs);
 static float calc_compensated_gas_resistance(uint16_t gas_adc, uint8_t gas_range);
 
 
@@ -199,6 +221,8 @@ int BME688::set_oversamplings(uint8_t ovsp_temp, uint8_t ovsp_press, uint8_t ovs
   * @return 0 if success, -1 if error.
   */
 int BME688::set_heater_configurations(bool run_gas, float target_temp, uint16_t ms){
+  heat_ms = run_gas ? ms : 0;
+  profile_len = 0;
   uint8_t buffer[4];
   uint8_t nb_conv = 0;
   if(I2C_Master::read_msg(BME688_ADRR, CONTROL_GAS_0_REG, &buffer[1], 1) == -1)
@@ -223,6 +247,7 @@ int BME688::set_heater_configurations(bool run_gas, float target_temp, uint16_t
 
 /**
   * @brief Obtain a measure from all the metris of the BME sensor. If a specific metric is not needed, pass NULL as parameter.
+  *        It sleeps for the expected conversion and heating time and then polls the measure status.
   *
   * @param[out] temperature The temperature obtained from the sensor.
   * @param[out] pressure The pressure obtained from the sensor.
@@ -230,31 +255,302 @@ int BME688::set_heater_configurations(bool run_gas, float target_temp, uint16_t
   * @param[out] gas_resistance The gas resistance of the hot plate obtained from the sensor. Greater values indicates good
   *                            quality air, smaller values indicates bad quality air.
   *
-  * @return 0 if success, -1 if error.
+  * @return 0 if success, -1 if error or a heater profile is set.
   */
 int BME688::get_data_one_measure(float *temperature, float *pressure, float *humidity, float *gas_resistance){
-  set_operation_mode(FORCED_OP_MODE);
+  //The profile replaced the forced mode heater step and nb_conv selects one of its steps
+  if(profile_len != 0)
+    return -1;
 
-  usleep(get_measure_duration(FORCED_OP_MODE, ovsp) + 100000);
+  if(set_operation_mode(FORCED_OP_MODE) == -1)
+    return -1;
+
+  //Sleep for the expected conversion and heating time, then check the status
+  usleep(get_measure_duration(FORCED_OP_MODE, ovsp) + heat_ms * 1000);
 
   return get_data_forced_mode(temperature, pressure, humidity, gas_resistance, temp_offset, &calibs);
 }
 
 
+/**
+  * @brief Starts a measure in forced mode and returns without waiting for it. Use poll_result() to get it.
+  *
+  * @return 0 if success, -1 if error or a heater profile is set.
+  */
+int BME688::start_measurement(){
+  //The data field buffer may still be in use by a previous read
+  if(pending_read.valid())
+    pending_read.wait();
+  pending_read = std::future<int>();
+
+  measuring = false;
+  if(profile_len != 0)
+    return -1;
+  if(set_operation_mode(FORCED_OP_MODE) == -1)
+    return -1;
+
+  ready_time = std::chrono::steady_clock::now() +
+               std::chrono::microseconds(get_measure_duration(FORCED_OP_MODE, ovsp) + heat_ms * 1000);
+  next_poll = ready_time;
+  poll_us = STATUS_POLL_US;
+  status_only = false;
+  measuring = true;
+  return 0;
+}
+
+
+/**
+  * @brief Gets the measure started with start_measurement() without blocking. The data field is read through the
+  *        asynchronous I2C worker once the measure should be finished. If it is late, only the status byte is
+  *        polled, with a growing wait, until the measure is done. If a specific metric is not needed, pass
+  *        NULL as parameter.
+  *
+  * @param[out] temperature The temperature obtained from the sensor.
+  * @param[out] pressure The pressure obtained from the sensor.
+  * @param[out] humidity The humidity obtained from the sensor.
+  * @param[out] gas_resistance The gas resistance of the hot plate obtained from the sensor.
+  *
+  * @return 0 if the measure was obtained, 1 if it is not ready yet, -1 if error or no measure was started.
+  */
+int BME688::poll_result(float *temperature, float *pressure, float *humidity, float *gas_resistance){
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+  if(!measuring)
+    return -1;
+
+  if(!pending_read.valid()){
+    if(now < next_poll)
+      return 1;
+    //Once late, only the status byte is polled until the measure is done
+    pending_read = I2C_Async::submit_read(BME688_ADRR, START_DATA_FIELD_0_REG, data_field,
+                                          status_only ? 1 : LEN_DATA_FIELD_0);
+  }
+
+  if(pending_read.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    return 1;
+
+  if(pending_read.get() == -1){
+    measuring = false;
+    return -1;
+  }
+
+  //The conversion is late: poll the status again with a growing wait
+  if(!measure_done(data_field[0])){
+    if(now > ready_time + std::chrono::microseconds(MEASURE_TIMEOUT_US)){
+      measuring = false;
+      return -1;
+    }
+    status_only = true;
+    next_poll = now + std::chrono::microseconds(poll_us);
+    if(poll_us < STATUS_POLL_MAX_US)
+      poll_us *= 2;
+    return 1;
+  }
+
+  //The status says the measure is done, the data field comes on the next read
+  if(status_only){
+    status_only = false;
+    pending_read = I2C_Async::submit_read(BME688_ADRR, START_DATA_FIELD_0_REG, data_field, LEN_DATA_FIELD_0);
+    return 1;
+  }
+
+  measuring = false;
+  decode_data_field(data_field, temperature, pressure, humidity, gas_resistance, temp_offset, &calibs);
+  return 0;
+}
+
+
+/**
+  * @brief Set a heater profile for the parallel or sequential mode. The sensor cycles through the steps, taking a gas
+  *        measure at each one, until stop_profile() is called. The sensor is put to sleep first. Forced measures are
+  *        rejected until set_heater_configurations() goes back to forced mode.
+  *
+  * @param[in] mode BME688_PARALLEL_MODE or BME688_SEQUENTIAL_MODE.
+  * @param[in] target_temps The temperature of the hot plate at each step.
+  * @param[in] durations The duration of each step. In sequential mode it is the heating time in ms, as in forced
+  *                      mode. In parallel mode it is the number of measure cycles the step lasts, from 1 to 255.
+  * @param[in] len The number of steps, from 1 to BME688_MAX_HEATER_STEPS.
+  * @param[in] shared_ms Parallel mode only. The heating time added to every measure cycle, under 1923 ms.
+  *
+  * @return 0 if success, -1 if error.
+  */
+int BME688::set_heater_profile(uint8_t mode, const float *target_temps, const uint16_t *durations, uint8_t len,
+                               uint16_t shared_ms){
+  uint8_t buffer[4 * BME688_MAX_HEATER_STEPS + 2];
+  uint8_t n = 0;
+
+  if((mode != PARALLEL_OP_MODE && mode != SEQUENTIAL_OP_MODE) || len == 0 || len > BME688_MAX_HEATER_STEPS)
+    return -1;
+  if(mode == PARALLEL_OP_MODE && (shared_ms == 0 || shared_ms >= MAX_HEAT_DUR_SHARED))
+    return -1;
+  for(uint8_t i = 0; i < len; i++)
+    if(mode == PARALLEL_OP_MODE && (durations[i] == 0 || durations[i] > 0xFF))
+      return -1;
+
+  //The heater can only be configured in sleep mode
+  if(set_operation_mode(SLEEP_OP_MODE) == -1)
+    return -1;
+
+  //All the steps in one write: the sensor takes (register, value) pairs
+  for(uint8_t i = 0; i < len; i++){
+    buffer[n++] = RESISTANCE_HEATER_0_REG + i;
+    buffer[n++] = calc_res_heat_x(target_temps[i], amb_temp, calibs.gas);
+    buffer[n++] = GAS_WAIT_0_REG + i;
+    buffer[n++] = mode == PARALLEL_OP_MODE ? (uint8_t)durations[i] : calc_gas_wait_x(durations[i]);
+    profile_dur[i] = durations[i];
+  }
+  if(mode == PARALLEL_OP_MODE){
+    buffer[n++] = GAS_WAIT_SHARED_REG;
+    buffer[n++] = calc_heat_dur_shared(shared_ms);
+  }
+
+  if(I2C_Master::write_msg(BME688_ADRR, buffer, n) == -1)
+    return -1;
+
+  //Heater on, gas measures on, and the number of steps
+  if(I2C_Master::read_msg(BME688_ADRR, CONTROL_GAS_0_REG, &buffer[1], 1) == -1)
+    return -1;
+  if(I2C_Master::read_msg(BME688_ADRR, CONTROL_GAS_1_REG, &buffer[3], 1) == -1)
+    return -1;
+  buffer[0] = CONTROL_GAS_0_REG;
+  buffer[1] &= ~(1 << HEATER_OFF_POS);
+  buffer[2] = CONTROL_GAS_1_REG;
+  buffer[3] = (buffer[3] & ~(1 << RUN_GAS_POS | NB_CONV_MASK)) | 1 << RUN_GAS_POS | (len & NB_CONV_MASK);
+  if(I2C_Master::write_msg(BME688_ADRR, buffer, 4) == -1)
+    return -1;
+
+  profile_mode = mode;
+  profile_len = len;
+  profile_shared_ms = shared_ms;
+  return 0;
+}
+
+
+/**
+  * @brief Starts the mode of the heater profile set with set_heater_profile().
+  *
+  * @return 0 if success, -1 if error or no profile is set.
+  */
+int BME688::start_profile(){
+  uint8_t buffer[LEN_DATA_FIELD_0 * N_DATA_FIELDS];
+
+  if(profile_len == 0)
+    return -1;
+
+  //Measures left from an earlier run are not returned
+  if(I2C_Master::read_msg(BME688_ADRR, START_DATA_FIELD_0_REG, buffer, sizeof(buffer)) == -1)
+    return -1;
+  meas_index_valid = false;
+  for(int f = 0; f < N_DATA_FIELDS; f++){
+    const uint8_t *field = &buffer[f * LEN_DATA_FIELD_0];
+    if(!(field[0] & NEW_DATA_MSK))
+      continue;
+    if(!meas_index_valid || (int8_t)(field[SUB_MEAS_INDEX] - last_meas_index) > 0)
+      last_meas_index = field[SUB_MEAS_INDEX];
+    meas_index_valid = true;
+  }
+
+  return set_operation_mode(profile_mode);
+}
+
+
+/**
+  * @brief Stops the parallel or sequential mode, the sensor goes to sleep.
+  *
+  * @return 0 if success, -1 if error.
+  */
+int BME688::stop_profile(){
+  return set_operation_mode(SLEEP_OP_MODE);
+}
+
+
+/**
+  * @brief Gets the time one pass through the heater profile takes, to set the period of read_fields(). Set the
+  *        oversamplings first.
+  *
+  * @return The duration in us, 0 if no profile is set.
+  */
+uint32_t BME688::get_profile_duration(){
+  uint32_t us = 0;
+
+  for(uint8_t i = 0; i < profile_len; i++){
+    if(profile_mode == PARALLEL_OP_MODE)
+      us += profile_dur[i] * (get_measure_duration(PARALLEL_OP_MODE, ovsp) + profile_shared_ms * 1000);
+    else
+      us += get_measure_duration(SEQUENTIAL_OP_MODE, ovsp) + profile_dur[i] * 1000;
+  }
+  return us;
+}
+
+
+/**
+  * @brief Reads the three data fields in a single transfer and returns the measures not returned before, oldest first.
+  *        Each one carries the heater step it was taken at. Read at least once every three steps so none is
+  *        overwritten.
+  *
+  * @param[out] data The new measures.
+  * @param[in] max_data The size of data, BME688_N_DATA_FIELDS is enough.
+  *
+  * @return The number of new measures, -1 if error.
+  */
+int BME688::read_fields(bme688_field_data *data, int max_data){
+  uint8_t buffer[LEN_DATA_FIELD_0 * N_DATA_FIELDS];
+  const uint8_t *fields[N_DATA_FIELDS];
+  int n_new = 0;
+
+  if(I2C_Master::read_msg(BME688_ADRR, START_DATA_FIELD_0_REG, buffer, sizeof(buffer)) == -1)
+    return -1;
+
+  //Keep the fields newer than the last measure returned, sorted by their wrapping index
+  for(int f = 0; f < N_DATA_FIELDS; f++){
+    const uint8_t *field = &buffer[f * LEN_DATA_FIELD_0];
+    if(!(field[0] & NEW_DATA_MSK))
+      continue;
+    if(meas_index_valid && (int8_t)(field[SUB_MEAS_INDEX] - last_meas_index) <= 0)
+      continue;
+
+    int pos = n_new++;
+    while(pos > 0 && (int8_t)(field[SUB_MEAS_INDEX] - fields[pos - 1][SUB_MEAS_INDEX]) < 0){
+      fields[pos] = fields[pos - 1];
+      pos--;
+    }
+    fields[pos] = field;
+  }
+
+  if(n_new > max_data)
+    n_new = max_data;
+
+  for(int i = 0; i < n_new; i++){
+    decode_data_field(fields[i], &data[i].temperature, &data[i].pressure, &data[i].humidity,
+                      &data[i].gas_resistance, temp_offset, &calibs);
+    data[i].gas_index = fields[i][0] & GAS_INDEX_MSK;
+    data[i].meas_index = fields[i][SUB_MEAS_INDEX];
+    data[i].gas_valid = fields[i][GAS_R_LSB] & GAS_VALID_MSK;
+    data[i].heat_stable = fields[i][GAS_R_LSB] & HEAT_STAB_MSK;
+    last_meas_index = fields[i][SUB_MEAS_INDEX];
+    meas_index_valid = true;
+  }
+
+  return n_new;
+}
+
+
 /**
   * @brief End communications with the sensor and free all the related resources.
   */
 BME688::~BME688(){
+  if(pending_read.valid())
+    pending_read.wait();
   I2C_Master::end();
 }
 
 
 /* Private functions ---------------------------------------------------------*/
 /**
-  * @brief Set the operation mode of the BME sensor. Can be SLEEP_OP_MODE, FORCED_OP_MODE or PARALLEL_OP_MODE. In practice,
-  * only SLEEP_OP_MODE (sensor off) and FORCED_OP_MODE (one measure, after that sensor off) will be used.
+  * @brief Set the operation mode of the BME sensor. Can be SLEEP_OP_MODE (sensor off), FORCED_OP_MODE (one measure,
+  * after that sensor off), PARALLEL_OP_MODE or SEQUENTIAL_OP_MODE (heater profile scans until sleep mode is set).
   *
-  * @param[in] mode The operation mode. Can be SLEEP_OP_MODE, FORCED_OP_MODE or PARALLEL_OP_MODE.
+  * @param[in] mode The operation mode. Can be SLEEP_OP_MODE, FORCED_OP_MODE, PARALLEL_OP_MODE or SEQUENTIAL_OP_MODE.
   *
   * @return 0 if success, -1 if error.
   */
@@ -320,43 +616,97 @@ static uint32_t get_measure_duration(uint8_t mode, bme688_oversamplings ovsp){
 static int get_data_forced_mode(float *temperature, float *pressure, float *humidity, float *gas_resistance,
                                 float temp_offset, bme688_calib_sensor *calibs){
   uint8_t buffer[LEN_DATA_FIELD_0];
+
+  if(wait_measure_done() == -1)
+    return -1;
+
+  //Bus errors are already retried by the I2C layer
+  if(I2C_Master::read_msg(BME688_ADRR, START_DATA_FIELD_0_REG, buffer, LEN_DATA_FIELD_0) == -1)
+    return -1;
+  if(!measure_done(buffer[0]))
+    return -1;
+
+  decode_data_field(buffer, temperature, pressure, humidity, gas_resistance, temp_offset, calibs);
+  return 0;
+}
+
+
+/**
+  * @brief Polls the measure status until the conversion is done. Only the status byte is read, with a wait that
+  * starts at STATUS_POLL_US and doubles up to STATUS_POLL_MAX_US.
+  *
+  * @return 0 if the measure is done, -1 if error or MEASURE_TIMEOUT_US elapsed.
+  */
+static int wait_measure_done(){
+  uint8_t status;
+  uint32_t poll_us = STATUS_POLL_US;
+  uint32_t waited_us = 0;
+
+  while(1){
+    if(I2C_Master::read_msg(BME688_ADRR, START_DATA_FIELD_0_REG, &status, 1) == -1)
+      return -1;
+    if(measure_done(status))
+      return 0;
+    if(waited_us >= MEASURE_TIMEOUT_US)
+      return -1;
+    usleep(poll_us);
+    waited_us += poll_us;
+    if(poll_us < STATUS_POLL_MAX_US)
+      poll_us *= 2;
+  }
+}
+
+
+/**
+  * @brief Checks the measure status register: new data and neither the TPH nor the gas conversion running.
+  *
+  * @param[in] status The value of the measure status register, first byte of the data field.
+  *
+  * @return true if the measure is done.
+  */
+static bool measure_done(uint8_t status){
+  return (status & NEW_DATA_MSK) && !(status & (MEASURING_MSK | GAS_MEASURING_MSK));
+}
+
+
+/**
+  * @brief Computes the compensated metrics from a data field read from the sensor. If a specific metric is not needed,
+  * pass NULL as parameter.
+  *
+  * @param[in] buffer The data field, LEN_DATA_FIELD_0 bytes.
+  * @param[out] temperature The temperature obtained from the sensor.
+  * @param[out] pressure The pressure obtained from the sensor.
+  * @param[out] humidity The humidity obtained from the sensor.
+  * @param[out] gas_resistance The gas resistance of the hot plate obtained from the sensor.
+  * @param[in] temp_offset A temperature offset to be subtracted to the resulting temperature.
+  * @param[in] calibs A structure with the calibration parameters for the calculation of the compensated metrics.
+  */
+static void decode_data_field(const uint8_t *buffer, float *temperature, float *pressure, float *humidity,
+                              float *gas_resistance, float temp_offset, bme688_calib_sensor *calibs){
   uint8_t gas_range;
   uint32_t adc_temp;
   uint32_t adc_pres;
   uint16_t adc_hum;
   uint16_t adc_gas_res;
-  uint8_t tries = 5;
-
-  do{
-    if(I2C_Master::read_msg(BME688_ADRR, START_DATA_FIELD_0_REG, buffer, LEN_DATA_FIELD_0) != -1){
-      if(buffer[0] & NEW_DATA_MSK){
-
-        if(temperature != NULL){
-          adc_temp = (uint32_t)(((uint32_t)buffer[5] * 4096) | ((uint32_t)buffer[6] * 16) | ((uint32_t)buffer[7] / 16));
-          *temperature = calc_compensated_temperature(adc_temp, temp_offset, calibs);
-        }
-
-        if(pressure != NULL){
-          adc_pres = (uint32_t)(((uint32_t)buffer[2] * 4096) | ((uint32_t)buffer[3] * 16) | ((uint32_t)buffer[4] / 16));
-          *pressure = calc_compensated_pressure(adc_pres, calibs);
-        }
-        if(humidity != NULL){
-          adc_hum = (uint16_t)(((uint32_t)buffer[8] * 256) | (uint32_t)buffer[9]);
-          *humidity = calc_compensated_humidity(adc_hum, calibs);
-        }
-        if(gas_resistance != NULL){
-          adc_gas_res = (uint16_t)((uint32_t)buffer[15] * 4 | (((uint32_t)buffer[16]) / 64));
-          gas_range = buffer[16] & GAS_RANGE_MSK;
-          *gas_resistance = calc_compensated_gas_resistance(adc_gas_res, gas_range);
-        }
-
-        return 0;
-      }
-    }
-    tries--;
-  }while(tries);
 
-  return -1;
+  if(temperature != NULL){
+    adc_temp = (uint32_t)(((uint32_t)buffer[5] * 4096) | ((uint32_t)buffer[6] * 16) | ((uint32_t)buffer[7] / 16));
+    *temperature = calc_compensated_temperature(adc_temp, temp_offset, calibs);
+  }
+
+  if(pressure != NULL){
+    adc_pres = (uint32_t)(((uint32_t)buffer[2] * 4096) | ((uint32_t)buffer[3] * 16) | ((uint32_t)buffer[4] / 16));
+    *pressure = calc_compensated_pressure(adc_pres, calibs);
+  }
+  if(humidity != NULL){
+    adc_hum = (uint16_t)(((uint32_t)buffer[8] * 256) | (uint32_t)buffer[9]);
+    *humidity = calc_compensated_humidity(adc_hum, calibs);
+  }
+  if(gas_resistance != NULL){
+    adc_gas_res = (uint16_t)((uint32_t)buffer[15] * 4 | (((uint32_t)buffer[16]) / 64));
+    gas_range = buffer[16] & GAS_RANGE_MSK;
+    *gas_resistance = calc_compensated_gas_resistance(adc_gas_res, gas_range);
+  }
 }
 
 
@@ -451,6 +801,7 @@ static int set_heat_gas_confs(uint8_t mode, float target_temp, float amb_temp, u
   *
   * @return the target resistance of the heater.
   */
+#ifndef BME688_INT_COMPENSATION
 static uint8_t calc_res_heat_x(float target_temp, float amb_temp, bme688_calib_gas_sensor gas_cals){
   float var1, var2;
   uint8_t res_heat_x;
@@ -462,6 +813,23 @@ static uint8_t calc_res_heat_x(float target_temp, float amb_temp, bme688_calib_g
 
   return res_heat_x;
 }
+#else
+static uint8_t calc_res_heat_x(float target_temp, float amb_temp, bme688_calib_gas_sensor gas_cals){
+  int32_t var1, var2, var3, var4, var5, res_heat_x100;
+  int32_t temp = (int32_t)target_temp;
+
+  //Integer version of the datasheet formula, as in the BME68x-Sensor-API except for the ambient term: there it is
+  //divided by 1000 and is lost, here it has the scale of var2 / 2 like in the floating point formula
+  var1 = (int32_t)amb_temp * gas_cals.par_g3 * 2560;
+  var2 = (gas_cals.par_g1 + 784) * (((((gas_cals.par_g2 + 154009) * temp * 5) / 100) + 3276800) / 10);
+  var3 = var1 + (var2 / 2);
+  var4 = var3 / (gas_cals.res_heat_range + 4);
+  var5 = (131 * gas_cals.res_heat_val) + 65536;
+  res_heat_x100 = ((var4 / var5) - 250) * 34;
+
+  return (uint8_t)((res_heat_x100 + 50) / 100);
+}
+#endif
 
 
 /**
@@ -487,6 +855,33 @@ static uint8_t calc_gas_wait_x(uint16_t ms){
 }
 
 
+/**
+  * @brief Calculate the shared heater time of the parallel mode as a value that can process the gas sensor. The value is
+  * counted in steps of 0.477 ms, with the same multiplier format as the gas wait time.
+  *
+  * @param[in] ms The heating time added to every measure cycle.
+  *
+  * @return the shared heater time.
+  */
+static uint8_t calc_heat_dur_shared(uint16_t ms){
+  uint8_t reg, mult_factor = 0;
+  uint32_t steps;
+  if(ms >= MAX_HEAT_DUR_SHARED){
+    reg = 0xFF; //Maximum value
+  }
+  else{
+    steps = (uint32_t)ms * 1000 / 477;
+    while (steps > 0x3F){
+      steps /= 4;
+      mult_factor++;
+    }
+    reg = steps + mult_factor * 0x40;
+  }
+  return reg;
+}
+
+
+#ifndef BME688_INT_COMPENSATION
 /**
   * @brief Calculate the compensated temperature.
   *
@@ -497,7 +892,7 @@ static uint8_t calc_gas_wait_x(uint16_t ms){
   *
   * @return the compensated temperature.
   */
-static float calc_compensated_temperature(float temp_adc, float temp_offset, bme688_calib_sensor *calibs){
+static float calc_compensated_temperature(uint32_t temp_adc, float temp_offset, bme688_calib_sensor *calibs){
   float var1, var2, temp_comp;
 
   //Perform calibrations according to the operations specified in the datasheet
@@ -519,7 +914,7 @@ static float calc_compensated_temperature(float temp_adc, float temp_offset, bme
   *
   * @return the compensated pressure.
   */
-static float calc_compensated_pressure(float press_adc, bme688_calib_sensor *calibs){
+static float calc_compensated_pressure(uint32_t press_adc, bme688_calib_sensor *calibs){
   float var1, var2, var3, var4, press_comp;
 
   //Perform calibrations according to the operations specified in the datasheet
@@ -554,12 +949,12 @@ static float calc_compensated_pressure(float press_adc, bme688_calib_sensor *cal
   *
   * @return the compensated humidity.
   */
-static float calc_compensated_humidity(float hum_adc, bme688_calib_sensor *calibs){
+static float calc_compensated_humidity(uint16_t hum_adc, bme688_calib_sensor *calibs){
   float temp_comp, var1, var2, var3, var4, hum_comp;
 
   //Perform calibrations according to the operations specified in the datasheet
   temp_comp = calibs->temp.t_fine / 5120.0;
-  var1 = hum_adc - (calibs->hum.par_h1 * 16.0) + ((calibs->hum.par_h3 / 2.0) * temp_comp);
+  var1 = hum_adc - ((calibs->hum.par_h1 * 16.0) + ((calibs->hum.par_h3 / 2.0) * temp_comp));
   var2 = var1 * (
       calibs->hum.par_h2 / 262144.0 * (
           1.0 + (calibs->hum.par_h4 / 16384.0 * temp_comp) + (calibs->hum.par_h5 / 1048576.0 * temp_comp * temp_comp)
@@ -600,4 +995,122 @@ static float calc_compensated_gas_resistance(uint16_t gas_adc, uint8_t gas_range
   return gas_res;
 }
 
+#else
+/**
+  * @brief Calculate the compensated temperature with integer arithmetic.
+  *
+  * @param[in] temp_adc The value of the temperature obtained from the sensor registers.
+  * @param[in] temp_offset A temperature offset to be subtracted to the result.
+  * @param[in] calibs A structure with the calibration parameters for the calculation of the compensated metrics.
+  *
+  * @return the compensated temperature, with a resolution of 0.01 degC.
+  */
+static float calc_compensated_temperature(uint32_t temp_adc, float temp_offset, bme688_calib_sensor *calibs){
+  int64_t var1, var2, var3;
+  int32_t temp_comp;
+
+  //Perform calibrations according to the operations specified in the BME68x-Sensor-API
+  var1 = ((int32_t)temp_adc >> 3) - ((int32_t)calibs->temp.par_t1 << 1);
+  var2 = (var1 * (int32_t)calibs->temp.par_t2) >> 11;
+  var3 = ((var1 >> 1) * (var1 >> 1)) >> 12;
+  var3 = (var3 * ((int32_t)calibs->temp.par_t3 << 4)) >> 14;
+  calibs->temp.t_fine = (int32_t)(var2 + var3) - (int32_t)(temp_offset * 5120);
+  temp_comp = ((calibs->temp.t_fine * 5) + 128) >> 8;
+
+  return temp_comp / 100.0f;
+}
+
+
+/**
+  * @brief Calculate the compensated pressure with integer arithmetic.
+  *
+  * @param[in] press_adc The value of the pressure obtained from the sensor registers.
+  * @param[in] calibs A structure with the calibration parameters for the calculation of the compensated metrics.
+  *
+  * @return the compensated pressure, with a resolution of 1 Pa.
+  */
+static float calc_compensated_pressure(uint32_t press_adc, bme688_calib_sensor *calibs){
+  int32_t var1, var2, var3, press_comp;
+
+  //Perform calibrations according to the operations specified in the BME68x-Sensor-API
+  var1 = (calibs->temp.t_fine >> 1) - 64000;
+  var2 = ((((var1 >> 2) * (var1 >> 2)) >> 11) * (int32_t)calibs->press.par_p6) >> 2;
+  var2 = var2 + ((var1 * (int32_t)calibs->press.par_p5) * 2);
+  var2 = (var2 >> 2) + ((int32_t)calibs->press.par_p4 * 65536);
+  var1 = (((((var1 >> 2) * (var1 >> 2)) >> 13) * ((int32_t)calibs->press.par_p3 * 32)) >> 3) +
+         (((int32_t)calibs->press.par_p2 * var1) >> 1);
+  var1 = var1 >> 18;
+  var1 = ((32768 + var1) * (int32_t)calibs->press.par_p1) >> 15;
+  if(var1 == 0)
+    return 0;
+
+  //In 64 bits: the product reaches 2^32 at high pressures
+  press_comp = (int32_t)((((int64_t)1048576 - press_adc - (var2 >> 12)) * 3125 * 2) / var1);
+  var1 = ((int32_t)calibs->press.par_p9 * (int32_t)(((press_comp >> 3) * (press_comp >> 3)) >> 13)) >> 12;
+  var2 = ((int32_t)(press_comp >> 2) * (int32_t)calibs->press.par_p8) >> 13;
+  //In 64 bits: the cube overflows over about 105 kPa
+  var3 = (int32_t)(((int64_t)(press_comp >> 8) * (press_comp >> 8) * (press_comp >> 8) * calibs->press.par_p10) >> 17);
+  press_comp = press_comp + ((var1 + var2 + var3 + ((int32_t)calibs->press.par_p7 * 128)) >> 4);
+
+  return (float)press_comp;
+}
+
+
+/**
+  * @brief Calculate the compensated humidity with integer arithmetic.
+  *
+  * @param[in] hum_adc The value of the humidity obtained from the sensor registers.
+  * @param[in] calibs A structure with the calibration parameters for the calculation of the compensated metrics.
+  *
+  * @return the compensated humidity, with a resolution of 0.001 %RH.
+  */
+static float calc_compensated_humidity(uint16_t hum_adc, bme688_calib_sensor *calibs){
+  int32_t var1, var2, var3, var4, var5, var6, temp_scaled, hum_comp;
+
+  //Perform calibrations according to the operations specified in the BME68x-Sensor-API
+  temp_scaled = ((calibs->temp.t_fine * 5) + 128) >> 8;
+  var1 = (int32_t)(hum_adc - ((int32_t)calibs->hum.par_h1 * 16)) -
+         (((temp_scaled * (int32_t)calibs->hum.par_h3) / 100) >> 1);
+  var2 = ((int32_t)calibs->hum.par_h2 *
+          (((temp_scaled * (int32_t)calibs->hum.par_h4) / 100) +
+           (((temp_scaled * ((temp_scaled * (int32_t)calibs->hum.par_h5) / 100)) >> 6) / 100) + (1 << 14))) >> 10;
+  var3 = var1 * var2;
+  var4 = (int32_t)calibs->hum.par_h6 << 7;
+  var4 = (var4 + ((temp_scaled * (int32_t)calibs->hum.par_h7) / 100)) >> 4;
+  var5 = ((var3 >> 14) * (var3 >> 14)) >> 10;
+  var6 = (var4 * var5) >> 1;
+  hum_comp = (((var3 + var6) >> 10) * 1000) >> 12;
+
+  if (hum_comp > 100000){
+    hum_comp = 100000;
+  }
+  else if (hum_comp < 0){
+    hum_comp = 0;
+  }
+  return hum_comp / 1000.0f;
+}
+
+
+/**
+  * @brief Calculate the compensated gas resistance with integer arithmetic.
+  *
+  * @param[in] gas_adc The value of the gas resistance obtained from the sensor registers.
+  * @param[in] gas_range A calibration parameter to obtain the gas resistance.
+  *
+  * @return the compensated gas resistance, with a resolution of 1 Ohm.
+  */
+static float calc_compensated_gas_resistance(uint16_t gas_adc, uint8_t gas_range){
+  uint32_t var1, gas_res;
+  int32_t var2;
+
+  //Perform calibrations according to the operations specified in the BME68x-Sensor-API
+  var1 = ((uint32_t)262144) >> gas_range;
+  var2 = ((int32_t)gas_adc - 512) * 3 + 4096;
+  //The product needs 64 bits, splitting the 10^6 instead costs two digits on low resistances
+  gas_res = (uint32_t)(((uint64_t)1000000 * var1) / (uint32_t)var2);
+
+  return (float)gas_res;
+}
+#endif
+
 
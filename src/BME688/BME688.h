@@ -15,12 +15,58 @@
 /* Includes ------------------------------------------------------------------*/
 #include <stdint.h>
 #include <stdio.h>
+#include <chrono>
+#include <future>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 /* Exported variables --------------------------------------------------------*/
 /* Exported types ------------------------------------------------------------*/
+#ifdef BME688_INT_COMPENSATION
+//Calibration as read from the sensor, for the integer compensation formulas
+struct bme688_calib_temperature_sensor
+{
+  uint16_t par_t1;
+  int16_t par_t2;
+  int8_t par_t3;
+  int32_t t_fine;     //Temperature in 1/5120 degC, shared with the pressure and humidity compensation
+};
+
+struct bme688_calib_pressure_sensor
+{
+  uint16_t par_p1;
+  int16_t par_p2;
+  int8_t par_p3;
+  int16_t par_p4;
+  int16_t par_p5;
+  int8_t par_p6;
+  int8_t par_p7;
+  int16_t par_p8;
+  int16_t par_p9;
+  uint8_t par_p10;
+};
+
+struct bme688_calib_humidity_sensor
+{
+  uint16_t par_h1;
+  uint16_t par_h2;
+  int8_t par_h3;
+  int8_t par_h4;
+  int8_t par_h5;
+  uint8_t par_h6;
+  int8_t par_h7;
+};
+
+struct bme688_calib_gas_sensor
+{
+  int8_t par_g1;
+  int16_t par_g2;
+  int8_t par_g3;
+  uint8_t res_heat_range;
+  int8_t res_heat_val;
+};
+#else
 struct bme688_calib_temperature_sensor
 {
   float par_t1;
@@ -62,6 +108,7 @@ struct bme688_calib_gas_sensor
   float res_heat_range;
   float res_heat_val;
 };
+#endif
 
 struct bme688_calib_sensor
 {
@@ -77,13 +124,36 @@ struct bme688_oversamplings
   uint8_t press;
   uint8_t hum;
 };
+
+struct bme688_field_data
+{
+  float temperature;
+  float pressure;
+  float humidity;
+  float gas_resistance;
+  uint8_t gas_index;    //Heater profile step of the gas measure
+  uint8_t meas_index;   //Sub-measurement counter, increases with every measure
+  bool gas_valid;
+  bool heat_stable;     //The hot plate reached the target temperature
+};
 /* Exported constants --------------------------------------------------------*/
+//Build with BME688_INT_COMPENSATION defined to compensate with integer arithmetic only. The results are the same
+//within the resolution of the sensor and do not depend on the floating point unit.
+
 #define OVSP_0_X      0  //Sensor off
 #define OVSP_1_X      1
 #define OVSP_2_X      2
 #define OVSP_4_X      3
 #define OVSP_8_X      4
 #define OVSP_16_X     5
+
+#define BME688_DATA_FIELD_LEN   17  //Bytes of the data field read per measure
+#define BME688_N_DATA_FIELDS    3   //Data fields filled in turn in parallel and sequential modes
+
+#define BME688_MAX_HEATER_STEPS 10
+
+#define BME688_PARALLEL_MODE    2
+#define BME688_SEQUENTIAL_MODE  3
 /* Exported macro ------------------------------------------------------------*/
 /* Exported Functions --------------------------------------------------------*/
 class BME688{
@@ -91,12 +161,28 @@ class BME688{
   bme688_oversamplings ovsp;
   float amb_temp;
   float temp_offset;
+  uint16_t heat_ms;
+  bool measuring;
+  std::chrono::steady_clock::time_point ready_time;
+  std::chrono::steady_clock::time_point next_poll;
+  uint32_t poll_us;
+  bool status_only;
+  std::future<int> pending_read;
+  uint8_t data_field[BME688_DATA_FIELD_LEN];
+  uint8_t profile_mode;
+  uint8_t profile_len;
+  uint16_t profile_dur[BME688_MAX_HEATER_STEPS];
+  uint16_t profile_shared_ms;
+  uint8_t last_meas_index;
+  bool meas_index_valid;
 public:
 
   /**
     * @brief Class constructor. Sets the ambient temperature.
     */
-  BME688(float amb_temp, float temp_offset): amb_temp(amb_temp), temp_offset(temp_offset){};
+  BME688(float amb_temp, float temp_offset): amb_temp(amb_temp), temp_offset(temp_offset), heat_ms(0), measuring(false),
+                                             poll_us(0), status_only(false), profile_mode(0), profile_len(0),
+                                             profile_shared_ms(0), last_meas_index(0), meas_index_valid(false){};
 
   /**
     * @brief Starts the module and the communications with the BME sensor and obtain the calibration parameters from the sensor.
@@ -138,6 +224,7 @@ public:
 
   /**
     * @brief Obtain a measure from all the metris of the BME sensor. If a specific metric is not needed, pass NULL as parameter.
+    *        It sleeps for the expected conversion and heating time and then polls the measure status.
     *
     * @param[out] temperature The temperature obtained from the sensor.
     * @param[out] pressure The pressure obtained from the sensor.
@@ -145,10 +232,83 @@ public:
     * @param[out] gas_resistance The gas resistance of the hot plate obtained from the sensor. Greater values indicates good
     *                            quality air, smaller values indicates bad quality air.
     *
-    * @return 0 if success, -1 if error.
+    * @return 0 if success, -1 if error or a heater profile is set.
     */
   int get_data_one_measure(float *temperature, float *pressure, float *humidity, float *gas_resistance);
 
+  /**
+    * @brief Starts a measure in forced mode and returns without waiting for it. Use poll_result() to get it.
+    *
+    * @return 0 if success, -1 if error or a heater profile is set.
+    */
+  int start_measurement();
+
+  /**
+    * @brief Gets the measure started with start_measurement() without blocking. The data field is read through the
+    *        asynchronous I2C worker once the measure should be finished. If it is late, only the status byte is
+    *        polled, with a growing wait, until the measure is done. If a specific metric is not needed, pass
+    *        NULL as parameter.
+    *
+    * @param[out] temperature The temperature obtained from the sensor.
+    * @param[out] pressure The pressure obtained from the sensor.
+    * @param[out] humidity The humidity obtained from the sensor.
+    * @param[out] gas_resistance The gas resistance of the hot plate obtained from the sensor.
+    *
+    * @return 0 if the measure was obtained, 1 if it is not ready yet, -1 if error or no measure was started.
+    */
+  int poll_result(float *temperature, float *pressure, float *humidity, float *gas_resistance);
+
+  /**
+    * @brief Set a heater profile for the parallel or sequential mode. The sensor cycles through the steps, taking a gas
+    *        measure at each one, until stop_profile() is called. The sensor is put to sleep first. Forced measures are
+    *        rejected until set_heater_configurations() goes back to forced mode.
+    *
+    * @param[in] mode BME688_PARALLEL_MODE or BME688_SEQUENTIAL_MODE.
+    * @param[in] target_temps The temperature of the hot plate at each step.
+    * @param[in] durations The duration of each step. In sequential mode it is the heating time in ms, as in forced
+    *                      mode. In parallel mode it is the number of measure cycles the step lasts, from 1 to 255.
+    * @param[in] len The number of steps, from 1 to BME688_MAX_HEATER_STEPS.
+    * @param[in] shared_ms Parallel mode only. The heating time added to every measure cycle, under 1923 ms.
+    *
+    * @return 0 if success, -1 if error.
+    */
+  int set_heater_profile(uint8_t mode, const float *target_temps, const uint16_t *durations, uint8_t len,
+                         uint16_t shared_ms = 0);
+
+  /**
+    * @brief Starts the mode of the heater profile set with set_heater_profile().
+    *
+    * @return 0 if success, -1 if error or no profile is set.
+    */
+  int start_profile();
+
+  /**
+    * @brief Stops the parallel or sequential mode, the sensor goes to sleep.
+    *
+    * @return 0 if success, -1 if error.
+    */
+  int stop_profile();
+
+  /**
+    * @brief Gets the time one pass through the heater profile takes, to set the period of read_fields(). Set the
+    *        oversamplings first.
+    *
+    * @return The duration in us, 0 if no profile is set.
+    */
+  uint32_t get_profile_duration();
+
+  /**
+    * @brief Reads the three data fields in a single transfer and returns the measures not returned before, oldest first.
+    *        Each one carries the heater step it was taken at. Read at least once every three steps so none is
+    *        overwritten.
+    *
+    * @param[out] data The new measures.
+    * @param[in] max_data The size of data, BME688_N_DATA_FIELDS is enough.
+    *
+    * @return The number of new measures, -1 if error.
+    */
+  int read_fields(bme688_field_data *data, int max_data);
+
   /**
    * @brief End communications with the sensor and free all the related resources.
    */
@@ -0,0 +1,260 @@
+/**
+  ******************************************************************************
+  * @file   i2c_simulator.cpp
+  * @brief  In-memory I2C Bus Simulator.
+  *
+  * @note   End-of-degree work.
+  *         This module provides an I2C backend with simulated slave devices
+  *         so the sensor drivers can run without the real hardware.
+  ******************************************************************************
+*/
+
+/* Includes ------------------------------------------------------------------*/
+#include "i2c_simulator.h" // Module header
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+/* Private defines -----------------------------------------------------------*/
+#define BITS_PER_BYTE   9   //8 data bits + ACK
+#define START_STOP_BITS 2
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private variables----------------------------------------------------------*/
+/* Private function prototypes -----------------------------------------------*/
+/* Functions -----------------------------------------------------------------*/
+
+/**
+ * @brief Class constructor. Constant signal.
+ */
+I2CSimulator::Signal::Signal(float value){
+  generator = [value](double) { return value; };
+}
+
+
+/**
+ * @brief Sine wave `offset + amplitude * sin(2*pi*freq_hz*t)`.
+ */
+I2CSimulator::Signal I2CSimulator::Signal::sine(float offset, float amplitude, float freq_hz){
+  return Signal(std::function<float(double)>([=](double t) {
+    return (float)(offset + amplitude * std::sin(2.0 * M_PI * freq_hz * t));
+  }));
+}
+
+
+/**
+ * @brief Recorded signal. The samples are copied and linearly interpolated.
+ *
+ * @param[in] samples Recorded samples.
+ * @param[in] samples_len Number of samples.
+ * @param[in] rate_hz Sample rate of the recording.
+ * @param[in] loop If true the recording repeats, otherwise it holds the last sample.
+ */
+I2CSimulator::Signal I2CSimulator::Signal::recorded(const float *samples, int samples_len, float rate_hz, bool loop){
+  if(samples_len <= 0)
+    return Signal(0.0f);
+
+  std::shared_ptr<std::vector<float>> rec = std::make_shared<std::vector<float>>(samples, samples + samples_len);
+
+  return Signal(std::function<float(double)>([rec, rate_hz, loop](double t) {
+    int len = rec->size();
+    double pos = t * rate_hz;
+    if(pos < 0)
+      pos = 0;
+    if(loop)
+      pos = std::fmod(pos, (double)len);
+    else if(pos >= len - 1)
+      return (*rec)[len - 1];
+
+    int i = (int)pos;
+    float frac = pos - i;
+    float next = (*rec)[(i + 1) % len];
+    return (*rec)[i] + ((next - (*rec)[i]) * frac);
+  }));
+}
+
+
+/**
+ * @brief Class constructor. All the registers start at 0.
+ */
+I2CSimulator::Device::Device(uint8_t address) : address(address){
+  std::memset(regs, 0, sizeof(regs));
+}
+
+
+/**
+ * @brief Handles a write message. data[0] is the register pointer and the rest
+ *        of the bytes are written with auto-increment.
+ */
+int I2CSimulator::Device::write(const uint8_t *data, int data_length, double t){
+  if(data_length < 1)
+    return 0;
+
+  uint8_t reg = data[0];
+  for(int i = 1; i < data_length; i++){
+    write_reg(reg++, data[i], t);
+  }
+  return 0;
+}
+
+
+/**
+ * @brief Handles a read starting at register `reg` with auto-increment.
+ */
+int I2CSimulator::Device::read(uint8_t reg, uint8_t *data, int data_length, double t){
+  for(int i = 0; i < data_length; i++){
+    data[i] = read_reg(reg++, t);
+  }
+  return 0;
+}
+
+
+void I2CSimulator::Device::write_reg(uint8_t reg, uint8_t value, double t){
+  regs[reg] = value;
+}
+
+
+uint8_t I2CSimulator::Device::read_reg(uint8_t reg, double t){
+  return regs[reg];
+}
+
+
+/**
+ * @brief Class constructor.
+ *
+ * @param[in] speed Simulated seconds per wall clock second. 0 means that the time
+ *                  only moves with advance().
+ * @param[in] bus_freq SCL frequency used to account the wire time.
+ */
+I2CSimulator::Bus::Bus(double speed, int bus_freq){
+  std::memset(devices, 0, sizeof(devices));
+  this->speed = speed;
+  this->bus_freq = bus_freq;
+  manual_time = 0;
+  wall_start = std::chrono::steady_clock::now();
+  wire_time_ns = 0;
+  transactions = 0;
+  opened = false;
+}
+
+
+/**
+ * @brief Connects a device to the bus. The bus does not take ownership.
+ *
+ * @return 0 if success, -1 if the address is in use or invalid.
+ */
+int I2CSimulator::Bus::attach(Device *device){
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+
+  if(device == NULL || device->address > 0x7F || devices[device->address] != NULL)
+    return -1;
+
+  devices[device->address] = device;
+  return 0;
+}
+
+
+/**
+ * @brief Disconnects the device with the given address. Accesses to it will NACK.
+ */
+void I2CSimulator::Bus::detach(uint8_t addr){
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+
+  if(addr <= 0x7F)
+    devices[addr] = NULL;
+}
+
+
+/**
+ * @brief Current simulated time in seconds.
+ */
+double I2CSimulator::Bus::now(){
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+
+  if(speed == 0)
+    return manual_time;
+
+  std::chrono::duration<double> wall = std::chrono::steady_clock::now() - wall_start;
+  return manual_time + wall.count() * speed;
+}
+
+
+/**
+ * @brief Moves the simulated time forward. Only meaningful with speed 0.
+ */
+void I2CSimulator::Bus::advance(double seconds){
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  manual_time += seconds;
+}
+
+
+int I2CSimulator::Bus::open(int i2c_device){
+  opened = true;
+  return 0;
+}
+
+
+int I2CSimulator::Bus::write_msg(uint8_t addr, uint8_t data[], uint8_t data_length){
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  Device *device;
+
+  double t = transfer_start(&device, addr);
+  account(1 + data_length);
+  if(device == NULL)
+    return -1;
+
+  if(device->write(data, data_length, t) == -1)
+    return -1;
+  return 1;
+}
+
+
+int I2CSimulator::Bus::read_msg(uint8_t addr, uint8_t read_reg, uint8_t data[], uint8_t data_length){
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  Device *device;
+
+  double t = transfer_start(&device, addr);
+  account(3 + data_length);
+  if(device == NULL)
+    return -1;
+
+  if(device->read(read_reg, data, data_length, t) == -1)
+    return -1;
+  return 2;
+}
+
+
+int I2CSimulator::Bus::close(){
+  opened = false;
+  return 0;
+}
+
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+ * @brief Looks up the addressed device and brings it to the current simulated time.
+ *
+ * @param[out] device The addressed device, NULL if nothing answers or the bus is closed.
+ * @param[in] addr I2C 7-bits slave address.
+ *
+ * @return The simulated time of the transfer.
+ */
+double I2CSimulator::Bus::transfer_start(Device **device, uint8_t addr){
+  double t = now();
+
+  transactions++;
+  *device = (opened && addr <= 0x7F) ? devices[addr] : NULL;
+  if(*device != NULL)
+    (*device)->update(t);
+  return t;
+}
+
+
+/**
+ * @brief Accounts the wire time of a transfer of `bytes` bytes, addresses included.
+ */
+void I2CSimulator::Bus::account(int bytes){
+  wire_time_ns += (uint64_t)(bytes * BITS_PER_BYTE + START_STOP_BITS) * 1000000000ULL / bus_freq;
+}
@@ -0,0 +1,196 @@
+/**
+  ******************************************************************************
+  * @file   i2c_simulator.h
+  * @brief  In-memory I2C Bus Simulator Header.
+  *
+  * @note   End-of-degree work.
+  *         This module provides an I2C backend with simulated slave devices
+  *         so the sensor drivers can run without the real hardware. Each
+  *         device models its register map and generates its measurements
+  *         from signal generators evaluated on a simulated clock.
+  ******************************************************************************
+*/
+
+#ifndef __I2C_SIMULATOR_H__
+#define __I2C_SIMULATOR_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <functional>
+#include <mutex>
+#include <chrono>
+#include "../i2c_master/i2c_backend.h"
+
+namespace I2CSimulator{
+
+/* Exported constants --------------------------------------------------------*/
+const int BUS_FREQ_STANDARD = 100000;
+const int BUS_FREQ_FAST     = 400000;
+
+/* Exported types ------------------------------------------------------------*/
+
+class Bus;
+
+/**
+ * @brief Signal generator evaluated on the simulated time, in seconds.
+ */
+class Signal{
+  std::function<float(double)> generator;
+public:
+  Signal() : Signal(0.0f) {};
+
+  /**
+   * @brief Class constructor. Constant signal.
+   */
+  Signal(float value);
+
+  /**
+   * @brief Class constructor. Scripted signal: any function of time.
+   */
+  Signal(std::function<float(double)> generator) : generator(generator) {};
+
+  /**
+   * @brief Sine wave `offset + amplitude * sin(2*pi*freq_hz*t)`.
+   */
+  static Signal sine(float offset, float amplitude, float freq_hz);
+
+  /**
+   * @brief Recorded signal. The samples are copied and linearly interpolated.
+   *
+   * @param[in] samples Recorded samples.
+   * @param[in] samples_len Number of samples.
+   * @param[in] rate_hz Sample rate of the recording.
+   * @param[in] loop If true the recording repeats, otherwise it holds the last sample.
+   */
+  static Signal recorded(const float *samples, int samples_len, float rate_hz, bool loop);
+
+  /**
+   * @brief Value of the signal at time `t` in seconds.
+   */
+  float at(double t) const { return generator(t); };
+};
+
+
+/**
+ * @brief Simulated I2C slave. By default it behaves as a plain register map with
+ *        auto-increment on reads and writes. Devices override the hooks to model
+ *        side effects (data generation, FIFOs, resets).
+ */
+class Device{
+protected:
+  uint8_t regs[256];
+public:
+  const uint8_t address;
+
+  Device(uint8_t address);
+
+  /**
+   * @brief Handles a write message. data[0] is the register pointer.
+   *
+   * @return 0 if success, -1 to NACK the message.
+   */
+  virtual int write(const uint8_t *data, int data_length, double t);
+
+  /**
+   * @brief Handles a read starting at register `reg`.
+   *
+   * @return 0 if success, -1 to NACK the message.
+   */
+  virtual int read(uint8_t reg, uint8_t *data, int data_length, double t);
+
+  /**
+   * @brief Register access hooks used by the default write() and read().
+   */
+  virtual void write_reg(uint8_t reg, uint8_t value, double t);
+  virtual uint8_t read_reg(uint8_t reg, double t);
+
+  /**
+   * @brief Brings the model up to the simulated time `t` before each transaction.
+   */
+  virtual void update(double t) {};
+
+  /**
+   * @brief Direct register access for tests, bypassing the hooks.
+   */
+  uint8_t peek(uint8_t reg) const { return regs[reg]; };
+  void poke(uint8_t reg, uint8_t value) { regs[reg] = value; };
+
+  virtual ~Device() {};
+};
+
+
+/**
+ * @brief Simulated bus. Install it with I2C_Master::set_backend().
+ *
+ *        The simulated time runs either from the wall clock multiplied by a speed
+ *        factor, or is advanced manually with advance() when the speed factor is 0.
+ *        The bus also accumulates the time the transfers would take on the wire at
+ *        the configured frequency, to benchmark bus occupancy.
+ */
+class Bus : public I2C_Backend{
+  Device *devices[128];
+  std::recursive_mutex mutex;
+  double speed;
+  double manual_time;
+  std::chrono::steady_clock::time_point wall_start;
+  int bus_freq;
+  uint64_t wire_time_ns;
+  uint32_t transactions;
+  bool opened;
+
+  double transfer_start(Device **device, uint8_t addr);
+  void account(int bytes);
+public:
+
+  /**
+   * @brief Class constructor.
+   *
+   * @param[in] speed Simulated seconds per wall clock second. 0 means that the time
+   *                  only moves with advance().
+   * @param[in] bus_freq SCL frequency used to account the wire time.
+   */
+  Bus(double speed = 1.0, int bus_freq = BUS_FREQ_STANDARD);
+
+  /**
+   * @brief Connects a device to the bus. The bus does not take ownership.
+   *
+   * @return 0 if success, -1 if the address is in use or invalid.
+   */
+  int attach(Device *device);
+
+  /**
+   * @brief Disconnects the device with the given address. Accesses to it will NACK.
+   */
+  void detach(uint8_t addr);
+
+  /**
+   * @brief Current simulated time in seconds.
+   */
+  double now();
+
+  /**
+   * @brief Moves the simulated time forward. Only meaningful with speed 0.
+   */
+  void advance(double seconds);
+
+  /**
+   * @brief Time the transfers would have kept the wire busy, in ns.
+   */
+  uint64_t get_wire_time_ns() const { return wire_time_ns; };
+
+  /**
+   * @brief Number of transactions served.
+   */
+  uint32_t get_transactions() const { return transactions; };
+
+  int open(int i2c_device) override;
+  int write_msg(uint8_t addr, uint8_t data[], uint8_t data_length) override;
+  int read_msg(uint8_t addr, uint8_t read_reg, uint8_t data[], uint8_t data_length) override;
+  int close() override;
+};
+
+/* Exported macro ------------------------------------------------------------*/
+/* Exported Functions --------------------------------------------------------*/
+}
+
+#endif /* __I2C_SIMULATOR_H__ */
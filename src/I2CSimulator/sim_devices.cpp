@@ -0,0 +1,1076 @@
+/**
+  ******************************************************************************
+  * @file   sim_devices.cpp
+  * @brief  Simulated Sensor Models.
+  *
+  * @note   End-of-degree work.
+  *         Register-level models of the BME688, LSM6DSOX and APDS9660 sensors
+  *         for the I2C Bus Simulator.
+  ******************************************************************************
+*/
+
+/* Includes ------------------------------------------------------------------*/
+#include "sim_devices.h" // Module header
+#include <cmath>
+#include <cstring>
+
+/* Private defines -----------------------------------------------------------*/
+//BME688
+#define BME_RESET_REG           0xE0
+#define BME_RESET_VALUE         0xB6
+#define BME_CHIP_ID_REG         0xD0
+#define BME_CHIP_ID_VALUE       0x61
+#define BME_VARIANT_ID_REG      0xF0
+#define BME_VARIANT_ID_VALUE    0x01
+#define BME_CTRL_GAS_1_REG      0x71
+#define BME_CTRL_HUM_REG        0x72
+#define BME_CTRL_MEAS_REG       0x74
+#define BME_GAS_WAIT_0_REG      0x64
+#define BME_GAS_WAIT_SHARED_REG 0x6E
+#define BME_MEAS_STATUS_0_REG   0x1D
+#define BME_PRESS_MSB_REG       0x1F
+#define BME_TEMP_MSB_REG        0x22
+#define BME_HUM_MSB_REG         0x25
+#define BME_GAS_R_MSB_REG       0x2C
+#define BME_GAS_R_LSB_REG       0x2D
+#define BME_CALIB_1_REG         0x8A
+#define BME_CALIB_2_REG         0xE1
+#define BME_CALIB_3_REG         0x00
+
+#define BME_NEW_DATA_MSK        0x80
+#define BME_MEASURING_MSK       0x20
+#define BME_RUN_GAS_MSK         0x20
+#define BME_GAS_VALID_MSK       0x20
+#define BME_HEAT_STAB_MSK       0x10
+#define BME_GAS_INDEX_MSK       0x0F
+#define BME_NB_CONV_MSK         0x0F
+#define BME_FORCED_MODE         1
+#define BME_PARALLEL_MODE       2
+#define BME_SEQUENTIAL_MODE     3
+#define BME_FIELD_LEN           17
+#define BME_N_FIELDS            3
+
+//LSM6DSOX
+#define LSM_FUNC_CFG_ACCESS_REG 0x01
+#define LSM_FIFO_CTRL1_REG      0x07
+#define LSM_FIFO_CTRL2_REG      0x08
+#define LSM_FIFO_CTRL3_REG      0x09
+#define LSM_FIFO_CTRL4_REG      0x0A
+#define LSM_WHO_AM_I_REG        0x0F
+#define LSM_WHO_AM_I_VALUE      0x6C
+#define LSM_CTRL1_XL_REG        0x10
+#define LSM_CTRL2_G_REG         0x11
+#define LSM_CTRL3_C_REG         0x12
+#define LSM_CTRL10_C_REG        0x19
+#define LSM_STATUS_REG          0x1E
+#define LSM_OUT_TEMP_REG        0x20
+#define LSM_OUTX_G_REG          0x22
+#define LSM_OUTX_A_REG          0x28
+#define LSM_WAKE_UP_SRC_REG     0x1B
+#define LSM_D6D_SRC_REG         0x1D
+#define LSM_FIFO_STATUS1_REG    0x3A
+#define LSM_FIFO_STATUS2_REG    0x3B
+#define LSM_TIMESTAMP0_REG      0x40
+#define LSM_FIFO_DATA_TAG_REG   0x78
+#define LSM_FIFO_DATA_END_REG   0x7E
+#define LSM_TAP_CFG2_REG        0x58
+#define LSM_TAP_THS_6D_REG      0x59
+#define LSM_WAKE_UP_THS_REG     0x5B
+
+#define LSM_SW_RESET_MSK        0x01
+#define LSM_TIMESTAMP_EN_MSK    0x20
+#define LSM_FIFO_MODE_MSK       0x07
+#define LSM_FUNC_CFG_ACCESS_MSK 0x80
+#define LSM_INTERRUPTS_EN_MSK   0x80
+#define LSM_WU_IA_MSK           0x08
+#define LSM_D6D_IA_MSK          0x40
+#define LSM_FIFO_BYPASS         0
+#define LSM_FIFO_FIFO           1
+#define LSM_FIFO_CONTINUOUS     6
+
+#define LSM_TAG_GYR             0x01
+#define LSM_TAG_ACC             0x02
+#define LSM_TAG_TIMESTAMP       0x04
+
+#define LSM_TIMESTAMP_LSB_S     25e-6
+
+//APDS9660
+#define APDS_ENABLE_REG         0x80
+#define APDS_ATIME_REG          0x81
+#define APDS_PILT_REG           0x89
+#define APDS_PIHT_REG           0x8B
+#define APDS_PERS_REG           0x8C
+#define APDS_CONTROL_REG        0x8F
+#define APDS_ID_REG             0x92
+#define APDS_ID_VALUE           0xAB
+#define APDS_STATUS_REG         0x93
+#define APDS_CDATA_REG          0x94
+#define APDS_PDATA_REG          0x9C
+#define APDS_GPENTH_REG         0xA0
+#define APDS_GEXTH_REG          0xA1
+#define APDS_GCONF1_REG         0xA2
+#define APDS_GCONF2_REG         0xA3
+#define APDS_GCONF4_REG         0xAB
+#define APDS_GFLVL_REG          0xAE
+#define APDS_GSTATUS_REG        0xAF
+#define APDS_GFIFO_U_REG        0xFC
+#define APDS_GFIFO_R_REG        0xFF
+#define APDS_PICLEAR_REG        0xE5
+#define APDS_AICLEAR_REG        0xE7
+
+#define APDS_PON_MSK            0x01
+#define APDS_AEN_MSK            0x02
+#define APDS_PEN_MSK            0x04
+#define APDS_PIEN_MSK           0x20
+#define APDS_GEN_MSK            0x40
+#define APDS_PINT_MSK           0x20
+#define APDS_GMODE_MSK          0x01
+#define APDS_GFIFO_CLR_MSK      0x04
+#define APDS_GVALID_MSK         0x01
+#define APDS_GFOV_MSK           0x02
+
+#define APDS_COUNTS_PER_LUX     0.216   //Per gain unit and integration cycle
+#define APDS_COUNTS_PER_CYCLE   1025
+#define APDS_GESTURE_CONV_S     2.8e-3
+
+/* Private typedef -----------------------------------------------------------*/
+struct bme_calib{
+  float t1, t2, t3;
+  float p1, p2, p3, p4, p5, p6, p7, p8, p9, p10;
+  float h1, h2, h3, h4, h5, h6, h7;
+};
+
+/* Private variables----------------------------------------------------------*/
+//Calibration of a typical part. Encoded into the calibration blocks on reset.
+static const bme_calib calib = {
+  26045, 26440, 3,
+  36478, -10420, 88, 6620, -111, 30, 34, -2706, -3196, 30,
+  757, 1016, 0, 45, 20, 120, -100
+};
+static const int8_t   calib_g1 = -30;
+static const int16_t  calib_g2 = -12047;
+static const int8_t   calib_g3 = 18;
+static const uint8_t  calib_res_heat_val = 42;
+static const uint8_t  calib_res_heat_range = 1;
+
+static const float lsm_bdr_hz[16] = {0, 12.5, 26, 52, 104, 208, 416, 833, 1667, 3333, 6667, 1.6, 0, 0, 0, 0};
+static const int lsm_ts_decimation[4] = {0, 1, 8, 32};
+static const int apds_gains[4] = {1, 4, 16, 64};
+static const double apds_gwtime_s[8] = {0, 2.8e-3, 5.6e-3, 8.4e-3, 14e-3, 22.4e-3, 30.8e-3, 39.2e-3};
+static const int apds_fifo_th[4] = {1, 4, 8, 16};
+
+/* Private function prototypes -----------------------------------------------*/
+static float bme_temperature(uint32_t adc, float *t_fine);
+static float bme_pressure(uint32_t adc, float t_fine);
+static float bme_humidity(uint32_t adc, float t_fine);
+static uint32_t invert_increasing(float (*f)(uint32_t, float), float arg, float target, uint32_t max);
+static int16_t to_raw(float value, int scale_range);
+static uint8_t tag_byte(uint8_t sensor, uint64_t count);
+
+/* Functions -----------------------------------------------------------------*/
+
+/* BME688 --------------------------------------------------------------------*/
+
+I2CSimulator::BME688_device::BME688_device(uint8_t address) : Device(address){
+  temperature = Signal(22.0f);
+  pressure = Signal(101325.0f);
+  humidity = Signal(45.0f);
+  gas_resistance = Signal(50000.0f);
+  for(int i = 0; i < 10; i++)
+    step_factor[i] = 1;
+  reset();
+}
+
+
+void I2CSimulator::BME688_device::set_signals(Signal temperature, Signal pressure, Signal humidity,
+                                              Signal gas_resistance){
+  this->temperature = temperature;
+  this->pressure = pressure;
+  this->humidity = humidity;
+  this->gas_resistance = gas_resistance;
+}
+
+
+void I2CSimulator::BME688_device::set_step_factors(const float *factors, int len){
+  for(int i = 0; i < len && i < 10; i++)
+    step_factor[i] = factors[i];
+}
+
+
+/**
+ * @brief BME688 writes are sequences of (register, value) pairs.
+ */
+int I2CSimulator::BME688_device::write(const uint8_t *data, int data_length, double t){
+  for(int i = 0; i + 1 < data_length; i += 2){
+    uint8_t reg = data[i], value = data[i + 1];
+
+    if(reg == BME_RESET_REG){
+      if(value == BME_RESET_VALUE)
+        reset();
+      continue;
+    }
+
+    regs[reg] = value;
+    if(reg != BME_CTRL_MEAS_REG)
+      continue;
+
+    run_mode = 0;
+    if((value & 0x03) == BME_FORCED_MODE){
+      start_measurement(t);
+    }else if((value & 0x03) != 0){
+      //Parallel and sequential modes run the heater profile until sleep mode is set
+      run_mode = value & 0x03;
+      step = 0;
+      step_end = t + step_duration(0) / 1e6;
+    }
+  }
+  return 0;
+}
+
+
+void I2CSimulator::BME688_device::update(double t){
+  if(measuring && t >= meas_end)
+    finish_measurement(t);
+
+  int nb_conv = regs[BME_CTRL_GAS_1_REG] & BME_NB_CONV_MSK;
+  if(nb_conv == 0 || nb_conv > 10)
+    nb_conv = 1;
+
+  //Every step fills the next data field, with the step as gas index
+  while(run_mode != 0 && t >= step_end){
+    uint8_t *field = &regs[BME_MEAS_STATUS_0_REG + (sub_index % BME_N_FIELDS) * BME_FIELD_LEN];
+    fill_field(step_end, field, step_factor[step]);
+    field[0] = BME_NEW_DATA_MSK | (step & BME_GAS_INDEX_MSK);
+    field[1] = sub_index++;
+
+    step = (step + 1) % nb_conv;
+    step_end += step_duration(step) / 1e6;
+  }
+}
+
+
+void I2CSimulator::BME688_device::reset(){
+  std::memset(regs, 0, sizeof(regs));
+  regs[BME_CHIP_ID_REG] = BME_CHIP_ID_VALUE;
+  regs[BME_VARIANT_ID_REG] = BME_VARIANT_ID_VALUE;
+  load_calibration();
+  measuring = false;
+  meas_end = 0;
+  run_mode = 0;
+  step = 0;
+  step_end = 0;
+  sub_index = 0;
+}
+
+
+/**
+ * @brief Encodes the calibration constants with the layout the driver decodes.
+ */
+void I2CSimulator::BME688_device::load_calibration(){
+  uint8_t *g1 = &regs[BME_CALIB_1_REG];
+  uint8_t *g2 = &regs[BME_CALIB_2_REG];
+  uint8_t *g3 = &regs[BME_CALIB_3_REG];
+
+  int16_t t2 = calib.t2, p2 = calib.p2, p4 = calib.p4, p5 = calib.p5, p8 = calib.p8, p9 = calib.p9;
+  uint16_t t1 = calib.t1, p1 = calib.p1, h1 = calib.h1, h2 = calib.h2;
+
+  g1[0] = t2 & 0xFF;  g1[1] = (uint16_t)t2 >> 8;
+  g1[2] = (int8_t)calib.t3;
+  g1[4] = p1 & 0xFF;  g1[5] = p1 >> 8;
+  g1[6] = p2 & 0xFF;  g1[7] = (uint16_t)p2 >> 8;
+  g1[8] = (int8_t)calib.p3;
+  g1[10] = p4 & 0xFF; g1[11] = (uint16_t)p4 >> 8;
+  g1[12] = p5 & 0xFF; g1[13] = (uint16_t)p5 >> 8;
+  g1[14] = (int8_t)calib.p7;
+  g1[15] = (int8_t)calib.p6;
+  g1[18] = p8 & 0xFF; g1[19] = (uint16_t)p8 >> 8;
+  g1[20] = p9 & 0xFF; g1[21] = (uint16_t)p9 >> 8;
+  g1[22] = (uint8_t)calib.p10;
+
+  g2[0] = h2 >> 4;
+  g2[1] = (h1 & 0x0F) | (h2 & 0x0F) << 4;
+  g2[2] = h1 >> 4;
+  g2[3] = (int8_t)calib.h3;
+  g2[4] = (int8_t)calib.h4;
+  g2[5] = (int8_t)calib.h5;
+  g2[6] = (uint8_t)calib.h6;
+  g2[7] = (int8_t)calib.h7;
+  g2[8] = t1 & 0xFF;  g2[9] = t1 >> 8;
+  g2[10] = (uint16_t)calib_g2 & 0xFF; g2[11] = (uint16_t)calib_g2 >> 8;
+  g2[12] = (uint8_t)calib_g1;
+  g2[13] = (uint8_t)calib_g3;
+
+  g3[0] = calib_res_heat_val;
+  g3[2] = calib_res_heat_range << 4;
+}
+
+
+/**
+ * @brief Starts a forced mode conversion. The duration follows the same estimation
+ *        the driver uses plus the programmed heater time.
+ */
+void I2CSimulator::BME688_device::start_measurement(double t){
+  double us = tph_duration_us(false);
+
+  if(regs[BME_CTRL_GAS_1_REG] & BME_RUN_GAS_MSK){
+    uint8_t gas_wait = regs[BME_GAS_WAIT_0_REG];
+    us += (gas_wait & 0x3F) * std::pow(4, gas_wait >> 6) * 1000.0;
+  }
+
+  regs[BME_MEAS_STATUS_0_REG] = (regs[BME_MEAS_STATUS_0_REG] & ~BME_NEW_DATA_MSK) | BME_MEASURING_MSK;
+  measuring = true;
+  meas_end = t + us / 1e6;
+}
+
+
+/**
+ * @brief Fills data field 0 with the ADC values matching the signals at time `t`.
+ */
+void I2CSimulator::BME688_device::finish_measurement(double t){
+  fill_field(t, &regs[BME_MEAS_STATUS_0_REG], step_factor[0]);
+
+  regs[BME_MEAS_STATUS_0_REG] = (regs[BME_MEAS_STATUS_0_REG] & ~BME_MEASURING_MSK) | BME_NEW_DATA_MSK;
+  regs[BME_CTRL_MEAS_REG] &= ~0x03; //Back to sleep mode
+  measuring = false;
+}
+
+
+/**
+ * @brief Conversion time of temperature, pressure and humidity with the driver
+ *        estimation. Parallel mode has no wake-up time.
+ */
+double I2CSimulator::BME688_device::tph_duration_us(bool parallel){
+  static const int ovsp_values[] = {0, 1, 2, 4, 8, 16, 16, 16};
+  int cycles = ovsp_values[(regs[BME_CTRL_MEAS_REG] >> 5) & 0x07] +
+               ovsp_values[(regs[BME_CTRL_MEAS_REG] >> 2) & 0x07] +
+               ovsp_values[regs[BME_CTRL_HUM_REG] & 0x07];
+  return cycles * 1963 + 477 * 4 + 477 * 5 + (parallel ? 0 : 1000);
+}
+
+
+/**
+ * @brief Duration of a heater profile step. In sequential mode the step is one
+ *        conversion plus its heater time in ms. In parallel mode it lasts the
+ *        given number of cycles of one conversion plus the shared heater time,
+ *        counted in 0.477 ms units.
+ */
+double I2CSimulator::BME688_device::step_duration(int step){
+  uint8_t gas_wait = regs[BME_GAS_WAIT_0_REG + step];
+
+  if(run_mode == BME_PARALLEL_MODE){
+    uint8_t shared = regs[BME_GAS_WAIT_SHARED_REG];
+    double shared_us = (shared & 0x3F) * std::pow(4, shared >> 6) * 477.0;
+    int cycles = gas_wait > 0 ? gas_wait : 1;
+    return cycles * (tph_duration_us(true) + shared_us);
+  }
+
+  return tph_duration_us(false) + (gas_wait & 0x3F) * std::pow(4, gas_wait >> 6) * 1000.0;
+}
+
+
+/**
+ * @brief Writes the ADC values matching the signals at time `t` into a data field.
+ *        The status and index bytes are left to the caller.
+ */
+void I2CSimulator::BME688_device::fill_field(double t, uint8_t *field, float gas_factor){
+  float t_fine;
+  uint32_t adc_temp = invert_increasing([](uint32_t adc, float) { float tf; return bme_temperature(adc, &tf); },
+                                        0, temperature.at(t), 0xFFFFF);
+  bme_temperature(adc_temp, &t_fine);
+  //Pressure decreases with the ADC value
+  uint32_t adc_press = invert_increasing([](uint32_t adc, float tf) { return -bme_pressure(adc, tf); },
+                                         t_fine, -pressure.at(t), 0xFFFFF);
+  uint32_t adc_hum = invert_increasing(bme_humidity, t_fine, humidity.at(t), 0xFFFF);
+
+  //Offsets inside the data field
+  uint8_t *press = &field[BME_PRESS_MSB_REG - BME_MEAS_STATUS_0_REG];
+  uint8_t *temp = &field[BME_TEMP_MSB_REG - BME_MEAS_STATUS_0_REG];
+  uint8_t *hum = &field[BME_HUM_MSB_REG - BME_MEAS_STATUS_0_REG];
+  uint8_t *gas = &field[BME_GAS_R_MSB_REG - BME_MEAS_STATUS_0_REG];
+
+  press[0] = adc_press >> 12;
+  press[1] = adc_press >> 4;
+  press[2] = (adc_press & 0x0F) << 4;
+  temp[0]  = adc_temp >> 12;
+  temp[1]  = adc_temp >> 4;
+  temp[2]  = (adc_temp & 0x0F) << 4;
+  hum[0]   = adc_hum >> 8;
+  hum[1]   = adc_hum & 0xFF;
+
+  gas[0] = 0;
+  gas[1] = 0;
+  if(regs[BME_CTRL_GAS_1_REG] & BME_RUN_GAS_MSK){
+    float res = gas_resistance.at(t) * gas_factor;
+    for(int range = 0; range < 16 && res > 0; range++){
+      double var2 = 1000000.0 * (262144 >> range) / res;
+      long adc = std::lround((var2 - 4096) / 3 + 512);
+      if(adc >= 0 && adc <= 1023){
+        gas[0] = adc >> 2;
+        gas[1] = (adc & 0x03) << 6 | BME_GAS_VALID_MSK | BME_HEAT_STAB_MSK | range;
+        break;
+      }
+    }
+  }
+}
+
+
+/* LSM6DSOX ------------------------------------------------------------------*/
+
+I2CSimulator::LSM6DSOX_device::LSM6DSOX_device(uint8_t address) : Device(address){
+  acc[0] = Signal(0.0f);
+  acc[1] = Signal(0.0f);
+  acc[2] = Signal(1.0f);
+  temperature = Signal(25.0f);
+  reset();
+}
+
+
+void I2CSimulator::LSM6DSOX_device::set_acc_signals(Signal x, Signal y, Signal z){
+  acc[0] = x;
+  acc[1] = y;
+  acc[2] = z;
+}
+
+
+void I2CSimulator::LSM6DSOX_device::set_gyr_signals(Signal x, Signal y, Signal z){
+  gyr[0] = x;
+  gyr[1] = y;
+  gyr[2] = z;
+}
+
+
+void I2CSimulator::LSM6DSOX_device::set_temperature_signal(Signal temperature){
+  this->temperature = temperature;
+}
+
+
+/**
+ * @brief Reads with auto-increment. Inside the FIFO output registers the address
+ *        rolls over from FIFO_DATA_OUT_Z_H back to FIFO_DATA_OUT_TAG, so several
+ *        words can be drained in one burst.
+ */
+int I2CSimulator::LSM6DSOX_device::read(uint8_t reg, uint8_t *data, int data_length, double t){
+  for(int i = 0; i < data_length; i++){
+    data[i] = read_reg(reg, t);
+    if(reg == LSM_FIFO_DATA_END_REG)
+      reg = LSM_FIFO_DATA_TAG_REG;
+    else
+      reg++;
+  }
+  return 0;
+}
+
+
+void I2CSimulator::LSM6DSOX_device::write_reg(uint8_t reg, uint8_t value, double t){
+  if(reg != LSM_FUNC_CFG_ACCESS_REG && (regs[LSM_FUNC_CFG_ACCESS_REG] & LSM_FUNC_CFG_ACCESS_MSK)){
+    emb_regs[reg] = value;
+    return;
+  }
+
+  if(reg == LSM_CTRL3_C_REG && (value & LSM_SW_RESET_MSK)){
+    reset();
+    return;
+  }
+
+  if(reg == LSM_FIFO_CTRL4_REG){
+    uint8_t old_mode = regs[reg] & LSM_FIFO_MODE_MSK;
+    uint8_t new_mode = value & LSM_FIFO_MODE_MSK;
+    if(new_mode == LSM_FIFO_BYPASS){
+      fifo.clear();
+    }
+    if(old_mode == LSM_FIFO_BYPASS && new_mode != LSM_FIFO_BYPASS){
+      fifo_t0 = t;
+      fifo_n_acc = fifo_n_gyr = fifo_batches = 0;
+    }
+  }
+
+  regs[reg] = value;
+}
+
+
+uint8_t I2CSimulator::LSM6DSOX_device::read_reg(uint8_t reg, double t){
+  if(reg != LSM_FUNC_CFG_ACCESS_REG && (regs[LSM_FUNC_CFG_ACCESS_REG] & LSM_FUNC_CFG_ACCESS_MSK))
+    return emb_regs[reg];
+
+  //Latched events are cleared when their source is read
+  if(reg == LSM_WAKE_UP_SRC_REG || reg == LSM_D6D_SRC_REG){
+    uint8_t value = regs[reg];
+    regs[reg] &= reg == LSM_WAKE_UP_SRC_REG ? ~(LSM_WU_IA_MSK | 0x07) : ~LSM_D6D_IA_MSK;
+    return value;
+  }
+
+  if(reg == LSM_FIFO_STATUS1_REG){
+    return fifo.size() & 0xFF;
+  }
+
+  if(reg == LSM_FIFO_STATUS2_REG){
+    unsigned int wtm = regs[LSM_FIFO_CTRL1_REG] | (regs[LSM_FIFO_CTRL2_REG] & 0x01) << 8;
+    uint8_t status = (fifo.size() >> 8) & 0x03;
+    if(wtm > 0 && fifo.size() >= wtm)
+      status |= 0x80;
+    if(fifo_ovr_latched)
+      status |= 0x40 | 0x08;
+    if(fifo.size() >= (unsigned int)LSM6DSOX_SIM_FIFO_WORDS)
+      status |= 0x20;
+    fifo_ovr_latched = false;
+    return status;
+  }
+
+  if(reg >= LSM_FIFO_DATA_TAG_REG && reg <= LSM_FIFO_DATA_END_REG){
+    if(fifo.empty())
+      return 0;
+    uint8_t value = fifo.front()[reg - LSM_FIFO_DATA_TAG_REG];
+    if(reg == LSM_FIFO_DATA_END_REG)
+      fifo.pop_front();
+    return value;
+  }
+
+  return regs[reg];
+}
+
+
+/**
+ * @brief Latches the output registers and batches into the FIFO every sample
+ *        produced up to time `t`.
+ */
+void I2CSimulator::LSM6DSOX_device::update(double t){
+  int16_t raw[3];
+
+  if(regs[LSM_CTRL1_XL_REG] >> 4){
+    raw_acc(t, raw);
+    for(int i = 0; i < 3; i++){
+      regs[LSM_OUTX_A_REG + 2 * i] = raw[i] & 0xFF;
+      regs[LSM_OUTX_A_REG + 2 * i + 1] = (uint16_t)raw[i] >> 8;
+    }
+    regs[LSM_STATUS_REG] |= 0x01;
+    detect_motion(t);
+  }
+
+  if(regs[LSM_CTRL2_G_REG] >> 4){
+    raw_gyr(t, raw);
+    for(int i = 0; i < 3; i++){
+      regs[LSM_OUTX_G_REG + 2 * i] = raw[i] & 0xFF;
+      regs[LSM_OUTX_G_REG + 2 * i + 1] = (uint16_t)raw[i] >> 8;
+    }
+    regs[LSM_STATUS_REG] |= 0x02;
+  }
+
+  if((regs[LSM_CTRL1_XL_REG] | regs[LSM_CTRL2_G_REG]) >> 4){
+    int16_t temp = (int16_t)std::lround((temperature.at(t) - 25.0) * 256.0);
+    regs[LSM_OUT_TEMP_REG] = temp & 0xFF;
+    regs[LSM_OUT_TEMP_REG + 1] = (uint16_t)temp >> 8;
+    regs[LSM_STATUS_REG] |= 0x04;
+  }
+
+  if(regs[LSM_CTRL10_C_REG] & LSM_TIMESTAMP_EN_MSK){
+    uint32_t ts = (uint32_t)(t / LSM_TIMESTAMP_LSB_S);
+    for(int i = 0; i < 4; i++)
+      regs[LSM_TIMESTAMP0_REG + i] = ts >> (8 * i);
+  }
+
+  if((regs[LSM_FIFO_CTRL4_REG] & LSM_FIFO_MODE_MSK) != LSM_FIFO_BYPASS)
+    fifo_fill(t);
+}
+
+
+void I2CSimulator::LSM6DSOX_device::reset(){
+  std::memset(regs, 0, sizeof(regs));
+  regs[LSM_WHO_AM_I_REG] = LSM_WHO_AM_I_VALUE;
+  regs[LSM_CTRL3_C_REG] = 0x04; //IF_INC
+  std::memset(emb_regs, 0, sizeof(emb_regs));
+  for(int i = 0; i < 3; i++)
+    last_acc[i] = NAN;
+  motion_t = 0;
+  fifo.clear();
+  fifo_t0 = 0;
+  fifo_n_acc = fifo_n_gyr = fifo_batches = 0;
+  fifo_ovr_latched = false;
+}
+
+
+/**
+ * @brief Pushes a word in the FIFO applying the FIFO or continuous mode policy.
+ */
+void I2CSimulator::LSM6DSOX_device::fifo_push(uint8_t tag, const uint8_t *data, bool stop_on_full){
+  if(fifo.size() >= (unsigned int)LSM6DSOX_SIM_FIFO_WORDS){
+    fifo_ovr_latched = true;
+    if(stop_on_full)
+      return;
+    fifo.pop_front();
+  }
+
+  std::array<uint8_t, 7> word;
+  word[0] = tag;
+  std::memcpy(&word[1], data, 6);
+  fifo.push_back(word);
+}
+
+
+/**
+ * @brief Generates the batched samples between the last fill and time `t` in time order.
+ */
+void I2CSimulator::LSM6DSOX_device::fifo_fill(double t){
+  float bdr_acc = lsm_bdr_hz[regs[LSM_FIFO_CTRL3_REG] & 0x0F];
+  float bdr_gyr = lsm_bdr_hz[regs[LSM_FIFO_CTRL3_REG] >> 4];
+  float bdr_max = bdr_acc > bdr_gyr ? bdr_acc : bdr_gyr;
+  bool stop_on_full = (regs[LSM_FIFO_CTRL4_REG] & LSM_FIFO_MODE_MSK) == LSM_FIFO_FIFO;
+  int ts_dec = (regs[LSM_CTRL10_C_REG] & LSM_TIMESTAMP_EN_MSK) ? lsm_ts_decimation[regs[LSM_FIFO_CTRL4_REG] >> 6] : 0;
+  uint8_t data[6];
+  int16_t raw[3];
+
+  if(bdr_max == 0)
+    return;
+
+  //Do not generate more than one FIFO worth of samples after long pauses. In
+  //continuous mode the last ones are kept, in FIFO mode the first ones.
+  double oldest = t - (double)LSM6DSOX_SIM_FIFO_WORDS / bdr_max;
+  if(!stop_on_full && bdr_acc > 0 && fifo_t0 + fifo_n_acc / bdr_acc < oldest)
+    fifo_n_acc = (uint64_t)((oldest - fifo_t0) * bdr_acc);
+  if(!stop_on_full && bdr_gyr > 0 && fifo_t0 + fifo_n_gyr / bdr_gyr < oldest)
+    fifo_n_gyr = (uint64_t)((oldest - fifo_t0) * bdr_gyr);
+
+  while(true){
+    double next_acc = bdr_acc > 0 ? fifo_t0 + (fifo_n_acc + 1) / bdr_acc : INFINITY;
+    double next_gyr = bdr_gyr > 0 ? fifo_t0 + (fifo_n_gyr + 1) / bdr_gyr : INFINITY;
+    double next = next_acc < next_gyr ? next_acc : next_gyr;
+    if(next > t)
+      break;
+
+    if(stop_on_full && fifo.size() >= (unsigned int)LSM6DSOX_SIM_FIFO_WORDS){
+      //The samples up to `t` are lost
+      fifo_ovr_latched = true;
+      if(bdr_acc > 0)
+        fifo_n_acc = (uint64_t)((t - fifo_t0) * bdr_acc);
+      if(bdr_gyr > 0)
+        fifo_n_gyr = (uint64_t)((t - fifo_t0) * bdr_gyr);
+      break;
+    }
+
+    //A batch starts once per period of the fastest sensor, the accelerometer
+    //if both run at the same rate. On ties its sample goes first.
+    bool acc_paces = bdr_acc == bdr_max;
+    bool tie = std::fabs(next_acc - next_gyr) < 1e-9;
+    bool acc_first = tie ? acc_paces : next_acc < next_gyr;
+    bool new_batch = acc_first == acc_paces;
+
+    if(new_batch){
+      if(ts_dec > 0 && fifo_batches % ts_dec == 0){
+        uint32_t ts = (uint32_t)(next / LSM_TIMESTAMP_LSB_S);
+        std::memset(data, 0, sizeof(data));
+        for(int i = 0; i < 4; i++)
+          data[i] = ts >> (8 * i);
+        fifo_push(tag_byte(LSM_TAG_TIMESTAMP, fifo_batches + 1), data, stop_on_full);  //Counted as its batch
+      }
+      fifo_batches++;
+    }
+
+    if(acc_first){
+      raw_acc(next, raw);
+      fifo_n_acc++;
+    }
+    else{
+      raw_gyr(next, raw);
+      fifo_n_gyr++;
+    }
+    for(int i = 0; i < 3; i++){
+      data[2 * i] = raw[i] & 0xFF;
+      data[2 * i + 1] = (uint16_t)raw[i] >> 8;
+    }
+    fifo_push(tag_byte(acc_first ? LSM_TAG_ACC : LSM_TAG_GYR, fifo_batches), data, stop_on_full);
+  }
+}
+
+
+void I2CSimulator::LSM6DSOX_device::raw_acc(double t, int16_t raw[3]){
+  static const int scales[4] = {2, 16, 4, 8};
+  int scale = scales[(regs[LSM_CTRL1_XL_REG] >> 2) & 0x03];
+
+  for(int i = 0; i < 3; i++)
+    raw[i] = to_raw(acc[i].at(t), scale);
+}
+
+
+void I2CSimulator::LSM6DSOX_device::raw_gyr(double t, int16_t raw[3]){
+  static const int scales[4] = {250, 500, 1000, 2000};
+  int scale = (regs[LSM_CTRL2_G_REG] & 0x02) ? 125 : scales[(regs[LSM_CTRL2_G_REG] >> 2) & 0x03];
+
+  for(int i = 0; i < 3; i++)
+    raw[i] = to_raw(gyr[i].at(t), scale);
+}
+
+
+/**
+ * @brief Wake-up and 6D detectors, evaluated on every accelerometer sample
+ *        produced since the last transaction (up to one FIFO worth).
+ */
+void I2CSimulator::LSM6DSOX_device::detect_motion(double t){
+  static const int scales[4] = {2, 16, 4, 8};
+  static const float cos_6d[4] = {0.174, 0.342, 0.5, 0.643};  //80, 70, 60 and 50 degrees
+  float odr = lsm_bdr_hz[regs[LSM_CTRL1_XL_REG] >> 4];
+  float now[3];
+
+  if(!(regs[LSM_TAP_CFG2_REG] & LSM_INTERRUPTS_EN_MSK) || odr == 0){
+    motion_t = t;
+    return;
+  }
+
+  float ths = (regs[LSM_WAKE_UP_THS_REG] & 0x3F) * scales[(regs[LSM_CTRL1_XL_REG] >> 2) & 0x03] / 64.0f;
+  float limit = cos_6d[(regs[LSM_TAP_THS_6D_REG] >> 5) & 0x03];
+
+  if(motion_t < t - (double)LSM6DSOX_SIM_FIFO_WORDS / odr)
+    motion_t = t - (double)LSM6DSOX_SIM_FIFO_WORDS / odr;
+
+  for(; motion_t + 1.0 / odr <= t; motion_t += 1.0 / odr){
+    uint8_t axes = 0;
+    uint8_t position = 0;
+
+    for(int i = 0; i < 3; i++){
+      now[i] = acc[i].at(motion_t + 1.0 / odr);
+      if(ths > 0 && !std::isnan(last_acc[i]) && std::fabs(now[i] - last_acc[i]) > ths)
+        axes |= 0x04 >> i;
+      if(now[i] > limit)
+        position |= 0x02 << (2 * i);
+      else if(now[i] < -limit)
+        position |= 0x01 << (2 * i);
+      last_acc[i] = now[i];
+    }
+
+    if(axes)
+      regs[LSM_WAKE_UP_SRC_REG] |= LSM_WU_IA_MSK | axes;
+    if(position != (regs[LSM_D6D_SRC_REG] & 0x3F))
+      regs[LSM_D6D_SRC_REG] = LSM_D6D_IA_MSK | position;
+  }
+}
+
+
+/* APDS9660 ------------------------------------------------------------------*/
+
+I2CSimulator::APDS9660_device::APDS9660_device(uint8_t address) : Device(address){
+  illuminance = Signal(300.0f);
+  proximity = Signal(0.0f);
+  color_ratio[0] = 0.36;
+  color_ratio[1] = 0.42;
+  color_ratio[2] = 0.30;
+  gesture_t = 0;
+  gesture_active = false;
+  gesture_overflow = false;
+  prox_int = false;
+  prox_persist = 0;
+  regs[APDS_ATIME_REG] = 0xFF;
+  regs[APDS_ID_REG] = APDS_ID_VALUE;
+}
+
+
+void I2CSimulator::APDS9660_device::set_illuminance_signal(Signal illuminance){
+  this->illuminance = illuminance;
+}
+
+
+void I2CSimulator::APDS9660_device::set_proximity_signal(Signal proximity){
+  this->proximity = proximity;
+}
+
+
+void I2CSimulator::APDS9660_device::set_color_ratio(float red, float green, float blue){
+  color_ratio[0] = red;
+  color_ratio[1] = green;
+  color_ratio[2] = blue;
+}
+
+
+/**
+ * @brief Scripts a hand pass over the sensor. The hand moves in the given
+ *        direction, so the opposite photodiode sees it first and the named
+ *        one last.
+ */
+void I2CSimulator::APDS9660_device::add_pass(double start, double duration, int direction, float peak){
+  passes.push_back({start, duration, direction, peak});
+}
+
+
+/**
+ * @brief Writes with auto-increment. An access to PICLEAR or AICLEAR clears
+ *        the proximity interrupt instead.
+ */
+int I2CSimulator::APDS9660_device::write(const uint8_t *data, int data_length, double t){
+  if(data_length >= 1 && (data[0] == APDS_PICLEAR_REG || data[0] == APDS_AICLEAR_REG)){
+    prox_int = false;
+    prox_persist = 0;
+    return 0;
+  }
+  return Device::write(data, data_length, t);
+}
+
+
+/**
+ * @brief Reads with auto-increment. Inside the gesture FIFO registers the address
+ *        wraps from GFIFO_R back to GFIFO_U, so the whole FIFO can be drained in
+ *        one burst.
+ */
+int I2CSimulator::APDS9660_device::read(uint8_t reg, uint8_t *data, int data_length, double t){
+  for(int i = 0; i < data_length; i++){
+    data[i] = read_reg(reg, t);
+    if(reg == APDS_GFIFO_R_REG)
+      reg = APDS_GFIFO_U_REG;
+    else
+      reg++;
+  }
+  return 0;
+}
+
+
+void I2CSimulator::APDS9660_device::write_reg(uint8_t reg, uint8_t value, double t){
+  if(reg == APDS_GCONF4_REG && (value & APDS_GFIFO_CLR_MSK)){
+    fifo.clear();
+    gesture_overflow = false;
+    value &= ~APDS_GFIFO_CLR_MSK;
+  }
+  if(reg == APDS_ENABLE_REG && !(regs[reg] & APDS_GEN_MSK) && (value & APDS_GEN_MSK)){
+    gesture_t = t;
+  }
+  regs[reg] = value;
+}
+
+
+uint8_t I2CSimulator::APDS9660_device::read_reg(uint8_t reg, double t){
+  if(reg == APDS_GFLVL_REG)
+    return fifo.size();
+
+  if(reg == APDS_GSTATUS_REG){
+    uint8_t status = gesture_overflow ? APDS_GFOV_MSK : 0;
+    if((int)fifo.size() >= apds_fifo_th[regs[APDS_GCONF1_REG] >> 6])
+      status |= APDS_GVALID_MSK;
+    return status;
+  }
+
+  if(reg >= APDS_GFIFO_U_REG){
+    if(fifo.empty())
+      return 0;
+    uint8_t value = fifo.front()[reg - APDS_GFIFO_U_REG];
+    if(reg == APDS_GFIFO_R_REG)
+      fifo.pop_front();
+    return value;
+  }
+
+  return regs[reg];
+}
+
+
+/**
+ * @brief Latches ALS and proximity results, evaluates the proximity interrupt
+ *        and runs the gesture engine up to time `t`. Each update counts as one
+ *        proximity cycle for the persistence filter.
+ */
+void I2CSimulator::APDS9660_device::update(double t){
+  uint8_t enable = regs[APDS_ENABLE_REG];
+  uint8_t status = 0;
+
+  if(!(enable & APDS_PON_MSK))
+    return;
+
+  if(enable & APDS_AEN_MSK){
+    int cycles = 256 - regs[APDS_ATIME_REG];
+    double max_counts = APDS_COUNTS_PER_CYCLE * cycles < 65535 ? APDS_COUNTS_PER_CYCLE * cycles : 65535;
+    double clear = illuminance.at(t) * APDS_COUNTS_PER_LUX * apds_gains[regs[APDS_CONTROL_REG] & 0x03] * cycles;
+    double channels[4] = {clear, clear * color_ratio[0], clear * color_ratio[1], clear * color_ratio[2]};
+
+    for(int i = 0; i < 4; i++){
+      uint16_t counts = channels[i] > max_counts ? max_counts : (channels[i] < 0 ? 0 : channels[i]);
+      regs[APDS_CDATA_REG + 2 * i] = counts & 0xFF;
+      regs[APDS_CDATA_REG + 2 * i + 1] = counts >> 8;
+    }
+    status |= 0x01;
+  }
+
+  if(enable & APDS_PEN_MSK){
+    float udlr[4];
+    gesture_channels(t, udlr);
+    float prox = proximity.at(t);
+    for(int i = 0; i < 4; i++)
+      prox = udlr[i] > prox ? udlr[i] : prox;
+    regs[APDS_PDATA_REG] = prox > 255 ? 255 : (prox < 0 ? 0 : (uint8_t)prox);
+    status |= 0x02;
+
+    //Persistence 0 interrupts on every cycle, n on n cycles out of the thresholds
+    if(enable & APDS_PIEN_MSK){
+      uint8_t pdata = regs[APDS_PDATA_REG];
+      int ppers = regs[APDS_PERS_REG] >> 4;
+      if(pdata < regs[APDS_PILT_REG] || pdata > regs[APDS_PIHT_REG])
+        prox_persist++;
+      else
+        prox_persist = 0;
+      if(ppers == 0 || prox_persist >= ppers)
+        prox_int = true;
+    }
+  }
+
+  if(prox_int)
+    status |= APDS_PINT_MSK;
+
+  regs[APDS_STATUS_REG] = status;
+
+  if(enable & APDS_GEN_MSK)
+    gesture_fill(t);
+}
+
+
+/**
+ * @brief Photodiode counts (U, D, L, R) at time `t` for the scripted passes.
+ */
+void I2CSimulator::APDS9660_device::gesture_channels(double t, float udlr[4]){
+  static const int opposite[4] = {1, 0, 3, 2};
+  float base = proximity.at(t);
+
+  for(int i = 0; i < 4; i++)
+    udlr[i] = base;
+
+  for(const pass &p : passes){
+    if(t < p.start || t > p.start + p.duration)
+      continue;
+
+    int lead = opposite[p.direction - GESTURE_UP];
+    for(int i = 0; i < 4; i++){
+      double lag = (i == lead) ? 0 : (i == opposite[lead] ? 0.3 : 0.15);
+      double x = (t - p.start - lag * p.duration) / (0.7 * p.duration);
+      if(x > 0 && x < 1){
+        double s = std::sin(M_PI * x);
+        udlr[i] += p.peak * s * s;
+      }
+    }
+  }
+}
+
+
+/**
+ * @brief Runs the gesture state machine and fills the FIFO with the datasets
+ *        captured between the last update and time `t`.
+ */
+void I2CSimulator::APDS9660_device::gesture_fill(double t){
+  double period = APDS_GESTURE_CONV_S + apds_gwtime_s[regs[APDS_GCONF2_REG] & 0x07];
+  float udlr[4];
+
+  if(t - gesture_t > 1.0)
+    gesture_t = t - 1.0;
+
+  while(gesture_t + period <= t){
+    gesture_t += period;
+    gesture_channels(gesture_t, udlr);
+
+    float max = udlr[0];
+    for(int i = 1; i < 4; i++)
+      max = udlr[i] > max ? udlr[i] : max;
+
+    if(!gesture_active && max > regs[APDS_GPENTH_REG])
+      gesture_active = true;
+    else if(gesture_active && max < regs[APDS_GEXTH_REG])
+      gesture_active = false;
+
+    if(!gesture_active)
+      continue;
+
+    if((int)fifo.size() >= APDS9660_SIM_FIFO_LEN){
+      gesture_overflow = true;
+      continue;
+    }
+
+    std::array<uint8_t, 4> dataset;
+    for(int i = 0; i < 4; i++)
+      dataset[i] = udlr[i] > 255 ? 255 : (udlr[i] < 0 ? 0 : (uint8_t)udlr[i]);
+    fifo.push_back(dataset);
+  }
+
+  if(gesture_active)
+    regs[APDS_GCONF4_REG] |= APDS_GMODE_MSK;
+  else
+    regs[APDS_GCONF4_REG] &= ~APDS_GMODE_MSK;
+}
+
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+ * @brief Datasheet temperature compensation, as done by the driver.
+ */
+static float bme_temperature(uint32_t adc, float *t_fine){
+  float var1, var2;
+  var1 = ((adc / 16384.0) - (calib.t1 / 1024.0)) * calib.t2;
+  var2 = (adc / 131072.0) - (calib.t1 / 8192.0);
+  var2 = var2 * var2 * calib.t3 * 16.0;
+  *t_fine = var1 + var2;
+  return *t_fine / 5120.0;
+}
+
+
+/**
+ * @brief Datasheet pressure compensation, as done by the driver.
+ */
+static float bme_pressure(uint32_t adc, float t_fine){
+  float var1, var2, var3, var4, press_comp;
+  var1 = (t_fine / 2.0) - 64000.0;
+  var2 = var1 * var1 * (calib.p6 / 131072.0) + (var1 * calib.p5 * 2.0);
+  var2 = (var2 / 4.0) + (calib.p4 * 65536.0);
+  var1 = (((calib.p3 * var1 * var1) / 16384.0) + (calib.p2 * var1)) / 524288.0;
+  var1 = (1.0 + (var1 / 32768.0)) * calib.p1;
+  press_comp = 1048576.0 - adc;
+  press_comp = ((press_comp - (var2 / 4096.0)) * 6250.0) / var1;
+  var1 = (calib.p9 * press_comp * press_comp) / 2147483648.0;
+  var2 = press_comp * (calib.p8 / 32768.0);
+  var4 = press_comp / 256.0;
+  var3 = var4 * var4 * var4 * (calib.p10 / 131072.0);
+  return press_comp + (var1 + var2 + var3 + (calib.p7 * 128.0)) / 16.0;
+}
+
+
+/**
+ * @brief Datasheet humidity compensation, as done by the driver but without clamping.
+ */
+static float bme_humidity(uint32_t adc, float t_fine){
+  float temp_comp, var1, var2, var3, var4;
+  temp_comp = t_fine / 5120.0;
+  var1 = adc - ((calib.h1 * 16.0) + ((calib.h3 / 2.0) * temp_comp));
+  var2 = var1 * (calib.h2 / 262144.0 * (1.0 + (calib.h4 / 16384.0 * temp_comp) +
+                                        (calib.h5 / 1048576.0 * temp_comp * temp_comp)));
+  var3 = calib.h6 / 16384.0;
+  var4 = calib.h7 / 2097152.0;
+  return var2 + ((var3 + (var4 * temp_comp)) * var2 * var2);
+}
+
+
+/**
+ * @brief Finds by bisection the ADC value in [0, max] for which the increasing
+ *        function `f` is closest to `target`.
+ */
+static uint32_t invert_increasing(float (*f)(uint32_t, float), float arg, float target, uint32_t max){
+  uint32_t low = 0, high = max;
+
+  while(low < high){
+    uint32_t mid = low + (high - low) / 2;
+    if(f(mid, arg) < target)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low;
+}
+
+
+/**
+ * @brief Inverse of the driver conversion: value = raw / 65536 * scale_range * 2.
+ */
+static int16_t to_raw(float value, int scale_range){
+  long raw = std::lround(value / (scale_range * 2.0) * 65536.0);
+  if(raw > 32767)
+    raw = 32767;
+  else if(raw < -32768)
+    raw = -32768;
+  return raw;
+}
+
+
+/**
+ * @brief FIFO tag byte: sensor, 2-bit batch counter and parity.
+ */
+static uint8_t tag_byte(uint8_t sensor, uint64_t count){
+  uint8_t tag = sensor << 3 | (count & 0x03) << 1;
+  return tag | (__builtin_parity(tag) & 0x01);
+}
@@ -0,0 +1,188 @@
+/**
+  ******************************************************************************
+  * @file   sim_devices.h
+  * @brief  Simulated Sensor Models Header.
+  *
+  * @note   End-of-degree work.
+  *         Register-level models of the BME688, LSM6DSOX and APDS9660 sensors
+  *         for the I2C Bus Simulator.
+  ******************************************************************************
+*/
+
+#ifndef __SIM_DEVICES_H__
+#define __SIM_DEVICES_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <deque>
+#include <vector>
+#include <array>
+#include "i2c_simulator.h"
+
+namespace I2CSimulator{
+
+/* Exported constants --------------------------------------------------------*/
+const uint8_t BME688_SIM_ADDR   = 0x76;
+const uint8_t LSM6DSOX_SIM_ADDR = 0x6A;
+const uint8_t APDS9660_SIM_ADDR = 0x39;
+
+const int LSM6DSOX_SIM_FIFO_WORDS = 512;
+const int APDS9660_SIM_FIFO_LEN   = 32;
+
+//Directions of the hand, with the values of UP, DOWN, LEFT and RIGHT of the APDS9660 driver
+const int GESTURE_UP    = 1;
+const int GESTURE_DOWN  = 2;
+const int GESTURE_LEFT  = 3;
+const int GESTURE_RIGHT = 4;
+
+/* Exported types ------------------------------------------------------------*/
+
+/**
+ * @brief BME688 model: chip/variant id, the three calibration blocks, forced mode
+ *        timing and data field 0, and the parallel and sequential modes that
+ *        run the heater profile steps and fill the three data fields in turn.
+ *        The ADC values are obtained by inverting the datasheet compensation
+ *        formulas, so the driver reads back the signals.
+ */
+class BME688_device : public Device{
+  Signal temperature;     //degC
+  Signal pressure;        //Pa
+  Signal humidity;        //%RH
+  Signal gas_resistance;  //Ohm
+  float step_factor[10];  //Gas resistance of each heater step relative to the signal
+  bool measuring;
+  double meas_end;
+  int run_mode;           //Parallel or sequential mode running, 0 otherwise
+  int step;
+  double step_end;
+  uint8_t sub_index;
+
+  void reset();
+  void load_calibration();
+  void start_measurement(double t);
+  void finish_measurement(double t);
+  double tph_duration_us(bool parallel);
+  double step_duration(int step);
+  void fill_field(double t, uint8_t *field, float gas_factor);
+public:
+  BME688_device(uint8_t address = BME688_SIM_ADDR);
+
+  void set_signals(Signal temperature, Signal pressure, Signal humidity, Signal gas_resistance);
+
+  /**
+   * @brief Gas resistance seen at each heater profile step, relative to the gas
+   *        resistance signal, so a scan gives a fingerprint. All 1 by default.
+   */
+  void set_step_factors(const float *factors, int len);
+
+  /**
+   * @brief BME688 writes are sequences of (register, value) pairs.
+   */
+  int write(const uint8_t *data, int data_length, double t) override;
+  void update(double t) override;
+};
+
+
+/**
+ * @brief LSM6DSOX model: control registers, temperature/gyroscope/accelerometer
+ *        outputs, timestamp counter, the tagged FIFO (bypass, FIFO and
+ *        continuous modes, watermark, batch data rates and timestamp batching),
+ *        the embedded functions register bank and the wake-up and 6D detectors.
+ *        The embedded algorithms themselves (tilt, significant motion) are not
+ *        modeled.
+ */
+class LSM6DSOX_device : public Device{
+  Signal acc[3];    //g
+  Signal gyr[3];    //dps
+  Signal temperature;
+  uint8_t emb_regs[256];
+  float last_acc[3];
+  double motion_t;
+  std::deque<std::array<uint8_t, 7>> fifo;
+  double fifo_t0;
+  uint64_t fifo_n_acc, fifo_n_gyr, fifo_batches;
+  bool fifo_ovr_latched;
+
+  void reset();
+  void fifo_push(uint8_t tag, const uint8_t *data, bool stop_on_full);
+  void fifo_fill(double t);
+  void raw_acc(double t, int16_t raw[3]);
+  void raw_gyr(double t, int16_t raw[3]);
+  void detect_motion(double t);
+public:
+  LSM6DSOX_device(uint8_t address = LSM6DSOX_SIM_ADDR);
+
+  void set_acc_signals(Signal x, Signal y, Signal z);
+  void set_gyr_signals(Signal x, Signal y, Signal z);
+  void set_temperature_signal(Signal temperature);
+
+  int read(uint8_t reg, uint8_t *data, int data_length, double t) override;
+  void write_reg(uint8_t reg, uint8_t value, double t) override;
+  uint8_t read_reg(uint8_t reg, double t) override;
+  void update(double t) override;
+};
+
+
+/**
+ * @brief APDS9660 model: ALS (RGBC counts from an illuminance signal, with gain,
+ *        integration time and saturation), proximity with its threshold interrupt
+ *        and persistence filter, and the gesture engine with its 32 dataset FIFO
+ *        fed by scripted hand passes. The INT pin is not modeled, the interrupt
+ *        is seen in STATUS.
+ */
+class APDS9660_device : public Device{
+  struct pass{
+    double start;
+    double duration;
+    int direction;
+    float peak;
+  };
+
+  Signal illuminance;   //lux
+  Signal proximity;     //counts, without hand passes
+  float color_ratio[3]; //red, green, blue relative to clear
+  std::vector<pass> passes;
+  std::deque<std::array<uint8_t, 4>> fifo;
+  double gesture_t;
+  bool gesture_active;
+  bool gesture_overflow;
+  bool prox_int;
+  int prox_persist;
+
+  void gesture_channels(double t, float udlr[4]);
+  void gesture_fill(double t);
+public:
+  APDS9660_device(uint8_t address = APDS9660_SIM_ADDR);
+
+  void set_illuminance_signal(Signal illuminance);
+  void set_proximity_signal(Signal proximity);
+  void set_color_ratio(float red, float green, float blue);
+
+  /**
+   * @brief Scripts a hand pass over the sensor. The hand moves in the given
+   *        direction, as the driver names them: a GESTURE_UP pass is seen
+   *        first by the D photodiode and last by the U one.
+   *
+   * @param[in] start Simulated time at which the hand enters, in seconds.
+   * @param[in] duration Time the hand takes to cross, in seconds.
+   * @param[in] direction GESTURE_UP, GESTURE_DOWN, GESTURE_LEFT or GESTURE_RIGHT.
+   * @param[in] peak Maximum photodiode count reached during the pass.
+   */
+  void add_pass(double start, double duration, int direction, float peak = 200);
+
+  /**
+   * @brief Writes with auto-increment. An access to PICLEAR or AICLEAR clears
+   *        the proximity interrupt instead.
+   */
+  int write(const uint8_t *data, int data_length, double t) override;
+  int read(uint8_t reg, uint8_t *data, int data_length, double t) override;
+  void write_reg(uint8_t reg, uint8_t value, double t) override;
+  uint8_t read_reg(uint8_t reg, double t) override;
+  void update(double t) override;
+};
+
+/* Exported macro ------------------------------------------------------------*/
+/* Exported Functions --------------------------------------------------------*/
+}
+
+#endif /* __SIM_DEVICES_H__ */
@@ -10,6 +10,9 @@
 */
 /* Includes ------------------------------------------------------------------*/
 #include "LSM6DSOX.h" // Module header
+#include <cstdio>
+#include <vector>
+#include <unistd.h>
 
 /* Private typedef -----------------------------------------------------------*/
 #define ADR_LSM  0x6A
@@ -18,19 +21,88 @@
 #define RESET_VALUE  0xA3
 
 #define CONF_ACC_GYR_REG  0x10
+#define CTRL10_C_REG      0x19
+
+#define INT1_CTRL_REG     0x0D
+#define TAP_CFG0_REG      0x56
+#define TAP_CFG2_REG      0x58
+#define TAP_THS_6D_REG    0x59
+#define WAKE_UP_THS_REG   0x5B
+#define WAKE_UP_DUR_REG   0x5C
+#define MD1_CFG_REG       0x5E
+#define WAKE_UP_SRC_REG   0x1B
+#define EMB_FUNC_STATUS_MAINPAGE_REG 0x35
+#define MLC_STATUS_MAINPAGE_REG      0x38
+#define INT2_CTRL_REG     0x0E
+#define MD2_CFG_REG       0x5F
+
+#define FUNC_CFG_ACCESS_REG 0x01
+#define EMB_FUNC_EN_A_REG   0x04  //Embedded functions bank
+#define EMB_FUNC_INT1_REG   0x0A  //Embedded functions bank
+#define EMB_FUNC_INT2_REG   0x0E  //Embedded functions bank
+#define PAGE_RW_REG         0x17  //Embedded functions bank
+#define EMB_FUNC_INIT_A_REG 0x66  //Embedded functions bank
+#define MLC0_SRC_REG        0x70  //Embedded functions bank
+
+#define FIFO_CTRL1_REG    0x07
+#define FIFO_STATUS1_REG  0x3A
+#define FIFO_DATA_TAG_REG 0x78
 
 #define TEMP_DATA_REG 0x20
 #define GYR_DATA_REG  0x22
 #define ACC_DATA_REG  0x28
+#define ALL_DATA_LEN  14    //OUT_TEMP, OUTX_G to OUTZ_G and OUTX_A to OUTZ_A
 
 #define ODR_MASK 0xF0
 #define ACC_FSR_MASK 0x0C
 #define GYR_FSR_MASK 0x0E
 
+#define FIFO_WTM8_MASK      0x01
+#define FIFO_BDR_ACC_MASK   0x0F
+#define FIFO_MODE_MASK      0x07
+#define FIFO_TS_DEC_POS     6
+#define FIFO_TS_DEC_MASK    0xC0
+#define TIMESTAMP_EN_MASK   0x20
+
+#define FIFO_DIFF_MASK      0x03FF
+#define FIFO_WTM_FLAG       0x8000
+#define FIFO_OVR_FLAG       0x4000
+#define FIFO_FULL_FLAG      0x2000
+
+#define FIFO_WORD_LEN       7   //Tag + 6 data bytes
+#define FIFO_BURST_WORDS    36  //Words per read, the I2C messages are up to 255 bytes
+#define FIFO_TAG_POS        3
+#define FIFO_TAG_TIMESTAMP  0x04
+
+#define INTERRUPTS_ENABLE_MASK  0x80  //Enables the wake-up, 6D, tap and activity detectors
+#define FUNC_CFG_ACCESS_MASK    0x80
+#define INT_CLR_ON_READ_MASK    0x40
+#define LIR_MASK                0x01
+#define EMB_FUNC_LIR_MASK       0x80
+#define WK_THS_MASK             0x3F
+#define WAKE_DUR_POS            5
+#define WAKE_DUR_MASK           0x60
+#define SIXD_THS_POS            5
+#define SIXD_THS_MASK           0x60
+#define WU_IA_MASK              0x08
+#define WU_AXES_MASK            0x07
+#define D6D_IA_MASK             0x40
+#define D6D_POS_MASK            0x3F
+#define WAKE_UP_SRC_LEN         3     //WAKE_UP_SRC, TAP_SRC and D6D_SRC
+
+#define UCF_LINE_LEN            128
+
+#define Q16_ONE                 65536.0
+#define UG_PER_G                1000000.0
+#define MDPS_PER_DPS            1000.0
+
 /* Private variables----------------------------------------------------------*/
 /* Private function prototypes -----------------------------------------------*/
-static int get_values(float *x_value, float *y_value, float *z_value, int reg, int scale_range);
-static float convert_value(int16_t value, int scale_range);
+static int get_values(float *x_value, float *y_value, float *z_value, int reg, float lsb);
+static void convert_triplets(const int16_t *raw, int count, float lsb, float *x, float *y, float *z);
+static void convert_triplets_fixed(const int16_t *raw, int count, int32_t mul_q16, int32_t *x, int32_t *y, int32_t *z);
+static int acc_scale_range(uint8_t fsr_acc);
+static int gyr_scale_range(uint8_t fsr_gyr);
 /* Functions -----------------------------------------------------------------*/
 
 /**
@@ -55,6 +127,12 @@ LSM6DSOX::LSM6DSOX(uint8_t odr_acc, uint8_t odr_gyr, uint8_t fsr_acc, uint8_t fs
   
   fsr_odr_reg_acc = odr_acc | fsr_acc;
   fsr_odr_reg_gyr = odr_gyr | fsr_gyr;
+  update_lsb();
+  for(int i = 0; i < 4; i++)
+    fifo_ctrl[i] = 0;   //Reset values, FIFO in bypass mode
+  fifo_timestamp = 0;
+  int_route[0] = int_route[1] = 0;
+  user_bank = true;
   //Configure accelerometer and gyroscope
   data[0] = CONF_ACC_GYR_REG;
   data[1] = fsr_odr_reg_acc;
@@ -84,6 +162,7 @@ int LSM6DSOX::set_fsr(uint8_t fsr_acc, uint8_t fsr_gyr) {
   
   fsr_odr_reg_acc = (fsr_odr_reg_acc & (~ACC_FSR_MASK)) | fsr_acc;
   fsr_odr_reg_gyr = (fsr_odr_reg_gyr & (~GYR_FSR_MASK)) | fsr_gyr;
+  update_lsb();
   
   //Configure accelerometer and gyroscope
   data[0] = CONF_ACC_GYR_REG;
@@ -158,22 +237,12 @@ int LSM6DSOX::get_temperature(float *temperature){
  */
 int LSM6DSOX::get_acc_values(float *x_value, float *y_value, float *z_value){
   
-  uint8_t scale_range = fsr_odr_reg_acc & ACC_FSR_MASK;
+  int scale_range = acc_scale_range(fsr_odr_reg_acc & ACC_FSR_MASK);
   
-  if(scale_range == ACC_16_G_FSR){
-    return get_values(x_value, y_value, z_value, ACC_DATA_REG, 16);
-  }
-  else if(scale_range == ACC_8_G_FSR){
-    return get_values(x_value, y_value, z_value, ACC_DATA_REG, 8);
-  }
-  else if(scale_range == ACC_4_G_FSR){
-    return get_values(x_value, y_value, z_value, ACC_DATA_REG, 4);
-  }
-  else if(scale_range == ACC_2_G_FSR){
-    return get_values(x_value, y_value, z_value, ACC_DATA_REG, 2);
-  }
+  if(scale_range == -1)
+    return -1;
   
-  return -1;
+  return get_values(x_value, y_value, z_value, ACC_DATA_REG, acc_lsb);
 }
 
 
@@ -191,25 +260,777 @@ int LSM6DSOX::get_acc_values(float *x_value, float *y_value, float *z_value){
  */
 int LSM6DSOX::get_gyr_values(float *x_value, float *y_value, float *z_value){
 
-  uint8_t scale_range = fsr_odr_reg_gyr & GYR_FSR_MASK;
+  int scale_range = gyr_scale_range(fsr_odr_reg_gyr & GYR_FSR_MASK);
   
-  if(scale_range == GYR_2000_DPS_FSR){
-    return get_values(x_value, y_value, z_value, GYR_DATA_REG, 2000);
+  if(scale_range == -1)
+    return -1;
+  
+  return get_values(x_value, y_value, z_value, GYR_DATA_REG, gyr_lsb);
+}
+
+
+/**
+ * @brief Gets the temperature, gyroscope and accelerometer values with a single
+ *        burst read, so the three come from the same output data latch.
+ * 
+ * @param[out] sample Structure where the values will be stored.
+ *
+ * @return 0 if success, -1 if error.
+ */
+int LSM6DSOX::read_all(lsm6dsox_imu_sample *sample){
+  uint8_t data[ALL_DATA_LEN];
+
+  if(I2C_Master::read_msg(ADR_LSM, TEMP_DATA_REG, data, ALL_DATA_LEN) == -1)
+    return -1;
+
+  sample->temperature = (float)((int16_t)(data[1] << 8 | data[0])) / 256.0 + 25.0;
+  sample->gyr_x = (int16_t)(data[3] << 8 | data[2]) * gyr_lsb;
+  sample->gyr_y = (int16_t)(data[5] << 8 | data[4]) * gyr_lsb;
+  sample->gyr_z = (int16_t)(data[7] << 8 | data[6]) * gyr_lsb;
+  sample->acc_x = (int16_t)(data[9] << 8 | data[8]) * acc_lsb;
+  sample->acc_y = (int16_t)(data[11] << 8 | data[10]) * acc_lsb;
+  sample->acc_z = (int16_t)(data[13] << 8 | data[12]) * acc_lsb;
+
+  return 0;
+}
+
+
+/**
+ * @brief Sets the FIFO watermark. The watermark flag rises when the FIFO holds
+ *        at least `words` words (samples and timestamps).
+ * 
+ * @param[in] words Watermark level, up to LSM6DSOX_FIFO_MAX_WATERMARK. 0 disables it.
+ *
+ * @return 0 if success, -1 if error.
+ */
+int LSM6DSOX::set_fifo_watermark(uint16_t words){
+  if(words > LSM6DSOX_FIFO_MAX_WATERMARK)
+    return -1;
+
+  fifo_ctrl[0] = words & 0xFF;
+  fifo_ctrl[1] = (fifo_ctrl[1] & ~FIFO_WTM8_MASK) | (words >> 8);
+  return write_fifo_ctrl();
+}
+
+
+/**
+ * @brief Sets the rates at which the accelerometer and gyroscope samples are 
+ *        stored in the FIFO. They should not exceed the ODRs.
+ * 
+ * @param[in] bdr_acc LSM6DSOX_BDR_* value for the accelerometer.
+ * @param[in] bdr_gyr LSM6DSOX_BDR_* value for the gyroscope.
+ *
+ * @return 0 if success, -1 if error.
+ */
+int LSM6DSOX::set_fifo_batch_rates(uint8_t bdr_acc, uint8_t bdr_gyr){
+  if(bdr_acc > LSM6DSOX_BDR_6_66_KHZ || bdr_gyr > LSM6DSOX_BDR_6_66_KHZ)
+    return -1;
+
+  fifo_ctrl[2] = bdr_gyr << 4 | (bdr_acc & FIFO_BDR_ACC_MASK);
+  return write_fifo_ctrl();
+}
+
+
+/**
+ * @brief Enables the timestamp counter and its batching in the FIFO.
+ * 
+ * @param[in] decimation LSM6DSOX_TS_OFF or LSM6DSOX_TS_DEC_* (batches per timestamp).
+ *
+ * @return 0 if success, -1 if error.
+ */
+int LSM6DSOX::set_fifo_timestamp(uint8_t decimation){
+  uint8_t data[2];
+
+  if(decimation > LSM6DSOX_TS_DEC_32)
+    return -1;
+
+  //The counter must run for the timestamps to be batched
+  if(I2C_Master::read_msg(ADR_LSM, CTRL10_C_REG, &data[1], 1) == -1)
+    return -1;
+  data[0] = CTRL10_C_REG;
+  if(decimation != LSM6DSOX_TS_OFF)
+    data[1] |= TIMESTAMP_EN_MASK;
+  else
+    data[1] &= ~TIMESTAMP_EN_MASK;
+  if(I2C_Master::write_msg(ADR_LSM, data, 2) == -1)
+    return -1;
+
+  fifo_ctrl[3] = (fifo_ctrl[3] & ~FIFO_TS_DEC_MASK) | decimation << FIFO_TS_DEC_POS;
+  return write_fifo_ctrl();
+}
+
+
+/**
+ * @brief Sets the FIFO mode. Going through LSM6DSOX_FIFO_BYPASS clears the FIFO.
+ * 
+ * @param[in] mode LSM6DSOX_FIFO_BYPASS, LSM6DSOX_FIFO_STOP_FULL or LSM6DSOX_FIFO_CONTINUOUS.
+ *
+ * @return 0 if success, -1 if error.
+ */
+int LSM6DSOX::set_fifo_mode(uint8_t mode){
+  if(mode != LSM6DSOX_FIFO_BYPASS && mode != LSM6DSOX_FIFO_STOP_FULL && mode != LSM6DSOX_FIFO_CONTINUOUS)
+    return -1;
+
+  fifo_ctrl[3] = (fifo_ctrl[3] & ~FIFO_MODE_MASK) | mode;
+  if(mode == LSM6DSOX_FIFO_BYPASS)
+    fifo_timestamp = 0;
+  return write_fifo_ctrl();
+}
+
+
+/**
+ * @brief Gets the FIFO level and flags. Reading it clears the overrun flag.
+ * 
+ * @param[out] status Structure where the status will be stored.
+ *
+ * @return 0 if success, -1 if error.
+ */
+int LSM6DSOX::get_fifo_status(lsm6dsox_fifo_status *status){
+  uint8_t data[2];
+
+  if(I2C_Master::read_msg(ADR_LSM, FIFO_STATUS1_REG, data, 2) == -1)
+    return -1;
+
+  uint16_t value = data[1] << 8 | data[0];
+  status->level = value & FIFO_DIFF_MASK;
+  status->watermark = value & FIFO_WTM_FLAG;
+  status->overrun = value & FIFO_OVR_FLAG;
+  status->full = value & FIFO_FULL_FLAG;
+  return 0;
+}
+
+
+/**
+ * @brief Drains the FIFO with burst reads and decodes the tagged words. The 
+ *        timestamp words are not returned but stamp the following samples.
+ * 
+ * @param[out] samples Array where the samples will be stored.
+ * @param[in] samples_len Capacity of `samples`. The words that do not fit stay
+ *                        in the FIFO.
+ *
+ * @return The number of samples stored if success, -1 if error.
+ */
+int LSM6DSOX::read_fifo(lsm6dsox_fifo_sample *samples, int samples_len){
+  uint8_t data[FIFO_BURST_WORDS * FIFO_WORD_LEN];
+  lsm6dsox_fifo_status status;
+  int stored = 0;
+
+  if(get_fifo_status(&status) == -1)
+    return -1;
+
+  //Every word gives at most one sample, so the words read always fit
+  int words = status.level < samples_len ? status.level : samples_len;
+
+  while(words > 0){
+    int burst = words < FIFO_BURST_WORDS ? words : FIFO_BURST_WORDS;
+
+    //The sensor rolls the address over inside the FIFO output registers
+    if(I2C_Master::read_msg(ADR_LSM, FIFO_DATA_TAG_REG, data, burst * FIFO_WORD_LEN) == -1)
+      return -1;
+
+    for(int i = 0; i < burst; i++){
+      uint8_t *word = &data[i * FIFO_WORD_LEN];
+      uint8_t tag = word[0] >> FIFO_TAG_POS;
+      int16_t x = word[2] << 8 | word[1];
+      int16_t y = word[4] << 8 | word[3];
+      int16_t z = word[6] << 8 | word[5];
+      lsm6dsox_fifo_sample *sample = &samples[stored];
+
+      if(tag == FIFO_TAG_TIMESTAMP){
+        fifo_timestamp = (uint32_t)word[4] << 24 | (uint32_t)word[3] << 16 | word[2] << 8 | word[1];
+        continue;
+      }
+
+      if(tag == LSM6DSOX_SAMPLE_ACC){
+        sample->x = x * acc_lsb;
+        sample->y = y * acc_lsb;
+        sample->z = z * acc_lsb;
+      }
+      else if(tag == LSM6DSOX_SAMPLE_GYR){
+        sample->x = x * gyr_lsb;
+        sample->y = y * gyr_lsb;
+        sample->z = z * gyr_lsb;
+      }
+      else if(tag == LSM6DSOX_SAMPLE_TEMP){
+        sample->x = (float)x / 256.0 + 25.0;
+        sample->y = sample->z = 0;
+      }
+      else{
+        continue;   //Words of sensors not handled by this driver
+      }
+      sample->type = tag;
+      sample->timestamp = fifo_timestamp;
+      stored++;
+    }
+    words -= burst;
+  }
+
+  return stored;
+}
+
+
+/**
+ * @brief Drains the FIFO like read_fifo(), but keeps the accelerometer and 
+ *        gyroscope words raw as interleaved x, y, z triplets for the batch 
+ *        conversions. Timestamp, temperature and other words are discarded.
+ * 
+ * @param[out] acc_raw Array of 3 * `capacity` values for the accelerometer.
+ * @param[out] acc_count Number of accelerometer triplets stored.
+ * @param[out] gyr_raw Array of 3 * `capacity` values for the gyroscope.
+ * @param[out] gyr_count Number of gyroscope triplets stored.
+ * @param[in] capacity Triplets each array can hold. The words that do not fit
+ *                     stay in the FIFO.
+ *
+ * @return 0 if success, -1 if error.
+ */
+int LSM6DSOX::read_fifo_raw(int16_t *acc_raw, int *acc_count, int16_t *gyr_raw, int *gyr_count, int capacity){
+  uint8_t data[FIFO_BURST_WORDS * FIFO_WORD_LEN];
+  lsm6dsox_fifo_status status;
+
+  *acc_count = *gyr_count = 0;
+  if(get_fifo_status(&status) == -1)
+    return -1;
+
+  int words = status.level < capacity ? status.level : capacity;
+
+  while(words > 0){
+    int burst = words < FIFO_BURST_WORDS ? words : FIFO_BURST_WORDS;
+
+    if(I2C_Master::read_msg(ADR_LSM, FIFO_DATA_TAG_REG, data, burst * FIFO_WORD_LEN) == -1)
+      return -1;
+
+    for(int i = 0; i < burst; i++){
+      uint8_t *word = &data[i * FIFO_WORD_LEN];
+      uint8_t tag = word[0] >> FIFO_TAG_POS;
+      int16_t *out;
+
+      if(tag == LSM6DSOX_SAMPLE_ACC)
+        out = &acc_raw[3 * (*acc_count)++];
+      else if(tag == LSM6DSOX_SAMPLE_GYR)
+        out = &gyr_raw[3 * (*gyr_count)++];
+      else
+        continue;
+
+      out[0] = word[2] << 8 | word[1];
+      out[1] = word[4] << 8 | word[3];
+      out[2] = word[6] << 8 | word[5];
+    }
+    words -= burst;
+  }
+
+  return 0;
+}
+
+
+/**
+ * @brief Converts raw accelerometer triplets to g, as structure of arrays.
+ * 
+ * @param[in] raw Interleaved x, y, z values, 3 * `count` of them.
+ * @param[in] count Number of triplets.
+ * @param[out] x Array of `count` values.
+ * @param[out] y Array of `count` values.
+ * @param[out] z Array of `count` values.
+ */
+void LSM6DSOX::convert_acc(const int16_t *raw, int count, float *x, float *y, float *z){
+  convert_triplets(raw, count, acc_lsb, x, y, z);
+}
+
+
+/**
+ * @brief Converts raw gyroscope triplets to dps, as structure of arrays.
+ * 
+ * @param[in] raw Interleaved x, y, z values, 3 * `count` of them.
+ * @param[in] count Number of triplets.
+ * @param[out] x Array of `count` values.
+ * @param[out] y Array of `count` values.
+ * @param[out] z Array of `count` values.
+ */
+void LSM6DSOX::convert_gyr(const int16_t *raw, int count, float *x, float *y, float *z){
+  convert_triplets(raw, count, gyr_lsb, x, y, z);
+}
+
+
+/**
+ * @brief Converts raw accelerometer triplets to integer micro-g, as structure
+ *        of arrays. Rounded to the nearest value.
+ * 
+ * @param[in] raw Interleaved x, y, z values, 3 * `count` of them.
+ * @param[in] count Number of triplets.
+ * @param[out] x Array of `count` values.
+ * @param[out] y Array of `count` values.
+ * @param[out] z Array of `count` values.
+ */
+void LSM6DSOX::convert_acc_fixed(const int16_t *raw, int count, int32_t *x, int32_t *y, int32_t *z){
+  convert_triplets_fixed(raw, count, acc_ug_q16, x, y, z);
+}
+
+
+/**
+ * @brief Converts raw gyroscope triplets to integer milli-dps, as structure 
+ *        of arrays. Rounded to the nearest value.
+ * 
+ * @param[in] raw Interleaved x, y, z values, 3 * `count` of them.
+ * @param[in] count Number of triplets.
+ * @param[out] x Array of `count` values.
+ * @param[out] y Array of `count` values.
+ * @param[out] z Array of `count` values.
+ */
+void LSM6DSOX::convert_gyr_fixed(const int16_t *raw, int count, int32_t *x, int32_t *y, int32_t *z){
+  convert_triplets_fixed(raw, count, gyr_mdps_q16, x, y, z);
+}
+
+
+/**
+ * @brief Routes interrupt sources to one of the interrupt pins, replacing the 
+ *        previous routing of that pin. The pins are active high and can be 
+ *        waited for with CustomGPIO::GPIO::waits() on a rising edge.
+ * 
+ * @param[in] pin LSM6DSOX_INT1 or LSM6DSOX_INT2.
+ * @param[in] sources LSM6DSOX_INT_* values ORed, 0 to leave the pin unused.
+ *
+ * @return 0 if success, -1 if error.
+ */
+int LSM6DSOX::set_int_route(int pin, uint16_t sources){
+  uint8_t data[2];
+
+  if(pin != LSM6DSOX_INT1 && pin != LSM6DSOX_INT2)
+    return -1;
+
+  //The low byte goes to INTx_CTRL and the high byte to MDx_CFG
+  data[0] = INT1_CTRL_REG + pin - 1;
+  data[1] = sources & 0xFF;
+  if(I2C_Master::write_msg(ADR_LSM, data, 2) == -1)
+    return -1;
+
+  data[0] = MD1_CFG_REG + pin - 1;
+  data[1] = sources >> 8;
+  if(I2C_Master::write_msg(ADR_LSM, data, 2) == -1)
+    return -1;
+
+  int_route[pin - 1] = sources;
+
+  //The motion detectors only drive the pins with the interrupts enabled
+  if(I2C_Master::read_msg(ADR_LSM, TAP_CFG2_REG, &data[1], 1) == -1)
+    return -1;
+  data[0] = TAP_CFG2_REG;
+  if((int_route[0] | int_route[1]) >> 8)
+    data[1] |= INTERRUPTS_ENABLE_MASK;
+  else
+    data[1] &= ~INTERRUPTS_ENABLE_MASK;
+  if(I2C_Master::write_msg(ADR_LSM, data, 2) == -1)
+    return -1;
+
+  return 0;
+}
+
+
+/**
+ * @brief Configures the wake-up detector, which fires when the acceleration 
+ *        slope exceeds the threshold. Route LSM6DSOX_INT_WAKE_UP to get an
+ *        interrupt.
+ * 
+ * @param[in] threshold_g Threshold in g, in steps of FSR/64.
+ * @param[in] duration Samples (0-3) the threshold must be exceeded.
+ *
+ * @return 0 if success, -1 if error.
+ */
+int LSM6DSOX::set_wake_up(float threshold_g, uint8_t duration){
+  uint8_t data[3];
+  int ths = threshold_g / (acc_scale_range(fsr_odr_reg_acc & ACC_FSR_MASK) / 64.0) + 0.5;
+
+  if(threshold_g < 0 || ths > WK_THS_MASK || duration > 3)
+    return -1;
+
+  if(enable_latched_events() == -1)
+    return -1;
+
+  //WAKE_UP_THS and WAKE_UP_DUR are contiguous. The other bits keep their reset values.
+  if(I2C_Master::read_msg(ADR_LSM, WAKE_UP_THS_REG, &data[1], 2) == -1)
+    return -1;
+  data[0] = WAKE_UP_THS_REG;
+  data[1] = (data[1] & ~WK_THS_MASK) | ths;
+  data[2] = (data[2] & ~WAKE_DUR_MASK) | duration << WAKE_DUR_POS;
+  if(I2C_Master::write_msg(ADR_LSM, data, 3) == -1)
+    return -1;
+
+  return 0;
+}
+
+
+/**
+ * @brief Configures the 6D orientation detector. Route LSM6DSOX_INT_6D to get
+ *        an interrupt on every orientation change.
+ * 
+ * @param[in] threshold One of the LSM6DSOX_6D_THS_* values.
+ *
+ * @return 0 if success, -1 if error.
+ */
+int LSM6DSOX::set_6d(uint8_t threshold){
+  uint8_t data[2];
+
+  if(threshold > LSM6DSOX_6D_THS_50_DEG)
+    return -1;
+
+  if(enable_latched_events() == -1)
+    return -1;
+
+  if(I2C_Master::read_msg(ADR_LSM, TAP_THS_6D_REG, &data[1], 1) == -1)
+    return -1;
+  data[0] = TAP_THS_6D_REG;
+  data[1] = (data[1] & ~SIXD_THS_MASK) | threshold << SIXD_THS_POS;
+  if(I2C_Master::write_msg(ADR_LSM, data, 2) == -1)
+    return -1;
+
+  return 0;
+}
+
+
+/**
+ * @brief Enables the embedded tilt and significant motion detectors and 
+ *        routes them to a pin.
+ * 
+ * @param[in] functions LSM6DSOX_EMB_* values ORed, 0 to disable them.
+ * @param[in] pin LSM6DSOX_INT1, LSM6DSOX_INT2, or 0 to only poll them with 
+ *                get_motion_events().
+ *
+ * @return 0 if success, -1 if error.
+ */
+int LSM6DSOX::set_embedded_functions(uint8_t functions, int pin){
+  uint8_t value;
+
+  if((functions & ~(LSM6DSOX_EMB_TILT | LSM6DSOX_EMB_SIG_MOTION)) || pin < 0 || pin > LSM6DSOX_INT2)
+    return -1;
+
+  //Restart the algorithms, keep the status latched until it is read, then enable them
+  value = functions;
+  if(write_emb_regs(EMB_FUNC_INIT_A_REG, &value, 1) == -1)
+    return -1;
+  value = EMB_FUNC_LIR_MASK;
+  if(write_emb_regs(PAGE_RW_REG, &value, 1) == -1)
+    return -1;
+  value = functions;
+  if(write_emb_regs(EMB_FUNC_EN_A_REG, &value, 1) == -1)
+    return -1;
+
+  for(int i = LSM6DSOX_INT1; i <= LSM6DSOX_INT2; i++){
+    value = (i == pin) ? functions : 0;
+    if(write_emb_regs(i == LSM6DSOX_INT1 ? EMB_FUNC_INT1_REG : EMB_FUNC_INT2_REG, &value, 1) == -1)
+      return -1;
+
+    uint16_t route = int_route[i - 1] & ~LSM6DSOX_INT_EMB_FUNC;
+    if(value)
+      route |= LSM6DSOX_INT_EMB_FUNC;
+    if(route != int_route[i - 1] && set_int_route(i, route) == -1)
+      return -1;
+  }
+
+  return 0;
+}
+
+
+/**
+ * @brief Gets and clears the latched motion events.
+ * 
+ * @param[out] events Structure where the events will be stored.
+ *
+ * @return 0 if success, -1 if error.
+ */
+int LSM6DSOX::get_motion_events(lsm6dsox_motion_events *events){
+  uint8_t data[WAKE_UP_SRC_LEN];
+  uint8_t emb_status;
+
+  if(I2C_Master::read_msg(ADR_LSM, WAKE_UP_SRC_REG, data, WAKE_UP_SRC_LEN) == -1)
+    return -1;
+
+  if(I2C_Master::read_msg(ADR_LSM, EMB_FUNC_STATUS_MAINPAGE_REG, &emb_status, 1) == -1)
+    return -1;
+
+  events->wake_up = data[0] & WU_IA_MASK;
+  events->wake_up_axes = data[0] & WU_AXES_MASK;
+  events->orientation_change = data[2] & D6D_IA_MASK;
+  events->orientation = data[2] & D6D_POS_MASK;
+  events->tilt = emb_status & LSM6DSOX_EMB_TILT;
+  events->significant_motion = emb_status & LSM6DSOX_EMB_SIG_MOTION;
+
+  return 0;
+}
+
+
+/**
+ * @brief Writes a register configuration, usually a Machine Learning Core
+ *        program generated as an UCF file. The driver keeps track of the ODR,
+ *        FSR, FIFO and interrupt registers written by the configuration.
+ * 
+ * @param[in] lines Configuration lines, applied in order.
+ * @param[in] lines_len Number of lines.
+ *
+ * @return 0 if success, -1 if error.
+ */
+int LSM6DSOX::load_config(const lsm6dsox_ucf_line *lines, int lines_len){
+  uint8_t data[2];
+
+  for(int i = 0; i < lines_len; i++){
+    if(lines[i].op == LSM6DSOX_UCF_DELAY){
+      usleep(lines[i].value * 1000);
+      continue;
+    }
+
+    data[0] = lines[i].reg;
+    data[1] = lines[i].value;
+    if(I2C_Master::write_msg(ADR_LSM, data, 2) == -1)
+      return -1;
+    track_write(lines[i].reg, lines[i].value);
+  }
+
+  return 0;
+}
+
+
+/**
+ * @brief Loads a configuration from an UCF text file. Each line is 
+ *        "Ac <reg> <value>" in hexadecimal or "WAIT <ms>"; lines starting 
+ *        with "--" are comments.
+ * 
+ * @param[in] path The UCF file.
+ *
+ * @return 0 if success, -1 if error.
+ */
+int LSM6DSOX::load_ucf(const char *path){
+  char text[UCF_LINE_LEN];
+  char first[3];
+  unsigned int reg, value;
+  std::vector<lsm6dsox_ucf_line> lines;
+
+  FILE *file = fopen(path, "r");
+  if(file == NULL)
+    return -1;
+
+  //The whole file is parsed before writing anything to the sensor
+  while(fgets(text, sizeof(text), file) != NULL){
+    if(sscanf(text, " %2s", first) != 1 || (first[0] == '-' && first[1] == '-'))
+      continue;
+
+    if(sscanf(text, " Ac %x %x", &reg, &value) == 2 && reg <= 0xFF && value <= 0xFF){
+      lines.push_back({LSM6DSOX_UCF_WRITE, (uint8_t)reg, (uint16_t)value});
+    }
+    else if(sscanf(text, " WAIT %u", &value) == 1 && value <= 0xFFFF){
+      lines.push_back({LSM6DSOX_UCF_DELAY, 0, (uint16_t)value});
+    }
+    else{
+      fclose(file);
+      return -1;
+    }
+  }
+  fclose(file);
+
+  return load_config(lines.data(), lines.size());
+}
+
+
+/**
+ * @brief Gets the last class given by each Machine Learning Core tree.
+ * 
+ * @param[out] outputs Array of LSM6DSOX_MLC_TREES values.
+ *
+ * @return 0 if success, -1 if error.
+ */
+int LSM6DSOX::get_mlc_outputs(uint8_t *outputs){
+  return read_emb_regs(MLC0_SRC_REG, outputs, LSM6DSOX_MLC_TREES);
+}
+
+
+/**
+ * @brief Gets the trees whose interrupt is active with their class. Route
+ *        LSM6DSOX_INT_EMB_FUNC and set the MLC_INTx registers in the 
+ *        configuration to get them on a pin.
+ * 
+ * @param[out] events Array where the events will be stored.
+ * @param[in] events_len Capacity of `events`, up to LSM6DSOX_MLC_TREES are needed.
+ *
+ * @return The number of events if success, -1 if error.
+ */
+int LSM6DSOX::get_mlc_events(lsm6dsox_mlc_event *events, int events_len){
+  uint8_t status;
+  uint8_t outputs[LSM6DSOX_MLC_TREES];
+  int stored = 0;
+
+  if(I2C_Master::read_msg(ADR_LSM, MLC_STATUS_MAINPAGE_REG, &status, 1) == -1)
+    return -1;
+
+  //Avoid the bank switch when nothing happened
+  if(status == 0)
+    return 0;
+
+  if(get_mlc_outputs(outputs) == -1)
+    return -1;
+
+  for(int i = 0; i < LSM6DSOX_MLC_TREES && stored < events_len; i++){
+    if(status & (1 << i)){
+      events[stored].tree = i;
+      events[stored].value = outputs[i];
+      stored++;
+    }
+  }
+
+  return stored;
+}
+
+
+/**
+ * @brief Latches the wake-up and 6D events until their source register is read,
+ *        so an edge on the interrupt pin can not be missed.
+ *
+ * @return 0 if success, -1 if error.
+ */
+int LSM6DSOX::enable_latched_events(){
+  uint8_t data[2];
+
+  if(I2C_Master::read_msg(ADR_LSM, TAP_CFG0_REG, &data[1], 1) == -1)
+    return -1;
+  data[0] = TAP_CFG0_REG;
+  data[1] |= INT_CLR_ON_READ_MASK | LIR_MASK;
+  if(I2C_Master::write_msg(ADR_LSM, data, 2) == -1)
+    return -1;
+
+  return 0;
+}
+
+
+/**
+ * @brief Writes registers of the embedded functions bank and switches back to 
+ *        the user bank.
+ *
+ * @param[in] reg First register to write.
+ * @param[in] values Values to write with auto-increment.
+ * @param[in] values_len Number of values, up to 8.
+ *
+ * @return 0 if success, -1 if error.
+ */
+int LSM6DSOX::write_emb_regs(uint8_t reg, uint8_t *values, int values_len){
+  uint8_t data[9];
+  int result = 0;
+
+  if(values_len > 8)
+    return -1;
+
+  data[0] = FUNC_CFG_ACCESS_REG;
+  data[1] = FUNC_CFG_ACCESS_MASK;
+  if(I2C_Master::write_msg(ADR_LSM, data, 2) == -1)
+    return -1;
+
+  data[0] = reg;
+  for(int i = 0; i < values_len; i++)
+    data[i + 1] = values[i];
+  if(I2C_Master::write_msg(ADR_LSM, data, values_len + 1) == -1)
+    result = -1;
+
+  //Always go back to the user bank
+  data[0] = FUNC_CFG_ACCESS_REG;
+  data[1] = 0;
+  if(I2C_Master::write_msg(ADR_LSM, data, 2) == -1)
+    return -1;
+
+  return result;
+}
+
+
+/**
+ * @brief Reads registers of the embedded functions bank and switches back to 
+ *        the user bank.
+ *
+ * @param[in] reg First register to read.
+ * @param[out] values Values read with auto-increment.
+ * @param[in] values_len Number of values.
+ *
+ * @return 0 if success, -1 if error.
+ */
+int LSM6DSOX::read_emb_regs(uint8_t reg, uint8_t *values, int values_len){
+  uint8_t data[2];
+  int result = 0;
+
+  data[0] = FUNC_CFG_ACCESS_REG;
+  data[1] = FUNC_CFG_ACCESS_MASK;
+  if(I2C_Master::write_msg(ADR_LSM, data, 2) == -1)
+    return -1;
+
+  if(I2C_Master::read_msg(ADR_LSM, reg, values, values_len) == -1)
+    result = -1;
+
+  //Always go back to the user bank
+  data[0] = FUNC_CFG_ACCESS_REG;
+  data[1] = 0;
+  if(I2C_Master::write_msg(ADR_LSM, data, 2) == -1)
+    return -1;
+
+  return result;
+}
+
+
+/**
+ * @brief Keeps the cached registers coherent with a raw register write.
+ *
+ * @param[in] reg Register written, in the bank selected at that moment.
+ * @param[in] value Value written.
+ */
+void LSM6DSOX::track_write(uint8_t reg, uint8_t value){
+  if(reg == FUNC_CFG_ACCESS_REG){
+    user_bank = !(value & FUNC_CFG_ACCESS_MASK);
+    return;
   }
-  else if(scale_range == GYR_1000_DPS_FSR){
-    return get_values(x_value, y_value, z_value, GYR_DATA_REG, 1000);
+  if(!user_bank)
+    return;
+
+  if(reg == CONF_ACC_GYR_REG){
+    fsr_odr_reg_acc = value;
+    update_lsb();
   }
-  else if(scale_range == GYR_500_DPS_FSR){
-    return get_values(x_value, y_value, z_value, GYR_DATA_REG, 500);
+  else if(reg == CONF_ACC_GYR_REG + 1){
+    fsr_odr_reg_gyr = value;
+    update_lsb();
   }
-  else if(scale_range == GYR_250_DPS_FSR){
-    return get_values(x_value, y_value, z_value, GYR_DATA_REG, 250);
+  else if(reg >= FIFO_CTRL1_REG && reg < FIFO_CTRL1_REG + 4){
+    fifo_ctrl[reg - FIFO_CTRL1_REG] = value;
   }
-  else if(scale_range == GYR_125_DPS_FSR){
-    return get_values(x_value, y_value, z_value, GYR_DATA_REG, 125);
+  else if(reg == INT1_CTRL_REG || reg == INT2_CTRL_REG){
+    int_route[reg - INT1_CTRL_REG] = (int_route[reg - INT1_CTRL_REG] & 0xFF00) | value;
   }
-  
-  return -1;
+  else if(reg == MD1_CFG_REG || reg == MD2_CFG_REG){
+    int_route[reg - MD1_CFG_REG] = (int_route[reg - MD1_CFG_REG] & 0x00FF) | value << 8;
+  }
+}
+
+
+/**
+ * @brief Updates the cached sensitivities from the current FSRs: the full scale
+ *        range spans the 65536 codes.
+ */
+void LSM6DSOX::update_lsb(){
+  double acc = acc_scale_range(fsr_odr_reg_acc & ACC_FSR_MASK) * 2 / 65536.0;
+  double gyr = gyr_scale_range(fsr_odr_reg_gyr & GYR_FSR_MASK) * 2 / 65536.0;
+
+  acc_lsb = acc;
+  gyr_lsb = gyr;
+  acc_ug_q16 = (int32_t)(acc * UG_PER_G * Q16_ONE + 0.5);
+  gyr_mdps_q16 = (int32_t)(gyr * MDPS_PER_DPS * Q16_ONE + 0.5);
+}
+
+
+/**
+ * @brief Writes the cached FIFO_CTRL1 to FIFO_CTRL4 registers in one message.
+ *
+ * @return 0 if success, -1 if error.
+ */
+int LSM6DSOX::write_fifo_ctrl(){
+  uint8_t data[5];
+
+  data[0] = FIFO_CTRL1_REG;
+  for(int i = 0; i < 4; i++)
+    data[i + 1] = fifo_ctrl[i];
+
+  if(I2C_Master::write_msg(ADR_LSM, data, 5) == -1)
+    return -1;
+
+  return 0;
 }
 
 
@@ -225,38 +1046,106 @@ int LSM6DSOX::get_gyr_values(float *x_value, float *y_value, float *z_value){
  * @param[out] z_value     Pointer to the location where the z-axis value is to be 
  *                         saved.
  * @param[in] reg          First I2C register to read from.
- * @param[in] scale_range  Scale range of the values.
+ * @param[in] lsb          Sensitivity, units per LSB.
  *
  * @return 0 if success, -1 if error.
  */
-static int get_values(float *x_value, float *y_value, float *z_value, int reg, int scale_range){
+static int get_values(float *x_value, float *y_value, float *z_value, int reg, float lsb){
 
   int len = 6;
   uint8_t data[len];
+  int16_t raw[3];
   if(I2C_Master::read_msg(ADR_LSM, reg, data, len) == -1)
     return -1;
-    
-  *x_value = convert_value(data[1] << 8 | data[0], scale_range);
-  *y_value = convert_value(data[3] << 8 | data[2], scale_range);
-  *z_value = convert_value(data[5] << 8 | data[4], scale_range);
-  
+
+  raw[0] = data[1] << 8 | data[0];
+  raw[1] = data[3] << 8 | data[2];
+  raw[2] = data[5] << 8 | data[4];
+  convert_triplets(raw, 1, lsb, x_value, y_value, z_value);
+
   return 0;
 }
 
 
 /**
- * @brief Converts the value as a int16_t to a value inside the scale_range
+ * @brief Deinterleaves raw triplets and scales them to floats. The loop has
+ *        no dependencies between iterations, so the compiler may vectorize it.
+ * 
+ * @param[in] raw Interleaved x, y, z values.
+ * @param[in] count Number of triplets.
+ * @param[in] lsb Sensitivity, units per LSB.
+ * @param[out] x Array of `count` values.
+ * @param[out] y Array of `count` values.
+ * @param[out] z Array of `count` values.
+ */
+static void convert_triplets(const int16_t *raw, int count, float lsb, float *x, float *y, float *z){
+  for(int i = 0; i < count; i++){
+    x[i] = raw[3 * i] * lsb;
+    y[i] = raw[3 * i + 1] * lsb;
+    z[i] = raw[3 * i + 2] * lsb;
+  }
+}
+
+
+/**
+ * @brief Deinterleaves raw triplets and scales them to integers with a Q16 
+ *        factor, rounding to the nearest. Same structure as convert_triplets().
+ * 
+ * @param[in] raw Interleaved x, y, z values.
+ * @param[in] count Number of triplets.
+ * @param[in] mul_q16 Output units per LSB, times 65536.
+ * @param[out] x Array of `count` values.
+ * @param[out] y Array of `count` values.
+ * @param[out] z Array of `count` values.
+ */
+static void convert_triplets_fixed(const int16_t *raw, int count, int32_t mul_q16, int32_t *x, int32_t *y, int32_t *z){
+  for(int i = 0; i < count; i++){
+    x[i] = (int32_t)(((int64_t)raw[3 * i] * mul_q16 + (1 << 15)) >> 16);
+    y[i] = (int32_t)(((int64_t)raw[3 * i + 1] * mul_q16 + (1 << 15)) >> 16);
+    z[i] = (int32_t)(((int64_t)raw[3 * i + 2] * mul_q16 + (1 << 15)) >> 16);
+  }
+}
+
+
+/**
+ * @brief Gets the accelerometer scale range in g from its FSR value.
  * 
- * @param[in] value        The value to be converted.
- * @param[in] scale_range  Scale range of the value converted.
+ * @param[in] fsr_acc Value of FSR for the accelerometer.
  *
- * @return The converted value as a float.
+ * @return The scale range if success, -1 if error.
  */
-static float convert_value(int16_t value, int scale_range){
-  float result;
-  result = (float)value / 65536.0 * scale_range * 2;
+static int acc_scale_range(uint8_t fsr_acc){
+  if(fsr_acc == ACC_16_G_FSR)
+    return 16;
+  else if(fsr_acc == ACC_8_G_FSR)
+    return 8;
+  else if(fsr_acc == ACC_4_G_FSR)
+    return 4;
+  else if(fsr_acc == ACC_2_G_FSR)
+    return 2;
 
-  return result;
+  return -1;
 }
 
 
+/**
+ * @brief Gets the gyroscope scale range in dps from its FSR value.
+ * 
+ * @param[in] fsr_gyr Value of FSR for the gyroscope.
+ *
+ * @return The scale range if success, -1 if error.
+ */
+static int gyr_scale_range(uint8_t fsr_gyr){
+  if(fsr_gyr == GYR_2000_DPS_FSR)
+    return 2000;
+  else if(fsr_gyr == GYR_1000_DPS_FSR)
+    return 1000;
+  else if(fsr_gyr == GYR_500_DPS_FSR)
+    return 500;
+  else if(fsr_gyr == GYR_250_DPS_FSR)
+    return 250;
+  else if(fsr_gyr == GYR_125_DPS_FSR)
+    return 125;
+
+  return -1;
+}
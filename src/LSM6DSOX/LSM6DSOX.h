@@ -45,12 +45,135 @@ extern "C" {
 #define GYR_500_DPS_FSR   0x04
 #define GYR_250_DPS_FSR   0x00
 #define GYR_125_DPS_FSR   0x02
+
+//FIFO batch data rates, same for the accelerometer and the gyroscope
+#define LSM6DSOX_BDR_OFF        0x00
+#define LSM6DSOX_BDR_12_5_HZ    0x01
+#define LSM6DSOX_BDR_26_HZ      0x02
+#define LSM6DSOX_BDR_52_HZ      0x03
+#define LSM6DSOX_BDR_104_HZ     0x04
+#define LSM6DSOX_BDR_208_HZ     0x05
+#define LSM6DSOX_BDR_416_HZ     0x06
+#define LSM6DSOX_BDR_833_HZ     0x07
+#define LSM6DSOX_BDR_1_66_KHZ   0x08
+#define LSM6DSOX_BDR_3_33_KHZ   0x09
+#define LSM6DSOX_BDR_6_66_KHZ   0x0A
+
+//FIFO modes
+#define LSM6DSOX_FIFO_BYPASS      0x00  //FIFO disabled and cleared
+#define LSM6DSOX_FIFO_STOP_FULL   0x01  //Stops collecting when full
+#define LSM6DSOX_FIFO_CONTINUOUS  0x06  //Oldest data overwritten when full
+
+//Timestamp batching decimation
+#define LSM6DSOX_TS_OFF     0x00
+#define LSM6DSOX_TS_DEC_1   0x01  //One timestamp per batch
+#define LSM6DSOX_TS_DEC_8   0x02
+#define LSM6DSOX_TS_DEC_32  0x03
+
+//FIFO sample types, as tagged by the sensor
+#define LSM6DSOX_SAMPLE_GYR   0x01
+#define LSM6DSOX_SAMPLE_ACC   0x02
+#define LSM6DSOX_SAMPLE_TEMP  0x03
+
+//Interrupt sources that can be routed to INT1 and INT2. Several can be ORed.
+#define LSM6DSOX_INT_DRDY_ACC   0x0001  //Accelerometer data ready
+#define LSM6DSOX_INT_DRDY_GYR   0x0002  //Gyroscope data ready
+#define LSM6DSOX_INT_FIFO_WTM   0x0008  //FIFO level reached the watermark
+#define LSM6DSOX_INT_FIFO_OVR   0x0010  //FIFO overrun
+#define LSM6DSOX_INT_FIFO_FULL  0x0020  //FIFO full
+#define LSM6DSOX_INT_EMB_FUNC   0x0200  //Embedded functions (tilt, significant motion)
+#define LSM6DSOX_INT_6D         0x0400  //6D orientation change
+#define LSM6DSOX_INT_WAKE_UP    0x2000  //Wake-up event
+
+#define LSM6DSOX_INT1   1
+#define LSM6DSOX_INT2   2
+
+//6D orientation thresholds
+#define LSM6DSOX_6D_THS_80_DEG  0x00
+#define LSM6DSOX_6D_THS_70_DEG  0x01
+#define LSM6DSOX_6D_THS_60_DEG  0x02
+#define LSM6DSOX_6D_THS_50_DEG  0x03
+
+//Embedded functions. They need the accelerometer ODR at 26 Hz or more.
+#define LSM6DSOX_EMB_TILT         0x10
+#define LSM6DSOX_EMB_SIG_MOTION   0x20
+
+//Machine Learning Core configuration lines, as in the UCF files
+#define LSM6DSOX_UCF_WRITE  0   //Write `value` to register `reg`
+#define LSM6DSOX_UCF_DELAY  1   //Wait `value` ms
+
+#define LSM6DSOX_MLC_TREES  8
+
+typedef struct{
+
+  uint8_t op;         //LSM6DSOX_UCF_WRITE or LSM6DSOX_UCF_DELAY
+  uint8_t reg;
+  uint16_t value;
+
+}lsm6dsox_ucf_line;
+
+typedef struct{
+
+  uint8_t tree;       //Decision tree, 0 to LSM6DSOX_MLC_TREES - 1
+  uint8_t value;      //Class given by the tree
+
+}lsm6dsox_mlc_event;
+
+typedef struct{
+
+  bool wake_up;             //Acceleration slope over the wake-up threshold
+  uint8_t wake_up_axes;     //Bit 0 z, bit 1 y, bit 2 x
+  bool orientation_change;  //6D position changed
+  uint8_t orientation;      //Bits XL, XH, YL, YH, ZL, ZH from bit 0 up
+  bool tilt;
+  bool significant_motion;
+
+}lsm6dsox_motion_events;
+
+typedef struct{
+
+  uint8_t type;         //LSM6DSOX_SAMPLE_*
+  float x, y, z;        //g, dps, or degC in x for temperature samples
+  uint32_t timestamp;   //Last batched timestamp, 25us per LSB. 0 if not batched
+
+}lsm6dsox_fifo_sample;
+
+typedef struct{
+
+  float temperature;              //degC
+  float gyr_x, gyr_y, gyr_z;      //dps
+  float acc_x, acc_y, acc_z;      //g
+
+}lsm6dsox_imu_sample;
+
+typedef struct{
+
+  uint16_t level;       //Unread words
+  bool watermark;       //Level reached the watermark
+  bool overrun;         //Data has been lost since the last status read
+  bool full;
+
+}lsm6dsox_fifo_status;
 /* Exported constants --------------------------------------------------------*/
+#define LSM6DSOX_FIFO_MAX_WATERMARK  511
 /* Exported macro ------------------------------------------------------------*/
 /* Exported Functions --------------------------------------------------------*/
 
 class LSM6DSOX{
     uint8_t fsr_odr_reg_acc, fsr_odr_reg_gyr;
+    uint8_t fifo_ctrl[4];
+    uint32_t fifo_timestamp;
+    uint16_t int_route[2];
+    float acc_lsb, gyr_lsb;   //g and dps per LSB for the current FSRs
+    int32_t acc_ug_q16, gyr_mdps_q16; //Same, in micro-g and milli-dps, Q16
+
+    int write_fifo_ctrl();
+    void update_lsb();
+    int enable_latched_events();
+    int write_emb_regs(uint8_t reg, uint8_t *values, int values_len);
+    int read_emb_regs(uint8_t reg, uint8_t *values, int values_len);
+    void track_write(uint8_t reg, uint8_t value);
+    bool user_bank;
   public:
     //Non complete constructors
     LSM6DSOX () : LSM6DSOX(LSM6DSOX_OFF_ODR, LSM6DSOX_OFF_ODR, ACC_2_G_FSR, GYR_250_DPS_FSR) {};
@@ -129,6 +252,247 @@ class LSM6DSOX{
      * @return 0 if success, -1 if error.
      */
     int get_gyr_values(float *x_value, float *y_value, float *z_value);
+
+    /**
+     * @brief Gets the temperature, gyroscope and accelerometer values with a single
+     *        burst read, so the three come from the same output data latch.
+     * 
+     * @param[out] sample Structure where the values will be stored.
+     *
+     * @return 0 if success, -1 if error.
+     */
+    int read_all(lsm6dsox_imu_sample *sample);
+
+    /**
+     * @brief Sets the FIFO watermark. The watermark flag rises when the FIFO holds
+     *        at least `words` words (samples and timestamps).
+     * 
+     * @param[in] words Watermark level, up to LSM6DSOX_FIFO_MAX_WATERMARK. 0 disables it.
+     *
+     * @return 0 if success, -1 if error.
+     */
+    int set_fifo_watermark(uint16_t words);
+
+    /**
+     * @brief Sets the rates at which the accelerometer and gyroscope samples are 
+     *        stored in the FIFO. They should not exceed the ODRs.
+     * 
+     * @param[in] bdr_acc LSM6DSOX_BDR_* value for the accelerometer.
+     * @param[in] bdr_gyr LSM6DSOX_BDR_* value for the gyroscope.
+     *
+     * @return 0 if success, -1 if error.
+     */
+    int set_fifo_batch_rates(uint8_t bdr_acc, uint8_t bdr_gyr);
+
+    /**
+     * @brief Enables the timestamp counter and its batching in the FIFO.
+     * 
+     * @param[in] decimation LSM6DSOX_TS_OFF or LSM6DSOX_TS_DEC_* (batches per timestamp).
+     *
+     * @return 0 if success, -1 if error.
+     */
+    int set_fifo_timestamp(uint8_t decimation);
+
+    /**
+     * @brief Sets the FIFO mode. Going through LSM6DSOX_FIFO_BYPASS clears the FIFO.
+     * 
+     * @param[in] mode LSM6DSOX_FIFO_BYPASS, LSM6DSOX_FIFO_STOP_FULL or LSM6DSOX_FIFO_CONTINUOUS.
+     *
+     * @return 0 if success, -1 if error.
+     */
+    int set_fifo_mode(uint8_t mode);
+
+    /**
+     * @brief Gets the FIFO level and flags. Reading it clears the overrun flag.
+     * 
+     * @param[out] status Structure where the status will be stored.
+     *
+     * @return 0 if success, -1 if error.
+     */
+    int get_fifo_status(lsm6dsox_fifo_status *status);
+
+    /**
+     * @brief Drains the FIFO with burst reads and decodes the tagged words. The 
+     *        timestamp words are not returned but stamp the following samples.
+     * 
+     * @param[out] samples Array where the samples will be stored.
+     * @param[in] samples_len Capacity of `samples`. The words that do not fit stay
+     *                        in the FIFO.
+     *
+     * @return The number of samples stored if success, -1 if error.
+     */
+    int read_fifo(lsm6dsox_fifo_sample *samples, int samples_len);
+
+    /**
+     * @brief Drains the FIFO like read_fifo(), but keeps the accelerometer and 
+     *        gyroscope words raw as interleaved x, y, z triplets for the batch 
+     *        conversions. Timestamp, temperature and other words are discarded.
+     * 
+     * @param[out] acc_raw Array of 3 * `capacity` values for the accelerometer.
+     * @param[out] acc_count Number of accelerometer triplets stored.
+     * @param[out] gyr_raw Array of 3 * `capacity` values for the gyroscope.
+     * @param[out] gyr_count Number of gyroscope triplets stored.
+     * @param[in] capacity Triplets each array can hold. The words that do not fit
+     *                     stay in the FIFO.
+     *
+     * @return 0 if success, -1 if error.
+     */
+    int read_fifo_raw(int16_t *acc_raw, int *acc_count, int16_t *gyr_raw, int *gyr_count, int capacity);
+
+    /**
+     * @brief Converts raw accelerometer triplets to g, as structure of arrays.
+     * 
+     * @param[in] raw Interleaved x, y, z values, 3 * `count` of them.
+     * @param[in] count Number of triplets.
+     * @param[out] x Array of `count` values.
+     * @param[out] y Array of `count` values.
+     * @param[out] z Array of `count` values.
+     */
+    void convert_acc(const int16_t *raw, int count, float *x, float *y, float *z);
+
+    /**
+     * @brief Gets the accelerometer sensitivity for the current FSR, in g per LSB.
+     */
+    float get_acc_lsb() { return acc_lsb; };
+
+    /**
+     * @brief Gets the gyroscope sensitivity for the current FSR, in dps per LSB.
+     */
+    float get_gyr_lsb() { return gyr_lsb; };
+
+    /**
+     * @brief Converts raw gyroscope triplets to dps, as structure of arrays.
+     * 
+     * @param[in] raw Interleaved x, y, z values, 3 * `count` of them.
+     * @param[in] count Number of triplets.
+     * @param[out] x Array of `count` values.
+     * @param[out] y Array of `count` values.
+     * @param[out] z Array of `count` values.
+     */
+    void convert_gyr(const int16_t *raw, int count, float *x, float *y, float *z);
+
+    /**
+     * @brief Converts raw accelerometer triplets to integer micro-g, as structure
+     *        of arrays. Rounded to the nearest value.
+     * 
+     * @param[in] raw Interleaved x, y, z values, 3 * `count` of them.
+     * @param[in] count Number of triplets.
+     * @param[out] x Array of `count` values.
+     * @param[out] y Array of `count` values.
+     * @param[out] z Array of `count` values.
+     */
+    void convert_acc_fixed(const int16_t *raw, int count, int32_t *x, int32_t *y, int32_t *z);
+
+    /**
+     * @brief Converts raw gyroscope triplets to integer milli-dps, as structure 
+     *        of arrays. Rounded to the nearest value.
+     * 
+     * @param[in] raw Interleaved x, y, z values, 3 * `count` of them.
+     * @param[in] count Number of triplets.
+     * @param[out] x Array of `count` values.
+     * @param[out] y Array of `count` values.
+     * @param[out] z Array of `count` values.
+     */
+    void convert_gyr_fixed(const int16_t *raw, int count, int32_t *x, int32_t *y, int32_t *z);
+
+    /**
+     * @brief Routes interrupt sources to one of the interrupt pins, replacing the 
+     *        previous routing of that pin. The pins are active high and can be 
+     *        waited for with CustomGPIO::GPIO::waits() on a rising edge.
+     * 
+     * @param[in] pin LSM6DSOX_INT1 or LSM6DSOX_INT2.
+     * @param[in] sources LSM6DSOX_INT_* values ORed, 0 to leave the pin unused.
+     *
+     * @return 0 if success, -1 if error.
+     */
+    int set_int_route(int pin, uint16_t sources);
+
+    /**
+     * @brief Configures the wake-up detector, which fires when the acceleration 
+     *        slope exceeds the threshold. Route LSM6DSOX_INT_WAKE_UP to get an
+     *        interrupt.
+     * 
+     * @param[in] threshold_g Threshold in g, in steps of FSR/64.
+     * @param[in] duration Samples (0-3) the threshold must be exceeded.
+     *
+     * @return 0 if success, -1 if error.
+     */
+    int set_wake_up(float threshold_g, uint8_t duration);
+
+    /**
+     * @brief Configures the 6D orientation detector. Route LSM6DSOX_INT_6D to get
+     *        an interrupt on every orientation change.
+     * 
+     * @param[in] threshold One of the LSM6DSOX_6D_THS_* values.
+     *
+     * @return 0 if success, -1 if error.
+     */
+    int set_6d(uint8_t threshold);
+
+    /**
+     * @brief Enables the embedded tilt and significant motion detectors and 
+     *        routes them to a pin.
+     * 
+     * @param[in] functions LSM6DSOX_EMB_* values ORed, 0 to disable them.
+     * @param[in] pin LSM6DSOX_INT1, LSM6DSOX_INT2, or 0 to only poll them with 
+     *                get_motion_events().
+     *
+     * @return 0 if success, -1 if error.
+     */
+    int set_embedded_functions(uint8_t functions, int pin);
+
+    /**
+     * @brief Gets and clears the latched motion events.
+     * 
+     * @param[out] events Structure where the events will be stored.
+     *
+     * @return 0 if success, -1 if error.
+     */
+    int get_motion_events(lsm6dsox_motion_events *events);
+
+    /**
+     * @brief Writes a register configuration, usually a Machine Learning Core
+     *        program generated as an UCF file. The driver keeps track of the ODR,
+     *        FSR, FIFO and interrupt registers written by the configuration.
+     * 
+     * @param[in] lines Configuration lines, applied in order.
+     * @param[in] lines_len Number of lines.
+     *
+     * @return 0 if success, -1 if error.
+     */
+    int load_config(const lsm6dsox_ucf_line *lines, int lines_len);
+
+    /**
+     * @brief Loads a configuration from an UCF text file. Each line is 
+     *        "Ac <reg> <value>" in hexadecimal or "WAIT <ms>"; lines starting 
+     *        with "--" are comments.
+     * 
+     * @param[in] path The UCF file.
+     *
+     * @return 0 if success, -1 if error.
+     */
+    int load_ucf(const char *path);
+
+    /**
+     * @brief Gets the last class given by each Machine Learning Core tree.
+     * 
+     * @param[out] outputs Array of LSM6DSOX_MLC_TREES values.
+     *
+     * @return 0 if success, -1 if error.
+     */
+    int get_mlc_outputs(uint8_t *outputs);
+
+    /**
+     * @brief Gets the trees whose interrupt is active with their class. Route
+     *        LSM6DSOX_INT_EMB_FUNC and set the MLC_INTx registers in the 
+     *        configuration to get them on a pin.
+     * 
+     * @param[out] events Array where the events will be stored.
+     * @param[in] events_len Capacity of `events`, up to LSM6DSOX_MLC_TREES are needed.
+     *
+     * @return The number of events if success, -1 if error.
+     */
+    int get_mlc_events(lsm6dsox_mlc_event *events, int events_len);
 };
 
 
@@ -0,0 +1,214 @@
+/**
+  ******************************************************************************
+  * @file   mlc_reference.cpp
+  * @brief  LSM6DSOX Machine Learning Core Reference Model.
+  *
+  * @note   End-of-degree work.
+  *         Host implementation of the windowed features and decision trees
+  *         computed by the LSM6DSOX Machine Learning Core.
+  ******************************************************************************
+*/
+/* Includes ------------------------------------------------------------------*/
+#include "mlc_reference.h" // Module header
+#include <cmath>
+#include <cfloat>
+#include <cstddef>
+
+/* Private defines -----------------------------------------------------------*/
+/* Private typedef -----------------------------------------------------------*/
+/* Private variables----------------------------------------------------------*/
+/* Private function prototypes -----------------------------------------------*/
+static float input_value(uint8_t input, const float *acc, const float *gyr);
+
+/* Functions -----------------------------------------------------------------*/
+
+/**
+  * @brief Class constructor.
+  *
+  * @param[in] features Features to compute, in the order of the sensor configuration. The array is not copied.
+  * @param[in] features_len Number of features.
+  * @param[in] window Samples per window, as configured in the sensor.
+  */
+MLC_Reference::MLC_Reference(const mlc_feature_conf *features, int features_len, int window){
+  this->features = features;
+  this->features_len = features_len;
+  this->window = window > 0 ? window : 1;
+  states = new feature_state[features_len];
+  values = new float[features_len];
+  for(int i = 0; i < features_len; i++)
+    values[i] = NAN;
+  reset_window();
+}
+
+
+/**
+  * @brief Adds a sample to the current window.
+  *
+  * @param[in] acc Accelerometer x, y and z in g.
+  * @param[in] gyr Gyroscope x, y and z in dps. May be NULL if no feature uses it.
+  *
+  * @return 1 if the window has been completed and the features are updated, 0 otherwise.
+  */
+int MLC_Reference::push(const float *acc, const float *gyr){
+  for(int i = 0; i < features_len; i++){
+    feature_state *state = &states[i];
+    float th = features[i].threshold;
+    float v = input_value(features[i].input, acc, gyr);
+
+    state->sum += v;
+    state->sum_sq += v * v;
+    if(v < state->min)
+      state->min = v;
+    if(v > state->max)
+      state->max = v;
+
+    if(samples > 0){
+      if(state->prev < th && v >= th)
+        state->pos_crossings++;
+      else if(state->prev >= th && v < th)
+        state->neg_crossings++;
+    }
+
+    //The previous sample is a peak if it stands over both neighbours and the threshold
+    if(samples > 1){
+      if(state->prev > state->prev2 && state->prev > v && state->prev > th)
+        state->pos_peaks++;
+      else if(state->prev < state->prev2 && state->prev < v && state->prev < -th)
+        state->neg_peaks++;
+    }
+
+    state->prev2 = state->prev;
+    state->prev = v;
+  }
+
+  samples++;
+  if(samples < window)
+    return 0;
+
+  for(int i = 0; i < features_len; i++){
+    feature_state *state = &states[i];
+    float mean = state->sum / window;
+
+    switch(features[i].feature){
+      case MLC_FEATURE_MEAN:              values[i] = mean; break;
+      case MLC_FEATURE_VARIANCE:          values[i] = state->sum_sq / window - mean * mean; break;
+      case MLC_FEATURE_ENERGY:            values[i] = state->sum_sq; break;
+      case MLC_FEATURE_PEAK_TO_PEAK:      values[i] = state->max - state->min; break;
+      case MLC_FEATURE_ZERO_CROSSING:     values[i] = state->pos_crossings + state->neg_crossings; break;
+      case MLC_FEATURE_POS_ZERO_CROSSING: values[i] = state->pos_crossings; break;
+      case MLC_FEATURE_NEG_ZERO_CROSSING: values[i] = state->neg_crossings; break;
+      case MLC_FEATURE_PEAK_DETECTOR:     values[i] = state->pos_peaks + state->neg_peaks; break;
+      case MLC_FEATURE_POS_PEAK_DETECTOR: values[i] = state->pos_peaks; break;
+      case MLC_FEATURE_NEG_PEAK_DETECTOR: values[i] = state->neg_peaks; break;
+      case MLC_FEATURE_MINIMUM:           values[i] = state->min; break;
+      case MLC_FEATURE_MAXIMUM:           values[i] = state->max; break;
+      default:                            values[i] = NAN; break;
+    }
+  }
+
+  reset_window();
+  return 1;
+}
+
+
+/**
+  * @brief Gets the features of the last completed window.
+  *
+  * @param[out] feature_values Array of `features_len` values.
+  *
+  * @return 0 if success, -1 if no window has been completed yet.
+  */
+int MLC_Reference::get_features(float *feature_values){
+  if(features_len > 0 && std::isnan(values[0]))
+    return -1;
+
+  for(int i = 0; i < features_len; i++)
+    feature_values[i] = values[i];
+  return 0;
+}
+
+
+/**
+  * @brief Evaluates a decision tree over a set of feature values.
+  *
+  * @param[in] nodes Tree nodes, the root is the first one.
+  * @param[in] nodes_len Number of nodes.
+  * @param[in] feature_values Feature values, as given by get_features().
+  *
+  * @return The class of the reached leaf if success, -1 if the tree is malformed.
+  */
+int MLC_Reference::evaluate_tree(const mlc_tree_node *nodes, int nodes_len, const float *feature_values){
+  int node = 0;
+
+  //A well formed tree reaches a leaf in less steps than nodes
+  for(int steps = 0; steps < nodes_len; steps++){
+    if(node >= nodes_len)
+      return -1;
+    if(nodes[node].feature < 0)
+      return nodes[node].leaf_class;
+
+    if(feature_values[nodes[node].feature] <= nodes[node].threshold)
+      node = nodes[node].left;
+    else
+      node = nodes[node].right;
+  }
+
+  return -1;
+}
+
+
+/**
+  * @brief Free all the related resources.
+  */
+MLC_Reference::~MLC_Reference(){
+  delete[] states;
+  delete[] values;
+}
+
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief Clears the accumulators for a new window.
+  */
+void MLC_Reference::reset_window(){
+  samples = 0;
+  for(int i = 0; i < features_len; i++){
+    states[i].sum = states[i].sum_sq = 0;
+    states[i].min = FLT_MAX;
+    states[i].max = -FLT_MAX;
+    states[i].prev = states[i].prev2 = 0;
+    states[i].pos_crossings = states[i].neg_crossings = 0;
+    states[i].pos_peaks = states[i].neg_peaks = 0;
+  }
+}
+
+
+/**
+  * @brief Computes the value of an MLC input from a sample.
+  *
+  * @param[in] input MLC_INPUT_* value.
+  * @param[in] acc Accelerometer x, y and z.
+  * @param[in] gyr Gyroscope x, y and z, or NULL.
+  *
+  * @return The input value, 0 if it is not available.
+  */
+static float input_value(uint8_t input, const float *acc, const float *gyr){
+  const float *axes = input < MLC_INPUT_GYR_X ? acc : gyr;
+  uint8_t base = input < MLC_INPUT_GYR_X ? MLC_INPUT_ACC_X : MLC_INPUT_GYR_X;
+
+  if(axes == NULL || input > MLC_INPUT_GYR_V2)
+    return 0;
+
+  float v2 = axes[0] * axes[0] + axes[1] * axes[1] + axes[2] * axes[2];
+  switch(input - base){
+    case 0:
+    case 1:
+    case 2:
+      return axes[input - base];
+    case 3:
+      return std::sqrt(v2);
+    default:
+      return v2;
+  }
+}
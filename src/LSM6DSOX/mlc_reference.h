@@ -0,0 +1,144 @@
+/**
+  ******************************************************************************
+  * @file   mlc_reference.h
+  * @brief  LSM6DSOX Machine Learning Core Reference Model header.
+  *
+  * @note   End-of-degree work.
+  *         Host implementation of the windowed features and decision trees
+  *         computed by the LSM6DSOX Machine Learning Core, to verify the
+  *         classes given by the sensor against the same samples read from the
+  *         FIFO or recorded offline.
+  *         It is an offline reference model: the application does not use
+  *         it, tools/mlc_check.cpp exercises it on the host.
+  ******************************************************************************
+*/
+
+#ifndef __MLC_REFERENCE_H__
+#define __MLC_REFERENCE_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* Exported types ------------------------------------------------------------*/
+
+typedef struct{
+
+  uint8_t input;        //MLC_INPUT_*
+  uint8_t feature;      //MLC_FEATURE_*
+  float threshold;      //Zero crossing and peak detector threshold
+
+}mlc_feature_conf;
+
+typedef struct{
+
+  int8_t feature;       //Feature index compared by the node, -1 for a leaf
+  float threshold;      //feature <= threshold goes to `left`, otherwise `right`
+  uint8_t left, right;  //Child nodes
+  uint8_t leaf_class;   //Class given by a leaf
+
+}mlc_tree_node;
+
+/* Exported constants --------------------------------------------------------*/
+#define MLC_INPUT_ACC_X   0
+#define MLC_INPUT_ACC_Y   1
+#define MLC_INPUT_ACC_Z   2
+#define MLC_INPUT_ACC_V   3   //Norm
+#define MLC_INPUT_ACC_V2  4   //Squared norm
+#define MLC_INPUT_GYR_X   5
+#define MLC_INPUT_GYR_Y   6
+#define MLC_INPUT_GYR_Z   7
+#define MLC_INPUT_GYR_V   8
+#define MLC_INPUT_GYR_V2  9
+
+#define MLC_FEATURE_MEAN              0
+#define MLC_FEATURE_VARIANCE          1
+#define MLC_FEATURE_ENERGY            2
+#define MLC_FEATURE_PEAK_TO_PEAK      3
+#define MLC_FEATURE_ZERO_CROSSING     4
+#define MLC_FEATURE_POS_ZERO_CROSSING 5
+#define MLC_FEATURE_NEG_ZERO_CROSSING 6
+#define MLC_FEATURE_PEAK_DETECTOR     7
+#define MLC_FEATURE_POS_PEAK_DETECTOR 8
+#define MLC_FEATURE_NEG_PEAK_DETECTOR 9
+#define MLC_FEATURE_MINIMUM           10
+#define MLC_FEATURE_MAXIMUM           11
+
+/* Exported macro ------------------------------------------------------------*/
+/* Exported Functions --------------------------------------------------------*/
+
+class MLC_Reference{
+  struct feature_state{
+    float sum, sum_sq;
+    float min, max;
+    float prev, prev2;
+    uint16_t pos_crossings, neg_crossings;
+    uint16_t pos_peaks, neg_peaks;
+  };
+
+  const mlc_feature_conf *features;
+  int features_len;
+  int window;
+  int samples;
+  feature_state *states;
+  float *values;
+
+  void reset_window();
+
+  //Owns the feature buffers, copies would free them twice
+  MLC_Reference(const MLC_Reference&) = delete;
+  MLC_Reference& operator=(const MLC_Reference&) = delete;
+public:
+
+  /**
+    * @brief Class constructor.
+    *
+    * @param[in] features Features to compute, in the order of the sensor configuration. The array is not copied.
+    * @param[in] features_len Number of features.
+    * @param[in] window Samples per window, as configured in the sensor.
+    */
+  MLC_Reference(const mlc_feature_conf *features, int features_len, int window);
+
+  /**
+    * @brief Adds a sample to the current window.
+    *
+    * @param[in] acc Accelerometer x, y and z in g.
+    * @param[in] gyr Gyroscope x, y and z in dps. May be NULL if no feature uses it.
+    *
+    * @return 1 if the window has been completed and the features are updated, 0 otherwise.
+    */
+  int push(const float *acc, const float *gyr);
+
+  /**
+    * @brief Gets the features of the last completed window.
+    *
+    * @param[out] feature_values Array of `features_len` values.
+    *
+    * @return 0 if success, -1 if no window has been completed yet.
+    */
+  int get_features(float *feature_values);
+
+  /**
+    * @brief Evaluates a decision tree over a set of feature values.
+    *
+    * @param[in] nodes Tree nodes, the root is the first one.
+    * @param[in] nodes_len Number of nodes.
+    * @param[in] feature_values Feature values, as given by get_features().
+    *
+    * @return The class of the reached leaf if success, -1 if the tree is malformed.
+    */
+  static int evaluate_tree(const mlc_tree_node *nodes, int nodes_len, const float *feature_values);
+
+  /**
+    * @brief Free all the related resources.
+    */
+  ~MLC_Reference();
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MLC_REFERENCE_H__ */
@@ -0,0 +1,178 @@
+/**
+  ******************************************************************************
+  * @file   MotionCodec.cpp
+  * @brief  Compressed Motion Stream Codec.
+  *
+  * @note   End-of-degree work.
+  *         This module packs raw IMU triplets into self-contained blocks with
+  *         zig-zag delta varints. The layout is described in the header.
+  ******************************************************************************
+*/
+/* Includes ------------------------------------------------------------------*/
+#include "MotionCodec.h" // Module header
+#include <cstring>
+
+/* Private defines -----------------------------------------------------------*/
+#define MAGIC_0     'M'
+#define MAGIC_1     'B'
+#define VERSION     1
+
+#define CRC_INIT    0xFFFF
+#define CRC_POLY    0x1021
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private variables----------------------------------------------------------*/
+/* Private function prototypes -----------------------------------------------*/
+static void put_le(uint8_t *out, uint64_t value, int len);
+static uint64_t get_le(const uint8_t *in, int len);
+static uint16_t crc16(const uint8_t *data, int len);
+
+/* Functions -----------------------------------------------------------------*/
+
+/**
+ * @brief Encodes raw triplets in one block. Does not allocate.
+ *
+ * @param[in] info Block parameters. `samples` is ignored, `count` is used.
+ * @param[in] raw Interleaved x, y, z raw codes, 3 * `count` values.
+ * @param[in] count Number of triplets, up to MOTION_BLOCK_MAX_SAMPLES.
+ * @param[out] out Output buffer.
+ * @param[in] out_len Size of `out`. MOTION_BLOCK_MAX_LEN(count) always fits.
+ *
+ * @return The block length if success, -1 if error.
+ */
+int MotionCodec::encode_block(const motion_block_info *info, const int16_t *raw, int count, uint8_t *out, int out_len){
+  int32_t prev[3] = {0, 0, 0};
+  uint32_t lsb_bits;
+  int pos = MOTION_BLOCK_HEADER_LEN;
+
+  if(count < 0 || count > MOTION_BLOCK_MAX_SAMPLES || out_len < MOTION_BLOCK_HEADER_LEN + MOTION_BLOCK_CRC_LEN)
+    return -1;
+
+  //Only the worst case needs the per byte bound check
+  bool checked = out_len < MOTION_BLOCK_MAX_LEN(count);
+
+  for(int i = 0; i < 3 * count; i++){
+    int32_t delta = raw[i] - prev[i % 3];
+    uint32_t zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+    prev[i % 3] = raw[i];
+
+    do{
+      if(checked && pos >= out_len - MOTION_BLOCK_CRC_LEN)
+        return -1;
+      out[pos++] = (zigzag & 0x7F) | (zigzag > 0x7F ? 0x80 : 0);
+      zigzag >>= 7;
+    }while(zigzag != 0);
+  }
+
+  std::memcpy(&lsb_bits, &info->lsb, sizeof(lsb_bits));
+  out[0] = MAGIC_0;
+  out[1] = MAGIC_1;
+  out[2] = VERSION;
+  out[3] = info->type;
+  put_le(&out[4], count, 2);
+  put_le(&out[6], info->t0_us, 8);
+  put_le(&out[14], info->period_us, 4);
+  put_le(&out[18], lsb_bits, 4);
+  put_le(&out[22], pos - MOTION_BLOCK_HEADER_LEN, 2);
+  put_le(&out[pos], crc16(out, pos), MOTION_BLOCK_CRC_LEN);
+
+  return pos + MOTION_BLOCK_CRC_LEN;
+}
+
+
+/**
+ * @brief Decodes one block and checks its CRC.
+ *
+ * @param[in] in Input buffer, starting at a block.
+ * @param[in] in_len Bytes available in `in`.
+ * @param[out] info Block parameters.
+ * @param[out] raw Interleaved x, y, z raw codes.
+ * @param[in] raw_capacity Triplets `raw` can hold.
+ *
+ * @return The block length if success, 0 if `in` does not hold a whole block
+ *         yet, -1 if the block is corrupted or does not fit in `raw`.
+ */
+int MotionCodec::decode_block(const uint8_t *in, int in_len, motion_block_info *info, int16_t *raw, int raw_capacity){
+  int32_t prev[3] = {0, 0, 0};
+  uint32_t lsb_bits;
+
+  if(in_len < MOTION_BLOCK_HEADER_LEN)
+    return 0;
+  if(in[0] != MAGIC_0 || in[1] != MAGIC_1 || in[2] != VERSION)
+    return -1;
+
+  int payload_len = get_le(&in[22], 2);
+  int block_len = MOTION_BLOCK_HEADER_LEN + payload_len + MOTION_BLOCK_CRC_LEN;
+  if(in_len < block_len)
+    return 0;
+  if(get_le(&in[block_len - MOTION_BLOCK_CRC_LEN], MOTION_BLOCK_CRC_LEN) != crc16(in, block_len - MOTION_BLOCK_CRC_LEN))
+    return -1;
+
+  info->type = in[3];
+  info->samples = get_le(&in[4], 2);
+  info->t0_us = get_le(&in[6], 8);
+  info->period_us = get_le(&in[14], 4);
+  lsb_bits = get_le(&in[18], 4);
+  std::memcpy(&info->lsb, &lsb_bits, sizeof(lsb_bits));
+
+  if(info->samples > raw_capacity)
+    return -1;
+
+  int pos = MOTION_BLOCK_HEADER_LEN;
+  int end = MOTION_BLOCK_HEADER_LEN + payload_len;
+  for(int i = 0; i < 3 * info->samples; i++){
+    uint32_t zigzag = 0;
+    int shift = 0;
+
+    do{
+      if(pos >= end || shift > 7 * (MOTION_MAX_VARINT_LEN - 1))
+        return -1;
+      zigzag |= (uint32_t)(in[pos] & 0x7F) << shift;
+      shift += 7;
+    }while(in[pos++] & 0x80);
+
+    int32_t delta = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+    prev[i % 3] += delta;
+    raw[i] = prev[i % 3];
+  }
+
+  return pos == end ? block_len : -1;
+}
+
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+ * @brief Stores `len` bytes of `value`, least significant first.
+ */
+static void put_le(uint8_t *out, uint64_t value, int len){
+  for(int i = 0; i < len; i++)
+    out[i] = value >> (8 * i);
+}
+
+
+/**
+ * @brief Loads `len` bytes, least significant first.
+ */
+static uint64_t get_le(const uint8_t *in, int len){
+  uint64_t value = 0;
+
+  for(int i = len - 1; i >= 0; i--)
+    value = value << 8 | in[i];
+  return value;
+}
+
+
+/**
+ * @brief CRC-16/CCITT-FALSE: polynomial 0x1021, initial value 0xFFFF.
+ */
+static uint16_t crc16(const uint8_t *data, int len){
+  uint16_t crc = CRC_INIT;
+
+  for(int i = 0; i < len; i++){
+    crc ^= (uint16_t)data[i] << 8;
+    for(int b = 0; b < 8; b++)
+      crc = (crc & 0x8000) ? (crc << 1) ^ CRC_POLY : crc << 1;
+  }
+  return crc;
+}
@@ -0,0 +1,99 @@
+/**
+  ******************************************************************************
+  * @file   MotionCodec.h
+  * @brief  Compressed Motion Stream Codec Header.
+  *
+  * @note   End-of-degree work.
+  *         This module packs raw IMU triplets into self-contained blocks: a
+  *         header with the timestamp base, the sample period and the
+  *         sensitivity, the samples as zig-zag deltas in varints, and a CRC.
+  *         Slow motion takes 3 to 4 bytes per triplet instead of 6 raw bytes
+  *         or about 40 bytes of JSON.
+  *
+  *         Block layout, little endian:
+  *           0  magic "MB"            2 bytes
+  *           2  version               1 byte
+  *           3  type                  1 byte (LSM6DSOX_SAMPLE_ACC or _GYR)
+  *           4  samples               2 bytes
+  *           6  t0, us                8 bytes
+  *           14 period, us            4 bytes
+  *           18 lsb, units per code   4 bytes (IEEE 754 float)
+  *           22 payload length        2 bytes
+  *           24 payload               x, y, z deltas from the previous sample
+  *                                    (from 0 for the first), zig-zag varints
+  *           .. CRC-16/CCITT-FALSE    2 bytes, of everything before it
+  ******************************************************************************
+*/
+
+#ifndef __MOTIONCODEC_H__
+#define __MOTIONCODEC_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* Exported types ------------------------------------------------------------*/
+
+typedef struct{
+
+  uint8_t type;         //Stream type, LSM6DSOX_SAMPLE_* for the IMU
+  uint16_t samples;     //Triplets in the block
+  uint64_t t0_us;       //Time of the first sample
+  uint32_t period_us;   //Time between samples
+  float lsb;            //Physical units per raw code
+
+}motion_block_info;
+
+/* Exported constants --------------------------------------------------------*/
+#define MOTION_BLOCK_HEADER_LEN   24
+#define MOTION_BLOCK_CRC_LEN      2
+#define MOTION_BLOCK_MAX_SAMPLES  4096
+#define MOTION_MAX_VARINT_LEN     3     //A 16 bits zig-zag delta takes up to 17 bits
+
+/* Exported macro ------------------------------------------------------------*/
+
+/**
+ * @brief Worst case size of a block of `samples` triplets.
+ */
+#define MOTION_BLOCK_MAX_LEN(samples) \
+  (MOTION_BLOCK_HEADER_LEN + (samples) * 3 * MOTION_MAX_VARINT_LEN + MOTION_BLOCK_CRC_LEN)
+
+/* Exported Functions --------------------------------------------------------*/
+namespace MotionCodec{
+
+  /**
+   * @brief Encodes raw triplets in one block. Does not allocate.
+   *
+   * @param[in] info Block parameters. `samples` is ignored, `count` is used.
+   * @param[in] raw Interleaved x, y, z raw codes, 3 * `count` values.
+   * @param[in] count Number of triplets, up to MOTION_BLOCK_MAX_SAMPLES.
+   * @param[out] out Output buffer.
+   * @param[in] out_len Size of `out`. MOTION_BLOCK_MAX_LEN(count) always fits.
+   *
+   * @return The block length if success, -1 if error.
+   */
+  int encode_block(const motion_block_info *info, const int16_t *raw, int count, uint8_t *out, int out_len);
+
+  /**
+   * @brief Decodes one block and checks its CRC.
+   *
+   * @param[in] in Input buffer, starting at a block.
+   * @param[in] in_len Bytes available in `in`.
+   * @param[out] info Block parameters.
+   * @param[out] raw Interleaved x, y, z raw codes.
+   * @param[in] raw_capacity Triplets `raw` can hold.
+   *
+   * @return The block length if success, 0 if `in` does not hold a whole block
+   *         yet, -1 if the block is corrupted or does not fit in `raw`.
+   */
+  int decode_block(const uint8_t *in, int in_len, motion_block_info *info, int16_t *raw, int raw_capacity);
+
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MOTIONCODEC_H__ */
@@ -0,0 +1,200 @@
+/**
+  ******************************************************************************
+  * @file   OccupancyEngine.cpp
+  * @brief  Cabin Occupancy Counting Engine.
+  *
+  * @note   End-of-degree work.
+  *         This module keeps the number of people in the cabin from the
+  *         events of several door sensors.
+  ******************************************************************************
+*/
+/* Includes ------------------------------------------------------------------*/
+#include "OccupancyEngine.h" // Module header
+#include <cstring>
+
+/* Private defines -----------------------------------------------------------*/
+#define DIR_IN  0
+#define DIR_OUT 1
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private variables----------------------------------------------------------*/
+/* Private function prototypes -----------------------------------------------*/
+static int64_t elapsed(uint64_t from, uint64_t to);
+/* Functions -----------------------------------------------------------------*/
+
+/**
+  * @brief Class constructor. The cabin starts empty.
+  *
+  * @param[in] max_occupation Count at which the cabin is full.
+  */
+OccupancyEngine::OccupancyEngine(int max_occupation){
+  this->max_occupation = max_occupation;
+  count = 0;
+  confidence = 1;
+  std::memset(&stats, 0, sizeof(stats));
+
+  for(int i = 0; i < OCC_MAX_SENSORS; i++){
+    sensor_near[i] = false;
+    sensor_near_ms[i] = 0;
+  }
+  for(int i = 0; i < OCC_MAX_DOORS; i++){
+    for(int dir = 0; dir < 2; dir++){
+      passage_valid[i][dir] = false;
+      passage_ms[i][dir] = 0;
+      passage_sensor[i][dir] = 0;
+    }
+  }
+
+  door_known = false;
+  door_open = false;
+  door_closed_ms = 0;
+  last_activity_ms = 0;
+}
+
+
+/**
+  * @brief Processes an event.
+  *
+  * @param[in] event The event.
+  *
+  * @return The change of the count: 1, -1 or 0.
+  */
+int OccupancyEngine::push(const occupancy_event *event){
+  if(event->sensor >= OCC_MAX_SENSORS || event->door >= OCC_MAX_DOORS)
+    return 0;
+
+  if(elapsed(last_activity_ms, event->time_ms) > 0)
+    last_activity_ms = event->time_ms;
+
+  switch(event->type){
+  case OCC_EVENT_ENTRY:
+  case OCC_EVENT_EXIT:
+    return passage(event);
+
+  case OCC_EVENT_NEAR:
+    sensor_near[event->sensor] = true;
+    sensor_near_ms[event->sensor] = event->time_ms;
+    return 0;
+
+  case OCC_EVENT_FAR:
+    sensor_near[event->sensor] = false;
+    return 0;
+
+  case OCC_EVENT_DOOR_OPEN:
+    door_known = true;
+    door_open = true;
+    return 0;
+
+  case OCC_EVENT_DOOR_CLOSED:
+    door_known = true;
+    door_open = false;
+    door_closed_ms = event->time_ms;
+    return 0;
+  }
+
+  return 0;
+}
+
+
+/**
+  * @brief Periodic drift correction. A count of up to OCC_DRIFT_MAX with
+  *        nobody near any sensor and no events for OCC_QUIET_MS is taken as
+  *        unmatched passages and the cabin is set empty.
+  *
+  * @param[in] now_ms Steady clock time.
+  *
+  * @return 1 if the count has been corrected, 0 otherwise.
+  */
+int OccupancyEngine::tick(uint64_t now_ms){
+  if(count == 0 || count > OCC_DRIFT_MAX || elapsed(last_activity_ms, now_ms) < OCC_QUIET_MS)
+    return 0;
+
+  for(int i = 0; i < OCC_MAX_SENSORS; i++){
+    if(sensor_near[i])
+      return 0;
+  }
+
+  count = 0;
+  confidence = 1;
+  stats.corrections++;
+  return 1;
+}
+
+
+/**
+  * @brief Sets the count, e.g. after a manual check. Its confidence becomes 1.
+  */
+void OccupancyEngine::set_count(int count){
+  if(count < 0)
+    count = 0;
+  if(count > max_occupation)
+    count = max_occupation;
+  this->count = count;
+  confidence = 1;
+}
+
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief Weighs, deduplicates and counts a passage.
+  *
+  * @return The change of the count: 1, -1 or 0.
+  */
+int OccupancyEngine::passage(const occupancy_event *event){
+  int dir = event->type == OCC_EVENT_ENTRY ? DIR_IN : DIR_OUT;
+  uint64_t now = event->time_ms;
+
+  //One person reported by both sensors of the door. Passages from the same
+  //sensor are distinct people, the classifier already splits close passes
+  if(passage_valid[event->door][dir] && passage_sensor[event->door][dir] != event->sensor &&
+     elapsed(passage_ms[event->door][dir], now) < OCC_SAME_DOOR_MS){
+    stats.duplicates++;
+    return 0;
+  }
+
+  float event_conf = event->confidence;
+
+  //Someone standing at the sensor backs the passage
+  bool near_seen = sensor_near_ms[event->sensor] != 0; //0 until the first NEAR
+  if(sensor_near[event->sensor] || (near_seen && elapsed(sensor_near_ms[event->sensor], now) < OCC_PROXIMITY_MS))
+    event_conf = 1 - (1 - event_conf) * 0.5f;
+
+  //Nobody goes through a door that has been closed for a while
+  if(door_known && !door_open && elapsed(door_closed_ms, now) > OCC_DOOR_GRACE_MS)
+    event_conf *= OCC_CLOSED_FACTOR;
+
+  if(event_conf < OCC_MIN_CONFIDENCE){
+    stats.rejected++;
+    return 0;
+  }
+
+  passage_valid[event->door][dir] = true;
+  passage_ms[event->door][dir] = now;
+  passage_sensor[event->door][dir] = event->sensor;
+
+  //A passage beyond an empty or full cabin means an earlier one was missed
+  if((dir == DIR_IN && count >= max_occupation) || (dir == DIR_OUT && count <= 0)){
+    stats.clamped++;
+    confidence *= 0.5f;
+    return 0;
+  }
+
+  confidence += OCC_COUNT_ALPHA * (event_conf - confidence);
+  if(dir == DIR_IN){
+    count++;
+    stats.entries++;
+    return 1;
+  }
+  count--;
+  stats.exits++;
+  return -1;
+}
+
+
+/**
+  * @brief Time from `from` to `to` in ms, negative if `to` is earlier.
+  */
+static int64_t elapsed(uint64_t from, uint64_t to){
+  return (int64_t)(to - from);
+}
@@ -0,0 +1,149 @@
+/**
+  ******************************************************************************
+  * @file   OccupancyEngine.h
+  * @brief  Cabin Occupancy Counting Engine Header.
+  *
+  * @note   End-of-degree work.
+  *         This module keeps the number of people in the cabin from the
+  *         events of several door sensors: passages classified from the
+  *         gesture engines, proximity crossings and, when available, the
+  *         door opening and closing seen by the accelerometer. Every passage
+  *         carries a confidence, which is raised or lowered by the other
+  *         events, and the count keeps a confidence of its own.
+  ******************************************************************************
+*/
+
+#ifndef __OCCUPANCYENGINE_H__
+#define __OCCUPANCYENGINE_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* Exported types ------------------------------------------------------------*/
+
+typedef struct{
+
+  uint8_t type;         //One of the OCC_EVENT_* values
+  uint8_t sensor;       //Sensor that saw it, up to OCC_MAX_SENSORS - 1
+  uint8_t door;         //Door the sensor watches, up to OCC_MAX_DOORS - 1
+  float confidence;     //0 to 1, only used by passages
+  uint64_t time_ms;     //Steady clock time of the event
+
+}occupancy_event;
+
+typedef struct{
+
+  uint32_t entries;     //Passages counted in
+  uint32_t exits;       //Passages counted out
+  uint32_t duplicates;  //Passages already counted by another report
+  uint32_t rejected;    //Passages under the minimum confidence
+  uint32_t clamped;     //Passages beyond an empty or full cabin
+  uint32_t corrections; //Drift corrections
+
+}occupancy_stats;
+
+/* Exported constants --------------------------------------------------------*/
+#define OCC_EVENT_ENTRY         0
+#define OCC_EVENT_EXIT          1
+#define OCC_EVENT_NEAR          2
+#define OCC_EVENT_FAR           3
+#define OCC_EVENT_DOOR_OPEN     4
+#define OCC_EVENT_DOOR_CLOSED   5
+
+#define OCC_MAX_SENSORS         8
+#define OCC_MAX_DOORS           4
+
+#define OCC_MIN_CONFIDENCE      0.15f //Weaker passages are not counted
+#define OCC_SAME_DOOR_MS        500   //Two sensors of a door seeing one person
+#define OCC_PROXIMITY_MS        1500  //A NEAR this recent backs a passage
+#define OCC_DOOR_GRACE_MS       2000  //Passages this long after closing still count fully
+#define OCC_CLOSED_FACTOR       0.5f  //Confidence kept by passages with the door closed
+#define OCC_COUNT_ALPHA         0.2f  //Weight of a passage in the count confidence
+#define OCC_QUIET_MS            600000 //Quiet time after which a low count is drift
+#define OCC_DRIFT_MAX           2     //Largest count taken as drift
+
+/* Exported macro ------------------------------------------------------------*/
+/* Exported Functions --------------------------------------------------------*/
+
+class OccupancyEngine{
+  int max_occupation;
+  int count;
+  float confidence;
+  occupancy_stats stats;
+
+  bool sensor_near[OCC_MAX_SENSORS];
+  uint64_t sensor_near_ms[OCC_MAX_SENSORS];
+
+  //Last counted passage of each door and direction
+  bool passage_valid[OCC_MAX_DOORS][2];
+  uint64_t passage_ms[OCC_MAX_DOORS][2];
+  uint8_t passage_sensor[OCC_MAX_DOORS][2];
+
+  bool door_known;
+  bool door_open;
+  uint64_t door_closed_ms;
+
+  uint64_t last_activity_ms;
+
+  int passage(const occupancy_event *event);
+public:
+
+  /**
+    * @brief Class constructor. The cabin starts empty.
+    *
+    * @param[in] max_occupation Count at which the cabin is full.
+    */
+  OccupancyEngine(int max_occupation);
+
+  /**
+    * @brief Processes an event. Events from different threads may arrive
+    *        slightly out of order, times are compared as signed differences.
+    *
+    *        A passage is dropped if another sensor of the same door counted
+    *        one in the same direction within OCC_SAME_DOOR_MS. Its confidence
+    *        is raised when its sensor saw someone near within
+    *        OCC_PROXIMITY_MS, and lowered by OCC_CLOSED_FACTOR when door events
+    *        are available and the door is closed. It is counted if it stays
+    *        over OCC_MIN_CONFIDENCE.
+    *
+    * @param[in] event The event.
+    *
+    * @return The change of the count: 1, -1 or 0.
+    */
+  int push(const occupancy_event *event);
+
+  /**
+    * @brief Periodic drift correction. A count of up to OCC_DRIFT_MAX with
+    *        nobody near any sensor and no events for OCC_QUIET_MS is taken as
+    *        unmatched passages and the cabin is set empty.
+    *
+    * @param[in] now_ms Steady clock time.
+    *
+    * @return 1 if the count has been corrected, 0 otherwise.
+    */
+  int tick(uint64_t now_ms);
+
+  /**
+    * @brief Sets the count, e.g. after a manual check. Its confidence becomes 1.
+    */
+  void set_count(int count);
+
+  int get_count() { return count; };
+
+  /**
+    * @brief Confidence in the count, from 0 to 1. It follows the confidence
+    *        of the counted passages and halves on every clamped passage.
+    */
+  float get_confidence() { return confidence; };
+
+  void get_stats(occupancy_stats *stats) { *stats = this->stats; };
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __OCCUPANCYENGINE_H__ */
@@ -0,0 +1,281 @@
+/**
+  ******************************************************************************
+  * @file   VibrationAnalyzer.cpp
+  * @brief  Streaming Vibration Spectrum Analyzer.
+  *
+  * @note   End-of-degree work.
+  *         This module computes the spectrum of an accelerometer stream with a
+  *         windowed, overlapped real FFT and extracts the band RMS values and
+  *         the dominant peak.
+  ******************************************************************************
+*/
+/* Includes ------------------------------------------------------------------*/
+#include "VibrationAnalyzer.h" // Module header
+#include <cmath>
+#include <cstring>
+
+/* Private defines -----------------------------------------------------------*/
+#define MIN_FFT_LEN 16
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private variables----------------------------------------------------------*/
+/* Private function prototypes -----------------------------------------------*/
+/* Functions -----------------------------------------------------------------*/
+
+/**
+  * @brief Class constructor. All the buffers are allocated here.
+  *
+  * @param[in] fft_len Samples per frame, a power of two from 16 to VIBRATION_MAX_FFT_LEN.
+  * @param[in] hop Samples between frames. fft_len / 2 gives 50% overlap.
+  * @param[in] sample_rate Sample rate of the input, in Hz.
+  * @param[in] band_edges Frequencies in Hz delimiting the bands, `bands + 1` increasing values.
+  * @param[in] bands Number of bands, up to VIBRATION_MAX_BANDS.
+  */
+VibrationAnalyzer::VibrationAnalyzer(int fft_len, int hop, float sample_rate, const float *band_edges, int bands){
+  int bits = 0;
+
+  //Round down to a supported power of two
+  this->fft_len = MIN_FFT_LEN;
+  while(this->fft_len * 2 <= fft_len && this->fft_len < VIBRATION_MAX_FFT_LEN)
+    this->fft_len *= 2;
+  fft_len = this->fft_len;
+  half_len = fft_len / 2;
+  while((1 << bits) < half_len)
+    bits++;
+
+  this->hop = (hop < 1 || hop > fft_len) ? fft_len : hop;
+  this->sample_rate = sample_rate;
+
+  history = new float[fft_len]();
+  frame = new float[fft_len];
+  window = new float[fft_len];
+  re = new float[half_len];
+  im = new float[half_len];
+  tw_re = new float[half_len];
+  tw_im = new float[half_len];
+  rf_re = new float[half_len + 1];
+  rf_im = new float[half_len + 1];
+  bit_rev = new uint16_t[half_len];
+  power = new float[half_len + 1]();
+
+  //Hann window
+  window_sum = window_power = 0;
+  for(int n = 0; n < fft_len; n++){
+    window[n] = 0.5f - 0.5f * std::cos(2.0 * M_PI * n / fft_len);
+    window_sum += window[n];
+    window_power += window[n] * window[n];
+  }
+
+  for(int k = 0; k < half_len; k++){
+    uint16_t r = 0;
+    for(int b = 0; b < bits; b++)
+      if(k & (1 << b))
+        r |= 1 << (bits - 1 - b);
+    bit_rev[k] = r;
+  }
+
+  //The stage with butterflies `h` apart uses h twiddles stored from index h - 1
+  for(int h = 1; h < half_len; h *= 2){
+    for(int j = 0; j < h; j++){
+      tw_re[h - 1 + j] = std::cos(M_PI * j / h);
+      tw_im[h - 1 + j] = -std::sin(M_PI * j / h);
+    }
+  }
+
+  for(int k = 0; k <= half_len; k++){
+    rf_re[k] = std::cos(2.0 * M_PI * k / fft_len);
+    rf_im[k] = -std::sin(2.0 * M_PI * k / fft_len);
+  }
+
+  if(bands < 0)
+    bands = 0;
+  if(bands > VIBRATION_MAX_BANDS)
+    bands = VIBRATION_MAX_BANDS;
+  for(int b = 0; b < bands; b++){
+    float bin_hz = sample_rate / fft_len;
+    int start = (int)std::ceil(band_edges[b] / bin_hz);
+    int end = (int)std::ceil(band_edges[b + 1] / bin_hz);
+    band_start[b] = start < 1 ? 1 : (start > half_len + 1 ? half_len + 1 : start);
+    band_end[b] = end < band_start[b] ? band_start[b] : (end > half_len + 1 ? half_len + 1 : end);
+  }
+
+  std::memset(&features, 0, sizeof(features));
+  features.bands = bands;
+  history_index = history_count = hop_count = 0;
+}
+
+
+/**
+  * @brief Adds samples to the stream. A new spectrum is computed every `hop`
+  *        samples once the first frame is full.
+  *
+  * @param[in] samples Input samples.
+  * @param[in] samples_len Number of samples.
+  *
+  * @return The number of spectra computed.
+  */
+int VibrationAnalyzer::push(const float *samples, int samples_len){
+  int computed = 0;
+
+  for(int i = 0; i < samples_len; i++){
+    history[history_index] = samples[i];
+    history_index = (history_index + 1) & (fft_len - 1);
+    if(history_count < fft_len)
+      history_count++;
+    hop_count++;
+
+    if(history_count == fft_len && hop_count >= hop){
+      hop_count = 0;
+      compute();
+      computed++;
+    }
+  }
+
+  return computed;
+}
+
+
+/**
+  * @brief Gets the features of the last spectrum.
+  *
+  * @param[out] result Where the features will be stored.
+  *
+  * @return 0 if success, -1 if no spectrum has been computed yet.
+  */
+int VibrationAnalyzer::get_features(vibration_features *result){
+  if(features.frames == 0)
+    return -1;
+
+  *result = features;
+  return 0;
+}
+
+
+/**
+  * @brief Gets the power spectrum of the last frame.
+  *
+  * @param[out] bins Array of `fft_len / 2 + 1` values, in squared input units.
+  *
+  * @return 0 if success, -1 if no spectrum has been computed yet.
+  */
+int VibrationAnalyzer::get_spectrum(float *bins){
+  if(features.frames == 0)
+    return -1;
+
+  std::memcpy(bins, power, (half_len + 1) * sizeof(float));
+  return 0;
+}
+
+
+/**
+  * @brief Free all the related resources.
+  */
+VibrationAnalyzer::~VibrationAnalyzer(){
+  delete[] history;
+  delete[] frame;
+  delete[] window;
+  delete[] re;
+  delete[] im;
+  delete[] tw_re;
+  delete[] tw_im;
+  delete[] rf_re;
+  delete[] rf_im;
+  delete[] bit_rev;
+  delete[] power;
+}
+
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief Computes the spectrum and the features of the last fft_len samples.
+  *
+  *        The real frame is packed as a half length complex sequence (even
+  *        samples real, odd samples imaginary), transformed, and split back
+  *        into the one sided spectrum of the real signal.
+  */
+void VibrationAnalyzer::compute(){
+  int tail = fft_len - history_index;
+  float mean = 0;
+
+  std::memcpy(frame, history + history_index, tail * sizeof(float));
+  std::memcpy(frame + tail, history, history_index * sizeof(float));
+  for(int n = 0; n < fft_len; n++)
+    mean += frame[n];
+  mean /= fft_len;
+
+  //Remove the DC (gravity), apply the window and deinterleave
+  int k;
+  for(k = 0; k < half_len; k++){
+    re[k] = (frame[2 * k] - mean) * window[2 * k];
+    im[k] = (frame[2 * k + 1] - mean) * window[2 * k + 1];
+  }
+
+  fft();
+
+  //Split: X[k] = (Z[k] + conj(Z[M-k])) / 2 + W^k (Z[k] - conj(Z[M-k])) / 2i
+  float scale = 2.0f / (fft_len * window_power);
+  float total = 0;
+  int peak = 1;
+  for(k = 0; k <= half_len; k++){
+    int a = k == half_len ? 0 : k;
+    int b = k == 0 ? 0 : half_len - k;
+    float even_re = 0.5f * (re[a] + re[b]);
+    float even_im = 0.5f * (im[a] - im[b]);
+    float odd_re = 0.5f * (im[a] + im[b]);
+    float odd_im = -0.5f * (re[a] - re[b]);
+    float x_re = even_re + rf_re[k] * odd_re - rf_im[k] * odd_im;
+    float x_im = even_im + rf_re[k] * odd_im + rf_im[k] * odd_re;
+
+    power[k] = (x_re * x_re + x_im * x_im) * ((k == 0 || k == half_len) ? scale / 2 : scale);
+    if(k > 0){
+      total += power[k];
+      if(power[k] > power[peak])
+        peak = k;
+    }
+  }
+
+  features.rms = std::sqrt(total);
+  features.peak_freq = peak * sample_rate / fft_len;
+  //A sine of amplitude A gives |X| = A * window_sum / 2
+  features.peak_amplitude = 2.0f * std::sqrt(power[peak] / scale) / window_sum;
+  for(int b = 0; b < features.bands; b++){
+    float energy = 0;
+    for(int i = band_start[b]; i < band_end[b]; i++)
+      energy += power[i];
+    features.band_rms[b] = std::sqrt(energy);
+  }
+  features.frames++;
+}
+
+
+/**
+  * @brief In-place iterative radix-2 FFT of the half length complex buffers.
+  */
+void VibrationAnalyzer::fft(){
+  for(int k = 0; k < half_len; k++){
+    int r = bit_rev[k];
+    if(r > k){
+      float t = re[k]; re[k] = re[r]; re[r] = t;
+      t = im[k]; im[k] = im[r]; im[r] = t;
+    }
+  }
+
+  for(int h = 1; h < half_len; h *= 2){
+    const float *wr = tw_re + h - 1;
+    const float *wi = tw_im + h - 1;
+
+    for(int i = 0; i < half_len; i += 2 * h){
+      float *ur = re + i, *ui = im + i;
+      float *vr = re + i + h, *vi = im + i + h;
+      for(int j = 0; j < h; j++){
+        float t_re = vr[j] * wr[j] - vi[j] * wi[j];
+        float t_im = vr[j] * wi[j] + vi[j] * wr[j];
+        vr[j] = ur[j] - t_re;
+        vi[j] = ui[j] - t_im;
+        ur[j] += t_re;
+        ui[j] += t_im;
+      }
+    }
+  }
+}
@@ -0,0 +1,126 @@
+/**
+  ******************************************************************************
+  * @file   VibrationAnalyzer.h
+  * @brief  Streaming Vibration Spectrum Analyzer Header.
+  *
+  * @note   End-of-degree work.
+  *         This module computes the spectrum of an accelerometer stream with a
+  *         windowed, overlapped real FFT and extracts the band RMS values and
+  *         the dominant peak, to detect HVAC and mechanical faults from the
+  *         cabin vibration.
+  ******************************************************************************
+*/
+
+#ifndef __VIBRATIONANALYZER_H__
+#define __VIBRATIONANALYZER_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* Exported types ------------------------------------------------------------*/
+
+/* Exported constants --------------------------------------------------------*/
+#define VIBRATION_MAX_BANDS   8
+#define VIBRATION_MAX_FFT_LEN 4096
+
+typedef struct{
+
+  float rms;                          //Total RMS without the DC, in input units
+  float peak_freq;                    //Frequency of the highest bin, in Hz
+  float peak_amplitude;               //Amplitude of a sine at the peak frequency
+  float band_rms[VIBRATION_MAX_BANDS];
+  int bands;
+  uint32_t frames;                    //Spectra computed since the start
+
+}vibration_features;
+
+/* Exported macro ------------------------------------------------------------*/
+/* Exported Functions --------------------------------------------------------*/
+
+class VibrationAnalyzer{
+  int fft_len;
+  int half_len;
+  int hop;
+  float sample_rate;
+
+  //Everything is allocated once in the constructor
+  float *history;       //Last fft_len samples, circular
+  int history_index;
+  int history_count;
+  int hop_count;
+  float *window;
+  float window_sum;     //Coherent gain times fft_len
+  float window_power;   //Sum of the squared window coefficients
+  float *frame;         //Linearized frame
+  float *re, *im;       //Half length complex FFT work buffers
+  float *tw_re, *tw_im; //Half length FFT twiddles, contiguous per stage
+  float *rf_re, *rf_im; //Real FFT split twiddles
+  uint16_t *bit_rev;
+  float *power;         //One sided power spectrum, half_len + 1 bins
+
+  int band_start[VIBRATION_MAX_BANDS];
+  int band_end[VIBRATION_MAX_BANDS];
+  vibration_features features;
+
+  void compute();
+  void fft();
+
+  //Owns the frame and FFT buffers, copies would free them twice
+  VibrationAnalyzer(const VibrationAnalyzer&) = delete;
+  VibrationAnalyzer& operator=(const VibrationAnalyzer&) = delete;
+public:
+
+  /**
+    * @brief Class constructor. All the buffers are allocated here.
+    *
+    * @param[in] fft_len Samples per frame, a power of two from 16 to VIBRATION_MAX_FFT_LEN.
+    * @param[in] hop Samples between frames. fft_len / 2 gives 50% overlap.
+    * @param[in] sample_rate Sample rate of the input, in Hz.
+    * @param[in] band_edges Frequencies in Hz delimiting the bands, `bands + 1` increasing values.
+    * @param[in] bands Number of bands, up to VIBRATION_MAX_BANDS.
+    */
+  VibrationAnalyzer(int fft_len, int hop, float sample_rate, const float *band_edges, int bands);
+
+  /**
+    * @brief Adds samples to the stream. A new spectrum is computed every `hop`
+    *        samples once the first frame is full.
+    *
+    * @param[in] samples Input samples.
+    * @param[in] samples_len Number of samples.
+    *
+    * @return The number of spectra computed.
+    */
+  int push(const float *samples, int samples_len);
+
+  /**
+    * @brief Gets the features of the last spectrum.
+    *
+    * @param[out] result Where the features will be stored.
+    *
+    * @return 0 if success, -1 if no spectrum has been computed yet.
+    */
+  int get_features(vibration_features *result);
+
+  /**
+    * @brief Gets the power spectrum of the last frame.
+    *
+    * @param[out] bins Array of `fft_len / 2 + 1` values, in squared input units.
+    *
+    * @return 0 if success, -1 if no spectrum has been computed yet.
+    */
+  int get_spectrum(float *bins);
+
+  /**
+    * @brief Free all the related resources.
+    */
+  ~VibrationAnalyzer();
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VIBRATIONANALYZER_H__ */
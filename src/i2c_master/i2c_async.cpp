@@ -0,0 +1,304 @@
+/**
+  ******************************************************************************
+  * @file   i2c_async.cpp
+  * @brief  Asynchronous I2C Requests.
+  *
+  * @note   End-of-degree work.
+  *         Queues I2C transactions that are executed by a single bus worker
+  *         thread. The queue is a fixed ring, so the memory used does not
+  *         grow with the number of sensors or requests.
+  ******************************************************************************
+*/
+
+/* Includes ------------------------------------------------------------------*/
+#include "i2c_async.h" // Module header
+#include "i2c_master.h"
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstring>
+#include <system_error>
+
+/* Private typedef -----------------------------------------------------------*/
+struct async_request{
+  uint8_t addr;
+  uint8_t reg;
+  bool is_read;
+  uint8_t data_length;
+  uint8_t *data;
+  uint8_t write_data[I2C_ASYNC_MAX_WRITE];
+  int client;                     //Scheduler client of the submitting thread
+  i2c_async_callback callback;    //NULL when completed through the promise
+  void *arg;
+  std::promise<int> promise;
+};
+
+/* Private variables----------------------------------------------------------*/
+static std::mutex queue_mutex;
+static std::condition_variable queue_cv;
+static async_request queue[I2C_ASYNC_QUEUE_LEN];
+static int queue_head = 0;
+static int queue_len = 0;
+static int in_progress = 0;
+static bool running = false;
+static bool stopping = false;     //stop() is joining the worker
+static std::thread worker;
+
+/* Private function prototypes -----------------------------------------------*/
+static async_request *queue_slot(uint8_t addr, uint8_t data_length, bool is_read);
+static int start_worker();
+static void worker_loop();
+
+/* Functions -----------------------------------------------------------------*/
+
+/**
+ * @brief Starts the bus worker. The submit functions start it too when needed.
+ *
+ * @return 0 if success, -1 if error.
+ */
+int I2C_Async::start(){
+  std::lock_guard<std::mutex> lock(queue_mutex);
+  return start_worker();
+}
+
+
+/**
+ * @brief Queues a read of `data_length` bytes starting at register `read_reg`.
+ *        `data` must stay valid until the request completes.
+ *
+ * @return A future with the result of I2C_Master::read_msg(). It is already
+ *         -1 if the queue is full.
+ */
+std::future<int> I2C_Async::submit_read(uint8_t addr, uint8_t read_reg, uint8_t data[], uint8_t data_length){
+  std::promise<int> promise;
+  std::future<int> future = promise.get_future();
+
+  std::unique_lock<std::mutex> lock(queue_mutex);
+  async_request *request = queue_slot(addr, data_length, true);
+  if(request == NULL){
+    promise.set_value(-1);
+    return future;
+  }
+
+  request->reg = read_reg;
+  request->data = data;
+  request->promise = std::move(promise);
+  lock.unlock();
+  queue_cv.notify_one();
+
+  return future;
+}
+
+
+/**
+ * @brief Queues a read and calls `callback` from the worker when it completes.
+ *
+ * @return 0 if queued, -1 if the queue is full (the callback is not called).
+ */
+int I2C_Async::submit_read(uint8_t addr, uint8_t read_reg, uint8_t data[], uint8_t data_length,
+                           i2c_async_callback callback, void *arg){
+  std::unique_lock<std::mutex> lock(queue_mutex);
+  async_request *request = queue_slot(addr, data_length, true);
+  if(request == NULL)
+    return -1;
+
+  request->reg = read_reg;
+  request->data = data;
+  request->callback = callback;
+  request->arg = arg;
+  lock.unlock();
+  queue_cv.notify_one();
+
+  return 0;
+}
+
+
+/**
+ * @brief Queues a write. The data is copied, so the caller may reuse it at once.
+ *
+ * @return A future with the result of I2C_Master::write_msg(). It is already
+ *         -1 if the queue is full or the message is too long.
+ */
+std::future<int> I2C_Async::submit_write(uint8_t addr, const uint8_t data[], uint8_t data_length){
+  std::promise<int> promise;
+  std::future<int> future = promise.get_future();
+
+  std::unique_lock<std::mutex> lock(queue_mutex);
+  async_request *request = data_length <= I2C_ASYNC_MAX_WRITE ? queue_slot(addr, data_length, false) : NULL;
+  if(request == NULL){
+    promise.set_value(-1);
+    return future;
+  }
+
+  std::memcpy(request->write_data, data, data_length);
+  request->promise = std::move(promise);
+  lock.unlock();
+  queue_cv.notify_one();
+
+  return future;
+}
+
+
+/**
+ * @brief Queues a write and calls `callback` from the worker when it completes.
+ *
+ * @return 0 if queued, -1 if the queue is full or the message is too long.
+ */
+int I2C_Async::submit_write(uint8_t addr, const uint8_t data[], uint8_t data_length,
+                            i2c_async_callback callback, void *arg){
+  std::unique_lock<std::mutex> lock(queue_mutex);
+  async_request *request = data_length <= I2C_ASYNC_MAX_WRITE ? queue_slot(addr, data_length, false) : NULL;
+  if(request == NULL)
+    return -1;
+
+  std::memcpy(request->write_data, data, data_length);
+  request->callback = callback;
+  request->arg = arg;
+  lock.unlock();
+  queue_cv.notify_one();
+
+  return 0;
+}
+
+
+/**
+ * @brief Number of requests queued or in progress.
+ */
+int I2C_Async::pending(){
+  std::lock_guard<std::mutex> lock(queue_mutex);
+  return queue_len + in_progress;
+}
+
+
+/**
+ * @brief Completes the queued requests and stops the worker. Requests submitted
+ *        while it is stopping are rejected.
+ *
+ * @return 0 if success, -1 if error.
+ */
+int I2C_Async::stop(){
+  std::unique_lock<std::mutex> lock(queue_mutex);
+
+  //Another thread is already joining the worker
+  if(stopping){
+    queue_cv.wait(lock, []{ return !stopping; });
+    return 0;
+  }
+  if(!running)
+    return 0;
+  running = false;
+  stopping = true;
+  lock.unlock();
+  queue_cv.notify_all();
+
+  worker.join();
+
+  lock.lock();
+  stopping = false;
+  lock.unlock();
+  queue_cv.notify_all();
+  return 0;
+}
+
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+ * @brief Reserves the next free slot of the queue, starting the worker if needed.
+ *        Must be called with queue_mutex locked.
+ *
+ * @return The slot, with the common fields filled, or NULL if the queue is full.
+ */
+static async_request *queue_slot(uint8_t addr, uint8_t data_length, bool is_read){
+  if(start_worker() == -1)
+    return NULL;
+
+  if(queue_len == I2C_ASYNC_QUEUE_LEN)
+    return NULL;
+
+  async_request *request = &queue[(queue_head + queue_len) % I2C_ASYNC_QUEUE_LEN];
+  queue_len++;
+
+  request->addr = addr;
+  request->is_read = is_read;
+  request->data_length = data_length;
+  request->data = NULL;
+  request->client = I2C_Master::get_thread_client();
+  request->callback = NULL;
+  request->arg = NULL;
+  return request;
+}
+
+
+/**
+ * @brief Starts the worker thread if it is not running. Must be called with 
+ *        queue_mutex locked.
+ *
+ * @return 0 if success, -1 if error or if the previous worker is being stopped.
+ */
+static int start_worker(){
+  if(running)
+    return 0;
+  if(stopping)
+    return -1;
+
+  try{
+    worker = std::thread(worker_loop);
+  }catch(const std::system_error &){
+    return -1;
+  }
+  running = true;
+  return 0;
+}
+
+
+/**
+ * @brief Bus worker. Executes the requests in submission order; the I2C scheduler
+ *        still orders them against the synchronous clients using the client of
+ *        the thread that submitted each one.
+ */
+static void worker_loop(){
+  std::unique_lock<std::mutex> lock(queue_mutex);
+
+  while(true){
+    queue_cv.wait(lock, []{ return queue_len > 0 || !running; });
+    if(queue_len == 0)
+      break;
+
+    async_request *request = &queue[queue_head];
+    async_request current;
+    current.addr = request->addr;
+    current.reg = request->reg;
+    current.is_read = request->is_read;
+    current.data_length = request->data_length;
+    current.data = request->data;
+    if(!current.is_read)
+      std::memcpy(current.write_data, request->write_data, current.data_length);
+    current.client = request->client;
+    current.callback = request->callback;
+    current.arg = request->arg;
+    if(current.callback == NULL)
+      current.promise = std::move(request->promise);
+
+    queue_head = (queue_head + 1) % I2C_ASYNC_QUEUE_LEN;
+    queue_len--;
+    in_progress++;
+    lock.unlock();
+
+    I2C_Master::set_thread_client(current.client);
+
+    int result;
+    if(current.is_read)
+      result = I2C_Master::read_msg(current.addr, current.reg, current.data, current.data_length);
+    else
+      result = I2C_Master::write_msg(current.addr, current.write_data, current.data_length);
+
+    if(current.callback != NULL)
+      current.callback(result, current.arg);
+    else
+      current.promise.set_value(result);
+
+    lock.lock();
+    in_progress--;
+  }
+}
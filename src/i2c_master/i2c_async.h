@@ -0,0 +1,104 @@
+/**
+  ******************************************************************************
+  * @file   i2c_async.h
+  * @brief  Asynchronous I2C Requests header.
+  *
+  * @note   End-of-degree work.
+  *         Queues I2C transactions that are executed by a single bus worker
+  *         thread, so that a sensor does not need its own thread just to wait
+  *         for the bus. Completions are delivered through std::future or
+  *         through a callback called from the worker.
+  ******************************************************************************
+*/
+
+#ifndef __I2C_ASYNC_H__
+#define __I2C_ASYNC_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <future>
+
+/* Exported constants --------------------------------------------------------*/
+#define I2C_ASYNC_QUEUE_LEN   32  //Requests waiting for the worker
+#define I2C_ASYNC_MAX_WRITE   32  //Bytes copied from the caller on writes
+
+/* Exported types ------------------------------------------------------------*/
+
+/**
+ * @brief Completion callback. Called from the worker thread, so it must be short
+ *        and must not wait for other asynchronous requests.
+ *
+ * @param[in] result Result of the transaction: non negative value if success,
+ *                   -1 if error.
+ * @param[in] arg Argument given on submission.
+ */
+typedef void (*i2c_async_callback)(int result, void *arg);
+
+/* Exported Functions --------------------------------------------------------*/
+
+namespace I2C_Async{
+
+  /**
+   * @brief Starts the bus worker. The submit functions start it too when needed.
+   *
+   * @return 0 if success, -1 if error.
+   */
+  int start();
+
+  /**
+   * @brief Queues a read of `data_length` bytes starting at register `read_reg`.
+   *        `data` must stay valid until the request completes.
+   *
+   * @param[in] addr I2C 7-bits slave address.
+   * @param[in] read_reg I2C register to start the reading process.
+   * @param[out] data Pointer to the array where the read data will be stored.
+   * @param[in] data_length Bytes to be read.
+   *
+   * @return A future with the result of I2C_Master::read_msg(). It is already
+   *         -1 if the queue is full.
+   */
+  std::future<int> submit_read(uint8_t addr, uint8_t read_reg, uint8_t data[], uint8_t data_length);
+
+  /**
+   * @brief Queues a read and calls `callback` from the worker when it completes.
+   *
+   * @return 0 if queued, -1 if the queue is full (the callback is not called).
+   */
+  int submit_read(uint8_t addr, uint8_t read_reg, uint8_t data[], uint8_t data_length,
+                  i2c_async_callback callback, void *arg);
+
+  /**
+   * @brief Queues a write. The data is copied, so the caller may reuse it at once.
+   *
+   * @param[in] addr I2C 7-bits slave address.
+   * @param[in] data Bytes to be sent, register first.
+   * @param[in] data_length Bytes to be written, up to I2C_ASYNC_MAX_WRITE.
+   *
+   * @return A future with the result of I2C_Master::write_msg(). It is already
+   *         -1 if the queue is full or the message is too long.
+   */
+  std::future<int> submit_write(uint8_t addr, const uint8_t data[], uint8_t data_length);
+
+  /**
+   * @brief Queues a write and calls `callback` from the worker when it completes.
+   *
+   * @return 0 if queued, -1 if the queue is full or the message is too long.
+   */
+  int submit_write(uint8_t addr, const uint8_t data[], uint8_t data_length,
+                   i2c_async_callback callback, void *arg);
+
+  /**
+   * @brief Number of requests queued or in progress.
+   */
+  int pending();
+
+  /**
+   * @brief Completes the queued requests and stops the worker. Requests
+   *        submitted while it is stopping are rejected.
+   *
+   * @return 0 if success, -1 if error.
+   */
+  int stop();
+}
+
+#endif /* __I2C_ASYNC_H__ */
@@ -0,0 +1,67 @@
+/**
+  ******************************************************************************
+  * @file   i2c_backend.h
+  * @brief  I2C Backend Interface.
+  *
+  * @note   End-of-degree work.
+  *         Transport used by the I2C Handler Module. The default backend
+  *         talks to the Linux /dev/i2c-<n> adapter; other backends (e.g. the
+  *         I2C simulator) can be installed with I2C_Master::set_backend().
+  ******************************************************************************
+*/
+
+#ifndef __I2C_BACKEND_H__
+#define __I2C_BACKEND_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Exported types ------------------------------------------------------------*/
+
+class I2C_Backend{
+public:
+
+  /**
+   * @brief Opens the bus. Calling it on an already opened bus must succeed.
+   * 
+   * @param[in] i2c_device Bus number, as in /dev/i2c-<number>.
+   *
+   * @return 0 if success, -1 if error.
+   */
+  virtual int open(int i2c_device) = 0;
+
+  /**
+   * @brief Sends `data_length` bytes to the slave with address `addr`.
+   * 
+   * @param[in] addr I2C 7-bits slave address.
+   * @param[in] data Pointer to data array to be sent to slave.
+   * @param[in] data_length Bytes to be written.
+   *
+   * @return non negative value if success, -1 if error.
+   */
+  virtual int write_msg(uint8_t addr, uint8_t data[], uint8_t data_length) = 0;
+
+  /**
+   * @brief Reads `data_length` bytes starting at register `read_reg` from the 
+   *        slave with address `addr`.
+   * 
+   * @param[in] addr I2C 7-bits slave address.
+   * @param[in] read_reg I2C register to start the reading process.
+   * @param[out] data Pointer to the array where the read data will be stored.
+   * @param[in] data_length Bytes to be read.
+   *
+   * @return non negative value if success, -1 if error.
+   */
+  virtual int read_msg(uint8_t addr, uint8_t read_reg, uint8_t data[], uint8_t data_length) = 0;
+
+  /**
+   * @brief Closes the bus and frees the related resources.
+   * 
+   * @return 0 if success, -1 if error.
+   */
+  virtual int close() = 0;
+
+  virtual ~I2C_Backend(){};
+};
+
+#endif /* __I2C_BACKEND_H__ */
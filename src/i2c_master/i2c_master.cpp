@@ -10,6 +10,7 @@
 */
 /* Includes ------------------------------------------------------------------*/
 #include "i2c_master.h" // Module header
+#include "i2c_trace.h"
 #include <cstdio>
 #include <fcntl.h>
 #include <unistd.h>
@@ -17,15 +18,94 @@
 #include <linux/i2c-dev.h>
 #include <linux/i2c.h>
 #include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include "../custom_gpio/custom_gpio.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define MAX_WAITERS       16
+#define CLIENT_NAME_LEN   16
+#define SCL_RECOVERY_PULSES 9   //Enough for a slave to finish a stuck byte
+#define SCL_HALF_PERIOD_US  5
 
 /* Private typedef -----------------------------------------------------------*/
+typedef std::chrono::steady_clock sched_clock;
+
+class Linux_backend : public I2C_Backend{
+  int fd;
+  struct i2c_rdwr_ioctl_data packets;
+  struct i2c_msg messages[2];
+public:
+  Linux_backend() : fd(-1) {};
+  int open(int i2c_device) override;
+  int write_msg(uint8_t addr, uint8_t data[], uint8_t data_length) override;
+  int read_msg(uint8_t addr, uint8_t read_reg, uint8_t data[], uint8_t data_length) override;
+  int close() override;
+};
+
+struct bus_client{
+  char name[CLIENT_NAME_LEN];
+  uint8_t priority;
+  uint32_t deadline_us;
+  i2c_client_stats stats;
+};
+
+struct device_health{
+  i2c_device_health info;
+  sched_clock::time_point quarantine_end;
+  bool probing;               //A transaction after the quarantine is in flight
+};
+
+struct bus_waiter{
+  int client;
+  uint8_t priority;
+  sched_clock::time_point requested;
+  sched_clock::time_point deadline;
+  bool has_deadline;
+  bool granted;
+};
+
 /* Private variables----------------------------------------------------------*/
-static int fd;
-static struct i2c_rdwr_ioctl_data packets;
-static struct i2c_msg messages[2];
-static std::mutex mutex;
+//Buses without an installed backend use their Linux adapter
+static Linux_backend linux_backends[I2C_MAX_BUSES];
+static I2C_Backend *backends[I2C_MAX_BUSES];
+static bool bus_started[I2C_MAX_BUSES];
+
+//Bus scheduler state. Protected by sched_mutex.
+static std::mutex sched_mutex;
+static std::condition_variable sched_cond;
+static bool bus_busy = false;
+static bus_waiter *waiters[MAX_WAITERS];
+static int waiters_len = 0;
+static bus_client clients[I2C_MAX_CLIENTS] = {
+  {"default", I2C_PRIO_NORMAL, I2C_NO_DEADLINE, {0, 0, 0, 0}}
+};
+static int clients_len = 1;
+static thread_local int thread_client = I2C_DEFAULT_CLIENT;
+
+//Error recovery state. Protected by health_mutex.
+static std::mutex health_mutex;
+static i2c_retry_policy policy = {
+  2, 1000, 20000, 5, 1000, 10, -1
+};
+static device_health health[I2C_MAX_BUSES][128];
+static uint32_t bus_consecutive_failures[I2C_MAX_BUSES];
+static uint64_t bus_failing_devices[I2C_MAX_BUSES][2];
+static uint32_t bus_recoveries = 0;
+static int bus_device[I2C_MAX_BUSES] = {1};
 
 /* Private function prototypes -----------------------------------------------*/
+static void bus_acquire();
+static void bus_release();
+static int select_next_waiter(sched_clock::time_point now);
+static I2C_Backend *bus_backend(int bus);
+static int transfer(int bus, uint8_t addr, uint8_t reg, uint8_t data[], uint8_t data_length, bool is_read);
+static int bus_transfer(int bus, uint8_t addr, uint8_t reg, uint8_t data[], uint8_t data_length, bool is_read);
+static bool health_admit(int bus, uint8_t addr, bool *probe);
+static bool health_update(int bus, uint8_t addr, bool success, int retries, bool probe);
+static int bus_recover(int bus);
 /* Functions -----------------------------------------------------------------*/
 
 /**
@@ -37,19 +117,7 @@ static std::mutex mutex;
  * @return 0 if success, -1 if error.
  */
 int I2C_Master::start (int i2c_device) {
-  if(fd == 0){
-    //Open file descriptor
-    char i2cFile[15];
-    std::sprintf(i2cFile, "/dev/i2c-%d", i2c_device);
-    
-    fd = open(i2cFile, O_RDWR);
-    
-    if(fd == -1){
-      return -1;
-    }
-  }
-  
-  return 0;
+  return start_bus(0, i2c_device);
 }
 
 
@@ -64,26 +132,7 @@ int I2C_Master::start (int i2c_device) {
  * @return non negative value if success, -1 if error.
  */
 int I2C_Master::write_msg(uint8_t addr, uint8_t data[], uint8_t data_length){
-  int result;
-
-  //Make thread-safe.
-  mutex.lock();
-
-  //Write configuration registers
-  messages[0].addr = addr;
-  messages[0].flags = 0;
-  messages[0].len = data_length;
-  messages[0].buf = data; //Pointer to the data bytes to be written
-  //Build packet list
-  packets.msgs = messages;
-  packets.nmsgs = 1;
-  //Send message(s)
-  //I2C_RDWR-> write/read i2c
-  result = ioctl(fd, I2C_RDWR, &packets);
-
-  mutex.unlock();
-
-  return result;
+  return transfer(0, addr, data_length > 0 ? data[0] : 0, data, data_length, false);
 }
 
 
@@ -101,11 +150,328 @@ int I2C_Master::write_msg(uint8_t addr, uint8_t data[], uint8_t data_length){
  * @return non negative value if success, -1 if error.
  */
 int I2C_Master::read_msg(uint8_t addr, uint8_t read_reg, uint8_t data[], uint8_t data_length){
-  int result;
+  return transfer(0, addr, read_reg, data, data_length, true);
+}
+
+
+/**
+ * @brief Replaces the transport used for every transaction. Passing NULL
+ *        restores the default Linux /dev/i2c-<n> backend. The backend 
+ *        must outlive its use by this module.
+ * 
+ * @param[in] backend The new backend or NULL.
+ *
+ * @return 0 if success, -1 if error.
+ */
+int I2C_Master::set_backend(I2C_Backend *new_backend){
+  return set_bus_backend(0, new_backend);
+}
+
+
+/**
+ * @brief Starts an additional I2C adapter. start() is start_bus(0, ...).
+ *        All the buses share the scheduler, so their transactions are
+ *        serialized and follow the same client priorities.
+ * 
+ * @param[in] bus Bus index, from 0 to I2C_MAX_BUSES - 1.
+ * @param[in] i2c_device Number of the /dev/i2c-<number> adapter.
+ *
+ * @return 0 if success, -1 if error.
+ */
+int I2C_Master::start_bus(int bus, int i2c_device){
+  if(bus < 0 || bus >= I2C_MAX_BUSES)
+    return -1;
+
+  bus_device[bus] = i2c_device;
+  if(bus_backend(bus)->open(i2c_device) < 0)
+    return -1;
+  bus_started[bus] = true;
+  return 0;
+}
+
+
+/**
+ * @brief write_msg() on the given bus.
+ *
+ * @return non negative value if success, -1 if error.
+ */
+int I2C_Master::write_msg_bus(int bus, uint8_t addr, uint8_t data[], uint8_t data_length){
+  if(bus < 0 || bus >= I2C_MAX_BUSES)
+    return -1;
+  return transfer(bus, addr, data_length > 0 ? data[0] : 0, data, data_length, false);
+}
+
+
+/**
+ * @brief read_msg() on the given bus.
+ *
+ * @return non negative value if success, -1 if error.
+ */
+int I2C_Master::read_msg_bus(int bus, uint8_t addr, uint8_t read_reg, uint8_t data[], uint8_t data_length){
+  if(bus < 0 || bus >= I2C_MAX_BUSES)
+    return -1;
+  return transfer(bus, addr, read_reg, data, data_length, true);
+}
+
+
+/**
+ * @brief set_backend() for the given bus.
+ *
+ * @return 0 if success, -1 if error.
+ */
+int I2C_Master::set_bus_backend(int bus, I2C_Backend *new_backend){
+  if(bus < 0 || bus >= I2C_MAX_BUSES)
+    return -1;
+
+  //Swap only between transactions
+  bus_acquire();
+
+  backends[bus] = new_backend;
+
+  bus_release();
+
+  return 0;
+}
+
+
+/**
+ * @brief Sets the retry, backoff and recovery policy applied to every 
+ *        transaction.
+ * 
+ * @param[in] new_policy The new policy.
+ *
+ * @return 0 if success, -1 if error.
+ */
+int I2C_Master::set_retry_policy(const i2c_retry_policy *new_policy){
+  if(new_policy == NULL || new_policy->fail_threshold == 0 || new_policy->stuck_threshold == 0)
+    return -1;
+
+  std::lock_guard<std::mutex> lock(health_mutex);
+  policy = *new_policy;
+  return 0;
+}
+
+
+/**
+ * @brief Gets the current retry, backoff and recovery policy.
+ * 
+ * @param[out] current_policy Structure where the policy will be stored.
+ *
+ * @return 0 if success, -1 if error.
+ */
+int I2C_Master::get_retry_policy(i2c_retry_policy *current_policy){
+  if(current_policy == NULL)
+    return -1;
+
+  std::lock_guard<std::mutex> lock(health_mutex);
+  *current_policy = policy;
+  return 0;
+}
+
+
+/**
+ * @brief Gets the health state of a slave device on bus 0.
+ * 
+ * @param[in] addr I2C 7-bits slave address.
+ * @param[out] device_health Structure where the state will be stored.
+ *
+ * @return 0 if success, -1 if error.
+ */
+int I2C_Master::get_device_health(uint8_t addr, i2c_device_health *device_health){
+  if(addr > 0x7F || device_health == NULL)
+    return -1;
+
+  std::lock_guard<std::mutex> lock(health_mutex);
+  *device_health = health[0][addr].info;
+  return 0;
+}
+
+
+/**
+ * @brief Recovers a stuck bus: closes the adapter, clocks SCL through the 
+ *        GPIO configured in the retry policy (if any) so a slave holding SDA 
+ *        low can finish its byte, and opens the adapter again. It is also 
+ *        done automatically when a stuck bus is detected.
+ * 
+ * @return 0 if success, -1 if error.
+ */
+int I2C_Master::recover_bus(){
+  return bus_recover(0);
+}
+
+
+/**
+ * @brief Gets the number of bus recoveries done since the start.
+ * 
+ * @return The number of bus recoveries.
+ */
+uint32_t I2C_Master::get_bus_recoveries(){
+  std::lock_guard<std::mutex> lock(health_mutex);
+  return bus_recoveries;
+}
+
+
+/**
+ * @brief Registers a bus client and binds it to the calling thread. Every
+ *        transaction issued afterwards by the thread is scheduled with
+ *        the client priority. When the bus is released, waiting clients
+ *        whose deadline has expired are served first (earliest deadline
+ *        first), then the highest priority, then the oldest request.
+ * 
+ * @param[in] name Client name, used only for diagnostics.
+ * @param[in] priority One of the I2C_PRIO_* values.
+ * @param[in] deadline_us Maximum desired wait for the bus in us, or
+ *                        I2C_NO_DEADLINE.
+ *
+ * @return The client id if success, -1 if error.
+ */
+int I2C_Master::register_client(const char *name, uint8_t priority, uint32_t deadline_us){
+  std::unique_lock<std::mutex> lock(sched_mutex);
+
+  if(clients_len >= I2C_MAX_CLIENTS || priority > I2C_PRIO_CRITICAL)
+    return -1;
+
+  bus_client *client = &clients[clients_len];
+  std::strncpy(client->name, name != NULL ? name : "", CLIENT_NAME_LEN - 1);
+  client->name[CLIENT_NAME_LEN - 1] = '\0';
+  client->priority = priority;
+  client->deadline_us = deadline_us;
+  std::memset(&client->stats, 0, sizeof(client->stats));
+
+  thread_client = clients_len;
+
+  return clients_len++;
+}
+
+
+/**
+ * @brief Binds an already registered client to the calling thread.
+ * 
+ * @param[in] client Client id returned by register_client().
+ *
+ * @return 0 if success, -1 if error.
+ */
+int I2C_Master::set_thread_client(int client){
+  std::unique_lock<std::mutex> lock(sched_mutex);
+
+  if(client < 0 || client >= clients_len)
+    return -1;
+
+  thread_client = client;
+  return 0;
+}
+
+
+/**
+ * @brief Gets the client bound to the calling thread.
+ * 
+ * @return The client id, I2C_DEFAULT_CLIENT if none was bound.
+ */
+int I2C_Master::get_thread_client(){
+  return thread_client;
+}
+
+
+/**
+ * @brief Gets the bus wait time metrics of a client.
+ * 
+ * @param[in] client Client id returned by register_client() or 
+ *                   I2C_DEFAULT_CLIENT.
+ * @param[out] stats Structure where the metrics will be stored.
+ *
+ * @return 0 if success, -1 if error.
+ */
+int I2C_Master::get_client_stats(int client, i2c_client_stats *stats){
+  std::unique_lock<std::mutex> lock(sched_mutex);
+
+  if(client < 0 || client >= clients_len || stats == NULL)
+    return -1;
+
+  *stats = clients[client].stats;
+  return 0;
+}
+
+
+/**
+ * @brief Clears the bus wait time metrics of a client.
+ * 
+ * @param[in] client Client id returned by register_client() or 
+ *                   I2C_DEFAULT_CLIENT.
+ *
+ * @return 0 if success, -1 if error.
+ */
+int I2C_Master::reset_client_stats(int client){
+  std::unique_lock<std::mutex> lock(sched_mutex);
+
+  if(client < 0 || client >= clients_len)
+    return -1;
+
+  std::memset(&clients[client].stats, 0, sizeof(clients[client].stats));
+  return 0;
+}
+
+
+/**
+ * @brief End I2C communications and free all the related resources.
+ * 
+ * @return 0 if success, -1 if error.
+ */
+int I2C_Master::end(){
+  int result = bus_backend(0)->close();
+
+  bus_started[0] = false;
+  for(int bus = 1; bus < I2C_MAX_BUSES; bus++){
+    if(bus_started[bus] && bus_backend(bus)->close() < 0)
+      result = -1;
+    bus_started[bus] = false;
+  }
+  return result;
+}
+
+
+/* Linux backend -------------------------------------------------------------*/
+
+/**
+ * @brief Opens /dev/i2c-<i2c_device> if it is not already open.
+ */
+int Linux_backend::open(int i2c_device){
+  if(fd == -1){
+    //Open file descriptor
+    char i2cFile[15];
+    std::sprintf(i2cFile, "/dev/i2c-%d", i2c_device);
+    
+    fd = ::open(i2cFile, O_RDWR);
+    
+    if(fd == -1)
+      return -1;
+  }
+  
+  return 0;
+}
+
+
+/**
+ * @brief Sends a single write message with I2C_RDWR.
+ */
+int Linux_backend::write_msg(uint8_t addr, uint8_t data[], uint8_t data_length){
+  //Write configuration registers
+  messages[0].addr = addr;
+  messages[0].flags = 0;
+  messages[0].len = data_length;
+  messages[0].buf = data; //Pointer to the data bytes to be written
+  //Build packet list
+  packets.msgs = messages;
+  packets.nmsgs = 1;
+  //Send message(s)
+  //I2C_RDWR-> write/read i2c
+  return ioctl(fd, I2C_RDWR, &packets);
+}
 
-  //Make thread-safe.
-  mutex.lock();
 
+/**
+ * @brief Sends the register pointer and reads back with a repeated start.
+ */
+int Linux_backend::read_msg(uint8_t addr, uint8_t read_reg, uint8_t data[], uint8_t data_length){
   //Write in th I2C device to point to reading registers
   messages[0].addr = addr;
   messages[0].flags = 0;
@@ -121,23 +487,343 @@ int I2C_Master::read_msg(uint8_t addr, uint8_t read_reg, uint8_t data[], uint8_t
   packets.nmsgs = 2;
   //Send message(s)
   //I2C_RDWR-> write/read i2c
-  result = ioctl(fd, I2C_RDWR, &packets);
+  return ioctl(fd, I2C_RDWR, &packets);
+}
+
+
+/**
+ * @brief Closes the adapter file descriptor, if it is open.
+ */
+int Linux_backend::close(){
+  if(fd == -1)
+    return 0;
+
+  int status = ::close(fd);
+  if(status != -1){
+    fd = -1;
+  }
+  return status;
+}
 
-  mutex.unlock();
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+ * @brief Backend of a bus: the installed one or its Linux adapter.
+ */
+static I2C_Backend *bus_backend(int bus){
+  return backends[bus] != NULL ? backends[bus] : &linux_backends[bus];
+}
+
+
+/**
+ * @brief Executes a transaction with the retry policy: failed attempts are 
+ *        retried with exponential backoff, sleeping without holding the bus so
+ *        other clients keep working. Devices in quarantine fail immediately.
+ *
+ * @param[in] bus Bus index.
+ * @param[in] addr I2C 7-bits slave address.
+ * @param[in] reg Register pointer (reads) or first written byte (writes).
+ * @param[in,out] data Read buffer or bytes to write.
+ * @param[in] data_length Bytes to read or write.
+ * @param[in] is_read True for reads.
+ *
+ * @return non negative value if success, -1 if error.
+ */
+static int transfer(int bus, uint8_t addr, uint8_t reg, uint8_t data[], uint8_t data_length, bool is_read){
+  int result = -1;
+  int attempts;
+  uint32_t backoff_us, max_backoff_us;
+  bool probe;
+
+  if(!health_admit(bus, addr, &probe))
+    return -1;
+
+  {
+    std::lock_guard<std::mutex> lock(health_mutex);
+    attempts = policy.retries + 1;
+    backoff_us = policy.backoff_us;
+    max_backoff_us = policy.max_backoff_us;
+  }
+
+  int attempt;
+  for(attempt = 0; attempt < attempts; attempt++){
+    if(attempt > 0){
+      std::this_thread::sleep_for(std::chrono::microseconds(backoff_us));
+      backoff_us = backoff_us * 2 < max_backoff_us ? backoff_us * 2 : max_backoff_us;
+    }
+
+    result = bus_transfer(bus, addr, reg, data, data_length, is_read);
+    if(result >= 0)
+      break;
+  }
+
+  if(health_update(bus, addr, result >= 0, attempt < attempts ? attempt : attempts - 1, probe))
+    bus_recover(bus);
 
   return result;
 }
 
 
 /**
- * @brief End I2C communications and free all the related resources.
- * 
+ * @brief Executes a single attempt of a transaction while owning the bus.
+ *
+ * @return The backend result.
+ */
+static int bus_transfer(int bus, uint8_t addr, uint8_t reg, uint8_t data[], uint8_t data_length, bool is_read){
+  int result;
+
+  //Make thread-safe. The scheduler decides which waiting client goes next.
+  bus_acquire();
+
+  uint64_t start = 0;
+  bool traced = I2C_Trace::enabled.load(std::memory_order_relaxed);
+  if(traced)
+    start = I2C_Trace::now_ns();
+
+  if(is_read)
+    result = bus_backend(bus)->read_msg(addr, reg, data, data_length);
+  else
+    result = bus_backend(bus)->write_msg(addr, data, data_length);
+
+  if(traced)
+    I2C_Trace::record(start, I2C_Trace::now_ns() - start, addr, reg, is_read, data, data_length, result,
+                      thread_client, bus);
+
+  bus_release();
+
+  return result;
+}
+
+
+/**
+ * @brief Decides if a transaction to a device may be attempted. Once the 
+ *        quarantine of a device ends, a single transaction is admitted as a
+ *        probe and the others keep failing until health_update() resolves it.
+ *
+ * @param[in] bus Bus index.
+ * @param[in] addr I2C 7-bits slave address.
+ * @param[out] probe True if the transaction is the probe of a failed device.
+ *
+ * @return True if the transaction may go to the bus.
+ */
+static bool health_admit(int bus, uint8_t addr, bool *probe){
+  std::lock_guard<std::mutex> lock(health_mutex);
+
+  *probe = false;
+  if(addr > 0x7F)
+    return true;
+
+  device_health *dev = &health[bus][addr];
+  if(dev->info.state != I2C_DEV_FAILED)
+    return true;
+  if(dev->probing || sched_clock::now() < dev->quarantine_end)
+    return false;
+
+  dev->probing = true;
+  *probe = true;
+  return true;
+}
+
+
+/**
+ * @brief Updates the device and bus health after a transaction.
+ *
+ * @param[in] bus Bus index.
+ * @param[in] addr I2C 7-bits slave address.
+ * @param[in] success True if the transaction finally succeeded.
+ * @param[in] retries Retries spent on the transaction.
+ * @param[in] probe True if the transaction was the probe of a failed device.
+ *
+ * @return True if the bus looks stuck and must be recovered.
+ */
+static bool health_update(int bus, uint8_t addr, bool success, int retries, bool probe){
+  std::lock_guard<std::mutex> lock(health_mutex);
+
+  if(addr > 0x7F)
+    return false;
+
+  device_health *dev = &health[bus][addr];
+  if(probe)
+    dev->probing = false;
+  uint64_t *failing_devices = bus_failing_devices[bus];
+  dev->info.retries += retries;
+
+  if(success){
+    dev->info.state = I2C_DEV_HEALTHY;
+    dev->info.consecutive_failures = 0;
+    bus_consecutive_failures[bus] = 0;
+    failing_devices[0] = failing_devices[1] = 0;
+    return false;
+  }
+
+  dev->info.failures++;
+  dev->info.consecutive_failures++;
+  if(dev->info.consecutive_failures >= policy.fail_threshold){
+    //Also re-arms the quarantine when the probe after a quarantine fails
+    dev->info.state = I2C_DEV_FAILED;
+    dev->info.quarantines++;
+    dev->quarantine_end = sched_clock::now() + std::chrono::milliseconds(policy.quarantine_ms);
+  }
+  else{
+    dev->info.state = I2C_DEV_DEGRADED;
+  }
+
+  //A missing device is not a stuck bus: require failures on several devices
+  bus_consecutive_failures[bus]++;
+  failing_devices[addr >> 6] |= 1ULL << (addr & 0x3F);
+  int failing = __builtin_popcountll(failing_devices[0]) + __builtin_popcountll(failing_devices[1]);
+
+  if(bus_consecutive_failures[bus] >= policy.stuck_threshold && failing >= 2){
+    bus_consecutive_failures[bus] = 0;
+    failing_devices[0] = failing_devices[1] = 0;
+    return true;
+  }
+  return false;
+}
+
+
+/**
+ * @brief Closes the adapter, clocks SCL through the recovery GPIO if configured
+ *        and opens the adapter again, all while owning the bus. The recovery
+ *        GPIO belongs to bus 0.
+ *
+ * @param[in] bus Bus index.
+ *
  * @return 0 if success, -1 if error.
  */
-int I2C_Master::end(){
-  int status = close(fd);
-  if(status != -1){
-    fd = 0;
+static int bus_recover(int bus){
+  int scl_gpio;
+  int result;
+
+  {
+    std::lock_guard<std::mutex> lock(health_mutex);
+    scl_gpio = bus == 0 ? policy.scl_gpio : -1;
+    bus_recoveries++;
   }
-  return status;
+
+  bus_acquire();
+
+  bus_backend(bus)->close();
+
+  if(scl_gpio >= 0){
+    CustomGPIO::GPIO scl(scl_gpio);
+    if(scl.setOutput() == 0){
+      for(int i = 0; i < SCL_RECOVERY_PULSES; i++){
+        scl.write(false);
+        std::this_thread::sleep_for(std::chrono::microseconds(SCL_HALF_PERIOD_US));
+        scl.write(true);
+        std::this_thread::sleep_for(std::chrono::microseconds(SCL_HALF_PERIOD_US));
+      }
+    }
+  }
+
+  result = bus_backend(bus)->open(bus_device[bus]);
+
+  bus_release();
+
+  return result;
+}
+
+
+/**
+ * @brief Blocks the calling thread until the scheduler grants it the bus and
+ *        updates the wait metrics of the thread client.
+ */
+static void bus_acquire(){
+  std::unique_lock<std::mutex> lock(sched_mutex);
+  bus_client *client = &clients[thread_client];
+  bus_waiter self;
+  uint32_t wait_us = 0;
+
+  self.client = thread_client;
+  self.priority = client->priority;
+  self.requested = sched_clock::now();
+  self.has_deadline = client->deadline_us != I2C_NO_DEADLINE;
+  self.deadline = self.requested + std::chrono::microseconds(client->deadline_us);
+  self.granted = false;
+
+  if(bus_busy || waiters_len > 0){
+    //Queue full: fall back to wait in arrival order for a free slot
+    sched_cond.wait(lock, []() { return waiters_len < MAX_WAITERS; });
+
+    waiters[waiters_len++] = &self;
+    sched_cond.wait(lock, [&self]() { return self.granted; });
+
+    wait_us = std::chrono::duration_cast<std::chrono::microseconds>(sched_clock::now() - self.requested).count();
+  }
+  bus_busy = true;
+
+  client->stats.transactions++;
+  client->stats.total_wait_us += wait_us;
+  if(wait_us > client->stats.max_wait_us)
+    client->stats.max_wait_us = wait_us;
+  if(self.has_deadline && wait_us > client->deadline_us)
+    client->stats.missed_deadlines++;
+}
+
+
+/**
+ * @brief Releases the bus and hands it over to the next waiting client, if any.
+ */
+static void bus_release(){
+  std::unique_lock<std::mutex> lock(sched_mutex);
+  int next = select_next_waiter(sched_clock::now());
+
+  if(next < 0){
+    bus_busy = false;
+    return;
+  }
+
+  //The bus stays busy: ownership goes directly to the selected waiter
+  waiters[next]->granted = true;
+  waiters[next] = waiters[--waiters_len];
+  sched_cond.notify_all();
+}
+
+
+/**
+ * @brief Chooses the waiter to be served next. Waiters that have already missed
+ *        their deadline go first, earliest deadline first. Otherwise the highest
+ *        priority wins and ties are broken by the oldest request.
+ *
+ * @param[in] now Current time of the scheduler clock.
+ *
+ * @return The index in the waiters array, or -1 if there are no waiters.
+ */
+static int select_next_waiter(sched_clock::time_point now){
+  int best = -1;
+  bool best_late = false;
+
+  for(int i = 0; i < waiters_len; i++){
+    bus_waiter *w = waiters[i];
+    bool late = w->has_deadline && w->deadline <= now;
+
+    if(best < 0){
+      best = i;
+      best_late = late;
+      continue;
+    }
+
+    bus_waiter *b = waiters[best];
+    if(late != best_late){
+      if(late){
+        best = i;
+        best_late = true;
+      }
+    }
+    else if(late){
+      if(w->deadline < b->deadline)
+        best = i;
+    }
+    else if(w->priority != b->priority){
+      if(w->priority > b->priority)
+        best = i;
+    }
+    else if(w->requested < b->requested){
+      best = i;
+    }
+  }
+
+  return best;
 }
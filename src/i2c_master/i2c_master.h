@@ -14,13 +14,93 @@
 
   /* Includes ------------------------------------------------------------------*/
     #include <stdint.h>
+#ifdef __cplusplus
+    #include "i2c_backend.h"
+#endif
 
 #ifdef __cplusplus
 extern "C" {
 #endif
   /* Exported variables --------------------------------------------------------*/
   /* Exported types ------------------------------------------------------------*/
+
+#define I2C_TRACE_MAX_DATA    255 //Payload bytes kept per traced transaction, the longest possible
+#define I2C_TRACE_LEN         1024 //Transactions kept in the trace ring (power of 2)
+#define I2C_HIST_BUCKETS      16  //Log2 latency buckets, from <1us to >=16ms
+
+typedef struct{
+
+  uint32_t transactions;      //Bus grants obtained by the client
+  uint64_t total_wait_us;     //Accumulated time waiting for the bus
+  uint32_t max_wait_us;       //Worst wait for the bus
+  uint32_t missed_deadlines;  //Grants that arrived after the client deadline
+
+}i2c_client_stats;
+
+typedef struct{
+
+  uint64_t timestamp_ns;      //Start of the transaction (steady clock)
+  uint32_t duration_ns;       //Time spent in the backend
+  uint8_t addr;               //I2C 7-bits slave address
+  uint8_t reg;                //Register pointer (first byte for writes)
+  uint8_t length;             //Bytes requested by the caller
+  uint8_t is_read;            //1 for read_msg, 0 for write_msg
+  int8_t result;              //0 if success, -1 if error
+  uint8_t client;             //Scheduler client that issued it
+  uint8_t data_len;           //Bytes stored in data
+  uint8_t bus;                //Bus index it went through
+  uint8_t data[I2C_TRACE_MAX_DATA]; //Read data or written bytes
+
+}i2c_trace_record;
+
+typedef struct{
+
+  uint32_t count;             //Transactions measured
+  uint32_t errors;            //Transactions that failed
+  uint32_t max_us;            //Worst latency
+  uint32_t buckets[I2C_HIST_BUCKETS]; //buckets[i]: 2^(i-1) <= latency < 2^i us
+
+}i2c_latency_histogram;
+
+typedef struct{
+
+  uint8_t retries;            //Extra attempts after a failed transaction
+  uint32_t backoff_us;        //Wait before the first retry, doubled every retry
+  uint32_t max_backoff_us;    //Upper limit of the wait between retries
+  uint8_t fail_threshold;     //Consecutive failed transactions to quarantine a device
+  uint32_t quarantine_ms;     //Time a failed device is not accessed
+  uint8_t stuck_threshold;    //Consecutive failures on several devices to reset the bus
+  int scl_gpio;               //GPIO wired to SCL to unlock the bus, -1 if none
+
+}i2c_retry_policy;
+
+typedef struct{
+
+  uint8_t state;              //I2C_DEV_HEALTHY, I2C_DEV_DEGRADED or I2C_DEV_FAILED
+  uint32_t consecutive_failures; //Failed transactions since the last success
+  uint32_t failures;          //Failed transactions, after retries
+  uint32_t retries;           //Retries done
+  uint32_t quarantines;       //Times the device has been quarantined
+
+}i2c_device_health;
+
   /* Exported constants --------------------------------------------------------*/
+
+#define I2C_MAX_BUSES         4   //Adapters in use at the same time, bus 0 is the default one
+#define I2C_MAX_CLIENTS       8   //Including the default client
+#define I2C_DEFAULT_CLIENT    0   //Client used by threads that never registered
+
+#define I2C_PRIO_BACKGROUND   0
+#define I2C_PRIO_NORMAL       1
+#define I2C_PRIO_HIGH         2
+#define I2C_PRIO_CRITICAL     3
+
+#define I2C_NO_DEADLINE       0
+
+#define I2C_DEV_HEALTHY       0   //Last transaction succeeded
+#define I2C_DEV_DEGRADED      1   //Failing, still accessed
+#define I2C_DEV_FAILED        2   //In quarantine, transactions fail immediately
+
   /* Exported macro ------------------------------------------------------------*/
   /* Exported Functions --------------------------------------------------------*/
 
@@ -63,6 +143,207 @@ extern "C" {
        */
       int read_msg(uint8_t addr, uint8_t read_reg, uint8_t data[], uint8_t data_length);
       
+      /**
+       * @brief Replaces the transport used for every transaction. Passing NULL
+       *        restores the default Linux /dev/i2c-<n> backend. The backend 
+       *        must outlive its use by this module.
+       * 
+       * @param[in] backend The new backend or NULL.
+       *
+       * @return 0 if success, -1 if error.
+       */
+      int set_backend(I2C_Backend *backend);
+
+      /**
+       * @brief Starts an additional I2C adapter. start() is start_bus(0, ...).
+       *        All the buses share the scheduler, so their transactions are
+       *        serialized and follow the same client priorities.
+       * 
+       * @param[in] bus Bus index, from 0 to I2C_MAX_BUSES - 1.
+       * @param[in] i2c_device Number of the /dev/i2c-<number> adapter.
+       *
+       * @return 0 if success, -1 if error.
+       */
+      int start_bus(int bus, int i2c_device);
+
+      /**
+       * @brief write_msg() on the given bus.
+       *
+       * @return non negative value if success, -1 if error.
+       */
+      int write_msg_bus(int bus, uint8_t addr, uint8_t data[], uint8_t data_length);
+
+      /**
+       * @brief read_msg() on the given bus.
+       *
+       * @return non negative value if success, -1 if error.
+       */
+      int read_msg_bus(int bus, uint8_t addr, uint8_t read_reg, uint8_t data[], uint8_t data_length);
+
+      /**
+       * @brief set_backend() for the given bus.
+       *
+       * @return 0 if success, -1 if error.
+       */
+      int set_bus_backend(int bus, I2C_Backend *backend);
+      
+      /**
+       * @brief Sets the retry, backoff and recovery policy applied to every 
+       *        transaction. Failed attempts are retried with exponential 
+       *        backoff without holding the bus. A device that keeps failing 
+       *        is quarantined, and consecutive failures on several devices 
+       *        trigger a bus recovery.
+       * 
+       * @param[in] new_policy The new policy.
+       *
+       * @return 0 if success, -1 if error.
+       */
+      int set_retry_policy(const i2c_retry_policy *new_policy);
+      
+      /**
+       * @brief Gets the current retry, backoff and recovery policy.
+       * 
+       * @param[out] current_policy Structure where the policy will be stored.
+       *
+       * @return 0 if success, -1 if error.
+       */
+      int get_retry_policy(i2c_retry_policy *current_policy);
+      
+      /**
+       * @brief Gets the health state of a slave device on bus 0.
+       * 
+       * @param[in] addr I2C 7-bits slave address.
+       * @param[out] device_health Structure where the state will be stored.
+       *
+       * @return 0 if success, -1 if error.
+       */
+      int get_device_health(uint8_t addr, i2c_device_health *device_health);
+      
+      /**
+       * @brief Recovers a stuck bus: closes the adapter, clocks SCL through the 
+       *        GPIO configured in the retry policy (if any) so a slave holding 
+       *        SDA low can finish its byte, and opens the adapter again. It is 
+       *        also done automatically when a stuck bus is detected.
+       *        The SCL GPIO must be one the platform gives back to the I2C 
+       *        controller (e.g. an i2c-gpio bus), otherwise leave it at -1.
+       * 
+       * @return 0 if success, -1 if error.
+       */
+      int recover_bus();
+      
+      /**
+       * @brief Gets the number of bus recoveries done since the start.
+       * 
+       * @return The number of bus recoveries.
+       */
+      uint32_t get_bus_recoveries();
+      
+      /**
+       * @brief Registers a bus client and binds it to the calling thread. Every
+       *        transaction issued afterwards by the thread is scheduled with
+       *        the client priority. When the bus is released, waiting clients
+       *        whose deadline has expired are served first (earliest deadline
+       *        first), then the highest priority, then the oldest request.
+       * 
+       * @param[in] name Client name, used only for diagnostics.
+       * @param[in] priority One of the I2C_PRIO_* values.
+       * @param[in] deadline_us Maximum desired wait for the bus in us, or
+       *                        I2C_NO_DEADLINE.
+       *
+       * @return The client id if success, -1 if error.
+       */
+      int register_client(const char *name, uint8_t priority, uint32_t deadline_us);
+      
+      /**
+       * @brief Binds an already registered client to the calling thread.
+       * 
+       * @param[in] client Client id returned by register_client().
+       *
+       * @return 0 if success, -1 if error.
+       */
+      int set_thread_client(int client);
+      
+      /**
+       * @brief Gets the client bound to the calling thread.
+       * 
+       * @return The client id, I2C_DEFAULT_CLIENT if none was bound.
+       */
+      int get_thread_client();
+      
+      /**
+       * @brief Gets the bus wait time metrics of a client.
+       * 
+       * @param[in] client Client id returned by register_client() or 
+       *                   I2C_DEFAULT_CLIENT.
+       * @param[out] stats Structure where the metrics will be stored.
+       *
+       * @return 0 if success, -1 if error.
+       */
+      int get_client_stats(int client, i2c_client_stats *stats);
+      
+      /**
+       * @brief Clears the bus wait time metrics of a client.
+       * 
+       * @param[in] client Client id returned by register_client() or 
+       *                   I2C_DEFAULT_CLIENT.
+       *
+       * @return 0 if success, -1 if error.
+       */
+      int reset_client_stats(int client);
+      
+      /**
+       * @brief Enables or disables transaction tracing. While enabled, every 
+       *        transaction is recorded into a lock-free ring buffer of the last
+       *        I2C_TRACE_LEN transactions and into the per-device latency 
+       *        histograms.
+       * 
+       * @param[in] enabled True to start tracing, false to stop it.
+       */
+      void set_trace(bool enabled);
+      
+      /**
+       * @brief Copies the traced transactions, oldest first. Records being
+       *        overwritten while reading are skipped.
+       * 
+       * @param[out] records Array where the records will be stored.
+       * @param[in] max_records Length of the records array.
+       *
+       * @return The number of records copied.
+       */
+      int read_trace(i2c_trace_record records[], int max_records);
+      
+      /**
+       * @brief Writes the traced transactions to a binary file that can be 
+       *        served again with the I2C_Replay backend.
+       * 
+       * @param[in] path Destination file.
+       *
+       * @return The number of records written if success, -1 if error.
+       */
+      int dump_trace(const char *path);
+      
+      /**
+       * @brief Gets the latency histogram of a slave device on bus 0.
+       * 
+       * @param[in] addr I2C 7-bits slave address.
+       * @param[out] hist Structure where the histogram will be stored.
+       *
+       * @return 0 if success, -1 if error.
+       */
+      int get_latency_histogram(uint8_t addr, i2c_latency_histogram *hist);
+      
+      /**
+       * @brief get_latency_histogram() on the given bus.
+       *
+       * @return 0 if success, -1 if error.
+       */
+      int get_latency_histogram_bus(int bus, uint8_t addr, i2c_latency_histogram *hist);
+      
+      /**
+       * @brief Clears the traced transactions and every latency histogram.
+       */
+      void reset_trace();
+      
       /**
        * @brief End I2C communications and free all the related resources.
        * 
@@ -0,0 +1,201 @@
+/**
+  ******************************************************************************
+  * @file   i2c_replay.cpp
+  * @brief  I2C Trace Replay Backend.
+  *
+  * @note   End-of-degree work.
+  *         I2C backend that serves the transactions stored in a trace file
+  *         written by I2C_Master::dump_trace().
+  ******************************************************************************
+*/
+/* Includes ------------------------------------------------------------------*/
+#include "i2c_replay.h" // Module header
+#include "i2c_trace.h"
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <thread>
+
+/* Private defines -----------------------------------------------------------*/
+/* Private typedef -----------------------------------------------------------*/
+/* Private variables----------------------------------------------------------*/
+/* Private function prototypes -----------------------------------------------*/
+/* Functions -----------------------------------------------------------------*/
+
+/**
+ * @brief Class constructor.
+ *
+ * @param[in] timing If true, every transaction takes the time it took when it was
+ *                   recorded, so bus stalls are reproduced as well.
+ * @param[in] bus Bus index whose records are served.
+ */
+I2C_Replay::I2C_Replay(bool timing, int bus){
+  this->timing = timing;
+  this->bus = bus;
+  rewind();
+}
+
+
+/**
+ * @brief Loads a trace file and rewinds the replay.
+ *
+ * @param[in] path File written by I2C_Master::dump_trace().
+ *
+ * @return The number of records loaded if success, -1 if error.
+ */
+int I2C_Replay::load(const char *path){
+  i2c_trace_file_header header;
+  std::vector<i2c_trace_record> loaded;
+
+  FILE *file = std::fopen(path, "rb");
+  if(file == NULL)
+    return -1;
+
+  //The older version left the bus byte zeroed, so its records are of bus 0
+  if(std::fread(&header, sizeof(header), 1, file) != 1 ||
+     std::memcmp(header.magic, I2C_TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+     (header.version != I2C_TRACE_VERSION && header.version != I2C_TRACE_VERSION_NO_BUS) ||
+     header.record_size != sizeof(i2c_trace_record)){
+    std::fclose(file);
+    return -1;
+  }
+
+  loaded.resize(header.records);
+  if(std::fread(loaded.data(), sizeof(i2c_trace_record), header.records, file) != header.records){
+    std::fclose(file);
+    return -1;
+  }
+  std::fclose(file);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  records.swap(loaded);
+  for(int i = 0; i < 128; i++)
+    cursors[i] = 0;
+  mismatches = 0;
+
+  return records.size();
+}
+
+
+/**
+ * @brief Starts serving the trace again from the first record.
+ */
+void I2C_Replay::rewind(){
+  std::lock_guard<std::mutex> lock(mutex);
+  for(int i = 0; i < 128; i++)
+    cursors[i] = 0;
+  mismatches = 0;
+}
+
+
+/**
+ * @brief Number of transactions that did not match the trace. Unmatched reads
+ *        fail and return zeros, unmatched writes succeed.
+ */
+uint32_t I2C_Replay::get_mismatches(){
+  std::lock_guard<std::mutex> lock(mutex);
+  return mismatches;
+}
+
+
+/**
+ * @brief True once every record of the bus has been served or skipped.
+ */
+bool I2C_Replay::finished(){
+  std::lock_guard<std::mutex> lock(mutex);
+  for(const i2c_trace_record &rec : records){
+    size_t index = &rec - records.data();
+    if(rec.bus == bus && index >= cursors[rec.addr & 0x7F])
+      return false;
+  }
+  return true;
+}
+
+
+int I2C_Replay::open(int i2c_device){
+  return 0;
+}
+
+
+int I2C_Replay::write_msg(uint8_t addr, uint8_t data[], uint8_t data_length){
+  uint32_t duration_ns = 0;
+  int result = 1;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    const i2c_trace_record *rec = next_match(addr, data_length > 0 ? data[0] : 0, false);
+    if(rec == NULL){
+      mismatches++;
+    }
+    else{
+      duration_ns = rec->duration_ns;
+      result = rec->result < 0 ? -1 : 1;
+    }
+  }
+
+  if(timing && duration_ns > 0)
+    std::this_thread::sleep_for(std::chrono::nanoseconds(duration_ns));
+  return result;
+}
+
+
+int I2C_Replay::read_msg(uint8_t addr, uint8_t read_reg, uint8_t data[], uint8_t data_length){
+  uint32_t duration_ns = 0;
+  int result;
+
+  std::memset(data, 0, data_length);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    const i2c_trace_record *rec = next_match(addr, read_reg, true);
+    if(rec == NULL || rec->data_len < data_length){
+      //A truncated record cannot give back the whole read
+      mismatches++;
+      result = -1;
+    }
+    else{
+      std::memcpy(data, rec->data, rec->data_len < data_length ? rec->data_len : data_length);
+      duration_ns = rec->duration_ns;
+      result = rec->result < 0 ? -1 : 2;
+    }
+  }
+
+  if(timing && duration_ns > 0)
+    std::this_thread::sleep_for(std::chrono::nanoseconds(duration_ns));
+  return result;
+}
+
+
+int I2C_Replay::close(){
+  return 0;
+}
+
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+ * @brief Finds the next record of the device on the bus served with the same
+ *        direction and register, within I2C_REPLAY_LOOKAHEAD records of that
+ *        device, and moves the device cursor past it. Must be called with the
+ *        mutex held.
+ *
+ * @return The matching record, or NULL if there is none.
+ */
+const i2c_trace_record *I2C_Replay::next_match(uint8_t addr, uint8_t reg, bool is_read){
+  int seen = 0;
+
+  if(addr > 0x7F)
+    return NULL;
+
+  for(size_t i = cursors[addr]; i < records.size() && seen < I2C_REPLAY_LOOKAHEAD; i++){
+    const i2c_trace_record *rec = &records[i];
+    if(rec->addr != addr || rec->bus != bus)
+      continue;
+
+    seen++;
+    if(rec->reg == reg && (rec->is_read != 0) == is_read){
+      cursors[addr] = i + 1;
+      return rec;
+    }
+  }
+  return NULL;
+}
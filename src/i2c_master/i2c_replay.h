@@ -0,0 +1,82 @@
+/**
+  ******************************************************************************
+  * @file   i2c_replay.h
+  * @brief  I2C Trace Replay Backend header.
+  *
+  * @note   End-of-degree work.
+  *         I2C backend that serves the transactions stored in a trace file
+  *         written by I2C_Master::dump_trace(), so that field recordings can
+  *         be reproduced offline with the real drivers. Each instance serves
+  *         the records of one bus, so a recording of several buses is
+  *         replayed with one instance per bus.
+  ******************************************************************************
+*/
+
+#ifndef __I2C_REPLAY_H__
+#define __I2C_REPLAY_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <mutex>
+#include <vector>
+#include "i2c_backend.h"
+#include "i2c_master.h"
+
+/* Exported constants --------------------------------------------------------*/
+#define I2C_REPLAY_LOOKAHEAD  64  //Records of the same device searched for a match
+
+/* Exported types ------------------------------------------------------------*/
+
+class I2C_Replay : public I2C_Backend{
+  std::vector<i2c_trace_record> records;
+  size_t cursors[128];   //Per device of the bus served
+  int bus;
+  bool timing;
+  uint32_t mismatches;
+  std::mutex mutex;
+
+  const i2c_trace_record *next_match(uint8_t addr, uint8_t reg, bool is_read);
+public:
+
+  /**
+   * @brief Class constructor.
+   *
+   * @param[in] timing If true, every transaction takes the time it took when it was
+   *                   recorded, so bus stalls are reproduced as well.
+   * @param[in] bus Bus index whose records are served.
+   */
+  I2C_Replay(bool timing = false, int bus = 0);
+
+  /**
+   * @brief Loads a trace file and rewinds the replay.
+   *
+   * @param[in] path File written by I2C_Master::dump_trace().
+   *
+   * @return The number of records loaded if success, -1 if error.
+   */
+  int load(const char *path);
+
+  /**
+   * @brief Starts serving the trace again from the first record.
+   */
+  void rewind();
+
+  /**
+   * @brief Number of transactions that did not match the trace. Unmatched reads,
+   *        and reads longer than the data kept in their record, fail and return
+   *        zeros. Unmatched writes succeed.
+   */
+  uint32_t get_mismatches();
+
+  /**
+   * @brief True once every record of the bus has been served or skipped.
+   */
+  bool finished();
+
+  int open(int i2c_device) override;
+  int write_msg(uint8_t addr, uint8_t data[], uint8_t data_length) override;
+  int read_msg(uint8_t addr, uint8_t read_reg, uint8_t data[], uint8_t data_length) override;
+  int close() override;
+};
+
+#endif /* __I2C_REPLAY_H__ */
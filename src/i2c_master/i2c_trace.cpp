@@ -0,0 +1,264 @@
+/**
+  ******************************************************************************
+  * @file   i2c_trace.cpp
+  * @brief  I2C Transaction Tracing Module.
+  *
+  * @note   End-of-degree work.
+  *         Records the I2C transactions into a lock-free ring buffer and
+  *         per-device latency histograms, and dumps them to binary files.
+  ******************************************************************************
+*/
+/* Includes ------------------------------------------------------------------*/
+#include "i2c_trace.h" // Module header
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <mutex>
+
+/* Private defines -----------------------------------------------------------*/
+#define TRACE_MASK  (I2C_TRACE_LEN - 1)
+
+/* Private typedef -----------------------------------------------------------*/
+
+//Seqlock protected slot: seq is odd while the record is being written and
+//2 * (index + 1) once the record of that ring index is complete.
+struct trace_slot{
+  std::atomic<uint64_t> seq;
+  i2c_trace_record record;
+};
+
+struct device_histogram{
+  std::atomic<uint32_t> count;
+  std::atomic<uint32_t> errors;
+  std::atomic<uint32_t> max_us;
+  std::atomic<uint32_t> buckets[I2C_HIST_BUCKETS];
+};
+
+/* Private variables----------------------------------------------------------*/
+std::atomic<bool> I2C_Trace::enabled(false);
+
+static trace_slot ring[I2C_TRACE_LEN];
+static std::atomic<uint64_t> ring_head(0);
+static device_histogram histograms[I2C_MAX_BUSES][128];
+
+/* Private function prototypes -----------------------------------------------*/
+static int latency_bucket(uint32_t us);
+static bool read_slot(uint64_t index, i2c_trace_record *record);
+
+/* Functions -----------------------------------------------------------------*/
+
+/**
+ * @brief Enables or disables transaction tracing. While enabled, every 
+ *        transaction is recorded into a lock-free ring buffer of the last
+ *        I2C_TRACE_LEN transactions and into the latency histograms of
+ *        each device of each bus.
+ * 
+ * @param[in] enabled True to start tracing, false to stop it.
+ */
+void I2C_Master::set_trace(bool enabled){
+  I2C_Trace::enabled.store(enabled);
+}
+
+
+/**
+ * @brief Copies the traced transactions, oldest first. Records being
+ *        overwritten while reading are skipped.
+ * 
+ * @param[out] records Array where the records will be stored.
+ * @param[in] max_records Length of the records array.
+ *
+ * @return The number of records copied.
+ */
+int I2C_Master::read_trace(i2c_trace_record records[], int max_records){
+  uint64_t head = ring_head.load(std::memory_order_acquire);
+  uint64_t first = head > I2C_TRACE_LEN ? head - I2C_TRACE_LEN : 0;
+  int copied = 0;
+
+  if(head - first > (uint64_t)max_records)
+    first = head - max_records;
+
+  for(uint64_t i = first; i < head; i++){
+    if(read_slot(i, &records[copied]))
+      copied++;
+  }
+  return copied;
+}
+
+
+/**
+ * @brief Writes the traced transactions to a binary file that can be 
+ *        served again with the I2C_Replay backend.
+ * 
+ * @param[in] path Destination file.
+ *
+ * @return The number of records written if success, -1 if error.
+ */
+int I2C_Master::dump_trace(const char *path){
+  static i2c_trace_record records[I2C_TRACE_LEN];
+  static std::mutex dump_mutex;
+  std::lock_guard<std::mutex> lock(dump_mutex);
+  i2c_trace_file_header header;
+
+  int len = read_trace(records, I2C_TRACE_LEN);
+
+  std::memcpy(header.magic, I2C_TRACE_MAGIC, sizeof(header.magic));
+  header.version = I2C_TRACE_VERSION;
+  header.record_size = sizeof(i2c_trace_record);
+  header.records = len;
+
+  FILE *file = std::fopen(path, "wb");
+  if(file == NULL)
+    return -1;
+
+  if(std::fwrite(&header, sizeof(header), 1, file) != 1 ||
+     std::fwrite(records, sizeof(i2c_trace_record), len, file) != (size_t)len){
+    std::fclose(file);
+    return -1;
+  }
+
+  if(std::fclose(file) != 0)
+    return -1;
+  return len;
+}
+
+
+/**
+ * @brief Gets the latency histogram of a slave device on bus 0.
+ * 
+ * @param[in] addr I2C 7-bits slave address.
+ * @param[out] hist Structure where the histogram will be stored.
+ *
+ * @return 0 if success, -1 if error.
+ */
+int I2C_Master::get_latency_histogram(uint8_t addr, i2c_latency_histogram *hist){
+  return get_latency_histogram_bus(0, addr, hist);
+}
+
+
+/**
+ * @brief get_latency_histogram() on the given bus.
+ *
+ * @return 0 if success, -1 if error.
+ */
+int I2C_Master::get_latency_histogram_bus(int bus, uint8_t addr, i2c_latency_histogram *hist){
+  if(bus < 0 || bus >= I2C_MAX_BUSES || addr > 0x7F || hist == NULL)
+    return -1;
+
+  device_histogram *h = &histograms[bus][addr];
+  hist->count = h->count.load(std::memory_order_relaxed);
+  hist->errors = h->errors.load(std::memory_order_relaxed);
+  hist->max_us = h->max_us.load(std::memory_order_relaxed);
+  for(int i = 0; i < I2C_HIST_BUCKETS; i++)
+    hist->buckets[i] = h->buckets[i].load(std::memory_order_relaxed);
+  return 0;
+}
+
+
+/**
+ * @brief Clears the traced transactions and every latency histogram.
+ */
+void I2C_Master::reset_trace(){
+  //Records older than the new head are never read again
+  uint64_t head = ring_head.load();
+  ring_head.store(head + I2C_TRACE_LEN);
+  for(uint64_t i = head; i < head + I2C_TRACE_LEN; i++)
+    ring[i & TRACE_MASK].seq.store(0, std::memory_order_release);
+
+  for(int bus = 0; bus < I2C_MAX_BUSES; bus++){
+    for(int addr = 0; addr < 128; addr++){
+      device_histogram *h = &histograms[bus][addr];
+      h->count.store(0, std::memory_order_relaxed);
+      h->errors.store(0, std::memory_order_relaxed);
+      h->max_us.store(0, std::memory_order_relaxed);
+      for(int i = 0; i < I2C_HIST_BUCKETS; i++)
+        h->buckets[i].store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+
+/**
+ * @brief Records a finished transaction in the ring buffer and the histograms.
+ */
+void I2C_Trace::record(uint64_t start_ns, uint32_t duration_ns, uint8_t addr, uint8_t reg, bool is_read,
+                       const uint8_t data[], uint8_t data_length, int result, int client, int bus){
+  uint64_t index = ring_head.fetch_add(1, std::memory_order_relaxed);
+  trace_slot *slot = &ring[index & TRACE_MASK];
+  i2c_trace_record *rec = &slot->record;
+
+  slot->seq.store(2 * index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  rec->timestamp_ns = start_ns;
+  rec->duration_ns = duration_ns;
+  rec->addr = addr;
+  rec->reg = reg;
+  rec->length = data_length;
+  rec->is_read = is_read;
+  rec->result = result < 0 ? -1 : 0;
+  rec->client = client;
+  rec->data_len = data_length < I2C_TRACE_MAX_DATA ? data_length : I2C_TRACE_MAX_DATA;
+  rec->bus = bus;
+  if(data != NULL)
+    std::memcpy(rec->data, data, rec->data_len);
+
+  slot->seq.store(2 * (index + 1), std::memory_order_release);
+
+  //Histograms
+  if(addr > 0x7F || bus < 0 || bus >= I2C_MAX_BUSES)
+    return;
+  device_histogram *h = &histograms[bus][addr];
+  uint32_t us = duration_ns / 1000;
+  h->count.fetch_add(1, std::memory_order_relaxed);
+  if(result < 0)
+    h->errors.fetch_add(1, std::memory_order_relaxed);
+  h->buckets[latency_bucket(us)].fetch_add(1, std::memory_order_relaxed);
+
+  uint32_t max = h->max_us.load(std::memory_order_relaxed);
+  while(us > max && !h->max_us.compare_exchange_weak(max, us, std::memory_order_relaxed));
+}
+
+
+/**
+ * @brief Current time of the clock used for the records, in ns.
+ */
+uint64_t I2C_Trace::now_ns(){
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+ * @brief Histogram bucket of a latency: bucket i holds [2^(i-1), 2^i) us, the
+ *        first one everything under 1us and the last one everything above.
+ */
+static int latency_bucket(uint32_t us){
+  int bucket = 0;
+  while(us > 0 && bucket < I2C_HIST_BUCKETS - 1){
+    us >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+
+/**
+ * @brief Copies the record of a ring index if it is complete and not being
+ *        overwritten.
+ *
+ * @return True if the copy is consistent.
+ */
+static bool read_slot(uint64_t index, i2c_trace_record *record){
+  trace_slot *slot = &ring[index & TRACE_MASK];
+  uint64_t expected = 2 * (index + 1);
+
+  if(slot->seq.load(std::memory_order_acquire) != expected)
+    return false;
+
+  std::memcpy(record, &slot->record, sizeof(*record));
+  std::atomic_thread_fence(std::memory_order_acquire);
+
+  return slot->seq.load(std::memory_order_relaxed) == expected;
+}
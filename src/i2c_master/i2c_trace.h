@@ -0,0 +1,67 @@
+/**
+  ******************************************************************************
+  * @file   i2c_trace.h
+  * @brief  I2C Transaction Tracing Module header.
+  *
+  * @note   End-of-degree work.
+  *         Internal hooks used by the I2C Handler Module to record the
+  *         transactions, and the layout of the binary trace files.
+  ******************************************************************************
+*/
+
+#ifndef __I2C_TRACE_H__
+#define __I2C_TRACE_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <atomic>
+#include "i2c_master.h"
+
+/* Exported types ------------------------------------------------------------*/
+
+//Header of the files written by I2C_Master::dump_trace()
+typedef struct{
+
+  char magic[4];              //I2C_TRACE_MAGIC
+  uint16_t version;           //I2C_TRACE_VERSION
+  uint16_t record_size;       //sizeof(i2c_trace_record)
+  uint32_t records;           //Records following the header
+
+}i2c_trace_file_header;
+
+/* Exported constants --------------------------------------------------------*/
+#define I2C_TRACE_MAGIC     "I2CT"
+#define I2C_TRACE_VERSION   3
+#define I2C_TRACE_VERSION_NO_BUS  2 //Same records with the bus byte zeroed, all bus 0
+
+/* Exported Functions --------------------------------------------------------*/
+
+namespace I2C_Trace{
+
+  //Set while tracing is enabled. Checked by the I2C Handler before timing.
+  extern std::atomic<bool> enabled;
+
+  /**
+   * @brief Records a finished transaction in the ring buffer and the histograms.
+   * 
+   * @param[in] start_ns Start of the transaction (steady clock).
+   * @param[in] duration_ns Time spent in the backend.
+   * @param[in] addr I2C 7-bits slave address.
+   * @param[in] reg Register pointer, or first written byte.
+   * @param[in] is_read True for reads.
+   * @param[in] data Read data or written bytes.
+   * @param[in] data_length Bytes in data.
+   * @param[in] result Value returned by the backend.
+   * @param[in] client Scheduler client that issued the transaction.
+   * @param[in] bus Bus index the transaction went through.
+   */
+  void record(uint64_t start_ns, uint32_t duration_ns, uint8_t addr, uint8_t reg, bool is_read,
+              const uint8_t data[], uint8_t data_length, int result, int client, int bus);
+
+  /**
+   * @brief Current time of the clock used for the records, in ns.
+   */
+  uint64_t now_ns();
+}
+
+#endif /* __I2C_TRACE_H__ */
@@ -9,14 +9,23 @@
 #include <mutex>
 #include <unistd.h>
 #include <csignal>
+#include <cstring>
+#include <cmath>
 #include <mqtt/client.h>
 #include <mqtt/async_client.h>
 #include <json/json.h>
 #include "./LSM6DSOX/LSM6DSOX.h"
 #include "./IAQTracker/IAQTracker.h"
+#include "./VibrationAnalyzer/VibrationAnalyzer.h"
+#include "./AttitudeFilter/AttitudeFilter.h"
+#include "./MotionCodec/MotionCodec.h"
 #include "./BME688/BME688.h"
 #include "./TFTDriver/display_driver.h"
 #include "./APDS9660/APDS9660_lib.h"
+#include "./APDS9660/gesture_classifier.h"
+#include "./APDS9660/als_autorange.h"
+#include "./APDS9660/light_meter.h"
+#include "./OccupancyEngine/OccupancyEngine.h"
 #include "./custom_gpio/custom_gpio.h"
 #include "./PWMDriver/custom_PWM.h"
 #include "./TFTDriver/fonts/FreeMono12pt7b.h"
@@ -24,10 +33,41 @@
 #include "./TFTDriver/icons.h"
 #include "./thread_signals/thread_queue.h"
 #include "./thread_signals/thread_flag.h"
+#include "./I2CSimulator/sim_devices.h"
+#include "./i2c_master/i2c_async.h"
 
 //Maximum occupation allowed
 #define MAX_OCCUPATION 100
 
+//Sensor threads configuration
+#define ACCEL_FIFO_WATERMARK 208 //250 ms of accelerometer and gyroscope samples at 416 Hz
+#define ACCEL_INT1_GPIO 6 //LSM6DSOX INT1 pin
+#define ACCEL_INT_TIMEOUT 300 //ms, fallback polling if the interrupt is missed
+#define APDS_INT_GPIO 5 //APDS9660 INT pin, active low
+#define APDS_ALS_PERIOD 50 //ms between light reads
+#define APDS_GESTURE_IDLE 150 //ms without datasets that end a pass
+#define APDS_PROX_NEAR 50 //Proximity over which someone is in front of the sensor
+#define APDS_PROX_FAR 30 //Proximity under which they have left
+#define APDS_PROX_PERSISTENCE 4 //Proximity cycles a crossing has to last
+#define DOOR_WAKE_UP_THS 0.5 //g, acceleration slope that wakes the thread early
+#define DOOR_SWING_RATE 15 //dps around the vertical that means the door moves
+#define DOOR_MOTION_HOLD 1000 //ms under the swing rate to consider the door still
+#define DOOR_OPEN_ANGLE 20 //deg from the closed position over which the door is open
+#define DOOR_CLOSED_ANGLE 5 //deg under which it is closed again
+#define APDS_OCC_SENSOR 0 //Occupancy engine id of the door sensor
+#define APDS_OCC_DOOR 0 //Door it watches
+#define OCC_TICK_MS 1000 //Drift correction period
+#define VIB_FFT_LEN 256 //0.6 s frames at 416 Hz, 1.6 Hz resolution
+#define VIB_HOP 128 //50% overlap
+#define MLC_UCF_FILE "cabin_motion.ucf" //Machine Learning Core program, optional
+
+//File where the I2C trace is dumped when running with --i2c-trace
+#define I2C_TRACE_FILE "i2c_trace.bin"
+
+//File where the full rate IMU stream is appended when running with --motion-log
+#define MOTION_LOG_FILE "motion.bin"
+#define IMU_PERIOD_US 2404 //416 Hz
+
 //Time variables defined for MQTT
 #define TIMEOUT 2
 #define KEEPALIVE 500
@@ -42,6 +82,9 @@
 //Run variable
 static uint8_t on = 1;
 
+//Archive of the IMU stream, decoded with tools/motion_decode
+static bool motion_log = false;
+
 //Widely used colors
 static uint8_t white_color[] = { 0xFF, 0xFF };
 static uint8_t red_color[] = { 0xf8, 0x00 };
@@ -76,22 +119,37 @@ Thread_queue<acceleration_val> accel_q;
 
 Thread_queue<color_data> rgb_q;
 
-Thread_queue<uint8_t> prox_q;
-
 Thread_queue<gas_meas> gas_q;
 
 Thread_queue<uint8_t> gesture;
 
 Thread_queue<uint8_t> joystick_button;
 
+//Passages, presence and door events for the occupancy engine
+Thread_queue<occupancy_event> occ_events;
+
+//Last vibration spectrum features, written by the accelerometer thread
+vibration_features vib_data;
+std::mutex vib_mutex;
+
+//Vibration bands: structure, HVAC fans, compressors and motors, bearings
+static const float vib_band_edges[] = { 2, 10, 30, 80, 200 };
+
 //Flag to syncronize the MQTT thread
 Thread_flag mqtt_sync = Thread_flag();
 
 //Atomic variables for synchronization between threads
 std::atomic<int> occ_data(0);
+std::atomic<float> occ_confidence(1);
 std::atomic<float> selected_temp(25);
 std::atomic<int> brightness(25);
 std::atomic<bool> pollution_danger(false);
+std::atomic<bool> door_moving(false);
+std::atomic<bool> someone_near(false);
+std::atomic<float> door_angle(0);
+std::atomic<float> cabin_roll(0);
+std::atomic<float> cabin_pitch(0);
+std::atomic<int> cabin_motion(-1); //MLC tree 0: stationary, vibrating, door swing, tampering
 std::atomic<bool> mqtt_connect(false);
 
 //Thread function prototypes
@@ -104,8 +162,13 @@ void BME688_thread();
 
 void joystick_thread();
 
+void occupancy_thread();
+
 void mqtt_thread();
 
+//Steady clock time of the occupancy events
+static uint64_t steady_ms();
+
 //Display writers
 
 //Prints home page
@@ -144,7 +207,31 @@ void erase_display();
 //End program in orderly manner
 void signalHandler( int signum );
 
-int main() {
+int main(int argc, char *argv[]) {
+
+	//Simulated sensors, to run the whole pipeline without the hardware
+	static I2CSimulator::Bus sim_bus;
+	static I2CSimulator::BME688_device sim_bme;
+	static I2CSimulator::LSM6DSOX_device sim_lsm;
+	static I2CSimulator::APDS9660_device sim_apds;
+
+	bool i2c_trace = false;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--i2c-sim") == 0) {
+			sim_bus.attach(&sim_bme);
+			sim_bus.attach(&sim_lsm);
+			sim_bus.attach(&sim_apds);
+			I2C_Master::set_backend(&sim_bus);
+			printf("Using simulated I2C sensors\n");
+		} else if (strcmp(argv[i], "--i2c-trace") == 0) {
+			//Bus trace dumped on exit, can be replayed with I2C_Replay
+			I2C_Master::set_trace(true);
+			i2c_trace = true;
+		} else if (strcmp(argv[i], "--motion-log") == 0) {
+			motion_log = true;
+		}
+	}
 
 	occ_data = 0;
 	bool light_auto = true;
@@ -175,6 +262,8 @@ int main() {
 
 	std::thread joy_thread(joystick_thread);
 
+	std::thread occ_thread(occupancy_thread);
+
 	std::thread thingsboard_th(mqtt_thread);
 
 	signal(SIGTERM, signalHandler);
@@ -184,7 +273,6 @@ int main() {
 	Display_driver::init_display();
 
 	gas_meas gas;
-	acceleration_val accel_data;
 
 	uint8_t button_pressed = 5;
 
@@ -226,7 +314,7 @@ int main() {
 			home_page(gas.temp, gas.humid, gas.iaq, occ_data);
 
 			if (light_auto)
-				print_light_sim(rgb_q.back_clear().clear);
+				print_light_sim(rgb_q.back_clear().lux);
 			else
 				print_light_sim(brightness);
 
@@ -236,9 +324,7 @@ int main() {
 				erase_display();
 				state = TEMP;
 			} else if (button_pressed == JOY_CENTER) {
-				accel_data = accel_q.back_clear();
-				if ((abs(accel_data.x) > 0.5 || abs(accel_data.z) > 0.5)
-						&& door_auto) {
+				if (door_moving && door_auto) {
 					print_door_button(red_color);
 				} else {
 					print_door_button(green_color);
@@ -254,7 +340,7 @@ int main() {
 			button_pressed = joystick_button.pop(100);
 
 			if (light_auto)
-				print_light_sim(rgb_q.back_clear().clear);
+				print_light_sim(rgb_q.back_clear().lux);
 			else
 				print_light_sim(brightness);
 
@@ -279,7 +365,7 @@ int main() {
 			button_pressed = joystick_button.pop(100);
 
 			if (light_auto)
-				print_light_sim(rgb_q.back_clear().clear);
+				print_light_sim(rgb_q.back_clear().lux);
 			else
 				print_light_sim(brightness);
 
@@ -296,7 +382,7 @@ int main() {
 		case BRIGHT:
 
 			if (light_auto)
-				print_light_sim(rgb_q.back_clear().clear);
+				print_light_sim(rgb_q.back_clear().lux);
 			else
 				print_light_sim(brightness);
 
@@ -334,6 +420,7 @@ int main() {
 	accel_thread.join();
 	color_thread.join();
 	gas_thread.join();
+	occ_thread.join();
 	Display_driver::uninit();
 	mqtt_sync.set();
 	thingsboard_th.join();
@@ -348,6 +435,11 @@ int main() {
 
 	joy_thread.join();
 
+	I2C_Async::stop();
+
+	if (i2c_trace && I2C_Master::dump_trace(I2C_TRACE_FILE) < 0)
+		printf("Error dumping I2C trace\n");
+
 	printf("Threads finished");
 
 	return 0;
@@ -402,6 +494,10 @@ void mqtt_thread() {
 
 			telemetry_object["clear"] = rgb_q.back().clear;
 
+			telemetry_object["lux"] = rgb_q.back().lux;
+
+			telemetry_object["cct"] = rgb_q.back().cct;
+
 			telemetry_object["x"] = accel_q.back().x;
 
 			telemetry_object["y"] = accel_q.back().y;
@@ -414,6 +510,27 @@ void mqtt_thread() {
 
 			telemetry_object["humid"] = gas_q.back().humid;
 			telemetry_object["occupation"] = occ_data.load();
+			telemetry_object["occ_confidence"] = occ_confidence.load();
+
+			telemetry_object["presence"] = someone_near.load();
+
+			telemetry_object["door_angle"] = door_angle.load();
+			telemetry_object["roll"] = cabin_roll.load();
+			telemetry_object["pitch"] = cabin_pitch.load();
+
+			if (cabin_motion != -1)
+				telemetry_object["motion_state"] = cabin_motion.load();
+
+			vib_mutex.lock();
+			if (vib_data.frames > 0) {
+				telemetry_object["vib_rms"] = vib_data.rms;
+				telemetry_object["vib_peak_hz"] = vib_data.peak_freq;
+				telemetry_object["vib_peak"] = vib_data.peak_amplitude;
+				for (int b = 0; b < vib_data.bands; b++)
+					telemetry_object["vib_band" + std::to_string(b)] =
+							vib_data.band_rms[b];
+			}
+			vib_mutex.unlock();
 
 			if (gas_q.back().iaq != -1)
 				telemetry_object["iaq"] = gas_q.back().iaq;
@@ -435,6 +552,34 @@ void mqtt_thread() {
 	}
 }
 
+void occupancy_thread() {
+
+	OccupancyEngine engine(MAX_OCCUPATION);
+
+	occupancy_event event;
+
+	uint64_t next_tick = steady_ms() + OCC_TICK_MS;
+
+	while (on) {
+
+		//Events are counted as they arrive, the timeout only drives the drift correction
+		if (occ_events.pop(&event, OCC_TICK_MS) == 0)
+			engine.push(&event);
+
+		uint64_t now = steady_ms();
+		if (now >= next_tick) {
+			if (engine.tick(now))
+				printf("Occupation reset after a quiet period\n");
+			next_tick = now + OCC_TICK_MS;
+		}
+
+		occ_data = engine.get_count();
+		occ_confidence = engine.get_confidence();
+	}
+
+	return;
+}
+
 void joystick_thread() {
 
 	CustomGPIO::GPIO up(25);
@@ -464,65 +609,314 @@ void joystick_thread() {
 
 void LSM6DSOX_thread() {
 
-	LSM6DSOX accel(LSM6DSOX_52_HZ_ODR, LSM6DSOX_52_HZ_ODR, ACC_2_G_FSR,
+	I2C_Master::register_client("LSM6DSOX", I2C_PRIO_HIGH, 5000);
+
+	LSM6DSOX accel(LSM6DSOX_416_HZ_ODR, LSM6DSOX_416_HZ_ODR, ACC_2_G_FSR,
 			GYR_250_DPS_FSR);
 
-	int i = 0;
+	//The cabin motion classifier runs in the sensor if its program is installed
+	bool mlc_ready = accel.load_ucf(MLC_UCF_FILE) == 0;
+	uint16_t int1_sources = LSM6DSOX_INT_FIFO_WTM | LSM6DSOX_INT_WAKE_UP;
+	if (mlc_ready)
+		int1_sources |= LSM6DSOX_INT_EMB_FUNC;
+
+	//Accelerometer and gyroscope batched in the FIFO at 416 Hz, drained 4 times per second
+	//Raw words converted per batch into one array per axis
+	static int16_t acc_raw[ACCEL_FIFO_WATERMARK * 2 * 3];
+	static int16_t gyr_raw[ACCEL_FIFO_WATERMARK * 2 * 3];
+	static float acc_x[ACCEL_FIFO_WATERMARK * 2], acc_y[ACCEL_FIFO_WATERMARK * 2],
+			acc_z[ACCEL_FIFO_WATERMARK * 2];
+	static float gyr_x[ACCEL_FIFO_WATERMARK * 2], gyr_y[ACCEL_FIFO_WATERMARK * 2],
+			gyr_z[ACCEL_FIFO_WATERMARK * 2];
+	int n_acc, n_gyr;
+
+	//Every batch is archived as one compressed block per sensor
+	static uint8_t motion_block[MOTION_BLOCK_MAX_LEN(ACCEL_FIFO_WATERMARK * 2)];
+	FILE *motion_file = motion_log ? fopen(MOTION_LOG_FILE, "ab") : NULL;
+	if (motion_log && motion_file == NULL)
+		perror(MOTION_LOG_FILE);
+
+	//Vibration spectrum of the acceleration norm, nothing is allocated in the loop
+	static float vib_samples[ACCEL_FIFO_WATERMARK * 2];
+	VibrationAnalyzer vibration(VIB_FFT_LEN, VIB_HOP, 416,
+			vib_band_edges, sizeof(vib_band_edges) / sizeof(float) - 1);
+
+	//Orientation fused at the FIFO rate, the door is assumed closed at start
+	AttitudeFilter attitude(416);
+	float gyr_sample[3] = { 0, 0, 0 };
+
+	accel.set_fifo_batch_rates(LSM6DSOX_BDR_416_HZ, LSM6DSOX_BDR_416_HZ);
+	accel.set_fifo_watermark(ACCEL_FIFO_WATERMARK);
+	accel.set_fifo_mode(LSM6DSOX_FIFO_CONTINUOUS);
+
+	//A bump or a door push wakes the thread before the watermark
+	accel.set_wake_up(DOOR_WAKE_UP_THS, 1);
+
+	//The thread sleeps until the FIFO watermark or a wake-up raises INT1
+	CustomGPIO::GPIO accel_int(ACCEL_INT1_GPIO);
+	bool int_ready = accel_int.setInput(CustomGPIO::GPIO_INT_RISING) == 0
+			&& accel.set_int_route(LSM6DSOX_INT1, int1_sources) == 0;
+	if (!int_ready) //Detectors still on, polled
+		accel.set_int_route(LSM6DSOX_INT1,
+				int1_sources & ~LSM6DSOX_INT_FIFO_WTM);
 
 	acceleration_val accel_data;
+	lsm6dsox_motion_events events;
+	lsm6dsox_mlc_event mlc_events[LSM6DSOX_MLC_TREES];
+	auto last_motion = std::chrono::steady_clock::now();
+	bool reference_set = false;
+	bool door_open = false;
 
 	while (on) {
 
-		accel.get_acc_values(&accel_data.x, &accel_data.y, &accel_data.z);
+		if (!int_ready) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(250));
+		} else if (accel_int.read() != 1) {
+			//A timeout only happens if the pin is not wired, read anyway
+			CustomGPIO::GPIO::waits(&accel_int, 1, ACCEL_INT_TIMEOUT);
+		}
 
-		accel_q.push(accel_data);
+		accel.get_motion_events(&events); //Clears the latched wake-up
 
-		i++;
+		if (mlc_ready) {
+			int n_mlc = accel.get_mlc_events(mlc_events, LSM6DSOX_MLC_TREES);
+			for (int i = 0; i < n_mlc; i++) {
+				if (mlc_events[i].tree == 0)
+					cabin_motion = mlc_events[i].value;
+			}
+		}
 
-		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		//On a bus error the counts still cover the words already read
+		accel.read_fifo_raw(acc_raw, &n_acc, gyr_raw, &n_gyr,
+				ACCEL_FIFO_WATERMARK * 2);
+		accel.convert_acc(acc_raw, n_acc, acc_x, acc_y, acc_z);
+		accel.convert_gyr(gyr_raw, n_gyr, gyr_x, gyr_y, gyr_z);
+
+		//Keep the strongest sample so short vibrations are not missed
+		float peak = -1;
+		float swing_rate = 0;
+		int n_vib = 0;
+		for (int i = 0; i < n_acc; i++) {
+			//Both sensors are batched at the same rate, so they pair by index
+			if (i < n_gyr) {
+				gyr_sample[0] = gyr_x[i];
+				gyr_sample[1] = gyr_y[i];
+				gyr_sample[2] = gyr_z[i];
+			}
+
+			float acc_sample[3] = { acc_x[i], acc_y[i], acc_z[i] };
+			attitude.update(gyr_sample, acc_sample);
+			if (std::fabs(attitude.get_vertical_rate()) > swing_rate)
+				swing_rate = std::fabs(attitude.get_vertical_rate());
+
+			vib_samples[n_vib++] = std::sqrt(
+					acc_x[i] * acc_x[i] + acc_y[i] * acc_y[i] + acc_z[i] * acc_z[i]);
+			float magnitude = std::fabs(acc_x[i]) + std::fabs(acc_z[i]);
+			if (magnitude > peak) {
+				peak = magnitude;
+				accel_data.x = acc_x[i];
+				accel_data.y = acc_y[i];
+				accel_data.z = acc_z[i];
+			}
+		}
+
+		if (peak >= 0)
+			accel_q.push(accel_data);
+
+		//Only a rotation around the hinge moves the door, bumps do not
+		auto now = std::chrono::steady_clock::now();
+		if (swing_rate > DOOR_SWING_RATE) {
+			last_motion = now;
+			door_moving = true;
+		} else if (now - last_motion
+				> std::chrono::milliseconds(DOOR_MOTION_HOLD)) {
+			door_moving = false;
+		}
+
+		if (n_acc > 0) {
+			attitude_angles angles;
+			if (!reference_set) {
+				attitude.set_reference();
+				reference_set = true;
+			}
+			attitude.get_angles(&angles);
+			cabin_roll = angles.roll;
+			cabin_pitch = angles.pitch;
+			door_angle = attitude.get_swing_angle();
+
+			//Hysteresis so a door resting near a threshold does not toggle
+			float opening = std::fabs(door_angle.load());
+			if (!door_open && opening > DOOR_OPEN_ANGLE) {
+				door_open = true;
+				occupancy_event event = { OCC_EVENT_DOOR_OPEN, 0, APDS_OCC_DOOR, 1,
+						steady_ms() };
+				occ_events.push(event);
+			} else if (door_open && opening < DOOR_CLOSED_ANGLE) {
+				door_open = false;
+				occupancy_event event = { OCC_EVENT_DOOR_CLOSED, 0, APDS_OCC_DOOR, 1,
+						steady_ms() };
+				occ_events.push(event);
+			}
+		}
+
+		if (vibration.push(vib_samples, n_vib) > 0) {
+			vib_mutex.lock();
+			vibration.get_features(&vib_data);
+			vib_mutex.unlock();
+		}
+
+		if (motion_file != NULL) {
+			//The batch ends now, the first sample is one batch earlier
+			uint64_t now_us = std::chrono::duration_cast<std::chrono::microseconds>(
+					std::chrono::system_clock::now().time_since_epoch()).count();
+			motion_block_info block = { LSM6DSOX_SAMPLE_ACC, 0, 0, IMU_PERIOD_US,
+					accel.get_acc_lsb() };
+			block.t0_us = now_us - (uint64_t) n_acc * IMU_PERIOD_US;
+			int len = MotionCodec::encode_block(&block, acc_raw, n_acc,
+					motion_block, sizeof(motion_block));
+			if (n_acc > 0 && len > 0)
+				fwrite(motion_block, 1, len, motion_file);
+
+			block.type = LSM6DSOX_SAMPLE_GYR;
+			block.lsb = accel.get_gyr_lsb();
+			block.t0_us = now_us - (uint64_t) n_gyr * IMU_PERIOD_US;
+			len = MotionCodec::encode_block(&block, gyr_raw, n_gyr, motion_block,
+					sizeof(motion_block));
+			if (n_gyr > 0 && len > 0)
+				fwrite(motion_block, 1, len, motion_file);
+		}
 
 	}
 
+	if (motion_file != NULL)
+		fclose(motion_file);
+
 	return;
 
 }
 
 void APDS9660_thread() {
 
-	APDS9660_Master::conf_proximity(3, 3);
-	APDS9660_Master::conf_rgbc(3);
+	//Gesture sampling is time-critical: fast passes are lost if the FIFO waits
+	I2C_Master::register_client("APDS9660", I2C_PRIO_CRITICAL, 2000);
+
+	//Door sensor, straight on the default bus
+	static APDS9660 apds;
 
-	APDS9660_Master::conf_gesture(3, 5, 5);
+	apds.conf_proximity(3, 3);
+	apds.conf_rgbc(3);
+
+	//Gain and integration time follow the cabin light
+	ALSAutoRange als_range(&apds);
+	als_range.init();
+	LightMeter light_meter;
+
+	apds.conf_gesture(3, 5, 5);
+
+	//The FIFO is read when the sensor asks for it, passes between polls are not lost
+	CustomGPIO::GPIO apds_int(APDS_INT_GPIO);
+	bool int_ready = apds_int.setInput(CustomGPIO::GPIO_INT_FALLING) == 0
+			&& apds.conf_gesture_int(1, GES_FIFO_TH_4) == 0;
+
+	//Proximity is only read when someone arrives or leaves
+	apds.conf_proximity_int(1, APDS_PROX_FAR,
+			APDS_PROX_NEAR, APDS_PROX_PERSISTENCE);
+	bool int_pending = false;
 
 	uint8_t valid_ges = 0;
 
+	static uint8_t ges_datasets[GES_FIFO_DATASETS * 4];
+	static GestureClassifier classifier;
+	gesture_event events[8];
+	int n_events = 0;
+	auto last_dataset = std::chrono::steady_clock::now();
+	uint64_t last_dataset_ms = steady_ms();
+
 	uint8_t prox = 0;
 
 	color_data color;
 
+	auto next_als = std::chrono::steady_clock::now();
+
 	while (on) {
 
-		prox = APDS9660_Master::read_proximity();
+		auto now = std::chrono::steady_clock::now();
 
-		color = APDS9660_Master::read_rgbc();
+		if (now >= next_als) {
 
-		valid_ges = APDS9660_Master::check_gesture();
+			//Only fresh samples are queued, failed reads are retried by the I2C layer
+			if (apds.read_rgbc(&color) == 0
+					&& als_range.update(&color) == 1) {
+				light_meter.process(&color, 1);
+				rgb_q.push(color);
+			}
 
-		if (valid_ges) {
+			next_als = now + std::chrono::milliseconds(APDS_ALS_PERIOD);
+		}
+
+		if (int_ready) {
+			//The pin stays low until the FIFO is read, so a missed edge is seen here
+			if (apds_int.read() != 0) {
+				int wait_ms = std::chrono::duration_cast<
+						std::chrono::milliseconds>(
+						next_als - std::chrono::steady_clock::now()).count();
+				if (wait_ms > 0)
+					CustomGPIO::GPIO::waits(&apds_int, 1, wait_ms);
+			}
+			int_pending = apds_int.read() == 0;
+			valid_ges = int_pending;
+		} else {
+			valid_ges = apds.check_gesture();
+			int_pending = true;
+		}
 
-			uint8_t gest = APDS9660_Master::read_ges_fifo_ud();
-			if (gest == UP) {
-				occ_data++;
-			} else if (gest == DOWN) {
-				occ_data--;
+		//Without the pin the status is polled, the thresholds still filter
+		if (int_pending) {
+			int prox_event = apds.read_proximity_event(&prox);
+			if (prox_event == PROX_NEAR || prox_event == PROX_FAR) {
+				someone_near = prox_event == PROX_NEAR;
+				occupancy_event event = { OCC_EVENT_NEAR, APDS_OCC_SENSOR,
+						APDS_OCC_DOOR, 1, steady_ms() };
+				if (prox_event == PROX_FAR)
+					event.type = OCC_EVENT_FAR;
+				occ_events.push(event);
 			}
 		}
 
-		prox_q.push(prox);
+		n_events = 0;
+		if (valid_ges) {
+			int n = apds.read_ges_fifo(ges_datasets, GES_FIFO_DATASETS);
+			if (n > 0) {
+				n_events = classifier.push(ges_datasets, n, events, 8);
+				last_dataset = std::chrono::steady_clock::now();
+				last_dataset_ms = steady_ms();
+			}
+		} else if (classifier.in_pass()
+				&& std::chrono::steady_clock::now() - last_dataset
+						> std::chrono::milliseconds(APDS_GESTURE_IDLE)) {
+			//The last datasets may stay under the FIFO threshold
+			int n = apds.read_ges_fifo(ges_datasets, GES_FIFO_DATASETS);
+			if (n > 0) {
+				n_events = classifier.push(ges_datasets, n, events, 8);
+				last_dataset_ms = steady_ms();
+			}
+			n_events += classifier.flush(&events[n_events], 8 - n_events);
+		}
 
-		rgb_q.push(color);
+		//The engine weighs and counts the passes, each one at the time it ended
+		for (int i = 0; i < n_events; i++) {
+			occupancy_event event = { OCC_EVENT_ENTRY, APDS_OCC_SENSOR,
+					APDS_OCC_DOOR, events[i].confidence, last_dataset_ms
+							- (uint64_t) events[i].age * GESTURE_DATASET_US / 1000 };
+			if (events[i].direction == DOWN)
+				event.type = OCC_EVENT_EXIT;
+			else if (events[i].direction != UP)
+				continue;
+			occ_events.push(event);
+		}
 
-		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		if (!int_ready)
+			std::this_thread::sleep_for(std::chrono::milliseconds(APDS_ALS_PERIOD));
 	}
 
 	return;
@@ -530,6 +924,8 @@ void APDS9660_thread() {
 
 void BME688_thread() {
 
+	I2C_Master::register_client("BME688", I2C_PRIO_BACKGROUND, I2C_NO_DEADLINE);
+
 	BME688 gas_sensor(25, 0);
 
 	gas_sensor.init();
@@ -550,7 +946,13 @@ void BME688_thread() {
 
 	while (on) {
 
-		gas_sensor.get_data_one_measure(&temp, &press, &humid, &gas_resistance);
+		//Non-blocking measure: the data field is read by the I2C worker
+		if (gas_sensor.start_measurement() == 0) {
+			while (gas_sensor.poll_result(&temp, &press, &humid,
+					&gas_resistance) == 1 && on) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+		}
 
 		if (tracker.get_IAQ(&iaq, temp, humid, gas_resistance) >= 0) {
 			data.iaq = iaq;
@@ -833,3 +1235,9 @@ void signalHandler( int signum ) {
 	on = 0;
 
 }
+
+static uint64_t steady_ms() {
+
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -98,6 +98,32 @@ public:
     	return item;
     }
 
+	/**
+	* @brief Pops the older element in the queue. If queue is empty it waits until an element is pushed or
+	* 		 timeout is reached. Unlike pop(timeout) it works with structured element types.
+	*
+	* @param[out] item Popped element, untouched on timeout.
+	* @param[in] timeout timeout in milliseconds.
+	*
+	* @return 0 if an element has been popped, -1 on timeout.
+	*/
+    int pop(T *item, int timeout)
+    {
+
+    	// acquire lock
+    	std::unique_lock<std::mutex> lock(m_mutex);
+
+    	// wait until queue is not empty
+    	if(!m_cond.wait_for(lock, std::chrono::milliseconds(timeout), [this]() { return !m_queue.empty(); }))
+    		return -1;
+
+    	// retrieve item
+    	*item = m_queue.front();
+    	m_queue.pop();
+
+    	return 0;
+    }
+
 	/**
 	* @brief Pops the oldest element in the queue without erasing it.
 	* 		 If queue is empty it waits until an element is pushed.
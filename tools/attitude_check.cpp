@@ -0,0 +1,313 @@
+/**
+  ******************************************************************************
+  * @file   attitude_check.cpp
+  * @brief  Attitude Filter Replay Check.
+  *
+  * @note   End-of-degree work.
+  *         Host check that replays an IMU log of MotionCodec blocks, as written
+  *         by the cabin controller with --motion-log, through the
+  *         AttitudeFilter the same way the LSM6DSOX thread does: accelerometer
+  *         and gyroscope blocks of a batch paired by index, and the swing
+  *         reference taken after the first batch.
+  *
+  *         The default log, data/door_swing.bin, is a door that rests 3 s,
+  *         opens 90 deg in 1.5 s, rests 3 s open, closes in 1.5 s and rests
+  *         3 s closed, with the sensor tilted, gyroscope bias and noise, at
+  *         416 Hz and the FSRs of the controller. Its roll, pitch and swing
+  *         errors are checked against the known motion. Any other log is
+  *         replayed and summarized only.
+  *
+  *         The time per update() is measured over the replayed samples.
+  *
+  *         Build and run: make -C tools check
+  *         Usage: attitude_check [motion.bin]
+  *                attitude_check --generate <motion.bin>
+  ******************************************************************************
+*/
+
+/* Includes ------------------------------------------------------------------*/
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "check.h"
+#include "../src/AttitudeFilter/AttitudeFilter.h"
+#include "../src/MotionCodec/MotionCodec.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define TYPE_ACC          0x02      //LSM6DSOX_SAMPLE_ACC
+#define TYPE_GYR          0x01      //LSM6DSOX_SAMPLE_GYR
+#define DEFAULT_LOG       "data/door_swing.bin"
+
+//Door swing log parameters
+#define SWING_PERIOD_US   2404      //416 Hz
+#define SWING_BATCH       208       //ACCEL_FIFO_WATERMARK
+#define SWING_ACC_LSB     (4.0f / 65536)    //+-2 g
+#define SWING_GYR_LSB     (500.0f / 65536)  //+-250 dps
+#define SWING_REST_S      3.0
+#define SWING_MOVE_S      1.5
+#define SWING_OPEN_DEG    90.0
+#define SWING_ROLL_DEG    2.0       //Sensor mounting tilt
+#define SWING_PITCH_DEG   -1.0
+#define SWING_ACC_NOISE   0.001     //g rms
+#define SWING_GYR_NOISE   0.06      //dps rms
+#define SWING_SEED        416
+
+//Tolerances on the door swing log, after the first batch
+#define TILT_TOLERANCE    0.5f      //deg, roll and pitch
+#define REST_TOLERANCE    1.0f      //deg, swing angle while the door rests
+#define MOVE_TOLERANCE    1.5f      //deg, swing angle while it moves
+#define UPDATE_BUDGET_NS  (SWING_PERIOD_US * 1000.0 / 100)  //1% of a sample period
+
+/* Private variables----------------------------------------------------------*/
+static const float swing_gyr_bias[3] = {0.5f, -0.3f, 0.4f};   //dps
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief Door angle of the door swing log.
+  *
+  * @param[in] t Time since the start, in s.
+  * @param[out] rate Angular rate, in deg/s.
+  *
+  * @return Angle around the vertical, in deg, positive counterclockwise.
+  */
+static double swing_truth(double t, double *rate){
+  const double open_start = SWING_REST_S;
+  const double close_start = 2 * SWING_REST_S + SWING_MOVE_S;
+  double phase = -1, sign = 1;
+
+  if(t >= open_start && t < open_start + SWING_MOVE_S)
+    phase = (t - open_start) / SWING_MOVE_S;
+  else if(t >= close_start && t < close_start + SWING_MOVE_S){
+    phase = (t - close_start) / SWING_MOVE_S;
+    sign = -1;
+  }
+
+  if(phase < 0){
+    *rate = 0;
+    return (t >= open_start + SWING_MOVE_S && t < close_start) ? SWING_OPEN_DEG : 0;
+  }
+
+  //Raised cosine, no jerk at the ends
+  *rate = sign * SWING_OPEN_DEG * M_PI / 2 * std::sin(M_PI * phase) / SWING_MOVE_S;
+  double opening = SWING_OPEN_DEG * (1 - std::cos(M_PI * phase)) / 2;
+  return sign > 0 ? opening : SWING_OPEN_DEG - opening;
+}
+
+static double swing_duration(){
+  return 3 * SWING_REST_S + 2 * SWING_MOVE_S;
+}
+
+static int16_t quantize(double value, float lsb){
+  double code = std::round(value / lsb);
+  return (int16_t)(code > 32767 ? 32767 : (code < -32768 ? -32768 : code));
+}
+
+/**
+  * @brief Writes the door swing log: the body is rotated by the door angle
+  *        around the vertical after the mounting tilt, so the gyroscope sees
+  *        the door rate through the tilt and the accelerometer sees gravity.
+  *
+  * @return 0 if success, -1 if error.
+  */
+static int generate(const char *path){
+  const double roll = SWING_ROLL_DEG * M_PI / 180, pitch = SWING_PITCH_DEG * M_PI / 180;
+  const double cr = std::cos(roll), sr = std::sin(roll), cp = std::cos(pitch), sp = std::sin(pitch);
+  std::mt19937 rng(SWING_SEED);
+  std::normal_distribution<double> acc_noise(0, SWING_ACC_NOISE), gyr_noise(0, SWING_GYR_NOISE);
+  static int16_t acc_raw[SWING_BATCH * 3], gyr_raw[SWING_BATCH * 3];
+  static uint8_t block[MOTION_BLOCK_MAX_LEN(SWING_BATCH)];
+
+  //World vertical in the tilted body frame, (Ry(pitch) Rx(roll))^T z
+  const double up[3] = {-sp, cp * sr, cp * cr};
+
+  FILE *file = fopen(path, "wb");
+  if(file == NULL){
+    perror(path);
+    return -1;
+  }
+
+  int total = (int)(swing_duration() * 1e6 / SWING_PERIOD_US);
+  for(int start = 0; start + SWING_BATCH <= total; start += SWING_BATCH){
+    for(int i = 0; i < SWING_BATCH; i++){
+      double rate;
+      swing_truth((start + i) * SWING_PERIOD_US / 1e6, &rate);
+      for(int axis = 0; axis < 3; axis++){
+        acc_raw[3 * i + axis] = quantize(up[axis] + acc_noise(rng), SWING_ACC_LSB);
+        gyr_raw[3 * i + axis] = quantize(up[axis] * rate + swing_gyr_bias[axis] + gyr_noise(rng), SWING_GYR_LSB);
+      }
+    }
+
+    motion_block_info info = {TYPE_ACC, 0, (uint64_t)start * SWING_PERIOD_US, SWING_PERIOD_US, SWING_ACC_LSB};
+    int len = MotionCodec::encode_block(&info, acc_raw, SWING_BATCH, block, sizeof(block));
+    if(len < 0 || fwrite(block, 1, len, file) != (size_t)len)
+      break;
+    info.type = TYPE_GYR;
+    info.lsb = SWING_GYR_LSB;
+    len = MotionCodec::encode_block(&info, gyr_raw, SWING_BATCH, block, sizeof(block));
+    if(len < 0 || fwrite(block, 1, len, file) != (size_t)len)
+      break;
+  }
+
+  if(ferror(file) || fclose(file) != 0){
+    perror(path);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+  * @brief Decodes a log into paired samples, as the LSM6DSOX thread pairs them.
+  *
+  * @param[out] samples gx, gy, gz, ax, ay, az per sample.
+  * @param[out] batches Samples in each batch.
+  * @param[out] period_us Sample period of the log.
+  *
+  * @return The number of corrupted blocks, -1 if the file cannot be read.
+  */
+static int load_log(const char *path, std::vector<float> *samples, std::vector<int> *batches, uint32_t *period_us){
+  FILE *in = fopen(path, "rb");
+  if(in == NULL){
+    perror(path);
+    return -1;
+  }
+
+  std::vector<uint8_t> data;
+  uint8_t chunk[4096];
+  size_t len;
+  while((len = fread(chunk, 1, sizeof(chunk), in)) > 0)
+    data.insert(data.end(), chunk, chunk + len);
+  fclose(in);
+
+  static int16_t raw[MOTION_BLOCK_MAX_SAMPLES * 3], acc[MOTION_BLOCK_MAX_SAMPLES * 3];
+  motion_block_info info, acc_info = {};
+  int n_acc = 0, corrupted = 0;
+  float gyr_sample[3] = {0, 0, 0};
+  size_t pos = 0;
+
+  *period_us = 0;
+  while(pos < data.size()){
+    int block_len = MotionCodec::decode_block(&data[pos], data.size() - pos, &info, raw, MOTION_BLOCK_MAX_SAMPLES);
+    if(block_len == 0)
+      break;
+    if(block_len < 0){
+      corrupted++;
+      pos++;
+      while(pos + 1 < data.size() && !(data[pos] == 'M' && data[pos + 1] == 'B'))
+        pos++;
+      continue;
+    }
+    pos += block_len;
+
+    if(info.type == TYPE_ACC){
+      acc_info = info;
+      n_acc = info.samples;
+      std::memcpy(acc, raw, sizeof(int16_t) * 3 * n_acc);
+      *period_us = info.period_us;
+      //The gyroscope block follows, unless the batch had no gyroscope samples
+      if(pos + 3 < data.size() && data[pos + 3] == TYPE_GYR)
+        continue;
+      info.samples = 0;
+    }else if(info.type != TYPE_GYR || n_acc == 0){
+      continue;
+    }
+
+    //Same pairing as the thread: the last gyroscope sample is held
+    for(int i = 0; i < n_acc; i++){
+      if(i < info.samples)
+        for(int axis = 0; axis < 3; axis++)
+          gyr_sample[axis] = raw[3 * i + axis] * info.lsb;
+      for(int axis = 0; axis < 3; axis++)
+        samples->push_back(gyr_sample[axis]);
+      for(int axis = 0; axis < 3; axis++)
+        samples->push_back(acc[3 * i + axis] * acc_info.lsb);
+    }
+    batches->push_back(n_acc);
+    n_acc = 0;
+  }
+
+  return corrupted;
+}
+
+int main(int argc, char *argv[]){
+  if(argc == 3 && std::strcmp(argv[1], "--generate") == 0)
+    return generate(argv[2]) == 0 ? 0 : 1;
+
+  const char *path = argc > 1 ? argv[1] : DEFAULT_LOG;
+  bool known_motion = argc <= 1;
+  std::vector<float> samples;
+  std::vector<int> batches;
+  uint32_t period_us;
+
+  int corrupted = load_log(path, &samples, &batches, &period_us);
+  if(corrupted < 0)
+    return 1;
+  CHECK(corrupted == 0);
+  CHECK(batches.size() > 1 && period_us > 0);
+  if(batches.size() <= 1 || period_us == 0)
+    return check_summary("attitude_check");
+
+  AttitudeFilter attitude(1e6f / period_us);
+  attitude_angles angles;
+  float max_tilt = 0, max_rest = 0, max_move = 0, max_swing = 0;
+  int n = 0;
+
+  for(size_t b = 0; b < batches.size(); b++){
+    for(int i = 0; i < batches[b]; i++, n++){
+      const float *sample = &samples[6 * n];
+      attitude.update(sample, sample + 3);
+      if(b == 0)
+        continue;
+
+      float swing = attitude.get_swing_angle();
+      if(std::fabs(swing) > max_swing)
+        max_swing = std::fabs(swing);
+      if(!known_motion)
+        continue;
+
+      double rate;
+      float error = std::fabs(swing - (float)swing_truth(n * period_us / 1e6, &rate));
+      if(rate == 0 && error > max_rest)
+        max_rest = error;
+      if(rate != 0 && error > max_move)
+        max_move = error;
+
+      attitude.get_angles(&angles);
+      float tilt = std::fmax(std::fabs(angles.roll - (float)SWING_ROLL_DEG),
+                             std::fabs(angles.pitch - (float)SWING_PITCH_DEG));
+      if(tilt > max_tilt)
+        max_tilt = tilt;
+    }
+    //The thread takes the reference once the first batch is fused
+    if(b == 0)
+      attitude.set_reference();
+  }
+
+  attitude.get_angles(&angles);
+  printf("%s: %d samples at %.0f Hz, max swing %.1f deg, final roll %.2f pitch %.2f swing %.2f deg\n",
+         path, n, 1e6 / period_us, max_swing, angles.roll, angles.pitch, attitude.get_swing_angle());
+
+  if(known_motion){
+    printf("max error: tilt %.3f deg, swing at rest %.3f deg, moving %.3f deg\n", max_tilt, max_rest, max_move);
+    CHECK(max_tilt < TILT_TOLERANCE);
+    CHECK(max_rest < REST_TOLERANCE);
+    CHECK(max_move < MOVE_TOLERANCE);
+    CHECK_NEAR(max_swing, SWING_OPEN_DEG, REST_TOLERANCE);
+  }
+
+  //Per update cost, cycling over the log
+  AttitudeFilter bench(1e6f / period_us);
+  int index = 0;
+  double ns = bench_ns([&](){
+    const float *sample = &samples[6 * index];
+    bench.update(sample, sample + 3);
+    if(++index == n)
+      index = 0;
+  }, 20 * n);
+  printf("update: %.1f ns per sample, budget %.0f ns\n", ns, UPDATE_BUDGET_NS);
+  CHECK(ns < UPDATE_BUDGET_NS);
+
+  return check_summary("attitude_check");
+}
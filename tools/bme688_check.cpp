@@ -0,0 +1,249 @@
+/**
+  ******************************************************************************
+  * @file   bme688_check.cpp
+  * @brief  BME688 Compensation Cross-Check and Benchmark.
+  *
+  * @note   End-of-degree work.
+  *         Host check that replays a recorded I2C trace of BME688 calibration
+  *         and data field reads, data/bme688_fields.bin, and compensates every
+  *         field. The results are compared with the ones the floating point
+  *         compensation gave when the trace was recorded, data/bme688_fields.ref.
+  *
+  *         It is built twice: bme688_check uses the floating point path and
+  *         has to reproduce the reference, bme688_check_int defines
+  *         BME688_INT_COMPENSATION and has to stay within the resolution of
+  *         the sensor: 0.0075 degC, 9 Pa, 0.055 %RH, 0.07% of the gas
+  *         resistance and 1 code of heater resistance.
+  *
+  *         The compensation functions are private to the driver, so the
+  *         driver source is included. The time to compensate one data field
+  *         is measured over the recorded fields.
+  *
+  *         The trace is recorded from the I2C simulator over a sweep of
+  *         temperature, pressure, humidity and gas resistance, with the
+  *         simulated calibration and with the humidity h3 and h7 of another
+  *         part, by the floating point build:
+  *
+  *         Build and run: make -C tools check
+  *         Record: bme688_check --record data/bme688_fields.bin data/bme688_fields.ref
+  ******************************************************************************
+*/
+
+/* Includes ------------------------------------------------------------------*/
+#include <array>
+#include <cstring>
+#include <vector>
+#include "check.h"
+#include "../src/BME688/BME688.cpp"
+#include "../src/I2CSimulator/sim_devices.h"
+#include "../src/i2c_master/i2c_replay.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define DEFAULT_TRACE       "data/bme688_fields.bin"
+#define DEFAULT_REF         "data/bme688_fields.ref"
+
+//Recording sweep
+#define SWEEP_FIELDS        60      //Per calibration
+#define SWEEP_HEATER_TEMP   320
+#define SWEEP_HEATER_MS     30
+#define SWEEP_AMB_TEMP      25
+#define SWEEP_MEASURE_US    60000   //Forced TPH at 4x and the heater, with margin
+#define OTHER_PART_H3       12      //Humidity h3 and h7 of another sensor
+#define OTHER_PART_H7       -40
+
+#ifdef BME688_INT_COMPENSATION
+#define CHECK_NAME          "bme688_check_int"
+#define TEMP_TOLERANCE      0.0075
+#define PRESS_TOLERANCE     9.0
+#define HUM_TOLERANCE       0.055
+#define GAS_TOLERANCE       0.0007  //Relative
+#define RES_HEAT_TOLERANCE  1
+#else
+#define CHECK_NAME          "bme688_check"
+#define TEMP_TOLERANCE      1e-4
+#define PRESS_TOLERANCE     0.01
+#define HUM_TOLERANCE       1e-4
+#define GAS_TOLERANCE       1e-6
+#define RES_HEAT_TOLERANCE  0
+#endif
+#define BENCH_BUDGET_NS     1000.0  //Per data field
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief Waits for the forced measure and reads data field 0, as
+  *        get_data_forced_mode() does, keeping the raw bytes.
+  *
+  * @return 0 if success, -1 if error.
+  */
+static int read_field(uint8_t *field){
+  if(wait_measure_done() == -1)
+    return -1;
+  if(I2C_Master::read_msg(BME688_ADRR, START_DATA_FIELD_0_REG, field, LEN_DATA_FIELD_0) == -1)
+    return -1;
+  return measure_done(field[0]) ? 0 : -1;
+}
+
+#ifndef BME688_INT_COMPENSATION
+/**
+  * @brief Low discrepancy sequence in [0, 1), so the sweep covers the ranges evenly.
+  */
+static double sweep(int i, double step){
+  double x = (i + 1) * step;
+  return x - (int)x;
+}
+#endif
+
+/**
+  * @brief Records the trace and the floating point reference from the simulator.
+  *
+  * @return 0 if success, -1 if error.
+  */
+static int record(const char *trace_path, const char *ref_path){
+#ifdef BME688_INT_COMPENSATION
+  fprintf(stderr, "The reference is recorded by the floating point build\n");
+  return -1;
+#else
+  static I2CSimulator::Bus bus;
+  static I2CSimulator::BME688_device sim_bme;
+  bme688_calib_sensor calibs;
+  uint8_t field[LEN_DATA_FIELD_0];
+  float temp, press, hum, gas;
+
+  bus.attach(&sim_bme);
+  I2C_Master::set_backend(&bus);
+  I2C_Master::start(1);
+
+  FILE *ref = fopen(ref_path, "w");
+  if(ref == NULL){
+    perror(ref_path);
+    return -1;
+  }
+
+  //The driver configures the sensor, only the reads to compensate are traced
+  BME688 gas_sensor(SWEEP_AMB_TEMP, 0);
+  if(gas_sensor.init() == -1 || gas_sensor.set_oversamplings(OVSP_4_X, OVSP_4_X, OVSP_4_X) == -1 ||
+     gas_sensor.set_heater_configurations(true, SWEEP_HEATER_TEMP, SWEEP_HEATER_MS) == -1){
+    fclose(ref);
+    return -1;
+  }
+
+  I2C_Master::reset_trace();
+  I2C_Master::set_trace(true);
+  for(int part = 0; part < 2; part++){
+    if(part == 1){
+      sim_bme.poke(0xE1 + 3, OTHER_PART_H3);
+      sim_bme.poke(0xE1 + 7, (uint8_t)OTHER_PART_H7);
+    }
+    if(get_calibs(&calibs) == -1)
+      break;
+    fprintf(ref, "calib\n");
+    for(int target = 200; target <= 400; target += 50)
+      for(int amb = 0; amb <= 40; amb += 20)
+        fprintf(ref, "res_heat %d %d %u\n", target, amb, calc_res_heat_x(target, amb, calibs.gas));
+
+    for(int i = 0; i < SWEEP_FIELDS; i++){
+      sim_bme.set_signals(-20 + 90 * sweep(i, 0.618034), 30000 + 80000 * sweep(i, 0.754878),
+                          5 + 90 * sweep(i, 0.569840), std::pow(10, 3 + 3 * sweep(i, 0.826031)));
+      if(set_operation_mode(FORCED_OP_MODE) == -1)
+        break;
+      usleep(SWEEP_MEASURE_US);
+      if(read_field(field) == -1)
+        break;
+      decode_data_field(field, &temp, &press, &hum, &gas, 0, &calibs);
+      fprintf(ref, "field %.9g %.9g %.9g %.9g\n", temp, press, hum, gas);
+    }
+  }
+  I2C_Master::set_trace(false);
+
+  int traced = I2C_Master::dump_trace(trace_path);
+  if(fclose(ref) != 0 || traced <= 0){
+    fprintf(stderr, "Could not write the trace or the reference\n");
+    return -1;
+  }
+  fprintf(stderr, "%d transactions recorded\n", traced);
+  return 0;
+#endif
+}
+
+int main(int argc, char *argv[]){
+  if(argc == 4 && std::strcmp(argv[1], "--record") == 0)
+    return record(argv[2], argv[3]) == 0 ? 0 : 1;
+
+  I2C_Replay replay;
+  if(replay.load(DEFAULT_TRACE) <= 0){
+    fprintf(stderr, "Could not load %s\n", DEFAULT_TRACE);
+    return 1;
+  }
+  FILE *ref = fopen(DEFAULT_REF, "r");
+  if(ref == NULL){
+    perror(DEFAULT_REF);
+    return 1;
+  }
+  I2C_Master::set_backend(&replay);
+  I2C_Master::start(1);
+
+  bme688_calib_sensor calibs = {};
+  std::vector<bme688_calib_sensor> field_calibs;
+  std::vector<std::array<uint8_t, LEN_DATA_FIELD_0>> fields;
+  double max_temp = 0, max_press = 0, max_hum = 0, max_gas = 0;
+  int max_res = 0;
+  char line[128];
+
+  while(fgets(line, sizeof(line), ref) != NULL){
+    float ref_temp, ref_press, ref_hum, ref_gas;
+    int target, amb;
+    unsigned code;
+
+    if(std::strncmp(line, "calib", 5) == 0){
+      CHECK(get_calibs(&calibs) == 0);
+    }
+    else if(sscanf(line, "res_heat %d %d %u", &target, &amb, &code) == 3){
+      int diff = std::abs((int)calc_res_heat_x(target, amb, calibs.gas) - (int)code);
+      max_res = diff > max_res ? diff : max_res;
+      CHECK(diff <= RES_HEAT_TOLERANCE);
+    }
+    else if(sscanf(line, "field %f %f %f %f", &ref_temp, &ref_press, &ref_hum, &ref_gas) == 4){
+      std::array<uint8_t, LEN_DATA_FIELD_0> field;
+      float temp, press, hum, gas;
+
+      if(!CHECK(read_field(field.data()) == 0))
+        break;
+      decode_data_field(field.data(), &temp, &press, &hum, &gas, 0, &calibs);
+      CHECK_NEAR(temp, ref_temp, TEMP_TOLERANCE);
+      CHECK_NEAR(press, ref_press, PRESS_TOLERANCE);
+      CHECK_NEAR(hum, ref_hum, HUM_TOLERANCE);
+      CHECK_NEAR(gas, ref_gas, ref_gas * GAS_TOLERANCE);
+
+      max_temp = std::fmax(max_temp, std::fabs(temp - ref_temp));
+      max_press = std::fmax(max_press, std::fabs(press - ref_press));
+      max_hum = std::fmax(max_hum, std::fabs(hum - ref_hum));
+      max_gas = std::fmax(max_gas, std::fabs(gas - ref_gas) / ref_gas);
+      fields.push_back(field);
+      field_calibs.push_back(calibs);
+    }
+  }
+  fclose(ref);
+
+  CHECK(fields.size() == 2 * SWEEP_FIELDS);
+  CHECK(replay.get_mismatches() == 0);
+  printf("%zu fields, max difference: %.4f degC, %.2f Pa, %.4f %%RH, %.4f%% gas, %d res_heat code\n",
+         fields.size(), max_temp, max_press, max_hum, 100 * max_gas, max_res);
+
+  //Per data field cost, cycling over the recorded fields
+  if(!fields.empty()){
+    volatile float sink = 0;
+    size_t index = 0;
+    double ns = bench_ns([&](){
+      float temp, press, hum, gas;
+      decode_data_field(fields[index].data(), &temp, &press, &hum, &gas, 0, &field_calibs[index]);
+      sink = sink + temp + press + hum + gas;
+      if(++index == fields.size())
+        index = 0;
+    }, 1000 * (int)fields.size());
+    printf("decode_data_field: %.1f ns per data field, budget %.0f ns\n", ns, BENCH_BUDGET_NS);
+    CHECK(ns < BENCH_BUDGET_NS);
+  }
+
+  return check_summary(CHECK_NAME);
+}
@@ -0,0 +1,75 @@
+/**
+  ******************************************************************************
+  * @file   check.h
+  * @brief  Host Check Helpers.
+  *
+  * @note   End-of-degree work.
+  *         Minimal assertion and timing helpers shared by the host checks in
+  *         tools/. A failed check is reported with its location and the
+  *         program exits with 1 from check_summary().
+  ******************************************************************************
+*/
+
+#ifndef __CHECK_H__
+#define __CHECK_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <cstdio>
+#include <cmath>
+#include <chrono>
+
+/* Exported macro ------------------------------------------------------------*/
+#define CHECK(cond) check_result((cond), #cond, __FILE__, __LINE__)
+#define CHECK_NEAR(value, expected, tolerance) \
+  check_near((value), (expected), (tolerance), #value, __FILE__, __LINE__)
+
+/* Private variables----------------------------------------------------------*/
+static int check_total = 0;
+static int check_failed = 0;
+
+/* Exported Functions --------------------------------------------------------*/
+
+static inline bool check_result(bool ok, const char *expr, const char *file, int line){
+  check_total++;
+  if(!ok){
+    check_failed++;
+    fprintf(stderr, "FAIL %s:%d: %s\n", file, line, expr);
+  }
+  return ok;
+}
+
+static inline bool check_near(double value, double expected, double tolerance, const char *expr,
+                              const char *file, int line){
+  check_total++;
+  if(std::fabs(value - expected) > tolerance){
+    check_failed++;
+    fprintf(stderr, "FAIL %s:%d: %s = %g, expected %g +- %g\n", file, line, expr, value, expected, tolerance);
+    return false;
+  }
+  return true;
+}
+
+/**
+  * @brief Prints the result of the checks.
+  *
+  * @return The exit code: 0 if every check passed, 1 otherwise.
+  */
+static inline int check_summary(const char *name){
+  printf("%s: %d checks, %d failed\n", name, check_total, check_failed);
+  return check_failed ? 1 : 0;
+}
+
+/**
+  * @brief Runs `f` `iterations` times.
+  *
+  * @return The mean time per iteration in ns.
+  */
+template <typename F>
+static inline double bench_ns(F f, int iterations){
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(int i = 0; i < iterations; i++)
+    f();
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+#endif /* __CHECK_H__ */
@@ -0,0 +1,149 @@
+/**
+  ******************************************************************************
+  * @file   convert_check.cpp
+  * @brief  LSM6DSOX Batch Conversion Checks and Benchmark.
+  *
+  * @note   End-of-degree work.
+  *         Host check that the batch conversions of raw FIFO triplets,
+  *         LSM6DSOX::convert_acc()/convert_gyr() and their Q16 variants, give
+  *         the same values as the per-value formula they replaced,
+  *         value / 65536 * scale_range * 2, for every raw value and full scale
+  *         range. The Q16 outputs are the per-value result in micro-g or
+  *         milli-dps rounded half up.
+  *
+  *         Then a FIFO worth of triplets is converted by both paths and timed.
+  *         The batch conversions have to be faster than the per-value one.
+  *
+  *         Build and run: make -C tools check
+  ******************************************************************************
+*/
+
+/* Includes ------------------------------------------------------------------*/
+#include <cmath>
+#include <vector>
+#include "check.h"
+#include "../src/I2CSimulator/sim_devices.h"
+#include "../src/LSM6DSOX/LSM6DSOX.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define RAW_VALUES      65536
+#define BENCH_TRIPLETS  256     //Accelerometer half of a full FIFO
+#define BENCH_RUNS      2000
+
+/* Private variables----------------------------------------------------------*/
+static I2CSimulator::Bus bus(0);
+static I2CSimulator::LSM6DSOX_device sim_lsm;
+
+static const uint8_t acc_fsrs[] = {ACC_2_G_FSR, ACC_4_G_FSR, ACC_8_G_FSR, ACC_16_G_FSR};
+static const int acc_ranges[] = {2, 4, 8, 16};
+static const uint8_t gyr_fsrs[] = {GYR_125_DPS_FSR, GYR_250_DPS_FSR, GYR_500_DPS_FSR, GYR_1000_DPS_FSR, GYR_2000_DPS_FSR};
+static const int gyr_ranges[] = {125, 250, 500, 1000, 2000};
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief The per-value conversion the driver used before the batch ones.
+  */
+static float convert_value(int16_t value, int scale_range){
+  float result;
+  result = (float)value / 65536.0 * scale_range * 2;
+
+  return result;
+}
+
+/**
+  * @brief Compares the batch conversions of every raw value with the per-value one.
+  *
+  * @param[in] imu Driver, with the full scale range to check already set.
+  * @param[in] gyr True for the gyroscope conversions.
+  * @param[in] scale_range Full scale range in g or dps.
+  * @param[in] unit Q16 output units per unit of the float output.
+  */
+static void check_all_values(LSM6DSOX *imu, bool gyr, int scale_range, double unit){
+  std::vector<int16_t> raw(3 * RAW_VALUES);
+  std::vector<float> x(RAW_VALUES), y(RAW_VALUES), z(RAW_VALUES);
+  std::vector<int32_t> xq(RAW_VALUES), yq(RAW_VALUES), zq(RAW_VALUES);
+  int float_diffs = 0, fixed_diffs = 0;
+
+  //Each axis gets every value, shifted so the three differ
+  for(int i = 0; i < RAW_VALUES; i++){
+    raw[3 * i] = (int16_t)i;
+    raw[3 * i + 1] = (int16_t)(i + 1);
+    raw[3 * i + 2] = (int16_t)(i + 2);
+  }
+
+  if(gyr){
+    imu->convert_gyr(raw.data(), RAW_VALUES, x.data(), y.data(), z.data());
+    imu->convert_gyr_fixed(raw.data(), RAW_VALUES, xq.data(), yq.data(), zq.data());
+  }
+  else{
+    imu->convert_acc(raw.data(), RAW_VALUES, x.data(), y.data(), z.data());
+    imu->convert_acc_fixed(raw.data(), RAW_VALUES, xq.data(), yq.data(), zq.data());
+  }
+
+  for(int i = 0; i < RAW_VALUES; i++){
+    const float *out[3] = {&x[i], &y[i], &z[i]};
+    const int32_t *out_q[3] = {&xq[i], &yq[i], &zq[i]};
+    for(int axis = 0; axis < 3; axis++){
+      float expected = convert_value(raw[3 * i + axis], scale_range);
+      if(*out[axis] != expected)
+        float_diffs++;
+      if(*out_q[axis] != (int32_t)std::floor((double)expected * unit + 0.5))
+        fixed_diffs++;
+    }
+  }
+  CHECK(float_diffs == 0);
+  CHECK(fixed_diffs == 0);
+}
+
+int main(){
+  bus.attach(&sim_lsm);
+  I2C_Master::set_backend(&bus);
+
+  LSM6DSOX imu(LSM6DSOX_416_HZ_ODR, LSM6DSOX_416_HZ_ODR);
+
+  for(int i = 0; i < 4; i++){
+    CHECK(imu.set_fsr(acc_fsrs[i], GYR_250_DPS_FSR) == 0);
+    check_all_values(&imu, false, acc_ranges[i], 1e6);
+  }
+  for(int i = 0; i < 5; i++){
+    CHECK(imu.set_fsr(ACC_2_G_FSR, gyr_fsrs[i]) == 0);
+    check_all_values(&imu, true, gyr_ranges[i], 1e3);
+  }
+
+  //A FIFO drain worth of accelerometer triplets at 4 g
+  CHECK(imu.set_fsr(ACC_4_G_FSR, GYR_250_DPS_FSR) == 0);
+  std::vector<int16_t> raw(3 * BENCH_TRIPLETS);
+  std::vector<float> x(BENCH_TRIPLETS), y(BENCH_TRIPLETS), z(BENCH_TRIPLETS);
+  std::vector<int32_t> xq(BENCH_TRIPLETS), yq(BENCH_TRIPLETS), zq(BENCH_TRIPLETS);
+  for(int i = 0; i < 3 * BENCH_TRIPLETS; i++)
+    raw[i] = (int16_t)(i * 7919);
+
+  volatile float sink = 0;
+  volatile int scale_range = 4;
+  double per_value_ns = bench_ns([&](){
+    for(int i = 0; i < BENCH_TRIPLETS; i++){
+      x[i] = convert_value(raw[3 * i], scale_range);
+      y[i] = convert_value(raw[3 * i + 1], scale_range);
+      z[i] = convert_value(raw[3 * i + 2], scale_range);
+    }
+    sink = sink + x[BENCH_TRIPLETS - 1];
+  }, BENCH_RUNS) / BENCH_TRIPLETS;
+
+  double batch_ns = bench_ns([&](){
+    imu.convert_acc(raw.data(), BENCH_TRIPLETS, x.data(), y.data(), z.data());
+    sink = sink + x[BENCH_TRIPLETS - 1];
+  }, BENCH_RUNS) / BENCH_TRIPLETS;
+
+  double fixed_ns = bench_ns([&](){
+    imu.convert_acc_fixed(raw.data(), BENCH_TRIPLETS, xq.data(), yq.data(), zq.data());
+    sink = sink + xq[BENCH_TRIPLETS - 1];
+  }, BENCH_RUNS) / BENCH_TRIPLETS;
+
+  printf("per triplet: convert_value %.2f ns, convert_acc %.2f ns, convert_acc_fixed %.2f ns\n",
+         per_value_ns, batch_ns, fixed_ns);
+  CHECK(batch_ns < per_value_ns);
+  CHECK(fixed_ns < per_value_ns);
+
+  return check_summary("convert_check");
+}
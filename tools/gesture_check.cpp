@@ -0,0 +1,166 @@
+/**
+  ******************************************************************************
+  * @file   gesture_check.cpp
+  * @brief  Gesture Classifier Checks Against the I2C Simulator.
+  *
+  * @note   End-of-degree work.
+  *         Host check that scripts hand passes on the simulated APDS9660,
+  *         reads them with APDS9660::read_ges_fifo() and classifies them with
+  *         GestureClassifier as the cabin controller does. It verifies that
+  *         single passes give their direction in the four directions, that
+  *         two passes too close for the sensor to exit are split at the dip,
+  *         that short passes and a hand approaching straight are rejected,
+  *         and the age of the events.
+  *         The simulated bus runs on a manual clock, so the check is
+  *         deterministic and immediate.
+  *
+  *         Build and run: make -C tools check
+  ******************************************************************************
+*/
+
+/* Includes ------------------------------------------------------------------*/
+#include <vector>
+#include "check.h"
+#include "../src/I2CSimulator/sim_devices.h"
+#include "../src/APDS9660/APDS9660_lib.h"
+#include "../src/APDS9660/gesture_classifier.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define READ_PERIOD_S     0.1     //FIFO threshold of 4 datasets, with margin
+#define PASS_S            0.4     //Time a hand takes to cross
+#define SETTLE_S          0.3     //Idle time after the scripted passes
+#define MAX_EVENTS        8
+#define RESTING_COUNTS    10      //Over the sensor exit threshold, under the classifier one
+#define SHORT_PASS_S      0.03    //Shorter than GESTURE_MIN_DATASETS datasets
+
+/* Private variables----------------------------------------------------------*/
+static I2CSimulator::Bus bus(0);
+static I2CSimulator::APDS9660_device sim_apds;
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief Advances the simulated time, reading the FIFO every `read_period`
+  *        seconds and classifying the datasets, then flushes the classifier.
+  *
+  * @param[out] datasets If not NULL, every dataset read, in order.
+  *
+  * @return The events, in the order they were given.
+  */
+static std::vector<gesture_event> run(APDS9660 *apds, GestureClassifier *classifier, double seconds,
+                                      double read_period, std::vector<uint8_t> *datasets = NULL){
+  std::vector<gesture_event> result;
+  gesture_event events[MAX_EVENTS];
+  uint8_t buffer[GES_FIFO_DATASETS * 4];
+
+  for(double t = 0; t < seconds; t += read_period){
+    bus.advance(read_period);
+    int n = apds->read_ges_fifo(buffer, GES_FIFO_DATASETS);
+    CHECK(n >= 0 && n < GES_FIFO_DATASETS);   //Never full, nothing lost
+    if(n <= 0)
+      continue;
+    if(datasets != NULL)
+      datasets->insert(datasets->end(), buffer, buffer + 4 * n);
+    int stored = classifier->push(buffer, n, events, MAX_EVENTS);
+    result.insert(result.end(), events, events + stored);
+  }
+
+  int stored = classifier->flush(events, MAX_EVENTS);
+  result.insert(result.end(), events, events + stored);
+  return result;
+}
+
+static void check_single_passes(APDS9660 *apds){
+  const int directions[4] = {I2CSimulator::GESTURE_UP, I2CSimulator::GESTURE_DOWN,
+                             I2CSimulator::GESTURE_LEFT, I2CSimulator::GESTURE_RIGHT};
+  const uint8_t expected[4] = {UP, DOWN, LEFT, RIGHT};
+
+  for(int d = 0; d < 4; d++){
+    GestureClassifier classifier;
+    std::vector<uint8_t> datasets;
+
+    //A hand resting far keeps the gesture engine on after the pass, under
+    //the exit threshold of the classifier, so the pass has datasets after it
+    sim_apds.set_proximity_signal(RESTING_COUNTS);
+    sim_apds.add_pass(bus.now() + 0.05, PASS_S, directions[d]);
+
+    //One read with the whole pass, so the age can be counted here
+    std::vector<gesture_event> events = run(apds, &classifier, PASS_S + SETTLE_S, PASS_S + SETTLE_S, &datasets);
+    sim_apds.set_proximity_signal(0);
+    if(!CHECK(events.size() == 1))
+      continue;
+    CHECK(events[0].direction == expected[d]);
+    CHECK(events[0].confidence > 0.5f);
+    CHECK(events[0].datasets >= GESTURE_MIN_DATASETS);
+
+    //The pass ends at the first dataset under the exit threshold after the entry
+    int n = datasets.size() / 4, end = -1;
+    bool entered = false;
+    for(int i = 0; i < n && end < 0; i++){
+      uint8_t max = 0;
+      for(int c = 0; c < 4; c++)
+        max = datasets[4 * i + c] > max ? datasets[4 * i + c] : max;
+      if(max > GESTURE_ENTRY_TH)
+        entered = true;
+      else if(entered && max < GESTURE_EXIT_TH)
+        end = i;
+    }
+    CHECK(end >= 0);
+    CHECK(events[0].age == n - 1 - end);
+    CHECK(events[0].age > 0);
+  }
+}
+
+static void check_back_to_back(APDS9660 *apds){
+  GestureClassifier classifier;
+  double start = bus.now() + 0.05;
+
+  //The second hand comes before the first one leaves: one pass for the sensor
+  sim_apds.add_pass(start, PASS_S, I2CSimulator::GESTURE_UP);
+  sim_apds.add_pass(start + 0.75 * PASS_S, PASS_S, I2CSimulator::GESTURE_DOWN);
+
+  std::vector<gesture_event> events = run(apds, &classifier, 2 * PASS_S + SETTLE_S, READ_PERIOD_S);
+  if(!CHECK(events.size() == 2))
+    return;
+  CHECK(events[0].direction == UP);
+  CHECK(events[1].direction == DOWN);
+
+  //The second pass starts at the dip where the first one ends
+  CHECK(events[0].age == events[1].age + events[1].datasets - 1);
+  CHECK(events[1].age >= 0);
+}
+
+static void check_noise(APDS9660 *apds){
+  GestureClassifier classifier;
+  double start = bus.now() + 0.05;
+
+  //Too short to be a hand crossing, though the sensor captures it
+  std::vector<uint8_t> datasets;
+  sim_apds.add_pass(start, SHORT_PASS_S, I2CSimulator::GESTURE_LEFT);
+  CHECK(run(apds, &classifier, SHORT_PASS_S + SETTLE_S, READ_PERIOD_S, &datasets).empty());
+  CHECK(!datasets.empty());
+
+  //A hand approaching straight: the four photodiodes see the same
+  start = bus.now() + 0.05;
+  sim_apds.set_proximity_signal(I2CSimulator::Signal([start](double t){
+    return (t > start && t < start + PASS_S) ? 150.0f : 0.0f;
+  }));
+  CHECK(run(apds, &classifier, PASS_S + SETTLE_S, READ_PERIOD_S).empty());
+  sim_apds.set_proximity_signal(0);
+}
+
+int main(){
+  bus.attach(&sim_apds);
+  I2C_Master::set_backend(&bus);
+  I2C_Master::start(1);
+
+  //As the cabin controller configures it
+  APDS9660 apds;
+  CHECK(apds.conf_gesture(3, 5, 5) == 0);
+
+  check_single_passes(&apds);
+  check_back_to_back(&apds);
+  check_noise(&apds);
+
+  return check_summary("gesture_check");
+}
@@ -0,0 +1,113 @@
+/**
+  ******************************************************************************
+  * @file   light_check.cpp
+  * @brief  Light Meter Checks and Benchmark.
+  *
+  * @note   End-of-degree work.
+  *         Host check that LightMeter gives, with the default calibration, the
+  *         same lux on white light as the clear-only formula of
+  *         APDS9660::calc_illuminance() at every gain and integration time,
+  *         that saturated samples give no colour temperature and that warm
+  *         light reads warmer than white light.
+  *
+  *         Then LightMeter::process() is timed over batches of samples with
+  *         mixed ranges against the clear-only formula with pow() it
+  *         replaced, and has to be faster.
+  *
+  *         Build and run: make -C tools check
+  ******************************************************************************
+*/
+
+/* Includes ------------------------------------------------------------------*/
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "check.h"
+#include "../src/APDS9660/APDS9660_lib.h"
+#include "../src/APDS9660/light_meter.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define BATCH_LEN       4096
+#define BATCHES         200
+#define LUX_TOLERANCE   0.01    //Relative, white light against the clear-only formula
+#define WHITE_CCT_MIN   4000.0f
+#define WHITE_CCT_MAX   6500.0f
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief Builds a sample with the channels as fractions of the clear one.
+  */
+static color_data sample(int clear, float r, float g, float b, uint8_t gain, uint8_t atime){
+  color_data data = {};
+  data.clear = clear;
+  data.red = (int)(clear * r);
+  data.green = (int)(clear * g);
+  data.blue = (int)(clear * b);
+  data.gain = gain;
+  data.atime = atime;
+  return data;
+}
+
+/**
+  * @brief Clear-only lux, as APDS9660::calc_illuminance() computes it.
+  */
+static float clear_lux(const color_data *data){
+  return data->clear / (als_gains[data->gain] * (256 - data->atime)) / 0.216f;
+}
+
+int main(){
+  LightMeter meter;
+  const uint8_t atimes[] = {0x00, 0x80, 0xC0, 0xF6, 0xFF};
+
+  //White light, R, G, B at 0.36, 0.42, 0.30 of clear
+  for(int gain = 0; gain < 4; gain++){
+    for(uint8_t atime : atimes){
+      int full_scale = std::min(ALS_COUNTS_PER_CYCLE * (256 - atime), ALS_MAX_COUNTS);
+      color_data white = sample(full_scale / 4, 0.36f, 0.42f, 0.30f, gain, atime);
+      float expected = clear_lux(&white);
+      meter.process(&white, 1);
+      CHECK_NEAR(white.lux, expected, expected * LUX_TOLERANCE);
+      CHECK(white.cct > WHITE_CCT_MIN && white.cct < WHITE_CCT_MAX);
+    }
+  }
+
+  //Warm light, little blue
+  color_data warm = sample(2000, 0.50f, 0.40f, 0.15f, 1, 0xC0);
+  color_data white = sample(2000, 0.36f, 0.42f, 0.30f, 1, 0xC0);
+  meter.process(&warm, 1);
+  meter.process(&white, 1);
+  CHECK(warm.cct > 0 && warm.cct < white.cct);
+
+  //Clipped clear channel: a lower bound of the lux, no cct
+  color_data saturated = sample(ALS_MAX_COUNTS, 0.36f, 0.42f, 0.30f, 3, 0x00);
+  meter.process(&saturated, 1);
+  CHECK(saturated.lux > 0);
+  CHECK(saturated.cct == 0);
+
+  //Mixed ranges, as the auto-ranging thread gives them
+  std::vector<color_data> batch(BATCH_LEN), work(BATCH_LEN);
+  for(int i = 0; i < BATCH_LEN; i++){
+    uint8_t atime = atimes[i % 5];
+    batch[i] = sample((i * 37) % std::min(ALS_COUNTS_PER_CYCLE * (256 - atime), ALS_MAX_COUNTS), 0.36f, 0.42f, 0.30f, (i / 5) % 4, atime);
+  }
+
+  volatile float sink = 0;
+  double meter_ns = bench_ns([&](){
+    work = batch;
+    meter.process(work.data(), BATCH_LEN);
+    sink = sink + work[BATCH_LEN - 1].lux;
+  }, BATCHES) / BATCH_LEN;
+
+  double pow_ns = bench_ns([&](){
+    work = batch;
+    for(int i = 0; i < BATCH_LEN; i++)
+      work[i].lux = work[i].clear / (std::pow(4, work[i].gain) * (256 - work[i].atime)) / 0.216;
+    sink = sink + work[BATCH_LEN - 1].lux;
+  }, BATCHES) / BATCH_LEN;
+
+  printf("process: %.1f ns/sample, clear-only with pow(): %.1f ns/sample\n", meter_ns, pow_ns);
+  CHECK(meter_ns < pow_ns);
+
+  return check_summary("light_check");
+}
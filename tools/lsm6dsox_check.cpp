@@ -0,0 +1,369 @@
+/**
+  ******************************************************************************
+  * @file   lsm6dsox_check.cpp
+  * @brief  LSM6DSOX Driver Checks Against the I2C Simulator.
+  *
+  * @note   End-of-degree work.
+  *         Host check that runs the LSM6DSOX driver against the simulated
+  *         sensor. It verifies the scaling of read_all() at every full scale
+  *         range, that read_fifo() and read_fifo_raw() decode the tagged words
+  *         in order with their timestamps, that sensors batched at the same
+  *         rate share one batch per period with its TAG_CNT, the FIFO level, watermark, overrun
+  *         and full flags in continuous and stop-on-full modes, and that the
+  *         wake-up and 6D detectors latch their events until they are read.
+  *         The simulated bus runs on a manual clock, so the check is
+  *         deterministic and immediate.
+  *
+  *         Build and run: make -C tools check
+  ******************************************************************************
+*/
+
+/* Includes ------------------------------------------------------------------*/
+#include <vector>
+#include "check.h"
+#include "../src/I2CSimulator/sim_devices.h"
+#include "../src/LSM6DSOX/LSM6DSOX.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define TIMESTAMP_LSB_S   25e-6
+#define FIFO_WORDS        512
+#define ACC_BDR_HZ        104.0
+#define GYR_BDR_HZ        52.0
+#define FILL_S            0.505     //52 accelerometer and 26 gyroscope samples
+#define FILL_ACC          52
+#define FILL_GYR          26
+#define FILL_WORDS        (FILL_ACC + FILL_GYR + FILL_ACC)    //One timestamp per batch
+#define WATERMARK         100
+#define SIM_GYR_X         10.0f
+#define SIM_TEMPERATURE   31.5f
+#define FIFO_DATA_OUT_TAG 0x78
+#define FIFO_WORD_LEN     7
+#define FIFO_BURST_WORDS  36        //As the driver, under the 255 byte transfer limit
+#define TS_DECIMATION     8
+
+/* Private variables----------------------------------------------------------*/
+static I2CSimulator::Bus bus(0);
+static I2CSimulator::LSM6DSOX_device sim_lsm;
+
+static const uint8_t acc_fsrs[] = {ACC_2_G_FSR, ACC_4_G_FSR, ACC_8_G_FSR, ACC_16_G_FSR};
+static const int acc_ranges[] = {2, 4, 8, 16};
+static const uint8_t gyr_fsrs[] = {GYR_125_DPS_FSR, GYR_250_DPS_FSR, GYR_500_DPS_FSR, GYR_1000_DPS_FSR, GYR_2000_DPS_FSR};
+static const int gyr_ranges[] = {125, 250, 500, 1000, 2000};
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief One LSB of a full scale range.
+  */
+static double lsb(int scale_range){
+  return scale_range * 2 / 65536.0;
+}
+
+static void check_read_all(LSM6DSOX *imu){
+  const float acc[3] = {0.25f, -0.5f, 1.0f};
+  const float gyr[3] = {100.0f, -62.5f, 120.0f};
+  lsm6dsox_imu_sample sample;
+
+  sim_lsm.set_acc_signals(acc[0], acc[1], acc[2]);
+  sim_lsm.set_gyr_signals(gyr[0], gyr[1], gyr[2]);
+  sim_lsm.set_temperature_signal(SIM_TEMPERATURE);
+
+  for(int i = 0; i < 4; i++){
+    CHECK(imu->set_fsr(acc_fsrs[i], GYR_250_DPS_FSR) == 0);
+    bus.advance(0.01);
+    CHECK(imu->read_all(&sample) == 0);
+    CHECK_NEAR(sample.acc_x, acc[0], lsb(acc_ranges[i]));
+    CHECK_NEAR(sample.acc_y, acc[1], lsb(acc_ranges[i]));
+    CHECK_NEAR(sample.acc_z, acc[2], lsb(acc_ranges[i]));
+    CHECK_NEAR(sample.temperature, SIM_TEMPERATURE, 1 / 256.0);
+  }
+  for(int i = 0; i < 5; i++){
+    CHECK(imu->set_fsr(ACC_2_G_FSR, gyr_fsrs[i]) == 0);
+    bus.advance(0.01);
+    CHECK(imu->read_all(&sample) == 0);
+    CHECK_NEAR(sample.gyr_x, gyr[0], lsb(gyr_ranges[i]));
+    CHECK_NEAR(sample.gyr_y, gyr[1], lsb(gyr_ranges[i]));
+    CHECK_NEAR(sample.gyr_z, gyr[2], lsb(gyr_ranges[i]));
+  }
+}
+
+/**
+  * @brief Starts batching the accelerometer at 104 Hz and the gyroscope, by
+  *        default at 52 Hz with a timestamp per batch. The accelerometer x axis
+  *        is the time since the start, in g, so every sample tells when it was
+  *        taken.
+  *
+  * @return The simulated time of the start.
+  */
+static double start_fifo(LSM6DSOX *imu, uint8_t bdr_gyr = LSM6DSOX_BDR_52_HZ,
+                         uint8_t ts_decimation = LSM6DSOX_TS_DEC_1){
+  double t0 = bus.now();
+
+  sim_lsm.set_acc_signals(I2CSimulator::Signal([t0](double t){ return (float)(t - t0); }), 0.0f, 1.0f);
+  sim_lsm.set_gyr_signals(SIM_GYR_X, 0.0f, 0.0f);
+  CHECK(imu->set_fifo_mode(LSM6DSOX_FIFO_BYPASS) == 0);
+  CHECK(imu->set_fifo_batch_rates(LSM6DSOX_BDR_104_HZ, bdr_gyr) == 0);
+  CHECK(imu->set_fifo_timestamp(ts_decimation) == 0);
+  CHECK(imu->set_fifo_watermark(WATERMARK) == 0);
+  CHECK(imu->set_fifo_mode(LSM6DSOX_FIFO_CONTINUOUS) == 0);
+  return t0;
+}
+
+static void check_read_fifo(LSM6DSOX *imu){
+  lsm6dsox_fifo_sample samples[FIFO_WORDS];
+  lsm6dsox_fifo_status status;
+
+  CHECK(imu->set_fsr(ACC_2_G_FSR, GYR_250_DPS_FSR) == 0);
+  double t0 = start_fifo(imu);
+  bus.advance(FILL_S);
+
+  CHECK(imu->get_fifo_status(&status) == 0);
+  CHECK(status.level == FILL_WORDS);
+  CHECK(status.watermark);
+  CHECK(!status.overrun && !status.full);
+
+  //Timestamps are not returned, so all the samples fit
+  if(!CHECK(imu->read_fifo(samples, FIFO_WORDS) == FILL_ACC + FILL_GYR))
+    return;
+
+  int acc = 0, gyr = 0;
+  for(int i = 0; i < FILL_ACC + FILL_GYR; i++){
+    //Two accelerometer samples per gyroscope one, the accelerometer first on ties
+    uint8_t expected = (i % 3 == 2) ? LSM6DSOX_SAMPLE_GYR : LSM6DSOX_SAMPLE_ACC;
+    if(!CHECK(samples[i].type == expected))
+      break;
+
+    double t = samples[i].timestamp * TIMESTAMP_LSB_S - t0;
+    if(expected == LSM6DSOX_SAMPLE_ACC){
+      acc++;
+      CHECK_NEAR(samples[i].x, acc / ACC_BDR_HZ, lsb(2));
+      CHECK_NEAR(samples[i].z, 1.0, lsb(2));
+      CHECK_NEAR(t, acc / ACC_BDR_HZ, TIMESTAMP_LSB_S);
+    }
+    else{
+      gyr++;
+      CHECK_NEAR(samples[i].x, SIM_GYR_X, lsb(250));
+      CHECK_NEAR(t, gyr / GYR_BDR_HZ, TIMESTAMP_LSB_S);
+    }
+  }
+
+  CHECK(imu->get_fifo_status(&status) == 0);
+  CHECK(status.level == 0);
+  CHECK(!status.watermark);
+}
+
+static void check_read_fifo_raw(LSM6DSOX *imu){
+  std::vector<int16_t> acc_raw(3 * FIFO_WORDS), gyr_raw(3 * FIFO_WORDS);
+  std::vector<float> x(FIFO_WORDS), y(FIFO_WORDS), z(FIFO_WORDS);
+  lsm6dsox_fifo_status status;
+  int acc_count, gyr_count;
+  const int partial = 30;
+
+  CHECK(imu->set_fsr(ACC_4_G_FSR, GYR_500_DPS_FSR) == 0);
+  start_fifo(imu);
+  bus.advance(FILL_S);
+
+  //The words that do not fit stay in the FIFO
+  CHECK(imu->read_fifo_raw(acc_raw.data(), &acc_count, gyr_raw.data(), &gyr_count, partial) == 0);
+  CHECK(acc_count + gyr_count == partial * 3 / 5);   //Two timestamps every three samples
+  CHECK(imu->get_fifo_status(&status) == 0);
+  CHECK(status.level == FILL_WORDS - partial);
+
+  CHECK(imu->read_fifo_raw(acc_raw.data() + 3 * acc_count, &acc_count, gyr_raw.data() + 3 * gyr_count,
+                           &gyr_count, FIFO_WORDS) == 0);
+  CHECK(imu->get_fifo_status(&status) == 0);
+  CHECK(status.level == 0);
+
+  //Both reads together, converted in a batch
+  int acc_total = 0, gyr_total = 0;
+  CHECK(imu->set_fifo_mode(LSM6DSOX_FIFO_BYPASS) == 0);
+  start_fifo(imu);
+  bus.advance(FILL_S);
+  CHECK(imu->read_fifo_raw(acc_raw.data(), &acc_total, gyr_raw.data(), &gyr_total, FIFO_WORDS) == 0);
+  CHECK(acc_total == FILL_ACC);
+  CHECK(gyr_total == FILL_GYR);
+
+  imu->convert_acc(acc_raw.data(), acc_total, x.data(), y.data(), z.data());
+  for(int i = 0; i < acc_total; i++){
+    CHECK_NEAR(x[i], (i + 1) / ACC_BDR_HZ, lsb(4));
+    CHECK_NEAR(z[i], 1.0, lsb(4));
+  }
+  imu->convert_gyr(gyr_raw.data(), gyr_total, x.data(), y.data(), z.data());
+  for(int i = 0; i < gyr_total; i++)
+    CHECK_NEAR(x[i], SIM_GYR_X, lsb(500));
+}
+
+static void check_equal_rates(LSM6DSOX *imu){
+  uint8_t words[FIFO_WORDS * FIFO_WORD_LEN];
+  lsm6dsox_fifo_sample samples[FIFO_WORDS];
+  lsm6dsox_fifo_status status;
+  const int timestamps = (FILL_ACC + TS_DECIMATION - 1) / TS_DECIMATION;
+
+  //Both sensors at 104 Hz: one batch per period with an accelerometer and a
+  //gyroscope word, and a timestamp every TS_DECIMATION batches
+  CHECK(imu->set_fsr(ACC_2_G_FSR, GYR_250_DPS_FSR) == 0);
+  start_fifo(imu, LSM6DSOX_BDR_104_HZ, LSM6DSOX_TS_DEC_8);
+  bus.advance(FILL_S);
+  CHECK(imu->get_fifo_status(&status) == 0);
+  if(!CHECK(status.level == 2 * FILL_ACC + timestamps))
+    return;
+
+  //The words of a batch share their TAG_CNT, which counts the batches
+  for(int read = 0; read < status.level; read += FIFO_BURST_WORDS){
+    int burst = status.level - read < FIFO_BURST_WORDS ? status.level - read : FIFO_BURST_WORDS;
+    CHECK(I2C_Master::read_msg(I2CSimulator::LSM6DSOX_SIM_ADDR, FIFO_DATA_OUT_TAG, &words[read * FIFO_WORD_LEN],
+                               burst * FIFO_WORD_LEN) != -1);
+  }
+  int batch = 0, batch_acc = 0, batch_gyr = 0, batch_ts = 0, bad_counts = 0;
+  for(int i = 0; i < status.level; i++){
+    uint8_t sensor = words[i * FIFO_WORD_LEN] >> 3;
+    uint8_t count = (words[i * FIFO_WORD_LEN] >> 1) & 0x03;
+    if(sensor == LSM6DSOX_SAMPLE_ACC){
+      batch++;
+      batch_acc++;
+    }
+    else if(sensor == LSM6DSOX_SAMPLE_GYR)
+      batch_gyr++;
+    else
+      batch_ts++;
+
+    //A timestamp comes first in its batch
+    int expected = sensor == LSM6DSOX_SAMPLE_ACC || sensor == LSM6DSOX_SAMPLE_GYR ? batch : batch + 1;
+    if(count != (expected & 0x03))
+      bad_counts++;
+  }
+  CHECK(batch_acc == FILL_ACC && batch_gyr == FILL_ACC && batch_ts == timestamps);
+  CHECK(bad_counts == 0);
+
+  //Decimated timestamps stamp TS_DECIMATION batches
+  start_fifo(imu, LSM6DSOX_BDR_104_HZ, LSM6DSOX_TS_DEC_8);
+  double t0 = bus.now();
+  bus.advance(FILL_S);
+  if(!CHECK(imu->read_fifo(samples, FIFO_WORDS) == 2 * FILL_ACC))
+    return;
+  for(int i = 0; i < 2 * FILL_ACC; i++){
+    int period = i / 2;
+    CHECK(samples[i].type == (i % 2 ? LSM6DSOX_SAMPLE_GYR : LSM6DSOX_SAMPLE_ACC));
+    CHECK_NEAR(samples[i].timestamp * TIMESTAMP_LSB_S - t0,
+               (period / TS_DECIMATION * TS_DECIMATION + 1) / ACC_BDR_HZ, TIMESTAMP_LSB_S);
+  }
+}
+
+static void check_fifo_flags(LSM6DSOX *imu){
+  lsm6dsox_fifo_sample samples[FIFO_WORDS];
+  lsm6dsox_fifo_status status;
+
+  CHECK(imu->set_fsr(ACC_2_G_FSR, GYR_250_DPS_FSR) == 0);
+  start_fifo(imu);
+  bus.advance(FILL_S);
+
+  //The watermark flag follows the level
+  CHECK(imu->set_fifo_watermark(FILL_WORDS + 1) == 0);
+  CHECK(imu->get_fifo_status(&status) == 0);
+  CHECK(!status.watermark);
+  CHECK(imu->set_fifo_watermark(FILL_WORDS) == 0);
+  CHECK(imu->get_fifo_status(&status) == 0);
+  CHECK(status.watermark);
+
+  //Continuous mode: the oldest words are overwritten and the overrun is
+  //reported once
+  bus.advance(FIFO_WORDS / ACC_BDR_HZ);
+  CHECK(imu->get_fifo_status(&status) == 0);
+  CHECK(status.level == FIFO_WORDS);
+  CHECK(status.full && status.overrun && status.watermark);
+  CHECK(imu->get_fifo_status(&status) == 0);
+  CHECK(status.full && !status.overrun);
+  int n = imu->read_fifo(samples, FIFO_WORDS);
+  CHECK(n > 0 && samples[0].type == LSM6DSOX_SAMPLE_ACC && samples[0].x > FILL_S);
+
+  //Stop-on-full mode: the first words are kept
+  double t0 = start_fifo(imu);
+  CHECK(imu->set_fifo_mode(LSM6DSOX_FIFO_BYPASS) == 0);
+  CHECK(imu->set_fifo_mode(LSM6DSOX_FIFO_STOP_FULL) == 0);
+  bus.advance(2 * FIFO_WORDS / ACC_BDR_HZ);
+  CHECK(imu->get_fifo_status(&status) == 0);
+  CHECK(status.level == FIFO_WORDS);
+  CHECK(status.full && status.overrun);
+  n = imu->read_fifo(samples, FIFO_WORDS);
+  CHECK(n > 0 && samples[0].type == LSM6DSOX_SAMPLE_ACC);
+  CHECK_NEAR(samples[0].timestamp * TIMESTAMP_LSB_S - t0, 1 / ACC_BDR_HZ, TIMESTAMP_LSB_S);
+
+  //Bypass clears it
+  CHECK(imu->set_fifo_mode(LSM6DSOX_FIFO_BYPASS) == 0);
+  CHECK(imu->get_fifo_status(&status) == 0);
+  CHECK(status.level == 0 && !status.full && !status.overrun);
+}
+
+static void check_motion(LSM6DSOX *imu){
+  lsm6dsox_motion_events events;
+  const uint8_t face_up = 0x20, x_up = 0x02;   //ZH and XH
+
+  CHECK(imu->set_fsr(ACC_2_G_FSR, GYR_250_DPS_FSR) == 0);
+  sim_lsm.set_acc_signals(0.0f, 0.0f, 1.0f);
+
+  CHECK(imu->set_wake_up(3.0f, 0) == -1);       //Over the full scale range
+  CHECK(imu->set_wake_up(0.5f, 4) == -1);
+  CHECK(imu->set_6d(LSM6DSOX_6D_THS_50_DEG + 1) == -1);
+
+  CHECK(imu->set_wake_up(0.5f, 0) == 0);
+  CHECK(imu->set_6d(LSM6DSOX_6D_THS_60_DEG) == 0);
+  CHECK(imu->set_int_route(LSM6DSOX_INT1, LSM6DSOX_INT_WAKE_UP | LSM6DSOX_INT_6D) == 0);
+
+  //The first position is a change
+  bus.advance(0.1);
+  CHECK(imu->get_motion_events(&events) == 0);
+  CHECK(!events.wake_up);
+  CHECK(events.orientation_change && events.orientation == face_up);
+
+  //Read events are cleared, the position stays
+  bus.advance(0.1);
+  CHECK(imu->get_motion_events(&events) == 0);
+  CHECK(!events.wake_up && !events.orientation_change);
+  CHECK(events.orientation == face_up);
+
+  //A slow turn under the wake-up threshold per sample
+  double t0 = bus.now();
+  sim_lsm.set_acc_signals(I2CSimulator::Signal([t0](double t){ return t < t0 + 1 ? (float)(t - t0) : 1.0f; }),
+                          0.0f, I2CSimulator::Signal([t0](double t){ return t < t0 + 1 ? (float)(1 - (t - t0)) : 0.0f; }));
+  bus.advance(1.1);
+  CHECK(imu->get_motion_events(&events) == 0);
+  CHECK(!events.wake_up);
+  CHECK(events.orientation_change && events.orientation == x_up);
+
+  //A knock back to face up, latched until it is read
+  t0 = bus.now() + 0.05;
+  sim_lsm.set_acc_signals(I2CSimulator::Signal([t0](double t){ return t < t0 ? 1.0f : 0.0f; }),
+                          0.0f, I2CSimulator::Signal([t0](double t){ return t < t0 ? 0.0f : 1.0f; }));
+  bus.advance(0.5);
+  bus.advance(0.5);
+  CHECK(imu->get_motion_events(&events) == 0);
+  CHECK(events.wake_up && events.wake_up_axes == 0x05);    //x and z
+  CHECK(events.orientation_change && events.orientation == face_up);
+  CHECK(imu->get_motion_events(&events) == 0);
+  CHECK(!events.wake_up && events.wake_up_axes == 0 && !events.orientation_change);
+
+  //Without the detectors routed nothing is reported
+  CHECK(imu->set_int_route(LSM6DSOX_INT1, 0) == 0);
+  t0 = bus.now() + 0.05;
+  sim_lsm.set_acc_signals(I2CSimulator::Signal([t0](double t){ return t < t0 ? 0.0f : 1.0f; }),
+                          0.0f, I2CSimulator::Signal([t0](double t){ return t < t0 ? 1.0f : 0.0f; }));
+  bus.advance(0.1);
+  CHECK(imu->get_motion_events(&events) == 0);
+  CHECK(!events.wake_up && !events.orientation_change);
+}
+
+int main(){
+  bus.attach(&sim_lsm);
+  I2C_Master::set_backend(&bus);
+
+  LSM6DSOX imu(LSM6DSOX_416_HZ_ODR, LSM6DSOX_416_HZ_ODR);
+
+  check_read_all(&imu);
+  check_read_fifo(&imu);
+  check_read_fifo_raw(&imu);
+  check_equal_rates(&imu);
+  check_fifo_flags(&imu);
+  check_motion(&imu);
+
+  return check_summary("lsm6dsox_check");
+}
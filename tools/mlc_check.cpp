@@ -0,0 +1,99 @@
+/**
+  ******************************************************************************
+  * @file   mlc_check.cpp
+  * @brief  Machine Learning Core Reference Model Checks.
+  *
+  * @note   End-of-degree work.
+  *         Host check that feeds MLC_Reference windows with known content and
+  *         verifies the features and the decision tree class they give.
+  *
+  *         Build and run: make -C tools check
+  ******************************************************************************
+*/
+
+/* Includes ------------------------------------------------------------------*/
+#include <cmath>
+#include "check.h"
+#include "../src/LSM6DSOX/mlc_reference.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define WINDOW      52    //Samples per window, 2 s at 26 Hz
+#define TOLERANCE   1e-4f
+
+/* Private variables----------------------------------------------------------*/
+static const mlc_feature_conf features[] = {
+  {MLC_INPUT_ACC_Z, MLC_FEATURE_MEAN, 0},
+  {MLC_INPUT_ACC_Z, MLC_FEATURE_VARIANCE, 0},
+  {MLC_INPUT_ACC_Z, MLC_FEATURE_PEAK_TO_PEAK, 0},
+  {MLC_INPUT_ACC_X, MLC_FEATURE_ZERO_CROSSING, 0},
+  {MLC_INPUT_ACC_X, MLC_FEATURE_POS_PEAK_DETECTOR, 0.5f},
+  {MLC_INPUT_ACC_V, MLC_FEATURE_MAXIMUM, 0},
+  {MLC_INPUT_GYR_V, MLC_FEATURE_MINIMUM, 0},
+};
+#define FEATURES_LEN  ((int)(sizeof(features) / sizeof(features[0])))
+
+//Still (0) if the z variance is low, otherwise walking (1) or shaking (2) by the x crossings
+static const mlc_tree_node tree[] = {
+  {1, 0.01f, 1, 2, 0},
+  {-1, 0, 0, 0, 0},
+  {3, 10.0f, 3, 4, 0},
+  {-1, 0, 0, 0, 1},
+  {-1, 0, 0, 0, 2},
+};
+#define TREE_LEN      ((int)(sizeof(tree) / sizeof(tree[0])))
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief Pushes a window where x alternates `period` samples over and under
+  *        zero and z alternates 1 +- `swing`.
+  *
+  * @return The number of completed windows.
+  */
+static int push_window(MLC_Reference *mlc, int period, float swing){
+  int completed = 0;
+  for(int i = 0; i < WINDOW; i++){
+    float sign = (i / period) % 2 ? -1.0f : 1.0f;
+    float acc[3] = {sign * (i % period == period / 2 ? 1.0f : 0.25f), 0, 1.0f + (i % 2 ? -swing : swing)};
+    float gyr[3] = {0, 0, 2.0f};
+    completed += mlc->push(acc, gyr);
+  }
+  return completed;
+}
+
+int main(){
+  MLC_Reference mlc(features, FEATURES_LEN, WINDOW);
+  float values[FEATURES_LEN];
+
+  CHECK(mlc.get_features(values) == -1);
+
+  //Slow x swings, small z swing
+  CHECK(push_window(&mlc, 13, 0.05f) == 1);
+  CHECK(mlc.get_features(values) == 0);
+  CHECK_NEAR(values[0], 1.0f, TOLERANCE);
+  CHECK_NEAR(values[1], 0.05f * 0.05f, TOLERANCE);
+  CHECK_NEAR(values[2], 0.1f, TOLERANCE);
+  CHECK_NEAR(values[3], 3, 0);    //Sign changes at 13, 26 and 39
+  CHECK_NEAR(values[4], 2, 0);    //At 6 and 32, the one at 45 is negative
+  CHECK_NEAR(values[5], std::sqrt(1.0f + 1.05f * 1.05f), TOLERANCE);
+  CHECK_NEAR(values[6], 2.0f, TOLERANCE);
+  CHECK(MLC_Reference::evaluate_tree(tree, TREE_LEN, values) == 0);
+
+  //Walking: same crossings, z swings
+  CHECK(push_window(&mlc, 13, 0.3f) == 1);
+  CHECK(mlc.get_features(values) == 0);
+  CHECK_NEAR(values[1], 0.09f, TOLERANCE);
+  CHECK(MLC_Reference::evaluate_tree(tree, TREE_LEN, values) == 1);
+
+  //Shaking: x changes sign every 2 samples
+  CHECK(push_window(&mlc, 2, 0.3f) == 1);
+  CHECK(mlc.get_features(values) == 0);
+  CHECK_NEAR(values[3], 25, 0);
+  CHECK(MLC_Reference::evaluate_tree(tree, TREE_LEN, values) == 2);
+
+  //A loop never reaches a leaf
+  const mlc_tree_node loop[] = {{0, 0, 1, 1, 0}, {0, 0, 0, 0, 0}};
+  CHECK(MLC_Reference::evaluate_tree(loop, 2, values) == -1);
+
+  return check_summary("mlc_check");
+}
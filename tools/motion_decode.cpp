@@ -0,0 +1,101 @@
+/**
+  ******************************************************************************
+  * @file   motion_decode.cpp
+  * @brief  Motion Stream Decoder Tool.
+  *
+  * @note   End-of-degree work.
+  *         Host tool that converts a file of MotionCodec blocks, as written by
+  *         the cabin controller with --motion-log, to CSV:
+  *
+  *           time_s,type,x,y,z
+  *
+  *         with the values in physical units (g or dps). Corrupted blocks are
+  *         skipped by scanning for the next block magic. A summary is printed
+  *         to stderr.
+  *
+  *         Build: make -C tools motion_decode
+  *         Usage: motion_decode <motion.bin> [output.csv]
+  ******************************************************************************
+*/
+
+/* Includes ------------------------------------------------------------------*/
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "../src/MotionCodec/MotionCodec.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define TYPE_ACC  0x02    //LSM6DSOX_SAMPLE_ACC
+#define TYPE_GYR  0x01    //LSM6DSOX_SAMPLE_GYR
+#define JSON_BYTES_PER_SAMPLE 40  //{"x":-0.0123,"y":0.0456,"z":0.9987} and separator
+
+/* Functions -----------------------------------------------------------------*/
+
+int main(int argc, char *argv[]){
+  if(argc < 2){
+    fprintf(stderr, "Usage: %s <motion.bin> [output.csv]\n", argv[0]);
+    return 1;
+  }
+
+  FILE *in = fopen(argv[1], "rb");
+  if(in == NULL){
+    perror(argv[1]);
+    return 1;
+  }
+  FILE *out = argc > 2 ? fopen(argv[2], "w") : stdout;
+  if(out == NULL){
+    perror(argv[2]);
+    fclose(in);
+    return 1;
+  }
+
+  std::vector<uint8_t> data;
+  uint8_t chunk[4096];
+  size_t len;
+  while((len = fread(chunk, 1, sizeof(chunk), in)) > 0)
+    data.insert(data.end(), chunk, chunk + len);
+  fclose(in);
+
+  static int16_t raw[MOTION_BLOCK_MAX_SAMPLES * 3];
+  motion_block_info info;
+  size_t pos = 0;
+  long blocks = 0, samples = 0, corrupted = 0;
+
+  fprintf(out, "time_s,type,x,y,z\n");
+  while(pos < data.size()){
+    int block_len = MotionCodec::decode_block(&data[pos], data.size() - pos, &info, raw, MOTION_BLOCK_MAX_SAMPLES);
+
+    if(block_len == 0)
+      break;    //Truncated last block
+    if(block_len < 0){
+      corrupted++;
+      pos++;
+      while(pos + 1 < data.size() && !(data[pos] == 'M' && data[pos + 1] == 'B'))
+        pos++;
+      continue;
+    }
+
+    const char *type = info.type == TYPE_ACC ? "acc" : (info.type == TYPE_GYR ? "gyr" : "unknown");
+    for(int i = 0; i < info.samples; i++){
+      double t = (info.t0_us + (uint64_t)i * info.period_us) / 1e6;
+      fprintf(out, "%.6f,%s,%.5f,%.5f,%.5f\n", t, type,
+              raw[3 * i] * info.lsb, raw[3 * i + 1] * info.lsb, raw[3 * i + 2] * info.lsb);
+    }
+
+    blocks++;
+    samples += info.samples;
+    pos += block_len;
+  }
+
+  if(out != stdout)
+    fclose(out);
+
+  fprintf(stderr, "%ld blocks, %ld samples, %ld corrupted, %zu bytes", blocks, samples, corrupted, data.size());
+  if(samples > 0)
+    fprintf(stderr, " (%.2f bytes/sample, %.0f%% of raw, %.0f%% of JSON)",
+            (double)data.size() / samples, 100.0 * data.size() / (samples * 6.0),
+            100.0 * data.size() / (samples * (double)JSON_BYTES_PER_SAMPLE));
+  fprintf(stderr, "\n");
+
+  return corrupted > 0 ? 2 : 0;
+}
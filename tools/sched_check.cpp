@@ -0,0 +1,175 @@
+/**
+  ******************************************************************************
+  * @file   sched_check.cpp
+  * @brief  I2C Bus Scheduler Checks.
+  *
+  * @note   End-of-degree work.
+  *         Host check of the order in which the I2C Handler grants the bus to
+  *         waiting clients: those whose deadline has expired first, by
+  *         earliest deadline, then by priority, then in arrival order. A
+  *         backend holds the bus with a first transaction while client
+  *         threads queue behind it, and records who is served next once it
+  *         is released. The wait metrics of every client are then checked.
+  *         The waits are real, so it takes about half a second.
+  *
+  *         Build and run: make -C tools check
+  ******************************************************************************
+*/
+
+/* Includes ------------------------------------------------------------------*/
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include "check.h"
+#include "../src/i2c_master/i2c_master.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define DEVICE_ADDR       0x10
+#define QUEUE_MS          20        //Time given to a client thread to queue
+#define HOLD_MS           100       //Bus held after the last client queued
+#define LONG_DEADLINE_US  10000000  //Never expires during the check
+
+/* Private types -------------------------------------------------------------*/
+
+/**
+ * @brief Backend that records the client of every transaction and can keep
+ *        the first one of a round on the bus until it is released.
+ */
+class Gate_backend : public I2C_Backend{
+  std::mutex mutex;
+  std::condition_variable cond;
+  bool holding = false;
+  bool held = false;
+public:
+  std::vector<int> order;
+
+  //The next transaction stays on the bus until release()
+  void hold(){
+    std::lock_guard<std::mutex> lock(mutex);
+    holding = true;
+    held = false;
+    order.clear();
+  }
+
+  void wait_held(){
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [this]() { return held; });
+  }
+
+  void release(){
+    std::lock_guard<std::mutex> lock(mutex);
+    holding = false;
+    cond.notify_all();
+  }
+
+  int open(int i2c_device) override { return 0; }
+  int close() override { return 0; }
+
+  int write_msg(uint8_t addr, uint8_t data[], uint8_t data_length) override {
+    return read_msg(addr, data_length > 0 ? data[0] : 0, data, data_length);
+  }
+
+  int read_msg(uint8_t addr, uint8_t read_reg, uint8_t data[], uint8_t data_length) override {
+    std::unique_lock<std::mutex> lock(mutex);
+    order.push_back(I2C_Master::get_thread_client());
+    if(holding && !held){
+      held = true;
+      cond.notify_all();
+      cond.wait(lock, [this]() { return !holding; });
+    }
+    return data_length;
+  }
+};
+
+/* Private variables----------------------------------------------------------*/
+static Gate_backend gate;
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief One transaction on behalf of a client.
+  */
+static void transaction(int client){
+  uint8_t data[2];
+  I2C_Master::set_thread_client(client);
+  CHECK(I2C_Master::read_msg(DEVICE_ADDR, 0x00, data, sizeof(data)) >= 0);
+}
+
+/**
+  * @brief Holds the bus with a default client transaction, queues the clients
+  *        in the given order and releases the bus.
+  *
+  * @return The clients in the order they got the bus, the holder first.
+  */
+static std::vector<int> run_round(const std::vector<int> &arrivals){
+  std::vector<std::thread> threads;
+
+  gate.hold();
+  threads.emplace_back(transaction, I2C_DEFAULT_CLIENT);
+  gate.wait_held();
+
+  for(int client : arrivals){
+    threads.emplace_back(transaction, client);
+    std::this_thread::sleep_for(std::chrono::milliseconds(QUEUE_MS));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(HOLD_MS));
+  gate.release();
+
+  for(std::thread &t : threads)
+    t.join();
+  return gate.order;
+}
+
+int main(){
+  I2C_Master::set_backend(&gate);
+  CHECK(I2C_Master::start(1) == 0);
+
+  //register_client() binds the client to the calling thread, so the main
+  //thread goes back to the default one afterwards
+  int background = I2C_Master::register_client("background", I2C_PRIO_BACKGROUND, I2C_NO_DEADLINE);
+  int normal = I2C_Master::register_client("normal", I2C_PRIO_NORMAL, I2C_NO_DEADLINE);
+  int high = I2C_Master::register_client("high", I2C_PRIO_HIGH, I2C_NO_DEADLINE);
+  int critical = I2C_Master::register_client("critical", I2C_PRIO_CRITICAL, I2C_NO_DEADLINE);
+  int late_normal = I2C_Master::register_client("late normal", I2C_PRIO_NORMAL, 5000);
+  int late_background = I2C_Master::register_client("late background", I2C_PRIO_BACKGROUND, 2000);
+  int on_time = I2C_Master::register_client("on time", I2C_PRIO_CRITICAL, LONG_DEADLINE_US);
+  CHECK(on_time == I2C_MAX_CLIENTS - 1);
+  CHECK(I2C_Master::register_client("one too many", I2C_PRIO_NORMAL, I2C_NO_DEADLINE) == -1);
+  CHECK(I2C_Master::set_thread_client(I2C_DEFAULT_CLIENT) == 0);
+  for(int client = 0; client < I2C_MAX_CLIENTS; client++)
+    CHECK(I2C_Master::reset_client_stats(client) == 0);
+
+  //Without deadlines: by priority, then in arrival order
+  std::vector<int> order = run_round({background, normal, high, normal, critical});
+  CHECK(order == std::vector<int>({I2C_DEFAULT_CLIENT, critical, high, normal, normal, background}));
+
+  //Expired deadlines go first, the earliest one first, whatever the priority.
+  //The deadline of the late normal client expires before the one of the
+  //late background client, which queues after it.
+  order = run_round({late_normal, late_background, critical, on_time});
+  CHECK(order == std::vector<int>({I2C_DEFAULT_CLIENT, late_normal, late_background, critical, on_time}));
+
+  //Wait metrics
+  const int transactions[I2C_MAX_CLIENTS] = {2, 1, 2, 1, 2, 1, 1, 1};
+  for(int client = 0; client < I2C_MAX_CLIENTS; client++){
+    i2c_client_stats stats;
+    CHECK(I2C_Master::get_client_stats(client, &stats) == 0);
+    CHECK(stats.transactions == (uint32_t)transactions[client]);
+    CHECK(stats.total_wait_us >= stats.max_wait_us);
+    CHECK(stats.total_wait_us <= (uint64_t)stats.max_wait_us * stats.transactions);
+
+    //The holder finds the bus free, every other client waits for its release
+    if(client == I2C_DEFAULT_CLIENT)
+      CHECK(stats.max_wait_us == 0);
+    else
+      CHECK(stats.max_wait_us >= HOLD_MS * 1000);
+
+    bool missed = client == late_normal || client == late_background;
+    CHECK(stats.missed_deadlines == (missed ? 1u : 0u));
+  }
+  CHECK(I2C_Master::get_client_stats(I2C_MAX_CLIENTS, NULL) == -1);
+
+  I2C_Master::end();
+  return check_summary("sched_check");
+}
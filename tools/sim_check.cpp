@@ -0,0 +1,301 @@
+/**
+  ******************************************************************************
+  * @file   sim_check.cpp
+  * @brief  Driver Checks Against the I2C Simulator.
+  *
+  * @note   End-of-degree work.
+  *         Host check that runs the BME688 and APDS9660 drivers against the
+  *         simulated sensors and verifies that they read back the simulated
+  *         signals, that the BME688 heater profiles can be changed and left,
+  *         that long bursts survive a trace and replay, that two devices at
+  *         the same address on different buses are traced and replayed
+  *         apart, that the asynchronous
+  *         worker can be stopped while requests restart it, and that a missing
+  *         device is reported as an error and probed by a single caller
+  *         after its quarantine.
+  *         The simulated bus runs on the wall clock, so it takes about a
+  *         second.
+  *
+  *         Build and run: make -C tools check
+  ******************************************************************************
+*/
+
+/* Includes ------------------------------------------------------------------*/
+#include <thread>
+#include <atomic>
+#include <cstring>
+#include "check.h"
+#include "../src/I2CSimulator/sim_devices.h"
+#include "../src/i2c_master/i2c_master.h"
+#include "../src/i2c_master/i2c_async.h"
+#include "../src/i2c_master/i2c_replay.h"
+#include "../src/BME688/BME688.h"
+#include "../src/APDS9660/APDS9660_lib.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define SIM_TEMPERATURE   21.0f
+#define SIM_PRESSURE      99000.0f
+#define SIM_HUMIDITY      55.0f
+#define SIM_GAS           80000.0f
+#define TRACE_FILE        "sim_check_trace.bin"
+#define QUARANTINE_MS     200
+#define ASYNC_RESTARTS    200
+#define LSM_CTRL1_XL      0x10
+#define LSM_OUTX_L_A      0x28
+#define LSM_416_HZ_2_G    0x60
+#define BUS_READS         4
+
+/* Private variables----------------------------------------------------------*/
+static I2CSimulator::Bus bus;
+static I2CSimulator::BME688_device sim_bme;
+static I2CSimulator::APDS9660_device sim_apds;
+static I2CSimulator::Bus second_bus;
+static I2CSimulator::LSM6DSOX_device sim_lsm[2];
+
+/* Functions -----------------------------------------------------------------*/
+
+static void check_bme688(BME688 *gas_sensor){
+  float temp = 0, press = 0, humid = 0, gas_resistance = 0;
+
+  CHECK(gas_sensor->init() == 0);
+  CHECK(gas_sensor->set_oversamplings(OVSP_4_X, OVSP_4_X, OVSP_4_X) == 0);
+  CHECK(gas_sensor->set_heater_configurations(true, 320, 30) == 0);
+
+  //Blocking measure
+  CHECK(gas_sensor->get_data_one_measure(&temp, &press, &humid, &gas_resistance) == 0);
+  CHECK_NEAR(temp, SIM_TEMPERATURE, 0.05);
+  CHECK_NEAR(press, SIM_PRESSURE, 10);
+  CHECK_NEAR(humid, SIM_HUMIDITY, 0.1);
+  CHECK_NEAR(gas_resistance, SIM_GAS, SIM_GAS * 0.01);
+
+  //Non-blocking measure
+  temp = 0;
+  CHECK(gas_sensor->start_measurement() == 0);
+  int res;
+  while((res = gas_sensor->poll_result(&temp, NULL, NULL, NULL)) == 1)
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  CHECK(res == 0);
+  CHECK_NEAR(temp, SIM_TEMPERATURE, 0.05);
+
+  //Sequential profile, changed while it runs
+  const float temps[2] = {200, 320};
+  const uint16_t durations[2] = {20, 30};
+  bme688_field_data fields[BME688_N_DATA_FIELDS];
+  CHECK(gas_sensor->set_heater_profile(BME688_SEQUENTIAL_MODE, temps, durations, 2) == 0);
+  CHECK(gas_sensor->start_profile() == 0);
+  std::this_thread::sleep_for(std::chrono::microseconds(gas_sensor->get_profile_duration()));
+  CHECK(gas_sensor->set_heater_profile(BME688_SEQUENTIAL_MODE, temps, durations, 1) == 0);
+  CHECK(gas_sensor->start_profile() == 0);
+  std::this_thread::sleep_for(std::chrono::microseconds(2 * gas_sensor->get_profile_duration()));
+  int n = gas_sensor->read_fields(fields, BME688_N_DATA_FIELDS);
+  CHECK(n > 0);
+  for(int i = 0; i < n; i++)
+    CHECK(fields[i].gas_index == 0);
+
+  //No forced measure with the profile steps loaded
+  CHECK(gas_sensor->get_data_one_measure(&temp, NULL, NULL, NULL) == -1);
+  CHECK(gas_sensor->start_measurement() == -1);
+  CHECK(gas_sensor->stop_profile() == 0);
+  CHECK(gas_sensor->set_heater_configurations(true, 320, 30) == 0);
+  CHECK(gas_sensor->get_data_one_measure(NULL, NULL, NULL, &gas_resistance) == 0);
+  CHECK_NEAR(gas_resistance, SIM_GAS, SIM_GAS * 0.01);
+}
+
+
+static void check_apds9660(){
+  APDS9660 apds;
+  color_data dim, bright;
+
+  //64 cycles, so the counts are well over the quantization
+  CHECK(apds.conf_rgbc(0) == 0);
+  CHECK(apds.conf_als_range(0, 0xC0) == 0);
+
+  sim_apds.set_illuminance_signal(50);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  CHECK(apds.read_rgbc(&dim) == 0);
+
+  sim_apds.set_illuminance_signal(200);
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  CHECK(apds.read_rgbc(&bright) == 0);
+
+  //The counts follow the illuminance
+  CHECK(dim.clear > 0);
+  CHECK_NEAR((double)bright.clear / dim.clear, 4, 0.2);
+
+  //A stored sample keeps its range after the sensor is re-ranged
+  CHECK(apds.conf_als_range(2, 0x80) == 0);
+  CHECK_NEAR(apds.calc_illuminance(dim), dim.lux, 1e-3);
+  CHECK_NEAR(apds.calc_illuminance(bright), 4 * dim.lux, 0.2 * dim.lux);
+}
+
+
+static void check_trace_replay(){
+  uint8_t burst[252], replayed[252];
+  I2C_Replay replay;
+
+  //A burst as long as an LSM6DSOX FIFO read, taken from the BME688 register map
+  I2C_Master::reset_trace();
+  I2C_Master::set_trace(true);
+  CHECK(I2C_Master::read_msg(I2CSimulator::BME688_SIM_ADDR, 0x00, burst, sizeof(burst)) >= 0);
+  I2C_Master::set_trace(false);
+  CHECK(I2C_Master::dump_trace(TRACE_FILE) == 1);
+
+  CHECK(replay.load(TRACE_FILE) == 1);
+  CHECK(replay.read_msg(I2CSimulator::BME688_SIM_ADDR, 0x00, replayed, sizeof(replayed)) >= 0);
+  CHECK(std::memcmp(burst, replayed, sizeof(burst)) == 0);
+  CHECK(replay.get_mismatches() == 0);
+  std::remove(TRACE_FILE);
+}
+
+
+/**
+ * @brief Two LSM6DSOX at the same address on buses 0 and 1, with opposite
+ *        accelerations, traced and replayed with one backend per bus.
+ */
+static void check_trace_buses(){
+  uint8_t ctrl[2] = {LSM_CTRL1_XL, LSM_416_HZ_2_G};
+  uint8_t recorded[2][BUS_READS][6], replayed[6];
+  i2c_trace_record records[2 * BUS_READS + 2];
+  i2c_latency_histogram hist;
+  I2C_Replay replay_0(false, 0), replay_1(false, 1);
+  I2C_Replay *replay[2] = {&replay_0, &replay_1};
+
+  sim_lsm[0].set_acc_signals(0.5f, 0.0f, 0.0f);
+  sim_lsm[1].set_acc_signals(-0.5f, 0.0f, 0.0f);
+  bus.attach(&sim_lsm[0]);
+  second_bus.attach(&sim_lsm[1]);
+  CHECK(I2C_Master::set_bus_backend(1, &second_bus) == 0);
+  CHECK(I2C_Master::start_bus(1, 2) == 0);
+
+  I2C_Master::reset_trace();
+  I2C_Master::set_trace(true);
+  for(int b = 0; b < 2; b++)
+    CHECK(I2C_Master::write_msg_bus(b, I2CSimulator::LSM6DSOX_SIM_ADDR, ctrl, 2) >= 0);
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  for(int i = 0; i < BUS_READS; i++){
+    for(int b = 0; b < 2; b++)
+      CHECK(I2C_Master::read_msg_bus(b, I2CSimulator::LSM6DSOX_SIM_ADDR, LSM_OUTX_L_A, recorded[b][i], 6) >= 0);
+  }
+  I2C_Master::set_trace(false);
+
+  //The accelerations tell the devices apart, and the records their buses
+  CHECK((int16_t)(recorded[0][0][1] << 8 | recorded[0][0][0]) > 0);
+  CHECK((int16_t)(recorded[1][0][1] << 8 | recorded[1][0][0]) < 0);
+  int len = I2C_Master::read_trace(records, 2 * BUS_READS + 2);
+  CHECK(len == 2 * BUS_READS + 2);
+  for(int i = 0; i < len; i++)
+    CHECK(records[i].bus == i % 2);
+  for(int b = 0; b < 2; b++){
+    CHECK(I2C_Master::get_latency_histogram_bus(b, I2CSimulator::LSM6DSOX_SIM_ADDR, &hist) == 0);
+    CHECK(hist.count == BUS_READS + 1);
+  }
+  CHECK(I2C_Master::get_latency_histogram_bus(I2C_MAX_BUSES, I2CSimulator::LSM6DSOX_SIM_ADDR, &hist) == -1);
+
+  //Each replay serves the records of its bus
+  CHECK(I2C_Master::dump_trace(TRACE_FILE) == len);
+  for(int b = 0; b < 2; b++){
+    CHECK(replay[b]->load(TRACE_FILE) == len);
+    CHECK(I2C_Master::set_bus_backend(b, replay[b]) == 0);
+  }
+  for(int b = 0; b < 2; b++)
+    CHECK(I2C_Master::write_msg_bus(b, I2CSimulator::LSM6DSOX_SIM_ADDR, ctrl, 2) >= 0);
+  for(int i = 0; i < BUS_READS; i++){
+    for(int b = 0; b < 2; b++){
+      CHECK(I2C_Master::read_msg_bus(b, I2CSimulator::LSM6DSOX_SIM_ADDR, LSM_OUTX_L_A, replayed, 6) >= 0);
+      CHECK(std::memcmp(replayed, recorded[b][i], 6) == 0);
+    }
+  }
+  for(int b = 0; b < 2; b++){
+    CHECK(replay[b]->get_mismatches() == 0);
+    CHECK(replay[b]->finished());
+  }
+
+  CHECK(I2C_Master::set_bus_backend(0, &bus) == 0);
+  CHECK(I2C_Master::set_bus_backend(1, &second_bus) == 0);
+  bus.detach(I2CSimulator::LSM6DSOX_SIM_ADDR);
+  std::remove(TRACE_FILE);
+}
+
+
+static void check_async_restart(){
+  std::atomic<bool> done(false);
+  int completed = 0, rejected = 0;
+
+  //Submits that restart the worker while another thread stops it
+  std::thread stopper([&](){
+    while(!done)
+      I2C_Async::stop();
+  });
+  for(int i = 0; i < ASYNC_RESTARTS; i++){
+    uint8_t id;
+    int result = I2C_Async::submit_read(I2CSimulator::BME688_SIM_ADDR, 0xD0, &id, 1).get();
+    if(result >= 0 && id == 0x61)
+      completed++;
+    else
+      rejected++;
+  }
+  done = true;
+  stopper.join();
+
+  CHECK(completed + rejected == ASYNC_RESTARTS);
+  CHECK(completed > 0);
+  CHECK(I2C_Async::pending() == 0);
+}
+
+
+static void check_missing_device(){
+  uint8_t id;
+  i2c_retry_policy policy, quick = {1, 1000, 1000, 1, QUARANTINE_MS, 10, -1};
+  i2c_device_health dev;
+  i2c_trace_record records[16];
+
+  bus.detach(I2CSimulator::APDS9660_SIM_ADDR);
+  CHECK(I2C_Master::get_retry_policy(&policy) == 0);
+  CHECK(I2C_Master::set_retry_policy(&quick) == 0);
+  CHECK(I2C_Master::read_msg(I2CSimulator::APDS9660_SIM_ADDR, 0x92, &id, 1) == -1);
+  CHECK(I2C_Master::get_device_health(I2CSimulator::APDS9660_SIM_ADDR, &dev) == 0);
+  CHECK(dev.state == I2C_DEV_FAILED);
+
+  //After the quarantine only one of the concurrent callers reaches the bus
+  std::this_thread::sleep_for(std::chrono::milliseconds(QUARANTINE_MS + 50));
+  I2C_Master::reset_trace();
+  I2C_Master::set_trace(true);
+  std::thread callers[4];
+  for(std::thread &caller : callers)
+    caller = std::thread([](){
+      uint8_t value;
+      CHECK(I2C_Master::read_msg(I2CSimulator::APDS9660_SIM_ADDR, 0x92, &value, 1) == -1);
+    });
+  for(std::thread &caller : callers)
+    caller.join();
+  I2C_Master::set_trace(false);
+
+  CHECK(I2C_Master::read_trace(records, 16) == quick.retries + 1);
+  CHECK(I2C_Master::get_device_health(I2CSimulator::APDS9660_SIM_ADDR, &dev) == 0);
+  CHECK(dev.quarantines == 2);
+  CHECK(I2C_Master::set_retry_policy(&policy) == 0);
+}
+
+
+int main(){
+  bus.attach(&sim_bme);
+  bus.attach(&sim_apds);
+  sim_bme.set_signals(SIM_TEMPERATURE, SIM_PRESSURE, SIM_HUMIDITY, SIM_GAS);
+  I2C_Master::set_backend(&bus);
+  I2C_Master::start(1);
+
+  check_apds9660();
+  check_trace_replay();
+  check_trace_buses();
+  check_async_restart();
+  check_missing_device();
+
+  //The driver ends the I2C communications when destroyed
+  {
+    BME688 gas_sensor(25, 0);
+    check_bme688(&gas_sensor);
+  }
+
+  I2C_Async::stop();
+  return check_summary("sim_check");
+}
@@ -0,0 +1,181 @@
+/**
+  ******************************************************************************
+  * @file   vibration_check.cpp
+  * @brief  Vibration Analyzer Checks and Benchmark.
+  *
+  * @note   End-of-degree work.
+  *         Host check that the power spectrum of VibrationAnalyzer matches a
+  *         direct DFT of the same mean-removed, Hann windowed frame at every
+  *         supported length, that a sine on top of gravity gives its frequency,
+  *         amplitude and RMS, that two sines land in their bands, and that a
+  *         spectrum is computed every hop.
+  *
+  *         Then push() is timed with the frame length and hop of the cabin
+  *         controller, VIB_FFT_LEN 256 and VIB_HOP 128 at 416 Hz, and has to
+  *         stay under 1% of a sample period per sample.
+  *
+  *         Build and run: make -C tools check
+  ******************************************************************************
+*/
+
+/* Includes ------------------------------------------------------------------*/
+#include <cmath>
+#include <random>
+#include <vector>
+#include "check.h"
+#include "../src/VibrationAnalyzer/VibrationAnalyzer.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define SAMPLE_RATE       416.0f
+#define VIB_FFT_LEN       256       //As in main.cpp
+#define VIB_HOP           128
+#define BIN_HZ            (SAMPLE_RATE / VIB_FFT_LEN)
+#define GRAVITY           1.0f
+#define DFT_TOLERANCE     1e-4      //Relative to the highest bin, float rounding grows with the length
+#define SINE_TOLERANCE    0.01      //Relative
+#define LEAK_TOLERANCE    1e-3      //Band RMS of the bands without a sine
+#define BENCH_SAMPLES     (416 * 60)
+#define BENCH_CHUNK       64        //Samples per push, as a FIFO drain
+#define PUSH_BUDGET_NS    (1e9 / SAMPLE_RATE / 100)   //1% of a sample period
+
+/* Private variables----------------------------------------------------------*/
+static const float band_edges[] = {2, 10, 30, 80, 200};   //As in main.cpp
+#define BANDS             ((int)(sizeof(band_edges) / sizeof(band_edges[0])) - 1)
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief One sided power spectrum of a frame by the DFT definition, scaled
+  *        as VibrationAnalyzer scales its bins.
+  */
+static std::vector<double> direct_spectrum(const std::vector<float> &frame){
+  int n = frame.size();
+  double mean = 0, window_power = 0;
+  std::vector<double> x(n), power(n / 2 + 1);
+
+  for(int i = 0; i < n; i++)
+    mean += frame[i];
+  mean /= n;
+  for(int i = 0; i < n; i++){
+    double w = 0.5 - 0.5 * std::cos(2 * M_PI * i / n);
+    x[i] = (frame[i] - mean) * w;
+    window_power += w * w;
+  }
+
+  for(int k = 0; k <= n / 2; k++){
+    double re = 0, im = 0;
+    for(int i = 0; i < n; i++){
+      re += x[i] * std::cos(2 * M_PI * k * i / n);
+      im -= x[i] * std::sin(2 * M_PI * k * i / n);
+    }
+    double scale = 2.0 / (n * window_power);
+    power[k] = (re * re + im * im) * ((k == 0 || k == n / 2) ? scale / 2 : scale);
+  }
+  return power;
+}
+
+/**
+  * @brief Gravity plus sines of the given amplitudes and frequencies.
+  */
+static std::vector<float> sines(int len, const float *amplitudes, const float *freqs, int count){
+  std::vector<float> samples(len);
+  for(int i = 0; i < len; i++){
+    samples[i] = GRAVITY;
+    for(int s = 0; s < count; s++)
+      samples[i] += amplitudes[s] * std::sin(2 * M_PI * freqs[s] * i / SAMPLE_RATE);
+  }
+  return samples;
+}
+
+static void check_dft(int fft_len){
+  std::mt19937 rng(fft_len);
+  std::normal_distribution<float> noise(GRAVITY, 0.05f);
+  std::vector<float> frame(fft_len);
+  std::vector<float> bins(fft_len / 2 + 1);
+  VibrationAnalyzer analyzer(fft_len, fft_len, SAMPLE_RATE, band_edges, BANDS);
+
+  for(float &sample : frame)
+    sample = noise(rng);
+  CHECK(analyzer.push(frame.data(), fft_len) == 1);
+  CHECK(analyzer.get_spectrum(bins.data()) == 0);
+
+  std::vector<double> expected = direct_spectrum(frame);
+  double highest = 0, worst = 0;
+  for(int k = 0; k <= fft_len / 2; k++)
+    highest = std::fmax(highest, expected[k]);
+  for(int k = 0; k <= fft_len / 2; k++)
+    worst = std::fmax(worst, std::fabs(bins[k] - expected[k]));
+  CHECK_NEAR(worst / highest, 0, DFT_TOLERANCE);
+}
+
+static void check_sine(){
+  const float amplitude = 0.3f, freq = 13 * BIN_HZ;
+  std::vector<float> samples = sines(VIB_FFT_LEN, &amplitude, &freq, 1);
+  VibrationAnalyzer analyzer(VIB_FFT_LEN, VIB_HOP, SAMPLE_RATE, band_edges, BANDS);
+  vibration_features features;
+
+  CHECK(analyzer.push(samples.data(), VIB_FFT_LEN) == 1);
+  CHECK(analyzer.get_features(&features) == 0);
+  CHECK_NEAR(features.peak_freq, freq, 1e-3);
+  CHECK_NEAR(features.peak_amplitude, amplitude, amplitude * SINE_TOLERANCE);
+  CHECK_NEAR(features.rms, amplitude / M_SQRT2, amplitude * SINE_TOLERANCE);
+}
+
+static void check_bands(){
+  const float amplitudes[2] = {0.2f, 0.1f};
+  const float freqs[2] = {3 * BIN_HZ, 31 * BIN_HZ};     //In 2-10 Hz and in 30-80 Hz
+  std::vector<float> samples = sines(VIB_FFT_LEN, amplitudes, freqs, 2);
+  VibrationAnalyzer analyzer(VIB_FFT_LEN, VIB_HOP, SAMPLE_RATE, band_edges, BANDS);
+  vibration_features features;
+
+  CHECK(analyzer.push(samples.data(), VIB_FFT_LEN) == 1);
+  CHECK(analyzer.get_features(&features) == 0);
+  CHECK(features.bands == BANDS);
+  CHECK_NEAR(features.band_rms[0], amplitudes[0] / M_SQRT2, amplitudes[0] * SINE_TOLERANCE);
+  CHECK_NEAR(features.band_rms[1], 0, LEAK_TOLERANCE);
+  CHECK_NEAR(features.band_rms[2], amplitudes[1] / M_SQRT2, amplitudes[1] * SINE_TOLERANCE);
+  CHECK_NEAR(features.band_rms[3], 0, LEAK_TOLERANCE);
+  CHECK_NEAR(features.peak_freq, freqs[0], 1e-3);
+}
+
+static void check_hop(){
+  std::vector<float> samples(VIB_FFT_LEN + 5 * VIB_HOP + VIB_HOP / 2, GRAVITY);
+  VibrationAnalyzer analyzer(VIB_FFT_LEN, VIB_HOP, SAMPLE_RATE, band_edges, BANDS);
+  vibration_features features;
+
+  CHECK(analyzer.get_features(&features) == -1);
+  CHECK(analyzer.push(samples.data(), VIB_FFT_LEN - 1) == 0);
+  CHECK(analyzer.push(samples.data(), samples.size() - (VIB_FFT_LEN - 1)) == 6);
+  CHECK(analyzer.get_features(&features) == 0);
+  CHECK(features.frames == 6);
+  CHECK_NEAR(features.rms, 0, 1e-6);
+}
+
+int main(){
+  for(int fft_len = 16; fft_len <= VIBRATION_MAX_FFT_LEN; fft_len *= 2)
+    check_dft(fft_len);
+  check_sine();
+  check_bands();
+  check_hop();
+
+  //Per sample cost at the controller configuration, noisy input
+  std::mt19937 rng(1);
+  std::normal_distribution<float> noise(GRAVITY, 0.05f);
+  std::vector<float> samples(BENCH_SAMPLES);
+  for(float &sample : samples)
+    sample = noise(rng);
+
+  VibrationAnalyzer analyzer(VIB_FFT_LEN, VIB_HOP, SAMPLE_RATE, band_edges, BANDS);
+  int offset = 0, spectra = 0;
+  double ns = bench_ns([&](){
+    spectra += analyzer.push(&samples[offset], BENCH_CHUNK);
+    offset = (offset + BENCH_CHUNK) % BENCH_SAMPLES;
+  }, BENCH_SAMPLES / BENCH_CHUNK * 10) / BENCH_CHUNK;
+  CHECK(spectra > 0);
+
+  printf("push: %.1f ns per sample, %.1f us per spectrum, budget %.0f ns per sample\n",
+         ns, ns * VIB_HOP / 1000, PUSH_BUDGET_NS);
+  CHECK(ns < PUSH_BUDGET_NS);
+
+  return check_summary("vibration_check");
+}